@@ -9,21 +9,40 @@ LOCAL_SRC_FILES := src/shd.c \
 	src/shd_ctx.c \
 	src/shd_section.c \
 	src/shd_mdata_hdr.c \
+	src/shd_schema.c \
+	src/shd_dirty.c \
+	src/shd_rec.c \
+	src/shd_tier.c \
+	src/shd_aggregate.c \
+	src/shd_rate.c \
+	src/shd_sub.c \
+	src/shd_filter.c \
+	src/shd_scan.c \
+	src/shd_col.c \
 	src/shd_hdr.c \
 	src/shd_data.c \
 	src/shd_sync.c \
 	src/shd_sample.c \
 	src/shd_window.c \
 	src/shd_search.c \
+	src/shd_trace.c \
+	src/shd_registry.c \
 	src/backend/shd_dev_mem.c \
 	src/backend/shd_shm.c
 LOCAL_CFLAGS += -DBUILD_TARGET_CPU=$(TARGET_CPU)
 
+# Concurrency hook points are only compiled in test builds
+ifdef TARGET_TEST
+LOCAL_CFLAGS += -DSHD_CONCURRENCY_HOOKS
+endif
+
 LOCAL_EXPORT_C_INCLUDES := $(LOCAL_PATH)/include
 
 LOCAL_C_INCLUDES := \
 	$(LOCAL_PATH)/src
 
+LOCAL_LDLIBS := -lm
+
 LOCAL_LIBRARIES := libshdata-section-lookup libfutils
 
 LOCAL_CONDITIONAL_LIBRARIES := \
@@ -67,6 +86,71 @@ LOCAL_SRC_FILES := examples/stress_test.c examples/common.c
 LOCAL_LIBRARIES := libshdata libfutils
 include $(BUILD_EXECUTABLE)
 
+# Ring index arithmetic microbenchmark
+include $(CLEAR_VARS)
+LOCAL_MODULE := libshdata-ring-index-bench
+LOCAL_CATEGORY_PATH := libs/libshdata/examples
+LOCAL_DESCRIPTION := Microbenchmark of ring index arithmetic in libshdata
+LOCAL_SRC_FILES := examples/ring_index_bench.c
+LOCAL_LIBRARIES := libshdata
+include $(BUILD_EXECUTABLE)
+
+# Software prefetching benchmark
+include $(CLEAR_VARS)
+LOCAL_MODULE := libshdata-prefetch-bench
+LOCAL_CATEGORY_PATH := libs/libshdata/examples
+LOCAL_DESCRIPTION := Benchmark of software prefetching in libshdata reads
+LOCAL_SRC_FILES := examples/prefetch_bench.c
+LOCAL_LIBRARIES := libshdata
+include $(BUILD_EXECUTABLE)
+
+# C++ typed layer benchmark
+include $(CLEAR_VARS)
+LOCAL_MODULE := libshdata-cpp-bench
+LOCAL_CATEGORY_PATH := libs/libshdata/examples
+LOCAL_DESCRIPTION := Comparison of the C++ typed layer of libshdata with its C api
+LOCAL_SRC_FILES := examples/cpp_bench.cpp
+LOCAL_CXXFLAGS := -std=c++17
+LOCAL_LIBRARIES := libshdata
+include $(BUILD_EXECUTABLE)
+
+# Coroutines awaiting commits
+include $(CLEAR_VARS)
+LOCAL_MODULE := libshdata-coro-notify
+LOCAL_CATEGORY_PATH := libs/libshdata/examples
+LOCAL_DESCRIPTION := Coroutines awaiting the commits of a libshdata producer
+LOCAL_SRC_FILES := examples/coro_notify.cpp
+LOCAL_CXXFLAGS := -std=c++20
+LOCAL_LIBRARIES := libshdata
+include $(BUILD_EXECUTABLE)
+
+# Hot paths microbenchmarks
+include $(CLEAR_VARS)
+LOCAL_MODULE := libshdata-bench
+LOCAL_CATEGORY_PATH := libs/libshdata/examples
+LOCAL_DESCRIPTION := Microbenchmarks of libshdata hot paths
+LOCAL_SRC_FILES := examples/bench.c
+LOCAL_LIBRARIES := libshdata
+include $(BUILD_EXECUTABLE)
+
+# Section registry listing
+include $(CLEAR_VARS)
+LOCAL_MODULE := libshdata-list
+LOCAL_CATEGORY_PATH := libs/libshdata/examples
+LOCAL_DESCRIPTION := List the sections recorded in libshdata section registry
+LOCAL_SRC_FILES := examples/list_sections.c
+LOCAL_LIBRARIES := libshdata
+include $(BUILD_EXECUTABLE)
+
+# Section replication over sockets
+include $(CLEAR_VARS)
+LOCAL_MODULE := libshdata-bridge
+LOCAL_CATEGORY_PATH := libs/libshdata/examples
+LOCAL_DESCRIPTION := Replication of libshdata sections over sockets
+LOCAL_SRC_FILES := examples/bridge.c
+LOCAL_LIBRARIES := libshdata
+include $(BUILD_EXECUTABLE)
+
 # Example code
 include $(CLEAR_VARS)
 LOCAL_MODULE := libshdata-1prod-1cons
@@ -102,13 +186,36 @@ LOCAL_SRC_FILES := \
 	tests/shd_test_func_write_adv.c \
 	tests/shd_test_error.c \
 	tests/shd_test_concurrency.c \
+	tests/shd_test_large_section.c \
+	tests/shd_test_registry.c \
+	tests/shd_test_schema.c \
+	tests/shd_test_notify.c \
+	tests/shd_test_dirty.c \
+	tests/shd_test_rec.c \
+	tests/shd_test_tier.c \
+	tests/shd_test_aggregate.c \
+	tests/shd_test_sub.c \
+	tests/shd_test_filter.c \
+	tests/shd_test_col.c \
 	tests/lookup/section_lookup.c
 
 LOCAL_C_INCLUDES := \
 	$(LOCAL_PATH)/src
 
+LOCAL_LDLIBS := -lm
+
 LOCAL_LIBRARIES := libshdata libcunit libshdata-concurrency-hooks-implem
 
 include $(BUILD_EXECUTABLE)
 
+include $(CLEAR_VARS)
+LOCAL_MODULE := tst-libshdata-cpp
+LOCAL_SRC_FILES := \
+	tests/shd_test_cpp.cpp \
+	tests/shd_test_coro.cpp
+LOCAL_CXXFLAGS := -std=c++20
+LOCAL_LIBRARIES := libshdata libcunit
+
+include $(BUILD_EXECUTABLE)
+
 endif
@@ -0,0 +1,597 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file bench.c
+ *
+ * @brief Microbenchmarks of the libshdata hot paths
+ *
+ * @details Each benchmark times every single operation and reports the
+ * distribution of its cost in ns/op (mean, p50, p90, p99, p99.9 and max) as a
+ * JSON document, so that results of two library versions can be compared by a
+ * script. The following operations are measured :
+ *   - shd_write_new_blob()
+ *   - shd_write_new_blobs() on bursts of samples (reported per blob)
+ *   - shd_read_from_sample() on the latest sample
+ *   - shd_select_samples() for each search method, reference sample search
+ * hint and section depth
+ *   - window reads (select + read quantity + end read) of varying sizes
+ *   - shd_open() followed by shd_close()
+ *
+ * Timing each operation adds the cost of two clock reads to the results,
+ * which is the same for all library versions.
+ *
+ * Example command line :
+ *   libshdata-bench -n 10000 -o results.json
+ * ... runs 10000 iterations of each benchmark and writes the results to
+ * results.json (to stdout by default).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include "example_log.h"
+#include "common.h"
+#define SHD_ADVANCED_READ_API
+#include "libshdata.h"
+
+#define BLOB_NAME "bench"
+#define BENCH_RATE 1000 /* in Hz */
+
+struct ex_metadata_blob_hdr ex_metadata_hdr = {
+	.i1 = 0,
+	.i2 = 0xDEAD,
+	.c1 = "Hello",
+};
+
+struct bench_conf {
+	uint32_t iterations;
+	FILE *out;
+};
+
+/* Distribution of the cost of an operation, in ns */
+struct bench_stats {
+	double mean;
+	uint64_t p50;
+	uint64_t p90;
+	uint64_t p99;
+	uint64_t p999;
+	uint64_t max;
+};
+
+static const uint32_t depths[] = { 64, 1024, 16384 };
+#define BENCH_MAX_BURST 32
+static const uint32_t burst_sizes[] = { 1, 8, BENCH_MAX_BURST };
+static const uint32_t window_sizes[] = { 1, 16, 256, 4096 };
+static const char *const hints[] = { "NAIVE", "BINARY", "DATE" };
+static const struct {
+	enum shd_search_method_t method;
+	const char *name;
+} methods[] = {
+	{ SHD_LATEST, "LATEST" },
+	{ SHD_OLDEST, "OLDEST" },
+	{ SHD_CLOSEST, "CLOSEST" },
+	{ SHD_FIRST_AFTER, "FIRST_AFTER" },
+	{ SHD_FIRST_BEFORE, "FIRST_BEFORE" },
+};
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+static bool first_result = true;
+
+static void usage()
+{
+	printf("Microbenchmarks of libshdata hot paths\n");
+	printf("Usage :\n");
+	printf("\tn : number of iterations of each benchmark\n");
+	printf("\to : output file for JSON results (default : stdout)\n");
+
+	exit(0);
+}
+
+static void parse_command(int argc, char *argv[], struct bench_conf *conf)
+{
+	int opt;
+
+	conf->iterations = 10000;
+	conf->out = stdout;
+
+	while ((opt = getopt(argc, argv, "n:o:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			conf->iterations = (uint32_t)strtol(optarg, NULL, 0);
+			break;
+		case 'o':
+			conf->out = fopen(optarg, "w");
+			if (conf->out == NULL) {
+				ULOGI("Could not open %s : %s", optarg,
+						strerror(errno));
+				exit(1);
+			}
+			break;
+		case 'h':
+		default:
+			usage();
+			break;
+		}
+	}
+}
+
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static struct timespec sample_date(uint32_t index)
+{
+	uint64_t ns = (uint64_t)index * (1000000000ULL / BENCH_RATE);
+	struct timespec ts = {
+		.tv_sec = ns / 1000000000ULL,
+		.tv_nsec = ns % 1000000000ULL,
+	};
+
+	return ts;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static void compute_stats(uint64_t *samples, uint32_t n,
+				struct bench_stats *stats)
+{
+	uint64_t sum = 0;
+	uint32_t i;
+
+	qsort(samples, n, sizeof(*samples), &cmp_u64);
+	for (i = 0; i < n; i++)
+		sum += samples[i];
+
+	stats->mean = (double)sum / n;
+	stats->p50 = samples[(uint64_t)n * 50 / 100];
+	stats->p90 = samples[(uint64_t)n * 90 / 100];
+	stats->p99 = samples[(uint64_t)n * 99 / 100];
+	stats->p999 = samples[(uint64_t)n * 999 / 1000];
+	stats->max = samples[n - 1];
+}
+
+/*
+ * Print one result object ; params is a preformatted list of JSON members
+ */
+static void report(const struct bench_conf *conf, const char *name,
+			const char *params, uint64_t *samples)
+{
+	struct bench_stats stats;
+
+	compute_stats(samples, conf->iterations, &stats);
+
+	fprintf(conf->out, "%s\n    {\"name\": \"%s\", \"params\": {%s}, "
+			"\"ns_per_op\": {\"mean\": %.1f, \"p50\": %ju, "
+			"\"p90\": %ju, \"p99\": %ju, \"p99.9\": %ju, "
+			"\"max\": %ju}}",
+			first_result ? "" : ",",
+			name, params, stats.mean,
+			(uintmax_t)stats.p50, (uintmax_t)stats.p90,
+			(uintmax_t)stats.p99, (uintmax_t)stats.p999,
+			(uintmax_t)stats.max);
+	first_result = false;
+}
+
+/*
+ * Create a section of a given depth and fill it one time and a half, so that
+ * the oldest sample sits in the middle of the buffer
+ */
+static struct shd_ctx *create_filled_section(uint32_t depth)
+{
+	struct shd_ctx *ctx;
+	struct shd_sample_metadata sample_meta = { { 0, 0 }, { 0, 0 } };
+	struct shd_hdr_user_info hdr_info = {
+		.blob_size = sizeof(struct example_prod_blob),
+		.max_nb_samples = depth,
+		.rate = BENCH_RATE,
+		.blob_metadata_hdr_size = sizeof(ex_metadata_hdr)
+	};
+	struct example_prod_blob blob;
+	uint32_t i;
+
+	ctx = shd_create(BLOB_NAME, NULL, &hdr_info, &ex_metadata_hdr);
+	if (ctx == NULL) {
+		ULOGI("Could not create section of depth %u", depth);
+		return NULL;
+	}
+
+	memset(&blob, 0, sizeof(blob));
+	for (i = 0; i < depth + depth / 2; i++) {
+		sample_meta.ts = sample_date(i);
+		blob.i1 = i;
+		shd_write_new_blob(ctx, &blob, sizeof(blob), &sample_meta);
+	}
+
+	return ctx;
+}
+
+/*
+ * Open the bench section with a given reference sample search hint
+ */
+static struct shd_ctx *open_section(const char *hint, struct shd_revision **rev)
+{
+	struct shd_ctx *ctx;
+
+	if (hint != NULL)
+		setenv("LIBSHDATA_CONFIG_INTERNAL_SEARCH_METHOD", hint, 1);
+	ctx = shd_open(BLOB_NAME, NULL, rev);
+	unsetenv("LIBSHDATA_CONFIG_INTERNAL_SEARCH_METHOD");
+	if (ctx == NULL)
+		ULOGI("Could not open section");
+
+	return ctx;
+}
+
+static int bench_write(const struct bench_conf *conf, uint64_t *samples)
+{
+	struct shd_ctx *ctx;
+	struct shd_sample_metadata sample_meta = { { 0, 0 }, { 0, 0 } };
+	struct example_prod_blob blob;
+	char params[64];
+	uint64_t start;
+	uint32_t depth = 1024;
+	uint32_t i;
+	int ret = 0;
+
+	ctx = create_filled_section(depth);
+	if (ctx == NULL)
+		return -1;
+
+	memset(&blob, 0, sizeof(blob));
+	for (i = 0; i < conf->iterations; i++) {
+		sample_meta.ts = sample_date(2 * depth + i);
+		start = get_time_ns();
+		ret = shd_write_new_blob(ctx, &blob, sizeof(blob),
+				&sample_meta);
+		samples[i] = get_time_ns() - start;
+		if (ret < 0)
+			goto exit;
+	}
+
+	snprintf(params, sizeof(params), "\"depth\": %u, \"blob_size\": %zu",
+			depth, sizeof(blob));
+	report(conf, "write_new_blob", params, samples);
+
+exit:
+	shd_close(ctx, NULL);
+	return ret;
+}
+
+static int bench_write_burst(const struct bench_conf *conf, uint64_t *samples,
+				uint32_t burst)
+{
+	struct shd_ctx *ctx;
+	struct shd_sample_metadata sample_meta[BENCH_MAX_BURST];
+	struct example_prod_blob blob[BENCH_MAX_BURST];
+	char params[96];
+	uint64_t start;
+	uint32_t depth = 1024;
+	uint32_t i, j;
+	int ret = 0;
+
+	ctx = create_filled_section(depth);
+	if (ctx == NULL)
+		return -1;
+
+	memset(blob, 0, sizeof(blob));
+	for (i = 0; i < conf->iterations; i++) {
+		for (j = 0; j < burst; j++)
+			sample_meta[j].ts = sample_date(2 * depth
+					+ i * burst + j);
+		start = get_time_ns();
+		ret = shd_write_new_blobs(ctx, blob, sizeof(blob[0]),
+				sample_meta, burst);
+		samples[i] = (get_time_ns() - start) / burst;
+		if (ret < 0)
+			goto exit;
+	}
+
+	snprintf(params, sizeof(params), "\"depth\": %u, \"blob_size\": %zu, "
+			"\"burst\": %u", depth, sizeof(blob[0]), burst);
+	report(conf, "write_new_blobs", params, samples);
+
+exit:
+	shd_close(ctx, NULL);
+	return ret;
+}
+
+static int bench_read_latest(const struct bench_conf *conf, uint64_t *samples)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons = NULL;
+	struct shd_revision *rev = NULL;
+	struct shd_sample_search search = {
+		.method = SHD_LATEST,
+	};
+	struct shd_quantity q_i1 = {
+		offsetof(struct example_prod_blob, i1),
+		sizeof(int)
+	};
+	struct shd_quantity_sample qty_sample;
+	int i1;
+	char params[64];
+	uint64_t start;
+	uint32_t depth = 1024;
+	uint32_t i;
+	int ret = -1;
+
+	ctx_prod = create_filled_section(depth);
+	if (ctx_prod == NULL)
+		return -1;
+	ctx_cons = open_section(NULL, &rev);
+	if (ctx_cons == NULL)
+		goto exit;
+
+	qty_sample.ptr = &i1;
+	qty_sample.size = sizeof(i1);
+	for (i = 0; i < conf->iterations; i++) {
+		start = get_time_ns();
+		ret = shd_read_from_sample(ctx_cons, 1, &search, &q_i1,
+				&qty_sample);
+		if (ret >= 0)
+			ret = shd_end_read(ctx_cons, rev);
+		samples[i] = get_time_ns() - start;
+		if (ret < 0)
+			goto exit;
+	}
+
+	snprintf(params, sizeof(params), "\"depth\": %u", depth);
+	report(conf, "read_latest", params, samples);
+
+exit:
+	if (ctx_cons != NULL)
+		shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+	return ret < 0 ? ret : 0;
+}
+
+static int bench_search(const struct bench_conf *conf, uint64_t *samples,
+			uint32_t depth)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons = NULL;
+	struct shd_revision *rev = NULL;
+	struct shd_sample_metadata *metadata;
+	struct shd_search_result result;
+	struct shd_sample_search search = {
+		.nb_values_before_date = 0,
+		.nb_values_after_date = 0,
+	};
+	char params[128];
+	uint64_t start;
+	size_t h, m;
+	uint32_t i;
+	int ret = -1;
+
+	ctx_prod = create_filled_section(depth);
+	if (ctx_prod == NULL)
+		return -1;
+
+	/* Look for a date between two samples in the middle of the valid
+	 * history */
+	search.date = sample_date(depth + depth / 4);
+	search.date.tv_nsec += 1000;
+
+	for (h = 0; h < ARRAY_SIZE(hints); h++) {
+		ctx_cons = open_section(hints[h], &rev);
+		if (ctx_cons == NULL)
+			goto exit;
+
+		for (m = 0; m < ARRAY_SIZE(methods); m++) {
+			search.method = methods[m].method;
+			for (i = 0; i < conf->iterations; i++) {
+				start = get_time_ns();
+				ret = shd_select_samples(ctx_cons, &search,
+						&metadata, &result);
+				if (ret >= 0)
+					ret = shd_end_read(ctx_cons, rev);
+				samples[i] = get_time_ns() - start;
+				if (ret < 0)
+					goto exit;
+			}
+
+			snprintf(params, sizeof(params),
+					"\"method\": \"%s\", \"hint\": \"%s\", "
+					"\"depth\": %u",
+					methods[m].name,
+					hints[h], depth);
+			report(conf, "search", params, samples);
+		}
+
+		shd_close(ctx_cons, rev);
+		ctx_cons = NULL;
+	}
+
+exit:
+	if (ctx_cons != NULL)
+		shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+	return ret < 0 ? ret : 0;
+}
+
+static int bench_window(const struct bench_conf *conf, uint64_t *samples)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons = NULL;
+	struct shd_revision *rev = NULL;
+	struct shd_sample_metadata *metadata;
+	struct shd_search_result result;
+	struct shd_sample_search search = {
+		.date = { 0, 0 },
+		.method = SHD_LATEST,
+		.nb_values_after_date = 0,
+	};
+	struct shd_quantity q_i1 = {
+		offsetof(struct example_prod_blob, i1),
+		sizeof(int)
+	};
+	char params[64];
+	int *dst = NULL;
+	uint64_t start;
+	uint32_t depth = 16384;
+	size_t w;
+	uint32_t i;
+	int ret = -1;
+
+	ctx_prod = create_filled_section(depth);
+	if (ctx_prod == NULL)
+		return -1;
+	ctx_cons = open_section(NULL, &rev);
+	if (ctx_cons == NULL)
+		goto exit;
+
+	for (w = 0; w < ARRAY_SIZE(window_sizes); w++) {
+		free(dst);
+		dst = calloc(window_sizes[w], sizeof(*dst));
+		if (dst == NULL) {
+			ret = -ENOMEM;
+			goto exit;
+		}
+
+		search.nb_values_before_date = window_sizes[w] - 1;
+		for (i = 0; i < conf->iterations; i++) {
+			start = get_time_ns();
+			ret = shd_select_samples(ctx_cons, &search, &metadata,
+					&result);
+			if (ret >= 0)
+				ret = shd_read_quantity(ctx_cons, &q_i1, dst,
+					window_sizes[w] * sizeof(*dst));
+			if (ret >= 0)
+				ret = shd_end_read(ctx_cons, rev);
+			samples[i] = get_time_ns() - start;
+			if (ret < 0)
+				goto exit;
+		}
+
+		snprintf(params, sizeof(params),
+				"\"window\": %u, \"depth\": %u",
+				window_sizes[w], depth);
+		report(conf, "window_read", params, samples);
+	}
+
+exit:
+	free(dst);
+	if (ctx_cons != NULL)
+		shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+	return ret < 0 ? ret : 0;
+}
+
+static int bench_open_close(const struct bench_conf *conf, uint64_t *samples)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	char params[64];
+	uint64_t start;
+	uint32_t depth = 1024;
+	uint32_t i;
+	int ret = 0;
+
+	ctx_prod = create_filled_section(depth);
+	if (ctx_prod == NULL)
+		return -1;
+
+	for (i = 0; i < conf->iterations; i++) {
+		start = get_time_ns();
+		ctx_cons = shd_open(BLOB_NAME, NULL, &rev);
+		if (ctx_cons != NULL)
+			ret = shd_close(ctx_cons, rev);
+		samples[i] = get_time_ns() - start;
+		if (ctx_cons == NULL || ret < 0) {
+			ret = -1;
+			goto exit;
+		}
+	}
+
+	snprintf(params, sizeof(params), "\"depth\": %u", depth);
+	report(conf, "open_close", params, samples);
+
+exit:
+	shd_close(ctx_prod, NULL);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_conf conf;
+	uint64_t *samples;
+	size_t d;
+	int ret = -1;
+
+	parse_command(argc, argv, &conf);
+
+	if (conf.iterations == 0) {
+		ULOGI("Number of iterations should be positive");
+		return -1;
+	}
+
+	samples = calloc(conf.iterations, sizeof(*samples));
+	if (samples == NULL)
+		return -1;
+
+	fprintf(conf.out, "{\n  \"library\": \"libshdata\",\n"
+			"  \"version\": \"%d.%d\",\n  \"iterations\": %u,\n"
+			"  \"results\": [",
+			SHD_VERSION_MAJOR, SHD_VERSION_MINOR, conf.iterations);
+
+	if (bench_write(&conf, samples) < 0)
+		goto exit;
+	for (d = 0; d < ARRAY_SIZE(burst_sizes); d++) {
+		if (bench_write_burst(&conf, samples, burst_sizes[d]) < 0)
+			goto exit;
+	}
+	if (bench_read_latest(&conf, samples) < 0)
+		goto exit;
+	for (d = 0; d < ARRAY_SIZE(depths); d++) {
+		if (bench_search(&conf, samples, depths[d]) < 0)
+			goto exit;
+	}
+	if (bench_window(&conf, samples) < 0)
+		goto exit;
+	if (bench_open_close(&conf, samples) < 0)
+		goto exit;
+
+	ret = 0;
+
+exit:
+	fprintf(conf.out, "\n  ]\n}\n");
+	if (ret < 0)
+		ULOGI("Benchmark failed");
+	if (conf.out != stdout)
+		fclose(conf.out);
+	free(samples);
+	return ret;
+}
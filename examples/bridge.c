@@ -0,0 +1,1419 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file bridge.c
+ *
+ * @brief Replication of shared memory sections to another host or container
+ *
+ * @details The bridge runs on both sides of a datagram socket (Unix or UDP) :
+ *   - the sender follows a list of sections with a lossless cursor (each poll
+ *   reads the samples committed after the last one it has sent, as long as it
+ *   keeps up with the depth of the sections and timestamps do not go
+ *   backwards), and sends them in batches
+ *   which fit in a datagram, along with the description of each section
+ *   (shd_hdr_user_info and blob metadata header) ;
+ *   - the receiver republishes them into local sections with the same names
+ *   (optionally prefixed) and the same header info, so that local consumers
+ *   use them as if the producer was running on their side.
+ * The description of a section is sent again whenever it changes and every
+ * second, so that a receiver started after the sender (or a lost UDP
+ * datagram) catches up. Samples keep the timestamps given by the producer.
+ * Both sides must share the same endianness and type sizes.
+ *
+ * A loopback mode runs a producer, a sender, a receiver and a consumer of the
+ * replicated section within a single process, and reports the throughput,
+ * the end-to-end latency and the lost samples.
+ *
+ * Example command lines :
+ *   libshdata-bridge -s -a udp:10.0.0.2:7891 imu_flight cam_h
+ * ... replicates sections imu_flight and cam_h to 10.0.0.2
+ *   libshdata-bridge -r -a udp:0.0.0.0:7891
+ * ... republishes the sections received on port 7891
+ *   libshdata-bridge -l -a unix:@shd-bridge -n 100000 -P 100 -b 1024
+ * ... replicates 100000 samples of 1 KiB produced every 100us over a Unix
+ * socket, in loopback
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "example_log.h"
+#define SHD_ADVANCED_READ_API
+#include "libshdata.h"
+
+#define BRIDGE_MAGIC			0x73686462
+#define BRIDGE_MAX_MSG_SIZE		65000
+#define BRIDGE_DEFAULT_PERIOD		1000	/* in us */
+#define BRIDGE_DESC_PERIOD		1000000000ULL	/* in ns */
+#define BRIDGE_RECV_TIMEOUT		100000	/* in us */
+#define BRIDGE_MAX_SECTIONS		256
+
+#define LOOPBACK_BLOB_NAME		"bridge_loopback"
+#define LOOPBACK_PREFIX			"bridged_"
+#define LOOPBACK_DEFAULT_ADDRESS	"unix:@shd-bridge-loopback"
+#define LOOPBACK_DEPTH			1024
+
+enum bridge_msg_type {
+	/* Description of a section : struct bridge_section_desc followed by
+	 * the blob metadata header */
+	BRIDGE_MSG_SECTION = 1,
+	/* Samples of a section : struct bridge_samples_desc followed by
+	 * nb_samples times a struct bridge_sample_meta and the blob */
+	BRIDGE_MSG_SAMPLES = 2,
+};
+
+/* All messages start with this header followed by the section name (without
+ * terminating null byte). Fields that follow the name are not aligned and
+ * are copied in and out of the message */
+struct bridge_msg_hdr {
+	uint32_t magic;
+	uint16_t type;
+	uint16_t name_len;
+};
+
+struct bridge_section_desc {
+	uint64_t blob_size;
+	uint32_t max_nb_samples;
+	uint32_t rate;
+	uint64_t blob_metadata_hdr_size;
+};
+
+struct bridge_samples_desc {
+	uint32_t nb_samples;
+	uint32_t reserved;
+	uint64_t blob_size;
+};
+
+struct bridge_sample_meta {
+	int64_t ts_sec;
+	int64_t ts_nsec;
+	int64_t exp_sec;
+	int64_t exp_nsec;
+};
+
+/* Lossless cursor on a section */
+struct bridge_cursor {
+	struct shd_ctx *ctx;
+	struct shd_revision *rev;
+	struct shd_hdr_user_info hdr_info;
+	/* Timestamp of the last sample read, and number of samples read with
+	 * this timestamp : several samples may share a timestamp, so the
+	 * position of the cursor is the rank of the last sample read among
+	 * them */
+	struct timespec last_ts;
+	uint32_t nb_last;
+	bool started;
+	/* Maximum number of samples read at once */
+	uint32_t batch;
+	/* Number of samples the buffers can hold */
+	uint32_t capacity;
+	struct shd_sample_metadata *meta_buf;
+	uint8_t *blob_buf;
+	/* Samples read by the last call to cursor_read(), within the
+	 * buffers */
+	struct shd_sample_metadata *meta;
+	uint8_t *blobs;
+	/* Number of reads that failed because samples were overwritten */
+	uint64_t nb_overruns;
+};
+
+struct bridge_section {
+	char name[SHD_SECTION_NAME_MAX];
+	struct bridge_cursor cursor;
+	/* Date of the last description sent */
+	uint64_t desc_date;
+};
+
+struct bridge_sender {
+	int fd;
+	struct sockaddr_storage addr;
+	socklen_t addr_len;
+	size_t max_msg_size;
+	uint8_t *msg;
+	uint32_t period;
+	bool follow_all;
+	struct bridge_section *sections[BRIDGE_MAX_SECTIONS];
+	int nb_sections;
+	uint64_t list_date;
+	/* Statistics */
+	uint64_t nb_samples;
+	uint64_t nb_msgs;
+	uint64_t nb_bytes;
+	uint64_t nb_send_errors;
+};
+
+struct bridge_replica {
+	char name[SHD_SECTION_NAME_MAX];
+	struct shd_ctx *ctx;
+	struct shd_hdr_user_info hdr_info;
+	uint8_t *mdata;
+};
+
+struct bridge_receiver {
+	int fd;
+	struct sockaddr_storage addr;
+	socklen_t addr_len;
+	const char *prefix;
+	uint8_t *msg;
+	struct bridge_replica *replicas[BRIDGE_MAX_SECTIONS];
+	int nb_replicas;
+	/* Number of sections created so far */
+	volatile int nb_created;
+	/* Statistics */
+	uint64_t nb_samples;
+	uint64_t nb_msgs;
+	uint64_t nb_dropped;
+};
+
+struct bridge_conf {
+	enum { MODE_NONE, MODE_SEND, MODE_RECEIVE, MODE_LOOPBACK } mode;
+	const char *address;
+	const char *prefix;
+	uint32_t period;
+	size_t max_msg_size;
+	bool follow_all;
+	char **names;
+	int nb_names;
+	/* Loopback test */
+	uint32_t nb_samples;
+	uint32_t prod_period;
+	uint32_t blob_size;
+};
+
+static volatile sig_atomic_t s_stop;
+
+static void usage(void)
+{
+	printf("Replication of libshdata sections over sockets\n");
+	printf("Usage :\n");
+	printf("\tlibshdata-bridge -s -a <address> [options] "
+			"(-A | <section>...)\n");
+	printf("\tlibshdata-bridge -r -a <address> [options]\n");
+	printf("\tlibshdata-bridge -l [-a <address>] [options]\n");
+	printf("Modes :\n");
+	printf("\ts : send sections to the given address\n");
+	printf("\tr : receive sections on the given address\n");
+	printf("\tl : loopback test\n");
+	printf("Options :\n");
+	printf("\ta : unix:<path>, unix:@<abstract name> or "
+			"udp:<host>:<port>\n");
+	printf("\tA : send all the sections of the registry\n");
+	printf("\tp : polling period of the sender, in us (default %d)\n",
+			BRIDGE_DEFAULT_PERIOD);
+	printf("\tM : maximum size of a datagram (default %d)\n",
+			BRIDGE_MAX_MSG_SIZE);
+	printf("\tx : prefix of the names of the republished sections\n");
+	printf("\tn : number of samples produced in loopback test\n");
+	printf("\tP : producer period in loopback test, in us\n");
+	printf("\tb : blob size in loopback test (at least 16 bytes)\n");
+
+	exit(0);
+}
+
+static void parse_command(int argc, char *argv[], struct bridge_conf *conf)
+{
+	int opt;
+
+	memset(conf, 0, sizeof(*conf));
+	conf->mode = MODE_NONE;
+	conf->prefix = "";
+	conf->period = BRIDGE_DEFAULT_PERIOD;
+	conf->max_msg_size = BRIDGE_MAX_MSG_SIZE;
+	conf->nb_samples = 10000;
+	conf->prod_period = 1000;
+	conf->blob_size = 64;
+
+	while ((opt = getopt(argc, argv, "srla:Ap:M:x:n:P:b:h")) != -1) {
+		switch (opt) {
+		case 's':
+			conf->mode = MODE_SEND;
+			break;
+		case 'r':
+			conf->mode = MODE_RECEIVE;
+			break;
+		case 'l':
+			conf->mode = MODE_LOOPBACK;
+			break;
+		case 'a':
+			conf->address = optarg;
+			break;
+		case 'A':
+			conf->follow_all = true;
+			break;
+		case 'p':
+			conf->period = strtoul(optarg, NULL, 0);
+			break;
+		case 'M':
+			conf->max_msg_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'x':
+			conf->prefix = optarg;
+			break;
+		case 'n':
+			conf->nb_samples = strtoul(optarg, NULL, 0);
+			break;
+		case 'P':
+			conf->prod_period = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			conf->blob_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'h':
+		default:
+			usage();
+			break;
+		}
+	}
+
+	conf->names = &argv[optind];
+	conf->nb_names = argc - optind;
+}
+
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void sig_handler(int sig)
+{
+	s_stop = 1;
+}
+
+/*
+ * Socket addresses
+ */
+
+static int parse_address(const char *address, struct sockaddr_storage *addr,
+			socklen_t *addr_len)
+{
+	struct sockaddr_un *sun = (struct sockaddr_un *)addr;
+	struct addrinfo hints, *res;
+	char *host, *port;
+	size_t len;
+	int ret;
+
+	memset(addr, 0, sizeof(*addr));
+
+	if (address == NULL)
+		return -EINVAL;
+
+	if (!strncmp(address, "unix:", 5)) {
+		address += 5;
+		len = strlen(address);
+		if (len == 0 || len >= sizeof(sun->sun_path))
+			return -EINVAL;
+		sun->sun_family = AF_UNIX;
+		memcpy(sun->sun_path, address, len);
+		/* Abstract socket name */
+		if (address[0] == '@')
+			sun->sun_path[0] = '\0';
+		*addr_len = offsetof(struct sockaddr_un, sun_path) + len
+				+ (address[0] == '@' ? 0 : 1);
+		return 0;
+	}
+
+	if (strncmp(address, "udp:", 4))
+		return -EINVAL;
+
+	host = strdup(address + 4);
+	if (host == NULL)
+		return -ENOMEM;
+	port = strrchr(host, ':');
+	if (port == NULL) {
+		free(host);
+		return -EINVAL;
+	}
+	*port++ = '\0';
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	ret = getaddrinfo(host, port, &hints, &res);
+	free(host);
+	if (ret != 0)
+		return -EINVAL;
+
+	memcpy(addr, res->ai_addr, res->ai_addrlen);
+	*addr_len = res->ai_addrlen;
+	freeaddrinfo(res);
+
+	return 0;
+}
+
+static bool address_is_unix_path(const struct sockaddr_storage *addr)
+{
+	const struct sockaddr_un *sun = (const struct sockaddr_un *)addr;
+
+	return addr->ss_family == AF_UNIX && sun->sun_path[0] != '\0';
+}
+
+/*
+ * Lossless cursor
+ */
+
+static void cursor_close(struct bridge_cursor *cursor)
+{
+	if (cursor->ctx != NULL)
+		shd_close(cursor->ctx, cursor->rev);
+	free(cursor->meta_buf);
+	free(cursor->blob_buf);
+	memset(cursor, 0, sizeof(*cursor));
+}
+
+/* Make room for a window of nb samples */
+static int cursor_reserve(struct bridge_cursor *cursor, uint32_t nb)
+{
+	struct shd_sample_metadata *meta;
+	uint8_t *blobs;
+
+	if (nb <= cursor->capacity)
+		return 0;
+
+	meta = realloc(cursor->meta_buf, nb * sizeof(*meta));
+	if (meta == NULL)
+		return -ENOMEM;
+	cursor->meta_buf = meta;
+	blobs = realloc(cursor->blob_buf, nb * cursor->hdr_info.blob_size);
+	if (blobs == NULL)
+		return -ENOMEM;
+	cursor->blob_buf = blobs;
+	cursor->capacity = nb;
+
+	return 0;
+}
+
+/* Restart the cursor from the oldest sample of a section whose header info
+ * is given */
+static int cursor_reset(struct bridge_cursor *cursor,
+			const struct shd_hdr_user_info *hdr_info,
+			uint32_t max_batch)
+{
+	cursor->hdr_info = *hdr_info;
+	cursor->started = false;
+	cursor->nb_last = 0;
+	cursor->batch = hdr_info->max_nb_samples < max_batch ?
+			hdr_info->max_nb_samples : max_batch;
+	if (cursor->batch == 0)
+		return -EMSGSIZE;
+
+	free(cursor->meta_buf);
+	free(cursor->blob_buf);
+	cursor->meta_buf = NULL;
+	cursor->blob_buf = NULL;
+	cursor->capacity = 0;
+
+	/* A window usually starts with the last sample read */
+	return cursor_reserve(cursor, cursor->batch < hdr_info->max_nb_samples ?
+			cursor->batch + 1 : cursor->batch);
+}
+
+/* Open a section : the cursor must then be reset with the batch size */
+static int cursor_open(struct bridge_cursor *cursor, const char *name)
+{
+	int ret;
+
+	cursor->ctx = shd_open(name, NULL, &cursor->rev);
+	if (cursor->ctx == NULL)
+		return -ENOENT;
+
+	/* Follow the section across restarts of its producer */
+	ret = shd_set_auto_reconnect(cursor->ctx, true);
+	if (ret < 0)
+		goto error;
+
+	ret = shd_read_section_hdr(cursor->ctx, &cursor->hdr_info,
+			cursor->rev);
+	if (ret < 0)
+		goto error;
+
+	return 0;
+
+error:
+	cursor_close(cursor);
+	return ret;
+}
+
+/*
+ * Read the samples committed after the last one read, at most batch of
+ * them : returns the number of samples read, 0 if there is none
+ */
+static int cursor_read(struct bridge_cursor *cursor)
+{
+	/* SHD_FIRST_AFTER also matches the samples whose timestamp is equal
+	 * to the date : the window starts with the samples which share the
+	 * timestamp of the last sample read, and which were already read */
+	uint32_t skip = cursor->started ? cursor->nb_last : 0;
+	uint32_t window = skip + cursor->batch;
+	struct shd_sample_search search = {
+		.date = cursor->last_ts,
+		.method = cursor->started ? SHD_FIRST_AFTER : SHD_OLDEST,
+		.nb_values_before_date = 0,
+	};
+	struct shd_sample_metadata *metadata;
+	struct shd_search_result result;
+	uint32_t nb_same;
+	int nb_samples;
+	int ret;
+	int i;
+
+	if (window > cursor->hdr_info.max_nb_samples)
+		window = cursor->hdr_info.max_nb_samples;
+	ret = cursor_reserve(cursor, window);
+	if (ret < 0)
+		return ret;
+	search.nb_values_after_date = window - 1;
+
+	ret = shd_select_samples(cursor->ctx, &search, &metadata, &result);
+	if (ret == -ENOENT || ret == -EAGAIN)
+		return 0;
+	else if (ret < 0)
+		return ret;
+
+	nb_samples = shd_read_quantity(cursor->ctx, NULL, cursor->blob_buf,
+				window * cursor->hdr_info.blob_size);
+	if (nb_samples > 0)
+		memcpy(cursor->meta_buf, metadata,
+				nb_samples * sizeof(*metadata));
+
+	/* Samples are only valid if they have not been overwritten in the
+	 * meantime */
+	ret = shd_end_read(cursor->ctx, cursor->rev);
+	if (ret == -EFAULT) {
+		/* The cursor lags behind the producer : start again from the
+		 * oldest sample, which is not about to be overwritten */
+		cursor->nb_overruns++;
+		cursor->started = false;
+		cursor->nb_last = 0;
+	}
+	if (ret < 0)
+		return ret;
+	if (nb_samples <= 0)
+		return nb_samples;
+
+	/* Skip the samples already read. Fewer of them are found if the
+	 * oldest ones were overwritten since the last read */
+	for (i = 0; i < (int)skip && i < nb_samples; i++) {
+		if (cursor->meta_buf[i].ts.tv_sec != cursor->last_ts.tv_sec
+				|| cursor->meta_buf[i].ts.tv_nsec
+					!= cursor->last_ts.tv_nsec)
+			break;
+	}
+	cursor->meta = cursor->meta_buf + i;
+	cursor->blobs = cursor->blob_buf + i * cursor->hdr_info.blob_size;
+	nb_samples -= i;
+	if (nb_samples > (int)cursor->batch)
+		nb_samples = cursor->batch;
+	if (nb_samples == 0)
+		return 0;
+
+	/* Count the samples read which share the timestamp of the last one */
+	for (nb_same = 1; nb_same < (uint32_t)nb_samples; nb_same++) {
+		i = nb_samples - 1 - nb_same;
+		if (cursor->meta[i].ts.tv_sec
+				!= cursor->meta[nb_samples - 1].ts.tv_sec
+			|| cursor->meta[i].ts.tv_nsec
+				!= cursor->meta[nb_samples - 1].ts.tv_nsec)
+			break;
+	}
+	if (nb_same == (uint32_t)nb_samples && cursor->started
+			&& cursor->meta[0].ts.tv_sec == cursor->last_ts.tv_sec
+			&& cursor->meta[0].ts.tv_nsec
+				== cursor->last_ts.tv_nsec)
+		cursor->nb_last += nb_same;
+	else
+		cursor->nb_last = nb_same;
+
+	cursor->last_ts = cursor->meta[nb_samples - 1].ts;
+	cursor->started = true;
+
+	return nb_samples;
+}
+
+/*
+ * Sender
+ */
+
+static size_t msg_init(uint8_t *msg, enum bridge_msg_type type,
+			const char *name)
+{
+	struct bridge_msg_hdr hdr = {
+		.magic = BRIDGE_MAGIC,
+		.type = type,
+		.name_len = strlen(name),
+	};
+
+	memcpy(msg, &hdr, sizeof(hdr));
+	memcpy(msg + sizeof(hdr), name, hdr.name_len);
+
+	return sizeof(hdr) + hdr.name_len;
+}
+
+static size_t msg_samples_overhead(const char *name)
+{
+	return sizeof(struct bridge_msg_hdr) + strlen(name)
+			+ sizeof(struct bridge_samples_desc);
+}
+
+static void sender_send(struct bridge_sender *sender, size_t size)
+{
+	ssize_t ret;
+
+	ret = sendto(sender->fd, sender->msg, size, 0,
+			(struct sockaddr *)&sender->addr, sender->addr_len);
+	if (ret < 0) {
+		/* The receiver may not be started yet */
+		sender->nb_send_errors++;
+		return;
+	}
+
+	sender->nb_msgs++;
+	sender->nb_bytes += size;
+}
+
+static int sender_send_desc(struct bridge_sender *sender,
+				struct bridge_section *section)
+{
+	struct bridge_cursor *cursor = &section->cursor;
+	struct bridge_section_desc desc = {
+		.blob_size = cursor->hdr_info.blob_size,
+		.max_nb_samples = cursor->hdr_info.max_nb_samples,
+		.rate = cursor->hdr_info.rate,
+		.blob_metadata_hdr_size =
+			cursor->hdr_info.blob_metadata_hdr_size,
+	};
+	size_t size;
+	int ret;
+
+	size = msg_init(sender->msg, BRIDGE_MSG_SECTION, section->name);
+	if (size + sizeof(desc) + desc.blob_metadata_hdr_size
+			> sender->max_msg_size)
+		return -EMSGSIZE;
+
+	memcpy(sender->msg + size, &desc, sizeof(desc));
+	size += sizeof(desc);
+	ret = shd_read_blob_metadata_hdr(cursor->ctx, sender->msg + size,
+				desc.blob_metadata_hdr_size, cursor->rev);
+	if (ret < 0)
+		return ret;
+	size += desc.blob_metadata_hdr_size;
+
+	sender_send(sender, size);
+
+	return 0;
+}
+
+static void sender_send_samples(struct bridge_sender *sender,
+				struct bridge_section *section,
+				int nb_samples)
+{
+	struct bridge_cursor *cursor = &section->cursor;
+	struct bridge_samples_desc desc = {
+		.nb_samples = nb_samples,
+		.blob_size = cursor->hdr_info.blob_size,
+	};
+	struct bridge_sample_meta meta;
+	size_t size;
+	int i;
+
+	size = msg_init(sender->msg, BRIDGE_MSG_SAMPLES, section->name);
+	memcpy(sender->msg + size, &desc, sizeof(desc));
+	size += sizeof(desc);
+
+	for (i = 0; i < nb_samples; i++) {
+		meta.ts_sec = cursor->meta[i].ts.tv_sec;
+		meta.ts_nsec = cursor->meta[i].ts.tv_nsec;
+		meta.exp_sec = cursor->meta[i].exp.tv_sec;
+		meta.exp_nsec = cursor->meta[i].exp.tv_nsec;
+		memcpy(sender->msg + size, &meta, sizeof(meta));
+		size += sizeof(meta);
+		memcpy(sender->msg + size,
+			cursor->blobs + i * desc.blob_size,
+			desc.blob_size);
+		size += desc.blob_size;
+	}
+
+	sender_send(sender, size);
+	sender->nb_samples += nb_samples;
+}
+
+static uint32_t sender_max_batch(const struct bridge_sender *sender,
+				const struct bridge_section *section,
+				size_t blob_size)
+{
+	size_t overhead = msg_samples_overhead(section->name);
+
+	if (overhead >= sender->max_msg_size)
+		return 0;
+
+	return (sender->max_msg_size - overhead)
+			/ (sizeof(struct bridge_sample_meta) + blob_size);
+}
+
+static void sender_poll_section(struct bridge_sender *sender,
+				struct bridge_section *section,
+				uint64_t now)
+{
+	struct bridge_cursor *cursor = &section->cursor;
+	struct shd_hdr_user_info hdr_info;
+	bool send_desc = false;
+	int ret;
+
+	if (cursor->ctx == NULL) {
+		/* Batches are sized once the blob size is known */
+		ret = cursor_open(cursor, section->name);
+		if (ret < 0)
+			return;
+		ret = cursor_reset(cursor, &cursor->hdr_info,
+				sender_max_batch(sender, section,
+					cursor->hdr_info.blob_size));
+		if (ret < 0) {
+			ULOGI("Section %s can not be sent : %s",
+					section->name, strerror(-ret));
+			cursor_close(cursor);
+			return;
+		}
+		send_desc = true;
+	} else {
+		/* The context is remapped when the section is re-created :
+		 * its header info may have changed */
+		ret = shd_read_section_hdr(cursor->ctx, &hdr_info,
+				cursor->rev);
+		if (ret < 0)
+			return;
+		if (memcmp(&hdr_info, &cursor->hdr_info,
+					sizeof(hdr_info)) != 0) {
+			ret = cursor_reset(cursor, &hdr_info,
+					sender_max_batch(sender, section,
+						hdr_info.blob_size));
+			if (ret < 0) {
+				cursor_close(cursor);
+				return;
+			}
+			send_desc = true;
+		}
+	}
+
+	if (send_desc || now - section->desc_date >= BRIDGE_DESC_PERIOD) {
+		ret = sender_send_desc(sender, section);
+		if (ret < 0)
+			ULOGI("Could not send description of section %s : %s",
+					section->name, strerror(-ret));
+		section->desc_date = now;
+	}
+
+	/* Drain all the samples committed since the last poll */
+	do {
+		ret = cursor_read(cursor);
+		if (ret > 0)
+			sender_send_samples(sender, section, ret);
+	} while (ret == (int)cursor->batch);
+}
+
+static int sender_add_section(struct bridge_sender *sender, const char *name)
+{
+	struct bridge_section *section;
+	int i;
+
+	for (i = 0; i < sender->nb_sections; i++) {
+		if (!strcmp(sender->sections[i]->name, name))
+			return 0;
+	}
+
+	if (sender->nb_sections == BRIDGE_MAX_SECTIONS
+			|| strlen(name) >= SHD_SECTION_NAME_MAX)
+		return -ENOSPC;
+
+	section = calloc(1, sizeof(*section));
+	if (section == NULL)
+		return -ENOMEM;
+	strcpy(section->name, name);
+	sender->sections[sender->nb_sections++] = section;
+
+	return 0;
+}
+
+/* Follow the sections which have been created since the last scan of the
+ * registry */
+static void sender_scan_registry(struct bridge_sender *sender)
+{
+	struct shd_section_info *infos;
+	int nb_sections;
+	int i;
+
+	nb_sections = shd_list_sections(NULL, 0);
+	if (nb_sections <= 0)
+		return;
+
+	infos = calloc(nb_sections, sizeof(*infos));
+	if (infos == NULL)
+		return;
+
+	nb_sections = shd_list_sections(infos, nb_sections);
+	for (i = 0; i < nb_sections; i++)
+		sender_add_section(sender, infos[i].name);
+
+	free(infos);
+}
+
+static int sender_init(struct bridge_sender *sender,
+			const struct bridge_conf *conf)
+{
+	int ret;
+	int i;
+
+	memset(sender, 0, sizeof(*sender));
+	sender->fd = -1;
+	sender->period = conf->period;
+	sender->max_msg_size = conf->max_msg_size;
+	sender->follow_all = conf->follow_all;
+
+	ret = parse_address(conf->address, &sender->addr, &sender->addr_len);
+	if (ret < 0) {
+		ULOGI("Invalid address : %s", conf->address);
+		return ret;
+	}
+
+	sender->msg = malloc(sender->max_msg_size);
+	if (sender->msg == NULL)
+		return -ENOMEM;
+
+	sender->fd = socket(sender->addr.ss_family,
+				SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (sender->fd < 0)
+		return -errno;
+
+	for (i = 0; i < conf->nb_names; i++) {
+		ret = sender_add_section(sender, conf->names[i]);
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+static void sender_clean(struct bridge_sender *sender)
+{
+	int i;
+
+	for (i = 0; i < sender->nb_sections; i++) {
+		cursor_close(&sender->sections[i]->cursor);
+		free(sender->sections[i]);
+	}
+	if (sender->fd >= 0)
+		close(sender->fd);
+	free(sender->msg);
+}
+
+static void sender_run(struct bridge_sender *sender,
+			volatile sig_atomic_t *stop)
+{
+	struct timespec next;
+	uint64_t now;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (!*stop) {
+		now = get_time_ns();
+		if (sender->follow_all
+			&& now - sender->list_date >= BRIDGE_DESC_PERIOD) {
+			sender_scan_registry(sender);
+			sender->list_date = now;
+		}
+
+		for (i = 0; i < sender->nb_sections; i++)
+			sender_poll_section(sender, sender->sections[i], now);
+
+		next.tv_nsec += sender->period * 1000ULL;
+		while (next.tv_nsec >= 1000000000) {
+			next.tv_nsec -= 1000000000;
+			next.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+	}
+}
+
+/*
+ * Receiver
+ */
+
+static struct bridge_replica *receiver_find(struct bridge_receiver *receiver,
+						const char *name)
+{
+	int i;
+
+	for (i = 0; i < receiver->nb_replicas; i++) {
+		if (!strcmp(receiver->replicas[i]->name, name))
+			return receiver->replicas[i];
+	}
+
+	return NULL;
+}
+
+static void receiver_handle_section(struct bridge_receiver *receiver,
+				const char *name, const uint8_t *payload,
+				size_t size)
+{
+	struct bridge_replica *replica;
+	struct bridge_section_desc desc;
+	struct shd_hdr_user_info hdr_info;
+	char local_name[SHD_SECTION_NAME_MAX];
+
+	if (size < sizeof(desc))
+		goto drop;
+	memcpy(&desc, payload, sizeof(desc));
+	if (size != sizeof(desc) + desc.blob_metadata_hdr_size)
+		goto drop;
+	payload += sizeof(desc);
+
+	memset(&hdr_info, 0, sizeof(hdr_info));
+	hdr_info.blob_size = desc.blob_size;
+	hdr_info.max_nb_samples = desc.max_nb_samples;
+	hdr_info.rate = desc.rate;
+	hdr_info.blob_metadata_hdr_size = desc.blob_metadata_hdr_size;
+
+	replica = receiver_find(receiver, name);
+	if (replica != NULL && replica->ctx != NULL
+		&& !memcmp(&replica->hdr_info, &hdr_info, sizeof(hdr_info))
+		&& !memcmp(replica->mdata, payload,
+				hdr_info.blob_metadata_hdr_size))
+		return;
+
+	if (replica == NULL) {
+		if (receiver->nb_replicas == BRIDGE_MAX_SECTIONS)
+			goto drop;
+		replica = calloc(1, sizeof(*replica));
+		if (replica == NULL)
+			goto drop;
+		strcpy(replica->name, name);
+		receiver->replicas[receiver->nb_replicas++] = replica;
+	}
+
+	/* The section is new, or has been re-created with another format */
+	if (replica->ctx != NULL)
+		shd_close(replica->ctx, NULL);
+	free(replica->mdata);
+	replica->ctx = NULL;
+	replica->hdr_info = hdr_info;
+	replica->mdata = malloc(hdr_info.blob_metadata_hdr_size + 1);
+	if (replica->mdata == NULL)
+		goto drop;
+	memcpy(replica->mdata, payload, hdr_info.blob_metadata_hdr_size);
+
+	snprintf(local_name, sizeof(local_name), "%s%s", receiver->prefix,
+			name);
+	replica->ctx = shd_create(local_name, NULL, &replica->hdr_info,
+			replica->mdata);
+	if (replica->ctx == NULL) {
+		ULOGI("Could not create section %s", local_name);
+		goto drop;
+	}
+	ULOGI("Republishing section %s as %s", name, local_name);
+	receiver->nb_created++;
+
+	return;
+
+drop:
+	receiver->nb_dropped++;
+}
+
+static void receiver_handle_samples(struct bridge_receiver *receiver,
+				const char *name, const uint8_t *payload,
+				size_t size)
+{
+	struct bridge_replica *replica;
+	struct bridge_samples_desc desc;
+	struct bridge_sample_meta meta;
+	struct shd_sample_metadata metadata;
+	uint32_t i;
+
+	replica = receiver_find(receiver, name);
+	if (size < sizeof(desc))
+		goto drop;
+	memcpy(&desc, payload, sizeof(desc));
+
+	/* Samples of a section whose description has not been received yet,
+	 * or which does not match it */
+	if (replica == NULL || replica->ctx == NULL
+		|| desc.blob_size != replica->hdr_info.blob_size
+		|| size != sizeof(desc) + desc.nb_samples
+			* (sizeof(meta) + desc.blob_size))
+		goto drop;
+	payload += sizeof(desc);
+
+	for (i = 0; i < desc.nb_samples; i++) {
+		memcpy(&meta, payload, sizeof(meta));
+		payload += sizeof(meta);
+		metadata.ts.tv_sec = meta.ts_sec;
+		metadata.ts.tv_nsec = meta.ts_nsec;
+		metadata.exp.tv_sec = meta.exp_sec;
+		metadata.exp.tv_nsec = meta.exp_nsec;
+		shd_write_new_blob(replica->ctx, payload, desc.blob_size,
+				&metadata);
+		payload += desc.blob_size;
+	}
+	receiver->nb_samples += desc.nb_samples;
+
+	return;
+
+drop:
+	receiver->nb_dropped++;
+}
+
+static void receiver_handle_msg(struct bridge_receiver *receiver, size_t size)
+{
+	struct bridge_msg_hdr hdr;
+	char name[SHD_SECTION_NAME_MAX];
+	const uint8_t *payload;
+
+	if (size < sizeof(hdr))
+		goto drop;
+	memcpy(&hdr, receiver->msg, sizeof(hdr));
+	if (hdr.magic != BRIDGE_MAGIC || hdr.name_len == 0
+			|| hdr.name_len >= sizeof(name)
+			|| sizeof(hdr) + hdr.name_len > size)
+		goto drop;
+
+	memcpy(name, receiver->msg + sizeof(hdr), hdr.name_len);
+	name[hdr.name_len] = '\0';
+	payload = receiver->msg + sizeof(hdr) + hdr.name_len;
+	size -= sizeof(hdr) + hdr.name_len;
+
+	receiver->nb_msgs++;
+	switch (hdr.type) {
+	case BRIDGE_MSG_SECTION:
+		receiver_handle_section(receiver, name, payload, size);
+		break;
+	case BRIDGE_MSG_SAMPLES:
+		receiver_handle_samples(receiver, name, payload, size);
+		break;
+	default:
+		goto drop;
+	}
+
+	return;
+
+drop:
+	receiver->nb_dropped++;
+}
+
+static int receiver_init(struct bridge_receiver *receiver,
+			const struct bridge_conf *conf)
+{
+	struct timeval timeout = {
+		.tv_sec = 0,
+		.tv_usec = BRIDGE_RECV_TIMEOUT,
+	};
+	int rcvbuf = 4 * 1024 * 1024;
+	int ret;
+
+	memset(receiver, 0, sizeof(*receiver));
+	receiver->fd = -1;
+	receiver->prefix = conf->prefix;
+
+	ret = parse_address(conf->address, &receiver->addr,
+			&receiver->addr_len);
+	if (ret < 0) {
+		ULOGI("Invalid address : %s", conf->address);
+		return ret;
+	}
+
+	receiver->msg = malloc(BRIDGE_MAX_MSG_SIZE > conf->max_msg_size ?
+				BRIDGE_MAX_MSG_SIZE : conf->max_msg_size);
+	if (receiver->msg == NULL)
+		return -ENOMEM;
+
+	receiver->fd = socket(receiver->addr.ss_family,
+				SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (receiver->fd < 0)
+		return -errno;
+
+	/* Absorb bursts of the sender, as UDP drops what does not fit */
+	setsockopt(receiver->fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf,
+			sizeof(rcvbuf));
+	setsockopt(receiver->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+			sizeof(timeout));
+
+	if (address_is_unix_path(&receiver->addr))
+		unlink(((struct sockaddr_un *)&receiver->addr)->sun_path);
+
+	if (bind(receiver->fd, (struct sockaddr *)&receiver->addr,
+				receiver->addr_len) < 0) {
+		ret = -errno;
+		ULOGI("Could not bind to %s : %s", conf->address,
+				strerror(-ret));
+		return ret;
+	}
+
+	return 0;
+}
+
+static void receiver_clean(struct bridge_receiver *receiver)
+{
+	int i;
+
+	for (i = 0; i < receiver->nb_replicas; i++) {
+		if (receiver->replicas[i]->ctx != NULL)
+			shd_close(receiver->replicas[i]->ctx, NULL);
+		free(receiver->replicas[i]->mdata);
+		free(receiver->replicas[i]);
+	}
+	if (receiver->fd >= 0) {
+		close(receiver->fd);
+		if (address_is_unix_path(&receiver->addr))
+			unlink(((struct sockaddr_un *)
+					&receiver->addr)->sun_path);
+	}
+	free(receiver->msg);
+}
+
+static void receiver_run(struct bridge_receiver *receiver,
+			size_t max_msg_size,
+			volatile sig_atomic_t *stop)
+{
+	ssize_t ret;
+
+	while (!*stop) {
+		ret = recv(receiver->fd, receiver->msg, max_msg_size, 0);
+		if (ret < 0)
+			continue;
+		receiver_handle_msg(receiver, ret);
+	}
+}
+
+/*
+ * Loopback test
+ */
+
+struct loopback_blob_hdr {
+	uint64_t seq;
+	uint64_t date;
+};
+
+struct loopback_test {
+	const struct bridge_conf *conf;
+	struct bridge_sender sender;
+	struct bridge_receiver receiver;
+	struct shd_ctx *prod_ctx;
+	volatile sig_atomic_t stop_bridge;
+	int prod_ret;
+};
+
+static void *loopback_producer(void *arg)
+{
+	struct loopback_test *test = arg;
+	const struct bridge_conf *conf = test->conf;
+	struct shd_sample_metadata metadata;
+	struct loopback_blob_hdr *blob;
+	struct timespec next;
+	uint32_t i;
+
+	test->prod_ret = -1;
+	blob = calloc(1, conf->blob_size);
+	if (blob == NULL)
+		return NULL;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	for (i = 0; i < conf->nb_samples && !s_stop; i++) {
+		next.tv_nsec += conf->prod_period * 1000ULL;
+		while (next.tv_nsec >= 1000000000) {
+			next.tv_nsec -= 1000000000;
+			next.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+		clock_gettime(CLOCK_MONOTONIC, &metadata.ts);
+		metadata.exp = metadata.ts;
+		blob->seq = i;
+		blob->date = get_time_ns();
+		shd_write_new_blob(test->prod_ctx, blob, conf->blob_size,
+				&metadata);
+	}
+
+	free(blob);
+	test->prod_ret = 0;
+
+	return NULL;
+}
+
+static void *loopback_sender(void *arg)
+{
+	struct loopback_test *test = arg;
+
+	sender_run(&test->sender, &test->stop_bridge);
+	return NULL;
+}
+
+static void *loopback_receiver(void *arg)
+{
+	struct loopback_test *test = arg;
+
+	receiver_run(&test->receiver, test->conf->max_msg_size,
+			&test->stop_bridge);
+	return NULL;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+	uint64_t va = *(const uint64_t *)a, vb = *(const uint64_t *)b;
+
+	return va < vb ? -1 : va > vb;
+}
+
+static int loopback_consume(const struct bridge_conf *conf,
+				const struct bridge_receiver *receiver,
+				uint64_t *latencies, uint32_t *nb_received,
+				uint64_t *nb_overruns)
+{
+	struct bridge_cursor cursor;
+	struct loopback_blob_hdr blob;
+	uint64_t deadline;
+	uint64_t expected = 0;
+	uint64_t now;
+	int nb_errors = 0;
+	int ret;
+	int i;
+
+	memset(&cursor, 0, sizeof(cursor));
+	*nb_received = 0;
+
+	/* The producer runs for nb_samples periods : leave a few more
+	 * seconds for the samples to go through the bridge */
+	deadline = get_time_ns() + conf->nb_samples
+			* (uint64_t)conf->prod_period * 1000ULL
+			+ 5 * 1000000000ULL;
+
+	while (*nb_received < conf->nb_samples && !s_stop) {
+		now = get_time_ns();
+		if (now > deadline)
+			break;
+
+		/* Do not open a stale section left by a previous run before
+		 * the receiver has re-created it */
+		if (cursor.ctx == NULL && receiver->nb_created == 0) {
+			usleep(1000);
+			continue;
+		} else if (cursor.ctx == NULL) {
+			if (cursor_open(&cursor,
+					LOOPBACK_PREFIX LOOPBACK_BLOB_NAME) == 0
+				&& cursor_reset(&cursor, &cursor.hdr_info,
+					LOOPBACK_DEPTH / 2) < 0)
+				cursor_close(&cursor);
+			usleep(1000);
+			continue;
+		}
+
+		ret = cursor_read(&cursor);
+		if (ret <= 0) {
+			usleep(100);
+			continue;
+		}
+
+		now = get_time_ns();
+		for (i = 0; i < ret; i++) {
+			memcpy(&blob, cursor.blobs
+					+ i * cursor.hdr_info.blob_size,
+					sizeof(blob));
+			if (blob.seq != expected)
+				nb_errors++;
+			expected = blob.seq + 1;
+			latencies[(*nb_received)++] = now - blob.date;
+			if (*nb_received == conf->nb_samples)
+				break;
+		}
+	}
+
+	*nb_overruns = cursor.nb_overruns;
+	cursor_close(&cursor);
+
+	return nb_errors;
+}
+
+static int loopback_run(const struct bridge_conf *conf)
+{
+	struct loopback_test test;
+	struct bridge_conf bridge_conf = *conf;
+	struct shd_hdr_user_info hdr_info = {
+		.blob_size = conf->blob_size,
+		.max_nb_samples = LOOPBACK_DEPTH,
+		.rate = conf->prod_period,
+		.blob_metadata_hdr_size = sizeof(uint32_t),
+	};
+	uint32_t mdata = conf->blob_size;
+	char *name = LOOPBACK_BLOB_NAME;
+	pthread_t producer, sender, receiver;
+	uint64_t *latencies;
+	uint64_t start, elapsed, nb_overruns;
+	uint32_t nb_received;
+	int nb_errors;
+	int ret = -1;
+
+	if (conf->blob_size < sizeof(struct loopback_blob_hdr)) {
+		ULOGI("Blob size should be at least %zu bytes",
+				sizeof(struct loopback_blob_hdr));
+		return -1;
+	}
+
+	latencies = calloc(conf->nb_samples, sizeof(*latencies));
+	if (latencies == NULL)
+		return -1;
+
+	if (bridge_conf.address == NULL)
+		bridge_conf.address = LOOPBACK_DEFAULT_ADDRESS;
+	bridge_conf.prefix = LOOPBACK_PREFIX;
+	bridge_conf.follow_all = false;
+	bridge_conf.names = &name;
+	bridge_conf.nb_names = 1;
+
+	memset(&test, 0, sizeof(test));
+	test.conf = &bridge_conf;
+	test.sender.fd = -1;
+	test.receiver.fd = -1;
+
+	/* The section is created before the sender is started, so that it
+	 * does not follow a section left by a previous run */
+	test.prod_ctx = shd_create(LOOPBACK_BLOB_NAME, NULL, &hdr_info,
+				&mdata);
+	if (test.prod_ctx == NULL) {
+		ULOGP("Could not create section");
+		goto exit;
+	}
+
+	if (receiver_init(&test.receiver, &bridge_conf) < 0
+			|| sender_init(&test.sender, &bridge_conf) < 0)
+		goto exit;
+
+	pthread_create(&receiver, NULL, loopback_receiver, &test);
+	pthread_create(&sender, NULL, loopback_sender, &test);
+	start = get_time_ns();
+	pthread_create(&producer, NULL, loopback_producer, &test);
+
+	nb_errors = loopback_consume(&bridge_conf, &test.receiver, latencies,
+				&nb_received, &nb_overruns);
+	elapsed = get_time_ns() - start;
+
+	pthread_join(producer, NULL);
+	test.stop_bridge = 1;
+	pthread_join(sender, NULL);
+	pthread_join(receiver, NULL);
+
+	qsort(latencies, nb_received, sizeof(*latencies), compare_u64);
+
+	ULOGI("Address : %s, blob size : %u, producer period : %uus",
+			bridge_conf.address, conf->blob_size,
+			conf->prod_period);
+	ULOGI("Received %u/%u samples (%u lost, %d out of sequence), "
+			"%llu overruns",
+			nb_received, conf->nb_samples,
+			conf->nb_samples - nb_received, nb_errors,
+			(unsigned long long)nb_overruns);
+	ULOGI("Sender : %llu samples in %llu datagrams (%llu bytes), "
+			"%llu send errors",
+			(unsigned long long)test.sender.nb_samples,
+			(unsigned long long)test.sender.nb_msgs,
+			(unsigned long long)test.sender.nb_bytes,
+			(unsigned long long)test.sender.nb_send_errors);
+	ULOGI("Receiver : %llu samples in %llu datagrams, %llu dropped",
+			(unsigned long long)test.receiver.nb_samples,
+			(unsigned long long)test.receiver.nb_msgs,
+			(unsigned long long)test.receiver.nb_dropped);
+	if (nb_received > 0) {
+		ULOGI("Throughput : %.1f samples/s, %.1f KiB/s",
+			nb_received * 1e9 / elapsed,
+			nb_received * (double)conf->blob_size * 1e9
+				/ elapsed / 1024);
+		ULOGI("Latency (us) : p50 %.1f, p99 %.1f, p99.9 %.1f, "
+			"max %.1f",
+			latencies[nb_received / 2] / 1000.,
+			latencies[(uint64_t)nb_received * 99 / 100] / 1000.,
+			latencies[(uint64_t)nb_received * 999 / 1000] / 1000.,
+			latencies[nb_received - 1] / 1000.);
+	}
+
+	ret = (test.prod_ret == 0 && nb_received == conf->nb_samples
+			&& nb_errors == 0) ? 0 : -1;
+
+exit:
+	sender_clean(&test.sender);
+	receiver_clean(&test.receiver);
+	if (test.prod_ctx != NULL)
+		shd_close(test.prod_ctx, NULL);
+	free(latencies);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bridge_conf conf;
+	struct bridge_sender sender;
+	struct bridge_receiver receiver;
+	int ret = -1;
+
+	parse_command(argc, argv, &conf);
+
+	signal(SIGINT, sig_handler);
+	signal(SIGTERM, sig_handler);
+
+	switch (conf.mode) {
+	case MODE_SEND:
+		if (conf.nb_names == 0 && !conf.follow_all)
+			usage();
+		if (sender_init(&sender, &conf) == 0) {
+			sender_run(&sender, &s_stop);
+			ret = 0;
+		}
+		sender_clean(&sender);
+		break;
+	case MODE_RECEIVE:
+		if (receiver_init(&receiver, &conf) == 0) {
+			receiver_run(&receiver, conf.max_msg_size, &s_stop);
+			ret = 0;
+		}
+		receiver_clean(&receiver);
+		break;
+	case MODE_LOOPBACK:
+		ret = loopback_run(&conf);
+		break;
+	default:
+		usage();
+		break;
+	}
+
+	return ret;
+}
@@ -0,0 +1,246 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file coro_notify.cpp
+ *
+ * @brief Coroutines awaiting the commits of a producer
+ *
+ * @details A producer thread writes samples at a fixed period in a section
+ * whose commits are notified, while many coroutines co_await each new sample
+ * through libshdata-coro.hpp. Each coroutine reads the latest sample when it
+ * is resumed, checks that samples are seen in order, and measures the delay
+ * between the commit of the sample and its read. The coroutines all end
+ * after having read the last sample.
+ *
+ * Example command line :
+ *   libshdata-coro-notify -c 1000 -n 1000 -p 1000
+ * ... runs 1000 coroutines over 1000 samples written every 1000 us.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <atomic>
+#include <thread>
+#include "example_log.h"
+#include "common.h"
+#include "libshdata-coro.hpp"
+
+#define BLOB_NAME "coro_notify"
+#define DEPTH 64
+
+static const struct ex_metadata_blob_hdr s_metadata_hdr = {
+	0, 0xDEAD, "Hello",
+};
+
+struct notify_conf {
+	uint32_t nb_coroutines;
+	uint32_t nb_samples;
+	uint32_t period_us;
+	uint32_t nb_threads;
+};
+
+struct notify_stats {
+	std::atomic<uint32_t> nb_done{0};
+	std::atomic<uint32_t> nb_errors{0};
+	std::atomic<uint64_t> nb_reads{0};
+	std::atomic<uint64_t> delay_ns{0};
+	std::atomic<uint64_t> max_delay_ns{0};
+};
+
+static void usage()
+{
+	printf("Coroutines awaiting the commits of a libshdata producer\n");
+	printf("Usage :\n");
+	printf("\tc : number of coroutines\n");
+	printf("\tn : number of samples written by the producer\n");
+	printf("\tp : write period of the producer (in us)\n");
+	printf("\tt : number of notifier threads\n");
+
+	exit(0);
+}
+
+static void parse_command(int argc, char *argv[], struct notify_conf *conf)
+{
+	int opt;
+
+	conf->nb_coroutines = 1000;
+	conf->nb_samples = 1000;
+	conf->period_us = 1000;
+	conf->nb_threads = 1;
+
+	while ((opt = getopt(argc, argv, "c:n:p:t:h")) != -1) {
+		switch (opt) {
+		case 'c':
+			conf->nb_coroutines = (uint32_t)strtol(optarg, NULL, 0);
+			break;
+		case 'n':
+			conf->nb_samples = (uint32_t)strtol(optarg, NULL, 0);
+			break;
+		case 'p':
+			conf->period_us = (uint32_t)strtol(optarg, NULL, 0);
+			break;
+		case 't':
+			conf->nb_threads = (uint32_t)strtol(optarg, NULL, 0);
+			break;
+		case 'h':
+		default:
+			usage();
+			break;
+		}
+	}
+}
+
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void produce(shd::Producer<example_prod_blob> *prod,
+			const struct notify_conf *conf)
+{
+	struct shd_sample_metadata meta = { { 0, 0 }, { 0, 0 } };
+	struct example_prod_blob blob;
+	uint32_t i;
+
+	memset(&blob, 0, sizeof(blob));
+	for (i = 0; i < conf->nb_samples; i++) {
+		usleep(conf->period_us);
+		clock_gettime(CLOCK_MONOTONIC, &meta.ts);
+		blob.i1 = i;
+		prod->write(blob, meta);
+	}
+}
+
+static shd::Task subscriber(shd::Notifier &notifier,
+			shd::Consumer<example_prod_blob> &cons,
+			const struct notify_conf *conf,
+			struct notify_stats *stats)
+{
+	const struct shd_sample_search search = {
+		{ 0, 0 }, SHD_LATEST, 0, 0
+	};
+	shd::Subscription<example_prod_blob> sub(notifier, cons);
+	struct shd_sample_metadata meta;
+	struct example_prod_blob blob;
+	uint64_t delay, max;
+	int last = -1;
+	int ret;
+
+	while (last != (int)conf->nb_samples - 1) {
+		ret = co_await sub.next_sample();
+		if (ret == 0)
+			ret = cons.read(search, blob, &meta);
+		if (ret < 0 || blob.i1 < last) {
+			stats->nb_errors++;
+			break;
+		}
+		/* The sample of a commit may already have been read if it
+		 * occurred while the previous one was being read */
+		if (blob.i1 == last)
+			continue;
+		last = blob.i1;
+
+		delay = get_time_ns() - ((uint64_t)meta.ts.tv_sec
+				* 1000000000ULL + meta.ts.tv_nsec);
+		stats->nb_reads++;
+		stats->delay_ns += delay;
+		max = stats->max_delay_ns.load();
+		while (delay > max
+			&& !stats->max_delay_ns.compare_exchange_weak(max,
+								delay))
+			;
+	}
+
+	stats->nb_done++;
+}
+
+int main(int argc, char *argv[])
+{
+	struct notify_conf conf;
+	struct notify_stats stats;
+	uint64_t start;
+	uint32_t i;
+
+	parse_command(argc, argv, &conf);
+
+	if (conf.nb_samples == 0 || conf.nb_coroutines == 0) {
+		ULOGI("There should be at least one sample and one coroutine");
+		return -1;
+	}
+
+	try {
+		shd::Producer<example_prod_blob> prod(BLOB_NAME, DEPTH, 1000,
+				s_metadata_hdr);
+		shd::Consumer<example_prod_blob> cons(BLOB_NAME);
+		/* Destroyed before the consumer it watches */
+		shd::Notifier notifier(conf.nb_threads);
+
+		prod.set_commit_notify(true);
+
+		/* All coroutines are suspended until the first commit */
+		for (i = 0; i < conf.nb_coroutines; i++)
+			subscriber(notifier, cons, &conf, &stats);
+
+		start = get_time_ns();
+		std::thread producer(produce, &prod, &conf);
+		producer.join();
+
+		/* Leave some time to the last coroutines */
+		while (stats.nb_done < conf.nb_coroutines
+			&& get_time_ns() - start < (uint64_t)conf.nb_samples
+				* conf.period_us * 1000 + 5000000000ULL)
+			usleep(1000);
+
+		ULOGI("%u/%u coroutines done in %.1f ms, %.1f samples read "
+				"per coroutine",
+				stats.nb_done.load(), conf.nb_coroutines,
+				(get_time_ns() - start) / 1e6,
+				(double)stats.nb_reads / conf.nb_coroutines);
+		if (stats.nb_reads > 0)
+			ULOGI("commit to read delay : mean %.1f us, "
+					"max %.1f us",
+					stats.delay_ns / 1e3 / stats.nb_reads,
+					stats.max_delay_ns / 1e3);
+
+		if (stats.nb_done < conf.nb_coroutines
+				|| stats.nb_errors > 0) {
+			ULOGI("%u coroutines did not complete, %u errors",
+					conf.nb_coroutines - stats.nb_done,
+					stats.nb_errors.load());
+			return -1;
+		}
+	} catch (const std::system_error &e) {
+		ULOGI("%s : %s", e.what(), strerror(e.code().value()));
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,290 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file cpp_bench.cpp
+ *
+ * @brief Comparison of the C++ typed layer with the C api
+ *
+ * @details Runs the same window reads and single sample reads through the C
+ * api and through libshdata.hpp, on the same section, to check that the
+ * typed layer does not cost anything over raw C calls.
+ *
+ * Example command line :
+ *   libshdata-cpp-bench -n 100000 -w 64
+ * ... runs 100000 iterations of each operation, with windows of 64 samples.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <array>
+#include <vector>
+#include "example_log.h"
+#include "common.h"
+#include "libshdata.hpp"
+
+#define BLOB_NAME "cpp_bench"
+#define DEPTH 1024
+
+static const struct ex_metadata_blob_hdr s_metadata_hdr = {
+	0, 0xDEAD, "Hello",
+};
+
+struct bench_conf {
+	uint32_t iterations;
+	uint32_t window;
+};
+
+static void usage()
+{
+	printf("Comparison of the C++ typed layer of libshdata with its C "
+			"api\n");
+	printf("Usage :\n");
+	printf("\tn : number of iterations of each operation\n");
+	printf("\tw : size of the read window (in number of samples)\n");
+
+	exit(0);
+}
+
+static void parse_command(int argc, char *argv[], struct bench_conf *conf)
+{
+	int opt;
+
+	conf->iterations = 100000;
+	conf->window = 64;
+
+	while ((opt = getopt(argc, argv, "n:w:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			conf->iterations = (uint32_t)strtol(optarg, NULL, 0);
+			break;
+		case 'w':
+			conf->window = (uint32_t)strtol(optarg, NULL, 0);
+			break;
+		case 'h':
+		default:
+			usage();
+			break;
+		}
+	}
+}
+
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int bench_window_c(const struct bench_conf *conf,
+			shd::Consumer<example_prod_blob> &cons,
+			std::vector<acceleration> &acc)
+{
+	struct shd_quantity q_acc = {
+		offsetof(struct example_prod_blob, acc),
+		sizeof(struct acceleration)
+	};
+	struct shd_sample_search search = {
+		{ 0, 0 }, SHD_LATEST, conf->window - 1, 0
+	};
+	struct shd_sample_metadata *metadata;
+	struct shd_search_result result;
+	uint32_t i;
+	int ret;
+
+	for (i = 0; i < conf->iterations; i++) {
+		ret = shd_select_samples(cons.get(), &search, &metadata,
+				&result);
+		if (ret < 0)
+			return ret;
+		ret = shd_read_quantity(cons.get(), &q_acc, acc.data(),
+				acc.size() * sizeof(acc[0]));
+		if (ret < 0)
+			return ret;
+		ret = shd_end_read(cons.get(), cons.revision());
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int bench_window_cpp(const struct bench_conf *conf,
+			shd::Consumer<example_prod_blob> &cons,
+			std::vector<acceleration> &acc)
+{
+	struct shd_sample_search search = {
+		{ 0, 0 }, SHD_LATEST, conf->window - 1, 0
+	};
+	uint32_t i;
+	int ret;
+
+	for (i = 0; i < conf->iterations; i++) {
+		auto session = cons.select(search);
+
+		ret = session.read<&example_prod_blob::acc>(acc);
+		if (ret < 0)
+			return ret;
+		ret = session.end();
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int bench_sample_c(const struct bench_conf *conf,
+			shd::Consumer<example_prod_blob> &cons,
+			int *i1)
+{
+	struct shd_quantity q_i1 = {
+		offsetof(struct example_prod_blob, i1),
+		sizeof(int)
+	};
+	struct shd_sample_search search = {
+		{ 0, 0 }, SHD_LATEST, 0, 0
+	};
+	struct shd_quantity_sample qty_sample;
+	uint32_t i;
+	int ret;
+
+	for (i = 0; i < conf->iterations; i++) {
+		qty_sample.ptr = i1;
+		qty_sample.size = sizeof(*i1);
+		ret = shd_read_from_sample(cons.get(), 1, &search, &q_i1,
+				&qty_sample);
+		if (ret < 0)
+			return ret;
+		ret = shd_end_read(cons.get(), cons.revision());
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int bench_sample_cpp(const struct bench_conf *conf,
+			shd::Consumer<example_prod_blob> &cons,
+			int *i1)
+{
+	struct shd_sample_search search = {
+		{ 0, 0 }, SHD_LATEST, 0, 0
+	};
+	uint32_t i;
+	int ret;
+
+	for (i = 0; i < conf->iterations; i++) {
+		ret = cons.read<&example_prod_blob::i1>(search, *i1);
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_conf conf;
+	struct shd_sample_metadata meta = { { 0, 0 }, { 0, 0 } };
+	struct example_prod_blob blob;
+	uint64_t start, c_ns, cpp_ns;
+	int i1 = 0;
+	uint32_t i;
+	int ret;
+
+	parse_command(argc, argv, &conf);
+
+	if (conf.window == 0 || conf.window > DEPTH / 2) {
+		ULOGI("Window size should be between 1 and %d samples",
+				DEPTH / 2);
+		return -1;
+	}
+
+	try {
+		shd::Producer<example_prod_blob> prod(BLOB_NAME, DEPTH, 1000,
+				s_metadata_hdr);
+		memset(&blob, 0, sizeof(blob));
+		for (i = 0; i < DEPTH; i++) {
+			meta.ts.tv_nsec = i * 1000;
+			blob.i1 = i;
+			blob.acc.x = i;
+			prod.write(blob, meta);
+		}
+
+		shd::Consumer<example_prod_blob> cons(BLOB_NAME);
+		std::vector<acceleration> acc(conf.window);
+
+		start = get_time_ns();
+		ret = bench_window_c(&conf, cons, acc);
+		c_ns = get_time_ns() - start;
+		if (ret < 0)
+			goto error;
+		start = get_time_ns();
+		ret = bench_window_cpp(&conf, cons, acc);
+		cpp_ns = get_time_ns() - start;
+		if (ret < 0)
+			goto error;
+		if (acc[conf.window - 1].x != DEPTH - 1) {
+			ULOGI("Unexpected value read in window");
+			return -1;
+		}
+		ULOGI("window read (%u samples) : C %8.1f ns/op, "
+				"C++ %8.1f ns/op",
+				conf.window,
+				(double)c_ns / conf.iterations,
+				(double)cpp_ns / conf.iterations);
+
+		start = get_time_ns();
+		ret = bench_sample_c(&conf, cons, &i1);
+		c_ns = get_time_ns() - start;
+		if (ret < 0)
+			goto error;
+		start = get_time_ns();
+		ret = bench_sample_cpp(&conf, cons, &i1);
+		cpp_ns = get_time_ns() - start;
+		if (ret < 0)
+			goto error;
+		if (i1 != DEPTH - 1) {
+			ULOGI("Unexpected value read in sample");
+			return -1;
+		}
+		ULOGI("single sample read           : C %8.1f ns/op, "
+				"C++ %8.1f ns/op",
+				(double)c_ns / conf.iterations,
+				(double)cpp_ns / conf.iterations);
+	} catch (const std::system_error &e) {
+		ULOGI("%s : %s", e.what(), strerror(e.code().value()));
+		return -1;
+	}
+
+	return 0;
+
+error:
+	ULOGI("Benchmark failed : %s", strerror(-ret));
+	return -1;
+}
@@ -0,0 +1,105 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file list_sections.c
+ *
+ * @brief List the shared memory sections recorded in the section registry
+ *
+ * @details Every section created with shd_create() is recorded in the
+ * section registry : this tool prints them along with their size, revision
+ * and producer.
+ *
+ * Example command line :
+ *   libshdata-list
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include "libshdata.h"
+
+static const char *backend_to_str(enum shd_section_backend_type backend)
+{
+	switch (backend) {
+	case SHD_SECTION_BACKEND_SHM:
+		return "shm";
+	case SHD_SECTION_BACKEND_DEV_MEM:
+		return "dev_mem";
+	default:
+		return "other";
+	}
+}
+
+int main(void)
+{
+	struct shd_section_info *infos = NULL;
+	int nb_sections;
+	int ret;
+	int i;
+
+	nb_sections = shd_list_sections(NULL, 0);
+	if (nb_sections < 0) {
+		fprintf(stderr, "Could not read section registry : %s\n",
+				strerror(-nb_sections));
+		return -1;
+	}
+
+	if (nb_sections > 0) {
+		infos = calloc(nb_sections, sizeof(*infos));
+		if (infos == NULL)
+			return -1;
+	}
+
+	/* Sections may have been created in the meantime */
+	ret = shd_list_sections(infos, nb_sections);
+	if (ret < 0) {
+		free(infos);
+		return -1;
+	}
+	if (ret < nb_sections)
+		nb_sections = ret;
+
+	printf("%-32s %-8s %12s %8s %8s %8s %8s %s\n", "NAME", "BACKEND",
+			"SIZE", "BLOB", "DEPTH", "RATE", "REV", "PRODUCER");
+	for (i = 0; i < nb_sections; i++) {
+		printf("%-32s %-8s %12llu %8zu %8u %8u %8d %d%s\n",
+				infos[i].name,
+				backend_to_str(infos[i].backend),
+				(unsigned long long)infos[i].size,
+				infos[i].hdr_info.blob_size,
+				infos[i].hdr_info.max_nb_samples,
+				infos[i].hdr_info.rate,
+				infos[i].revision,
+				infos[i].producer_pid,
+				kill(infos[i].producer_pid, 0) < 0
+					&& errno == ESRCH ? " (exited)" : "");
+	}
+
+	free(infos);
+	return 0;
+}
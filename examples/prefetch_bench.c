@@ -0,0 +1,366 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file prefetch_bench.c
+ *
+ * @brief Benchmark of software prefetching in window reads and searches
+ *
+ * @details Consecutive slots of sections holding large blobs are too far apart
+ * for hardware prefetchers. This benchmark measures window reads of the start
+ * of each blob, window reads of whole blobs and linear searches through the
+ * history of sections with 64Ko and 1Mo blobs, with software prefetching
+ * enabled and disabled. Caches are evicted before each operation, and the
+ * cache misses of each operation are counted when the kernel exposes hardware
+ * counters.
+ *
+ * Example command line :
+ *   libshdata-prefetch-bench -n 50 -e 64
+ * ... runs 50 iterations of each operation, evicting caches with a 64Mo
+ * buffer before each of them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "example_log.h"
+#include "common.h"
+#define SHD_ADVANCED_READ_API
+#include "libshdata.h"
+
+#define BLOB_NAME "prefetch_bench"
+/* Size of the start of each blob read by "head" window reads */
+#define HEAD_SIZE 256
+/* Number of samples in "whole blob" window reads */
+#define WHOLE_WINDOW 8
+#define CACHE_LINE_SIZE 64
+
+struct ex_metadata_blob_hdr ex_metadata_hdr = {
+	.i1 = 0,
+	.i2 = 0xDEAD,
+	.c1 = "Hello",
+};
+
+struct bench_conf {
+	uint32_t iterations;
+	size_t evict_size;
+};
+
+struct bench_op {
+	uint64_t ns;
+	uint64_t misses;
+};
+
+struct bench_env {
+	const struct bench_conf *conf;
+	uint8_t *evict;
+	int perf_fd;
+};
+
+static void usage()
+{
+	printf("Benchmark of software prefetching in libshdata\n");
+	printf("Usage :\n");
+	printf("\tn : number of iterations of each operation\n");
+	printf("\te : size of the buffer used to evict caches (in Mo)\n");
+
+	exit(0);
+}
+
+static void parse_command(int argc, char *argv[], struct bench_conf *conf)
+{
+	int opt;
+
+	conf->iterations = 50;
+	conf->evict_size = 64;
+
+	while ((opt = getopt(argc, argv, "n:e:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			conf->iterations = (uint32_t)strtol(optarg, NULL, 0);
+			break;
+		case 'e':
+			conf->evict_size = (size_t)strtol(optarg, NULL, 0);
+			break;
+		case 'h':
+		default:
+			usage();
+			break;
+		}
+	}
+	conf->evict_size *= 1024 * 1024;
+}
+
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Open a counter of the cache misses of the calling process, initially
+ * disabled */
+static int cache_misses_counter_open(void)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void evict_caches(struct bench_env *env)
+{
+	size_t i;
+
+	for (i = 0; i < env->conf->evict_size; i += CACHE_LINE_SIZE)
+		env->evict[i]++;
+}
+
+static void op_start(struct bench_env *env, uint64_t *start)
+{
+	evict_caches(env);
+	if (env->perf_fd >= 0) {
+		ioctl(env->perf_fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(env->perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+	*start = get_time_ns();
+}
+
+static void op_end(struct bench_env *env, uint64_t start,
+			struct bench_op *op)
+{
+	uint64_t misses;
+
+	op->ns += get_time_ns() - start;
+	if (env->perf_fd >= 0) {
+		ioctl(env->perf_fd, PERF_EVENT_IOC_DISABLE, 0);
+		if (read(env->perf_fd, &misses, sizeof(misses))
+				== sizeof(misses))
+			op->misses += misses;
+	}
+}
+
+static void op_print(struct bench_env *env, const char *name,
+			const struct bench_op *op)
+{
+	if (env->perf_fd >= 0)
+		ULOGI("    %-22s : %10.1f us/op, %10.1f misses/op", name,
+				(double)op->ns / env->conf->iterations / 1000,
+				(double)op->misses / env->conf->iterations);
+	else
+		ULOGI("    %-22s : %10.1f us/op", name,
+				(double)op->ns / env->conf->iterations / 1000);
+}
+
+static int bench_reads(struct bench_env *env, size_t blob_size,
+			uint32_t depth, bool prefetch)
+{
+	struct shd_ctx *ctx_cons = NULL;
+	struct shd_revision *rev = NULL;
+	struct shd_sample_metadata *metadata;
+	struct shd_search_result result;
+	struct shd_quantity q_head = { 0, HEAD_SIZE };
+	struct shd_quantity q_whole = { 0, blob_size };
+	struct shd_sample_search search = {
+		.date = { 0, 0 },
+		.method = SHD_LATEST,
+		.nb_values_before_date = depth - 2,
+		.nb_values_after_date = 0,
+	};
+	struct bench_op head = { 0, 0 }, whole = { 0, 0 }, lookup = { 0, 0 };
+	uint8_t *dst = NULL;
+	uint64_t start;
+	uint32_t i;
+	int ret = -ENOMEM;
+
+	dst = malloc(WHOLE_WINDOW * blob_size);
+	if (dst == NULL)
+		goto exit;
+
+	if (!prefetch)
+		setenv("LIBSHDATA_CONFIG_INTERNAL_PREFETCH", "OFF", 1);
+	ctx_cons = shd_open(BLOB_NAME, NULL, &rev);
+	unsetenv("LIBSHDATA_CONFIG_INTERNAL_PREFETCH");
+	if (ctx_cons == NULL) {
+		ULOGI("Could not open section");
+		ret = -ENOENT;
+		goto exit;
+	}
+
+	for (i = 0; i < env->conf->iterations; i++) {
+		/* Start of each blob of the whole history */
+		search.method = SHD_LATEST;
+		search.nb_values_before_date = depth - 2;
+		op_start(env, &start);
+		ret = shd_select_samples(ctx_cons, &search, &metadata,
+				&result);
+		if (ret < 0)
+			goto exit;
+		shd_read_quantity(ctx_cons, &q_head, dst,
+				(depth - 1) * HEAD_SIZE);
+		op_end(env, start, &head);
+		shd_end_read(ctx_cons, rev);
+
+		/* Whole blobs of the latest samples */
+		search.nb_values_before_date = WHOLE_WINDOW - 1;
+		op_start(env, &start);
+		ret = shd_select_samples(ctx_cons, &search, &metadata,
+				&result);
+		if (ret < 0)
+			goto exit;
+		shd_read_quantity(ctx_cons, &q_whole, dst,
+				WHOLE_WINDOW * blob_size);
+		op_end(env, start, &whole);
+		shd_end_read(ctx_cons, rev);
+
+		/* Linear search of the oldest sample by its date */
+		search.method = SHD_FIRST_AFTER;
+		search.nb_values_before_date = 0;
+		search.date.tv_sec = 0;
+		search.date.tv_nsec = 1;
+		op_start(env, &start);
+		ret = shd_select_samples(ctx_cons, &search, &metadata,
+				&result);
+		op_end(env, start, &lookup);
+		if (ret < 0)
+			goto exit;
+		shd_end_read(ctx_cons, rev);
+	}
+
+	ULOGI("  prefetch %s :", prefetch ? "on" : "off");
+	op_print(env, "blob heads window", &head);
+	op_print(env, "whole blobs window", &whole);
+	op_print(env, "linear search", &lookup);
+
+	ret = 0;
+
+exit:
+	if (ret < 0)
+		ULOGI("Read benchmark failed : %s", strerror(-ret));
+	if (ctx_cons != NULL)
+		shd_close(ctx_cons, rev);
+	free(dst);
+	return ret;
+}
+
+static int bench_section(struct bench_env *env, size_t blob_size,
+			uint32_t depth)
+{
+	struct shd_ctx *ctx_prod = NULL;
+	struct shd_sample_metadata sample_meta = { { 0, 0 }, { 0, 0 } };
+	struct shd_hdr_user_info hdr_info = {
+		.blob_size = blob_size,
+		.max_nb_samples = depth,
+		.rate = 1000,
+		.blob_metadata_hdr_size = sizeof(ex_metadata_hdr)
+	};
+	uint8_t *blob = NULL;
+	uint32_t i;
+	int ret = -ENOMEM;
+
+	blob = calloc(1, blob_size);
+	if (blob == NULL)
+		goto exit;
+
+	ctx_prod = shd_create(BLOB_NAME, NULL, &hdr_info, &ex_metadata_hdr);
+	if (ctx_prod == NULL) {
+		ULOGI("Could not create section");
+		ret = -ENOENT;
+		goto exit;
+	}
+
+	/* Fill the section so that windows wrap around its end */
+	for (i = 0; i < depth + depth / 2; i++) {
+		sample_meta.ts.tv_sec = 1 + i / 1000;
+		sample_meta.ts.tv_nsec = (i % 1000) * 1000000;
+		blob[0] = (uint8_t)i;
+		ret = shd_write_new_blob(ctx_prod, blob, blob_size,
+				&sample_meta);
+		if (ret < 0)
+			goto exit;
+	}
+
+	ULOGI("blob size %zu Ko, depth %u :", blob_size / 1024, depth);
+	ret = bench_reads(env, blob_size, depth, false);
+	if (ret < 0)
+		goto exit;
+	ret = bench_reads(env, blob_size, depth, true);
+
+exit:
+	if (ctx_prod != NULL)
+		shd_close(ctx_prod, NULL);
+	free(blob);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_conf conf;
+	struct bench_env env = { .conf = &conf, .perf_fd = -1 };
+	int ret = -1;
+
+	parse_command(argc, argv, &conf);
+
+	if (conf.iterations == 0) {
+		ULOGI("Number of iterations should be at least 1");
+		return -1;
+	}
+
+	env.evict = calloc(1, conf.evict_size + 1);
+	if (env.evict == NULL)
+		return -1;
+
+	env.perf_fd = cache_misses_counter_open();
+	if (env.perf_fd < 0)
+		ULOGI("Cache misses counter unavailable : %s",
+				strerror(errno));
+
+	if (bench_section(&env, 64 * 1024, 256) < 0)
+		goto exit;
+	if (bench_section(&env, 1024 * 1024, 32) < 0)
+		goto exit;
+
+	ret = 0;
+
+exit:
+	if (env.perf_fd >= 0)
+		close(env.perf_fd);
+	free(env.evict);
+	return ret;
+}
@@ -0,0 +1,235 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file ring_index_bench.c
+ *
+ * @brief Microbenchmark of ring index arithmetic in window reads and searches
+ *
+ * @details Sections whose number of samples is a power of two use a mask
+ * instead of a modulo to compute ring indexes. This benchmark compares the
+ * cost of window reads and binary searches on two sections that only differ
+ * by their depth : one with a power-of-two depth and one without.
+ *
+ * Example command line :
+ *   libshdata-ring-index-bench -n 100000 -w 512
+ * ... runs 100000 iterations of each operation, with windows of 512 samples.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include "example_log.h"
+#include "common.h"
+#define SHD_ADVANCED_READ_API
+#include "libshdata.h"
+
+#define BLOB_NAME "ring_index_bench"
+
+struct ex_metadata_blob_hdr ex_metadata_hdr = {
+	.i1 = 0,
+	.i2 = 0xDEAD,
+	.c1 = "Hello",
+};
+
+struct bench_conf {
+	uint32_t iterations;
+	uint32_t window;
+};
+
+static void usage()
+{
+	printf("Microbenchmark of ring index arithmetic in libshdata\n");
+	printf("Usage :\n");
+	printf("\tn : number of iterations of each operation\n");
+	printf("\tw : size of the read window (in number of samples)\n");
+
+	exit(0);
+}
+
+static void parse_command(int argc, char *argv[], struct bench_conf *conf)
+{
+	int opt;
+
+	conf->iterations = 100000;
+	conf->window = 512;
+
+	while ((opt = getopt(argc, argv, "n:w:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			conf->iterations = (uint32_t)strtol(optarg, NULL, 0);
+			break;
+		case 'w':
+			conf->window = (uint32_t)strtol(optarg, NULL, 0);
+			break;
+		case 'h':
+		default:
+			usage();
+			break;
+		}
+	}
+}
+
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int bench_section(const struct bench_conf *conf, uint32_t depth)
+{
+	struct shd_ctx *ctx_prod = NULL, *ctx_cons = NULL;
+	struct shd_revision *rev = NULL;
+	struct shd_sample_metadata sample_meta = { { 0, 0 }, { 0, 0 } };
+	struct shd_sample_metadata *metadata;
+	struct shd_search_result result;
+	struct shd_quantity q_i1 = {
+		offsetof(struct example_prod_blob, i1),
+		sizeof(int)
+	};
+	struct shd_hdr_user_info hdr_info = {
+		.blob_size = sizeof(struct example_prod_blob),
+		.max_nb_samples = depth,
+		.rate = 1000,
+		.blob_metadata_hdr_size = sizeof(ex_metadata_hdr)
+	};
+	struct shd_sample_search search = {
+		.date = { 0, 0 },
+		.method = SHD_LATEST,
+		.nb_values_before_date = conf->window - 1,
+		.nb_values_after_date = 0,
+	};
+	struct example_prod_blob blob;
+	int *dst = NULL;
+	uint64_t start, window_ns, search_ns;
+	uint32_t i;
+	int ret = -1;
+
+	dst = calloc(conf->window, sizeof(*dst));
+	if (dst == NULL)
+		goto exit;
+
+	ctx_prod = shd_create(BLOB_NAME, NULL, &hdr_info, &ex_metadata_hdr);
+	if (ctx_prod == NULL) {
+		ULOGI("Could not create section");
+		goto exit;
+	}
+
+	/* Fill the section so that the oldest sample sits in the middle of
+	 * the buffer and windows wrap around its end */
+	memset(&blob, 0, sizeof(blob));
+	for (i = 0; i < depth + depth / 2; i++) {
+		sample_meta.ts.tv_nsec = (i % 1000000) * 1000;
+		sample_meta.ts.tv_sec = i / 1000000;
+		blob.i1 = i;
+		shd_write_new_blob(ctx_prod, &blob, sizeof(blob), &sample_meta);
+	}
+
+	/* Window reads */
+	ctx_cons = shd_open(BLOB_NAME, NULL, &rev);
+	if (ctx_cons == NULL) {
+		ULOGI("Could not open section");
+		goto exit;
+	}
+	start = get_time_ns();
+	for (i = 0; i < conf->iterations; i++) {
+		ret = shd_select_samples(ctx_cons, &search, &metadata,
+				&result);
+		if (ret < 0)
+			goto exit;
+		shd_read_quantity(ctx_cons, &q_i1, dst,
+				conf->window * sizeof(*dst));
+		shd_end_read(ctx_cons, rev);
+	}
+	window_ns = get_time_ns() - start;
+	shd_close(ctx_cons, rev);
+
+	/* Binary searches of a reference sample in the middle of the
+	 * history */
+	setenv("LIBSHDATA_CONFIG_INTERNAL_SEARCH_METHOD", "BINARY", 1);
+	ctx_cons = shd_open(BLOB_NAME, NULL, &rev);
+	unsetenv("LIBSHDATA_CONFIG_INTERNAL_SEARCH_METHOD");
+	if (ctx_cons == NULL) {
+		ULOGI("Could not open section");
+		goto exit;
+	}
+	search.method = SHD_FIRST_BEFORE;
+	search.nb_values_before_date = 0;
+	search.date.tv_sec = (depth + depth / 4) / 1000000;
+	search.date.tv_nsec = ((depth + depth / 4) % 1000000) * 1000 + 1;
+	start = get_time_ns();
+	for (i = 0; i < conf->iterations; i++) {
+		ret = shd_select_samples(ctx_cons, &search, &metadata,
+				&result);
+		if (ret < 0)
+			goto exit;
+		shd_end_read(ctx_cons, rev);
+	}
+	search_ns = get_time_ns() - start;
+
+	ULOGI("depth %5u%s : window read (%u samples) %8.1f ns/op, "
+			"binary search %8.1f ns/op",
+			depth,
+			(depth & (depth - 1)) == 0 ? " (pow2)" : "       ",
+			conf->window,
+			(double)window_ns / conf->iterations,
+			(double)search_ns / conf->iterations);
+
+	ret = 0;
+
+exit:
+	if (ret < 0)
+		ULOGI("Benchmark on depth %u failed : %s", depth,
+				strerror(-ret));
+	if (ctx_cons != NULL)
+		shd_close(ctx_cons, rev);
+	if (ctx_prod != NULL)
+		shd_close(ctx_prod, NULL);
+	free(dst);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_conf conf;
+
+	parse_command(argc, argv, &conf);
+
+	if (conf.window == 0 || conf.window > 1000) {
+		ULOGI("Window size should be between 1 and 1000 samples");
+		return -1;
+	}
+
+	if (bench_section(&conf, 1000) < 0)
+		return -1;
+	if (bench_section(&conf, 1024) < 0)
+		return -1;
+
+	return 0;
+}
@@ -42,14 +42,34 @@
  * in the consumer runs at 10ms while the producer runs at 1ms, we'll have to
  * get 10 samples at each run of the consumer)
  *
+ * Several consumers can run in parallel, each in its own process, and the
+ * producer can write to several sections at each loop : consumer #i then reads
+ * from section #(i modulo the number of sections). Consumers can be pinned to
+ * chosen CPUs.
+ *
+ * The producer stamps each blob with the monotonic date at which it is written,
+ * and consumers account for the latency between that date and the end of the
+ * read of each new sample into a log-linear histogram (16 sub-buckets per
+ * power of two, hence a precision of 1/16). The p50/p99/p99.9/max of these
+ * latencies are reported for each consumer and for all of them.
+ *
  * The following parameters are configurable :
  *   - the producer/consumer periods
  *   - the blob size
  *   - the shared memory section size
  *   - the number of samples to retrieve at each consumer loop
  *   - the total number of loops
+ *   - the number of consumers and sections
+ *   - the CPUs on which the producer and consumers run
+ *   - the way the producer copies blobs into the sections, and the size of a
+ *   working set it walks through after each write
+ *
+ * The producer counts the cache misses it takes during the whole test, when
+ * the kernel exposes hardware counters, as well as the time it spends walking
+ * its working set : large blobs written with regular copies evict this working
+ * set from its cache, while streaming writes leave it there.
  *
- * At the moment, both the consumer and the producer run at the maximum
+ * At the moment, both the consumers and the producer run at the maximum
  * real-time priority.
  *
  * Example command line :
@@ -57,8 +77,18 @@
  * ... runs the test with a producer running every 200us until it has produced
  * 10000 samples of 1Ko, a consumer running every 1ms looking for 4 + 1 previous
  * samples, and a section containing 100 samples at max.
+ *
+ *   libshdata-stress -p 200 -c 1000 -r 10000 -n 4 -m 2 -P 0 -C 1,2,3
+ * ... runs the same test with 4 consumers reading from 2 sections, the
+ * producer being pinned on CPU 0 and the consumers on CPUs 1, 2, 3 and 1.
+ *
+ *   libshdata-stress -p 5000 -c 5000 -r 1000 -b 1048576 -s 8 -w cached -k 512
+ *   libshdata-stress -p 5000 -c 5000 -r 1000 -b 1048576 -s 8 -w stream -k 512
+ * ... compare the producer cache misses with 1MB blobs, while it walks through
+ * a working set of 512Ko after each write.
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <sys/mman.h>		/* For shm and PROT flags */
 #include <sys/stat.h>		/* For mode constants */
@@ -67,10 +97,15 @@
 #include <sys/types.h>
 #include <poll.h>
 #include <sys/wait.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <signal.h>
+#include <time.h>
 #include "example_log.h"
 #include "common.h"
 #define SHD_ADVANCED_READ_API
@@ -81,6 +116,18 @@
 #define BLOB_NAME "stress_test"
 #define COMMUNICATION_ZONE_NAME "libshdata-stress-test"
 #define TIMER_PERIOD_NS 50000
+#define MAX_CONSUMERS 16
+#define MAX_SECTIONS 16
+#define BLOB_NAME_SIZE 32
+#define CACHE_LINE_SIZE 64
+
+/* Log-linear latency histogram : values below HIST_SUB_BUCKETS are counted
+ * exactly, then each power of two is split into HIST_SUB_BUCKETS buckets */
+#define HIST_SUB_BUCKETS_BITS 4
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BUCKETS_BITS)
+#define HIST_MAX_MAGNITUDE 40 /* ~18 minutes in ns */
+#define HIST_NB_BUCKETS \
+	((HIST_MAX_MAGNITUDE - HIST_SUB_BUCKETS_BITS + 1) * HIST_SUB_BUCKETS)
 
 struct ex_metadata_blob_hdr ex_metadata_hdr = {
 	.i1 = 0,
@@ -101,6 +148,13 @@ static void usage()
 	printf("\tb : size of the blob (in bytes)\n");
 	printf("\ts : size of the section (in number of samples)\n");
 	printf("\td : history depth on consumer-side\n");
+	printf("\tn : number of consumers (at most %d)\n", MAX_CONSUMERS);
+	printf("\tm : number of sections (at most %d)\n", MAX_SECTIONS);
+	printf("\tP : CPU on which to pin the producer\n");
+	printf("\tC : comma-separated list of CPUs on which to pin the "
+			"consumers\n");
+	printf("\tw : producer write mode (auto, cached or stream)\n");
+	printf("\tk : size of the producer working set (in Ko)\n");
 
 	exit(0);
 }
@@ -115,6 +169,12 @@ struct test_setup {
 	int max_producer_loops;
 	int blob_size;
 	int samples_after;
+	int nb_sections;
+	int nb_consumers;
+	int consumer_id;
+	int cpu;
+	enum shd_write_mode write_mode;
+	size_t working_set_size;
 };
 
 struct test_result {
@@ -125,6 +185,12 @@ struct test_result {
 	int last_missed;
 };
 
+struct latency_histogram {
+	uint64_t counts[HIST_NB_BUCKETS];
+	uint64_t total;
+	uint64_t max;
+};
+
 struct cmd_line_args {
 	uint32_t prod_period; /* in us */
 	uint32_t cons_period; /* in us */
@@ -132,15 +198,28 @@ struct cmd_line_args {
 	uint32_t blob_size;
 	uint32_t section_size;
 	uint32_t samples_before;
+	uint32_t nb_consumers;
+	uint32_t nb_sections;
+	int prod_cpu;
+	int cons_cpus[MAX_CONSUMERS];
+	int nb_cons_cpus;
+	enum shd_write_mode write_mode;
+	uint32_t working_set_size; /* in Ko */
+};
+
+struct producer_stats {
+	/* -1 if hardware counters are not available */
+	int64_t cache_misses;
+	uint64_t working_set_ns;
 };
 
 struct communication_zone {
-	int consumer_ready;
-	int timer_fd;
+	int consumers_ready;
 	int test_over;
-	struct pollfd poll;
 	struct test_result res_prod;
-	struct test_result res_cons;
+	struct producer_stats stats_prod;
+	struct test_result res_cons[MAX_CONSUMERS];
+	struct latency_histogram latency[MAX_CONSUMERS];
 };
 static struct communication_zone *communication_zone_get(void)
 {
@@ -203,6 +282,161 @@ static struct communication_zone *communication_zone_create(void)
 	return zone;
 }
 
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int histogram_index(uint64_t value)
+{
+	int magnitude, shift;
+
+	if (value < HIST_SUB_BUCKETS)
+		return value;
+
+	magnitude = 63 - __builtin_clzll(value);
+	if (magnitude >= HIST_MAX_MAGNITUDE)
+		return HIST_NB_BUCKETS - 1;
+
+	/* Keep the HIST_SUB_BUCKETS_BITS bits following the leading one */
+	shift = magnitude - HIST_SUB_BUCKETS_BITS;
+	return (shift + 1) * HIST_SUB_BUCKETS
+		+ (int)((value >> shift) - HIST_SUB_BUCKETS);
+}
+
+static uint64_t histogram_value(int index)
+{
+	int shift;
+
+	if (index < HIST_SUB_BUCKETS)
+		return index;
+
+	shift = index / HIST_SUB_BUCKETS - 1;
+	return (uint64_t)(index % HIST_SUB_BUCKETS + HIST_SUB_BUCKETS)
+		<< shift;
+}
+
+static void histogram_record(struct latency_histogram *hist, uint64_t value)
+{
+	hist->counts[histogram_index(value)]++;
+	hist->total++;
+	if (value > hist->max)
+		hist->max = value;
+}
+
+static void histogram_merge(struct latency_histogram *dst,
+				const struct latency_histogram *src)
+{
+	int i;
+
+	for (i = 0; i < HIST_NB_BUCKETS; i++)
+		dst->counts[i] += src->counts[i];
+	dst->total += src->total;
+	if (src->max > dst->max)
+		dst->max = src->max;
+}
+
+/*
+ * Get the lowest value of the bucket containing a given percentile
+ */
+static uint64_t histogram_percentile(const struct latency_histogram *hist,
+					double percentile)
+{
+	uint64_t rank, count = 0;
+	int i;
+
+	if (hist->total == 0)
+		return 0;
+
+	rank = (uint64_t)(hist->total * percentile / 100.0);
+	if (rank == 0)
+		rank = 1;
+	for (i = 0; i < HIST_NB_BUCKETS; i++) {
+		count += hist->counts[i];
+		if (count >= rank)
+			return histogram_value(i);
+	}
+
+	return hist->max;
+}
+
+static void histogram_print(const char *name,
+				const struct latency_histogram *hist)
+{
+	ULOGI("%s latency over %llu samples : p50 %lluus, p99 %lluus, "
+			"p99.9 %lluus, max %lluus",
+			name,
+			(unsigned long long)hist->total,
+			(unsigned long long)histogram_percentile(hist, 50) / 1000,
+			(unsigned long long)histogram_percentile(hist, 99) / 1000,
+			(unsigned long long)histogram_percentile(hist, 99.9)
+				/ 1000,
+			(unsigned long long)hist->max / 1000);
+}
+
+static void pin_to_cpu(int cpu)
+{
+	cpu_set_t set;
+
+	if (cpu < 0)
+		return;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) < 0)
+		ULOGI("Could not pin process %d to CPU %d : %s", getpid(), cpu,
+				strerror(errno));
+}
+
+/*
+ * Start a timer ticking at the period of the calling process, in ns. Loops
+ * account for time in base clock ticks, hence the expiration counts of this
+ * timer are multiplied by the scaler of the process.
+ */
+static int timer_start(uint64_t timer_period)
+{
+	struct itimerspec period = {
+		.it_interval = {
+			.tv_sec = timer_period / 1000000000ULL,
+			.tv_nsec = timer_period % 1000000000ULL
+		},
+		.it_value = { .tv_sec = 0, .tv_nsec = 100000000 }
+	};
+	int timer_fd;
+
+	timer_fd = timerfd_create(CLOCK_MONOTONIC, 0);
+	if (timer_fd < 0) {
+		ULOGI("Error creating the timer : %s", strerror(errno));
+		return -1;
+	}
+
+	if (timerfd_settime(timer_fd, 0, &period, NULL) < 0)
+		ULOGI("Error setting the timer : %s", strerror(errno));
+
+	return timer_fd;
+}
+
+static void get_blob_name(int section, char *name)
+{
+	snprintf(name, BLOB_NAME_SIZE, "%s-%d", BLOB_NAME, section);
+}
+
+static void parse_cpu_list(const char *list, struct cmd_line_args *args)
+{
+	char *end;
+
+	args->nb_cons_cpus = 0;
+	while (*list != '\0' && args->nb_cons_cpus < MAX_CONSUMERS) {
+		args->cons_cpus[args->nb_cons_cpus++] = strtol(list, &end, 0);
+		if (*end != ',')
+			break;
+		list = end + 1;
+	}
+}
+
 static void get_size(int size, char *string)
 {
 	if (size >= 1024 * 1024)
@@ -223,8 +457,14 @@ static void parse_command(int argc, char *argv[], struct cmd_line_args *args)
 	args->blob_size = 1;
 	args->section_size = 100;
 	args->samples_before = 0;
-
-	while ((opt = getopt(argc, argv, "p:c:r:b:s:d:h")) != -1) {
+	args->nb_consumers = 1;
+	args->nb_sections = 1;
+	args->prod_cpu = -1;
+	args->nb_cons_cpus = 0;
+	args->write_mode = SHD_WRITE_MODE_AUTO;
+	args->working_set_size = 0;
+
+	while ((opt = getopt(argc, argv, "p:c:r:b:s:d:n:m:P:C:w:k:h")) != -1) {
 		switch (opt) {
 		case 'p':
 			args->prod_period = (uint32_t)strtol(optarg, NULL, 0);
@@ -245,12 +485,54 @@ static void parse_command(int argc, char *argv[], struct cmd_line_args *args)
 			args->samples_before = (uint32_t)strtol(optarg,
 								NULL, 0);
 			break;
+		case 'n':
+			args->nb_consumers = (uint32_t)strtol(optarg, NULL, 0);
+			break;
+		case 'm':
+			args->nb_sections = (uint32_t)strtol(optarg, NULL, 0);
+			break;
+		case 'P':
+			args->prod_cpu = (int)strtol(optarg, NULL, 0);
+			break;
+		case 'C':
+			parse_cpu_list(optarg, args);
+			break;
+		case 'w':
+			if (strcmp(optarg, "cached") == 0) {
+				args->write_mode = SHD_WRITE_MODE_CACHED;
+			} else if (strcmp(optarg, "stream") == 0) {
+				args->write_mode = SHD_WRITE_MODE_STREAMING;
+			} else if (strcmp(optarg, "auto") == 0) {
+				args->write_mode = SHD_WRITE_MODE_AUTO;
+			} else {
+				ULOGI("Unknown write mode : %s", optarg);
+				exit(1);
+			}
+			break;
+		case 'k':
+			args->working_set_size = (uint32_t)strtol(optarg,
+								NULL, 0);
+			break;
 		case 'h':
 		default:
 			usage();
 			break;
 		}
 	}
+	/* Blobs carry the date at which they were written */
+	if (args->blob_size < sizeof(uint64_t))
+		args->blob_size = sizeof(uint64_t);
+	if (args->nb_consumers < 1 || args->nb_consumers > MAX_CONSUMERS) {
+		ULOGI("Number of consumers should be between 1 and %d",
+				MAX_CONSUMERS);
+		exit(1);
+	}
+	if (args->nb_sections < 1 || args->nb_sections > MAX_SECTIONS) {
+		ULOGI("Number of sections should be between 1 and %d",
+				MAX_SECTIONS);
+		exit(1);
+	}
+
 	ULOGI("Test configuration :");
 	ULOGI("    - producer period : %i us", args->prod_period);
 	ULOGI("    - consumer period : %i us", args->cons_period);
@@ -260,6 +542,39 @@ static void parse_command(int argc, char *argv[], struct cmd_line_args *args)
 	ULOGI("    - section size : %i samples (at least %s)",
 			args->section_size, size);
 	ULOGI("    - history depth : %i samples", args->samples_before);
+	ULOGI("    - %u consumer(s) reading from %u section(s)",
+			args->nb_consumers, args->nb_sections);
+	ULOGI("    - producer write mode : %s, working set : %u Ko",
+			args->write_mode == SHD_WRITE_MODE_CACHED ? "cached" :
+			args->write_mode == SHD_WRITE_MODE_STREAMING ?
+				"stream" : "auto",
+			args->working_set_size);
+}
+
+/* Open a counter of the cache misses of the calling process, initially
+ * disabled */
+static int cache_misses_counter_open(void)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/* Walk through the working set of the producer, one cache line at a time */
+static void working_set_walk(uint8_t *ws, size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < size; i += CACHE_LINE_SIZE)
+		ws[i]++;
 }
 
 static void sig_int_handler(int sig)
@@ -271,15 +586,29 @@ static void sig_int_handler(int sig)
 
 static void producer_loop(struct test_setup *setup)
 {
-	struct shd_ctx *ctx_prod;
+	struct shd_ctx *ctx_prod[MAX_SECTIONS] = { NULL };
 	struct shd_sample_metadata sample_meta = { { 0, 0 }, { 0, 0 } };
 	struct communication_zone *zone = NULL;
 	struct pollfd pollfd;
+	char blob_name[BLOB_NAME_SIZE];
 	uint8_t *data = calloc(sizeof(uint8_t), setup->blob_size);
+	uint8_t *ws = NULL;
+	uint64_t ws_start;
+	uint64_t misses;
+	int perf_fd = -1;
 	if (!data) {
 		ULOGP("Could not allocate blob memory : %s", strerror(errno));
 		return;
 	}
+	if (setup->working_set_size > 0) {
+		ws = calloc(1, setup->working_set_size);
+		if (!ws) {
+			ULOGP("Could not allocate working set : %s",
+					strerror(errno));
+			free(data);
+			return;
+		}
+	}
 	struct shd_hdr_user_info hdr_info = {
 		.blob_size = sizeof(uint8_t) * setup->blob_size,
 		.max_nb_samples = setup->max_nb_samples,
@@ -289,25 +618,41 @@ static void producer_loop(struct test_setup *setup)
 	int index = 0;
 	int currentLoop = 0;
 	int nextLoopIndex = 0;
+	int i;
 
 	zone = communication_zone_get();
 	if (!zone)
 		ULOGI("Could not get communication zone");
 
-	ctx_prod = shd_create(BLOB_NAME, NULL, &hdr_info, &ex_metadata_hdr);
-	if (!ctx_prod) {
-		ULOGP("Could not create new memory section");
-		goto exit;
+	for (i = 0; i < setup->nb_sections; i++) {
+		get_blob_name(i, blob_name);
+		ctx_prod[i] = shd_create(blob_name, NULL, &hdr_info,
+				&ex_metadata_hdr);
+		if (!ctx_prod[i]) {
+			ULOGP("Could not create new memory section");
+			goto exit;
+		}
+		shd_set_write_mode(ctx_prod[i], setup->write_mode);
 	}
 
-	while (zone->consumer_ready == 0)
+	while (zone->consumers_ready < setup->nb_consumers)
 		usleep(1);
 
-	pollfd.fd = zone->timer_fd;
+	pollfd.fd = timer_start(setup->prod_scaler * setup->timer_period);
 	pollfd.events = POLLIN;
+	if (pollfd.fd < 0)
+		goto exit;
+
+	perf_fd = cache_misses_counter_open();
+	if (perf_fd < 0)
+		ULOGP("Cache misses counter unavailable : %s",
+				strerror(errno));
+	else
+		ioctl(perf_fd, PERF_EVENT_IOC_ENABLE, 0);
 
 	while (!zone->test_over) {
 		uint64_t timer_value;
+		uint64_t write_date;
 		nextLoopIndex = (currentLoop + 1) * setup->prod_scaler;
 
 		/* The loop "wakes up" at every timer tick : however we only
@@ -322,7 +667,7 @@ static void producer_loop(struct test_setup *setup)
 		}
 
 		ret = read(pollfd.fd, &timer_value, sizeof(timer_value));
-		index += timer_value;
+		index += timer_value * setup->prod_scaler;
 		if (index < nextLoopIndex)
 			continue;
 		else if (index > nextLoopIndex + setup->prod_scaler) {
@@ -340,14 +685,27 @@ static void producer_loop(struct test_setup *setup)
 			break;
 		}
 
-		ret = shd_write_new_blob(ctx_prod, data,
+		for (i = 0; i < setup->nb_sections; i++) {
+			write_date = get_time_ns();
+			memcpy(data, &write_date, sizeof(write_date));
+			ret = shd_write_new_blob(ctx_prod[i], data,
 						setup->blob_size, &sample_meta);
+			if (ret < 0)
+				break;
+		}
 
 		if (ret < 0) {
 			ULOGP("Error writing blob : %s", strerror(-ret));
 			break;
 		}
 
+		if (ws) {
+			ws_start = get_time_ns();
+			working_set_walk(ws, setup->working_set_size);
+			zone->stats_prod.working_set_ns +=
+					get_time_ns() - ws_start;
+		}
+
 		if (currentLoop * 10 % setup->max_producer_loops == 0)
 			ULOGP("%i %%",
 			      currentLoop * 100 / setup->max_producer_loops);
@@ -358,12 +716,25 @@ static void producer_loop(struct test_setup *setup)
 			break;
 	}
 
+	close(pollfd.fd);
+
+	if (perf_fd >= 0) {
+		ioctl(perf_fd, PERF_EVENT_IOC_DISABLE, 0);
+		if (read(perf_fd, &misses, sizeof(misses)) == sizeof(misses))
+			zone->stats_prod.cache_misses = (int64_t)misses;
+		close(perf_fd);
+	}
+
 exit:
 	zone->test_over = 1;
 	zone->res_prod.total_loops = currentLoop;
 	zone->res_prod.produced_samples = currentLoop;
 	communication_zone_destroy(zone);
-	shd_close(ctx_prod, NULL);
+	for (i = 0; i < setup->nb_sections; i++) {
+		if (ctx_prod[i])
+			shd_close(ctx_prod[i], NULL);
+	}
+	free(ws);
 	free(data);
 }
 
@@ -391,6 +762,8 @@ static void consumer_one_sample_loop(struct test_setup *setup,
 	struct shd_quantity_sample blob_samp[1] = {
 		{ .ptr = read_data, .size = sizeof(uint8_t) * setup->blob_size }
 	};
+	uint64_t write_date, last_write_date = 0;
+	int read_ret;
 
 	while (!zone->test_over) {
 		uint64_t timer_value;
@@ -406,13 +779,13 @@ static void consumer_one_sample_loop(struct test_setup *setup,
 		}
 
 		ret = read(pollfd->fd, &timer_value, sizeof(timer_value));
-		index = timer_value;
+		index += timer_value * setup->cons_scaler;
 		if (index < nextLoopIndex)
 			continue;
-		else if (index > nextLoopIndex + setup->prod_scaler) {
+		else if (index > nextLoopIndex + setup->cons_scaler) {
 			ULOGC("Consumer didn't execute in time after %i loops!",
 					currentLoop);
-			zone->res_cons.missed_loops++;
+			zone->res_cons[setup->consumer_id].missed_loops++;
 		}
 
 		do {
@@ -426,13 +799,24 @@ static void consumer_one_sample_loop(struct test_setup *setup,
 			ULOGC("Error encountered while reading from "
 					"sample : %s", strerror(-ret));
 
+		read_ret = ret;
 		ret = shd_end_read(*ctx_cons, *rev);
 		if (ret < 0 && ret == -ENODEV) {
 			ULOGC("Reopening memory section ...");
 			do {
 				shd_close(*ctx_cons, *rev);
-				*ctx_cons = shd_open(BLOB_NAME, NULL, rev);
+				*ctx_cons = shd_open(setup->blob_name, NULL,
+						rev);
 			} while (*ctx_cons == NULL);
+		} else if (ret >= 0 && read_ret > 0) {
+			/* Account for the latency of new samples only */
+			memcpy(&write_date, read_data, sizeof(write_date));
+			if (write_date != last_write_date) {
+				histogram_record(
+					&zone->latency[setup->consumer_id],
+					get_time_ns() - write_date);
+				last_write_date = write_date;
+			}
 		} else if (ret < 0) {
 			ULOGC("Error encountered while ending read : %s",
 					strerror(-ret));
@@ -440,7 +824,7 @@ static void consumer_one_sample_loop(struct test_setup *setup,
 		}
 		currentLoop++;
 	}
-	zone->res_cons.total_loops = currentLoop;
+	zone->res_cons[setup->consumer_id].total_loops = currentLoop;
 	free(read_data);
 }
 
@@ -455,30 +839,46 @@ static int try_read(struct shd_ctx **ctx_cons,
 		    struct shd_search_result *result)
 {
 	int ret;
+	int i;
 	struct timespec diff = { 0, 0 };
 	uint64_t diff_us = 0;
 	uint64_t prod_period_us = setup->prod_scaler
 					* setup->timer_period / 1000;
+	uint64_t write_date, read_date;
+	struct test_result *res = &zone->res_cons[setup->consumer_id];
+	struct timespec oldest, newest;
 
 	ret = shd_read_quantity(*ctx_cons, NULL, read_data,
 				setup->blob_size * (setup->samples_after + 1));
 	if (ret < 0)
 		ULOGC("Problem reading quantity : %s", strerror(-ret));
 
+	/* Metadata are freed by shd_end_read() */
+	oldest = metadata[0].ts;
+	newest = metadata[result->nb_matches - 1].ts;
+
 	ret = shd_end_read(*ctx_cons, *rev);
 	if (ret < 0 && ret == -ENODEV) {
 		ULOGC("Reopening memory section ...");
 		do {
 			shd_close(*ctx_cons, *rev);
-			*ctx_cons = shd_open(BLOB_NAME, NULL, rev);
+			*ctx_cons = shd_open(setup->blob_name, NULL, rev);
 		} while (*ctx_cons == NULL);
 	} else if (ret >= 0) {
-		ret = time_timespec_cmp(most_recent, &metadata[0].ts);
+		/* All the samples of the window are new ones */
+		read_date = get_time_ns();
+		for (i = 0; i < result->nb_matches; i++) {
+			memcpy(&write_date, read_data + i * setup->blob_size,
+					sizeof(write_date));
+			histogram_record(&zone->latency[setup->consumer_id],
+					read_date - write_date);
+		}
+
+		ret = time_timespec_cmp(most_recent, &oldest);
 		if (ret > 0) {
 			ULOGC("Retrieved sample is outdated");
 		} else {
-			ret = time_timespec_diff(most_recent, &metadata[0].ts,
-						 &diff);
+			ret = time_timespec_diff(most_recent, &oldest, &diff);
 			if (ret < 0)
 				ULOGC("Error computing diff : %s",
 						strerror(-ret));
@@ -491,12 +891,12 @@ static int try_read(struct shd_ctx **ctx_cons,
 			if (diff_us > prod_period_us) {
 				ULOGC("Missed %llu samples",
 						diff_us / prod_period_us);
-				zone->res_cons.missed_samples +=
+				res->missed_samples +=
 					diff_us / prod_period_us;
-				zone->res_cons.last_missed = current_loop;
+				res->last_missed = current_loop;
 			}
 
-			*most_recent = metadata[result->nb_matches - 1].ts;
+			*most_recent = newest;
 		}
 	}
 
@@ -545,13 +945,13 @@ static void consumer_several_sample_loop(struct test_setup *setup,
 		}
 
 		ret = read(pollfd->fd, &timer_value, sizeof(timer_value));
-		index += timer_value;
+		index += timer_value * setup->cons_scaler;
 		if (index < nextLoopIndex)
 			continue;
 		else if (index > nextLoopIndex + setup->cons_scaler) {
 			ULOGC("Consumer didn't execute in time after %i loops!",
 					currentLoop);
-			zone->res_cons.missed_loops++;
+			zone->res_cons[setup->consumer_id].missed_loops++;
 		}
 
 		currentLoop++;
@@ -574,7 +974,7 @@ static void consumer_several_sample_loop(struct test_setup *setup,
 				 currentLoop, &most_recent, &result);
 		}
 	}
-	zone->res_cons.total_loops = currentLoop;
+	zone->res_cons[setup->consumer_id].total_loops = currentLoop;
 	free(read_data);
 }
 
@@ -590,12 +990,12 @@ static void consumer_loop(struct test_setup *setup)
 		ULOGI("Could not get communication zone");
 
 	while (ctx_cons == NULL)
-		ctx_cons = shd_open(BLOB_NAME, NULL, &rev);
+		ctx_cons = shd_open(setup->blob_name, NULL, &rev);
 
-	pollfd.fd = zone->timer_fd;
+	pollfd.fd = timer_start(setup->cons_scaler * setup->timer_period);
 	pollfd.events = POLLIN;
 
-	zone->consumer_ready = 1;
+	__atomic_add_fetch(&zone->consumers_ready, 1, __ATOMIC_SEQ_CST);
 
 	if (setup->samples_after == 0)
 		consumer_one_sample_loop(setup, zone, &ctx_cons, &rev, &pollfd);
@@ -603,47 +1003,57 @@ static void consumer_loop(struct test_setup *setup)
 		consumer_several_sample_loop(setup, zone, &ctx_cons, &rev,
 					     &pollfd);
 
+	close(pollfd.fd);
 	shd_close(ctx_cons, rev);
 	communication_zone_destroy(zone);
 }
 
-static void launch_test(int timer_fd, struct test_setup *setup)
+static void launch_test(struct test_setup *setup, const int *cons_cpus,
+			int nb_cons_cpus)
 {
-	struct itimerspec period = {
-		.it_interval = { .tv_sec = 0, .tv_nsec = setup->timer_period },
-		.it_value = { .tv_sec = 0, .tv_nsec = 100000000 }
-	};
-	int ret = timerfd_settime(timer_fd, 0, &period, NULL);
-	if (ret < 0)
-		ULOGI("Error setting the timer : %s", strerror(errno));
 	struct sched_param sched_params;
+	int i;
+
 	sched_params.__sched_priority = sched_get_priority_max(SCHED_RR);
 
-	pid_t pid = fork();
-
-	if (pid == 0) {
-		/* Child code */
-		ULOGC("Created with PID = %d", getpid());
-		if (sched_setscheduler(0, SCHED_RR, &sched_params) < 0)
-			ULOGC("Could not apply scheduling policy");
-
-		signal(SIGINT, sig_int_handler);
-		consumer_loop(setup);
-		ULOGC("... ended");
-		exit(0);
-	} else if (pid > 0) {
-		/* Parent code */
-		ULOGP("Created with PID = %d", getpid());
-		if (sched_setscheduler(0, SCHED_RR, &sched_params) < 0)
-			ULOGP("Could not apply scheduling policy");
-
-		signal(SIGINT, sig_int_handler);
-		producer_loop(setup);
-		ULOGP("... ended, waiting for consumer to exit");
-		wait(NULL);
-	} else {
-		ULOGI("Oops");
+	for (i = 0; i < setup->nb_consumers; i++) {
+		pid_t pid = fork();
+
+		if (pid == 0) {
+			/* Child code */
+			struct test_setup cons_setup = *setup;
+			char blob_name[BLOB_NAME_SIZE];
+
+			ULOGC("#%d created with PID = %d", i, getpid());
+			get_blob_name(i % setup->nb_sections, blob_name);
+			cons_setup.blob_name = blob_name;
+			cons_setup.consumer_id = i;
+			if (nb_cons_cpus > 0)
+				pin_to_cpu(cons_cpus[i % nb_cons_cpus]);
+			if (sched_setscheduler(0, SCHED_RR, &sched_params) < 0)
+				ULOGC("Could not apply scheduling policy");
+
+			signal(SIGINT, sig_int_handler);
+			consumer_loop(&cons_setup);
+			ULOGC("#%d ... ended", i);
+			exit(0);
+		} else if (pid < 0) {
+			ULOGI("Oops");
+			return;
+		}
 	}
+
+	/* Parent code */
+	ULOGP("Created with PID = %d", getpid());
+	pin_to_cpu(setup->cpu);
+	if (sched_setscheduler(0, SCHED_RR, &sched_params) < 0)
+		ULOGP("Could not apply scheduling policy");
+
+	signal(SIGINT, sig_int_handler);
+	producer_loop(setup);
+	ULOGP("... ended, waiting for consumers to exit");
+	for (i = 0; i < setup->nb_consumers; i++)
+		wait(NULL);
 }
 
 int main(int argc, char *argv[])
@@ -651,6 +1061,9 @@ int main(int argc, char *argv[])
 	struct cmd_line_args args;
 	parse_command(argc, argv, &args);
 	struct communication_zone *zone;
+	struct latency_histogram *all_latencies;
+	char name[32];
+	uint32_t i;
 
 	zone = communication_zone_create();
 	if (!zone) {
@@ -659,20 +1072,9 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
-	zone->timer_fd = timerfd_create(CLOCK_MONOTONIC, 0);
-	if (zone->timer_fd < 0) {
-		ULOGI("Error creating the timer : %s", strerror(errno));
-		return -1;
-	}
-
-	zone->consumer_ready = 0;
-	zone->test_over = 0;
-	zone->res_cons.missed_loops = 0;
-	zone->res_cons.total_loops = 0;
-	zone->res_cons.missed_samples = 0;
-	zone->res_prod.missed_loops = 0;
-	zone->res_prod.total_loops = 0;
-	zone->res_prod.missed_samples = 0;
+	/* Zero the whole zone, including results and histograms */
+	memset(zone, 0, sizeof(*zone));
+	zone->stats_prod.cache_misses = -1;
 
 	if (args.cons_period * 1000 % TIMER_PERIOD_NS != 0) {
 		ULOGI("Consumer period should be an integer multiple of %i ns",
@@ -691,19 +1093,46 @@ int main(int argc, char *argv[])
 		.timer_period = TIMER_PERIOD_NS,
 		.max_producer_loops = args.repeats,
 		.blob_size = args.blob_size,
-		.samples_after = args.samples_before
+		.samples_after = args.samples_before,
+		.nb_sections = args.nb_sections,
+		.nb_consumers = args.nb_consumers,
+		.consumer_id = -1,
+		.cpu = args.prod_cpu,
+		.write_mode = args.write_mode,
+		.working_set_size = (size_t)args.working_set_size * 1024
 	};
 
-	launch_test(zone->timer_fd, &setup);
+	launch_test(&setup, args.cons_cpus, args.nb_cons_cpus);
 
 	ULOGI("Producer missed %i loops out of %i", zone->res_prod.missed_loops,
 						zone->res_prod.total_loops);
-	ULOGI("Consumer missed %i samples (for the last time at iteration #%i "
-			"out of %i loops)",
-			zone->res_cons.missed_samples,
-			zone->res_cons.last_missed,
-			zone->res_cons.total_loops);
+	if (zone->stats_prod.cache_misses >= 0 && zone->res_prod.total_loops)
+		ULOGI("Producer cache misses : %lld (%.1f per loop)",
+				(long long)zone->stats_prod.cache_misses,
+				(double)zone->stats_prod.cache_misses /
+					zone->res_prod.total_loops);
+	if (args.working_set_size > 0 && zone->res_prod.total_loops)
+		ULOGI("Producer working set walk : %.1f us per loop",
+				(double)zone->stats_prod.working_set_ns /
+					zone->res_prod.total_loops / 1000);
+
+	all_latencies = calloc(1, sizeof(*all_latencies));
+	for (i = 0; i < args.nb_consumers; i++) {
+		ULOGI("Consumer #%u missed %i samples (for the last time at "
+				"iteration #%i out of %i loops)",
+				i,
+				zone->res_cons[i].missed_samples,
+				zone->res_cons[i].last_missed,
+				zone->res_cons[i].total_loops);
+		snprintf(name, sizeof(name), "Consumer #%u", i);
+		histogram_print(name, &zone->latency[i]);
+		if (all_latencies)
+			histogram_merge(all_latencies, &zone->latency[i]);
+	}
+	if (all_latencies && args.nb_consumers > 1)
+		histogram_print("All consumers", all_latencies);
 
+	free(all_latencies);
 	communication_zone_destroy(zone);
 	return 0;
 }
@@ -43,14 +43,18 @@ enum shd_concurrency_hook {
 	HOOK_SAMPLE_WRITE_AFTER_COMMIT,
 	HOOK_WINDOW_SEARCH_START,
 	HOOK_WINDOW_SEARCH_OVER,
+	HOOK_SECTION_OPEN_FROM_REGISTRY,
 	HOOK_TOTAL
 };
 
+#ifdef SHD_CONCURRENCY_HOOKS
+
 /*
  * @brief Function called at each hook point : defined as a weak symbol here,
- * and as a strong symbol in libshdata's test code. In normal operation this
- * code doesn't do anything but go through the "false" branch of the test in
- * SHD_HOOK (obviously a slight performance hit)
+ * and as a strong symbol in libshdata's test code. Hook points are only
+ * compiled in when the library is built with SHD_CONCURRENCY_HOOKS defined
+ * (which is the case in test builds) : production builds don't pay for the
+ * test of the weak symbol on their hot paths
  */
 void __attribute__((weak)) shd_concurrency_hook(enum shd_concurrency_hook hook);
 
@@ -60,5 +64,11 @@ void __attribute__((weak)) shd_concurrency_hook(enum shd_concurrency_hook hook);
 			shd_concurrency_hook(a);	\
 	} while (0)
 
+#else
+
+#define SHD_HOOK(a) do { } while (0)
+
+#endif /* SHD_CONCURRENCY_HOOKS */
+
 
 #endif /* _LIBSHDATA_CONCURRENCY_HOOKS_H_ */
@@ -0,0 +1,459 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file libshdata-coro.hpp
+ *
+ * @brief C++20 coroutine integration of the shared memory data low level api.
+ *
+ * @details Consumers of a section can suspend a coroutine until a new sample
+ * is committed, instead of blocking a thread in shd_wait_sample() :
+ *   - shd::Notifier runs a few threads, each of which waits with
+ * shd_wait_any() for commits in up to SHD_WAIT_MAX_SECTIONS sections, and
+ * resumes the coroutines awaiting them ;
+ *   - shd::Subscription keeps track of the last commit seen by a coroutine,
+ * and co_await-ing its next_sample() suspends the coroutine until a new sample
+ * is committed, or returns at once if one already was.
+ *
+ * Coroutines are resumed by the notifier thread which watches their section :
+ * the coroutines awaiting a given section run one after the other, and can
+ * thus share a single consumer context. Consumers are woken up on each commit
+ * if their producer enabled commit notification (see shd_set_commit_notify()),
+ * and within a millisecond otherwise. A watched context may be remapped by
+ * its notifier thread in automatic reconnection mode (see
+ * shd_set_auto_reconnect()) : it should only be used by the coroutines
+ * awaiting it, the notifier probing it for them.
+ *
+ * Example :
+ *   shd::Consumer<imu_blob> cons("imu");
+ *   shd::Notifier notifier;
+ *
+ *   shd::Task follow(shd::Notifier &notifier, shd::Consumer<imu_blob> &cons)
+ *   {
+ *       shd::Subscription<imu_blob> sub(notifier, cons);
+ *       imu_blob blob;
+ *
+ *       while (co_await sub.next_sample() == 0)
+ *           if (cons.read({ {}, SHD_LATEST, 0, 0 }, blob) > 0)
+ *               process(blob);
+ *   }
+ */
+
+#ifndef _LIBSHDATA_CORO_HPP_
+#define _LIBSHDATA_CORO_HPP_
+
+#include <cerrno>
+#include <coroutine>
+#include <ctime>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "libshdata.hpp"
+
+namespace shd {
+
+/**
+ * Resumes the coroutines awaiting commits in shared memory sections
+ */
+class Notifier {
+public:
+	class Awaitable;
+
+	/**
+	 * @brief Start the notifier
+	 *
+	 * @param[in] nb_threads : number of watching threads, each of which
+	 * watches up to SHD_WAIT_MAX_SECTIONS sections
+	 */
+	explicit Notifier(unsigned nb_threads = 1)
+		: mWatchers(nb_threads > 0 ? nb_threads : 1)
+	{
+		for (unsigned i = 0; i < mWatchers.size(); i++)
+			mWatchers[i].thread = std::thread(&Notifier::run, this,
+					i);
+	}
+
+	Notifier(const Notifier &) = delete;
+	Notifier &operator=(const Notifier &) = delete;
+
+	/**
+	 * @brief Stop the notifier : the coroutines still waiting are resumed
+	 * with -ECANCELED. The notifier should be destroyed before the
+	 * consumers it watches
+	 */
+	~Notifier()
+	{
+		std::vector<Waiter> cancelled;
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStop = true;
+		}
+		for (auto &watcher : mWatchers)
+			watcher.thread.join();
+
+		for (auto &watcher : mWatchers)
+			for (auto &watch : watcher.watches)
+				for (auto &waiter : watch->waiters) {
+					*waiter.result = -ECANCELED;
+					cancelled.push_back(waiter);
+				}
+		for (auto &waiter : cancelled)
+			waiter.handle.resume();
+	}
+
+	/**
+	 * @brief Await the next commit in a section
+	 *
+	 * @param[in] ctx : consumer context of the section
+	 * @param[in,out] seq : commit sequence number last seen by the
+	 * coroutine (see shd_wait_sample()), updated on resumption
+	 *
+	 * @return : awaitable whose co_await expression evaluates to 0 once a
+	 * sample has been committed since seq, or to a negative errno value
+	 * (see shd_wait_sample(), -ENOSPC if all threads already watch
+	 * SHD_WAIT_MAX_SECTIONS sections, -ECANCELED if the notifier is
+	 * destroyed). On error, the section stops being watched until it is
+	 * awaited again, without affecting the other sections
+	 */
+	Awaitable next_commit(shd_ctx *ctx, uint32_t &seq) noexcept;
+
+	/**
+	 * @brief Get the commit sequence number of a section, from which to
+	 * await its next commits
+	 *
+	 * @param[in] ctx : consumer context of the section
+	 * @param[in,out] seq : commit sequence number last seen, updated with
+	 * the current one
+	 *
+	 * @return : see shd_wait_sample()
+	 */
+	int last_commit(shd_ctx *ctx, uint32_t &seq) noexcept
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		return probe(ctx, seq);
+	}
+
+private:
+	/* Period at which watching threads take new sections into account */
+	static constexpr long WATCH_PERIOD_NS = 20000000;
+
+	struct Waiter {
+		std::coroutine_handle<> handle;
+		uint32_t *seq;
+		int *result;
+	};
+
+	struct Watch {
+		shd_ctx *ctx;
+		uint32_t seq;
+		std::vector<Waiter> waiters;
+	};
+
+	struct Watcher {
+		std::thread thread;
+		std::vector<std::unique_ptr<Watch>> watches;
+	};
+
+	/*
+	 * Get the commits of a section since seq, with mMutex locked : the
+	 * context of a watched section is only used by its watching thread,
+	 * which may reconnect it, so the sequence number this thread last saw
+	 * is returned instead
+	 */
+	int probe(shd_ctx *ctx, uint32_t &seq) noexcept
+	{
+		const timespec now = { 0, 0 };
+		auto it = mIndex.find(ctx);
+
+		if (it == mIndex.end())
+			return shd_wait_sample(ctx, &seq, &now);
+
+		if (it->second->seq == seq)
+			return -ETIMEDOUT;
+		seq = it->second->seq;
+		return 1;
+	}
+
+	/* Called with mMutex locked */
+	int add_waiter(shd_ctx *ctx, const Waiter &waiter)
+	{
+		auto it = mIndex.find(ctx);
+		Watch *watch;
+
+		if (mStop)
+			return -ECANCELED;
+
+		if (it == mIndex.end()) {
+			Watcher *watcher = nullptr;
+
+			for (auto &w : mWatchers)
+				if (w.watches.size() < SHD_WAIT_MAX_SECTIONS
+					&& (watcher == nullptr
+						|| w.watches.size()
+						< watcher->watches.size()))
+					watcher = &w;
+			if (watcher == nullptr)
+				return -ENOSPC;
+
+			watcher->watches.push_back(std::unique_ptr<Watch>(
+					new Watch{ ctx, *waiter.seq, {} }));
+			watch = watcher->watches.back().get();
+			mIndex.emplace(ctx, watch);
+		} else {
+			watch = it->second;
+		}
+
+		watch->waiters.push_back(waiter);
+		return 0;
+	}
+
+	/*
+	 * Find the sections which made shd_wait_any() fail : err[i] is set to
+	 * the error of section i, 0 if it can still be waited for. Returns
+	 * false if no section fails on its own
+	 */
+	static bool find_failed(shd_ctx *ctx[], const uint32_t seq[],
+				size_t nb, int err[])
+	{
+		const timespec now = { 0, 0 };
+		bool found = false;
+
+		for (size_t i = 0; i < nb; i++) {
+			uint32_t s = seq[i];
+
+			err[i] = shd_wait_sample(ctx[i], &s, &now);
+			if (err[i] >= 0 || err[i] == -ETIMEDOUT)
+				err[i] = 0;
+			else
+				found = true;
+		}
+
+		return found;
+	}
+
+	void run(unsigned index)
+	{
+		shd_ctx *ctx[SHD_WAIT_MAX_SECTIONS];
+		uint32_t seq[SHD_WAIT_MAX_SECTIONS];
+		int err[SHD_WAIT_MAX_SECTIONS];
+		std::vector<Waiter> ready;
+		std::unique_lock<std::mutex> lock(mMutex);
+		auto &watches = mWatchers[index].watches;
+
+		while (!mStop) {
+			/* Watches are appended to the list by other threads,
+			 * and only removed from it by this one */
+			size_t nb = watches.size();
+			timespec timeout;
+			int ret = -ETIMEDOUT;
+			bool drop = false;
+
+			for (size_t i = 0; i < nb; i++) {
+				ctx[i] = watches[i]->ctx;
+				seq[i] = watches[i]->seq;
+			}
+			lock.unlock();
+
+			clock_gettime(CLOCK_MONOTONIC, &timeout);
+			timeout.tv_nsec += WATCH_PERIOD_NS;
+			if (timeout.tv_nsec >= 1000000000) {
+				timeout.tv_nsec -= 1000000000;
+				timeout.tv_sec++;
+			}
+			if (nb > 0)
+				ret = shd_wait_any(ctx, seq, nb, &timeout);
+			else
+				clock_nanosleep(CLOCK_MONOTONIC,
+						TIMER_ABSTIME, &timeout,
+						nullptr);
+
+			/* Only the coroutines of the failing sections are
+			 * resumed with the error, and these sections are not
+			 * watched anymore. Should none fail on its own, all
+			 * coroutines get the error */
+			if (ret < 0 && ret != -ETIMEDOUT) {
+				drop = find_failed(ctx, seq, nb, err);
+				for (size_t i = 0; !drop && i < nb; i++)
+					err[i] = ret;
+			}
+
+			lock.lock();
+			if (ret == -ETIMEDOUT)
+				continue;
+
+			for (size_t i = 0; i < nb; i++) {
+				Watch *watch = watches[i].get();
+				auto &waiters = watch->waiters;
+				int error = ret < 0 ? err[i] : 0;
+				size_t kept = 0;
+
+				if (ret > 0)
+					watch->seq = seq[i];
+				for (auto &waiter : waiters) {
+					if (error == 0
+						&& *waiter.seq == watch->seq) {
+						waiters[kept++] = waiter;
+						continue;
+					}
+					*waiter.seq = watch->seq;
+					*waiter.result = error;
+					ready.push_back(waiter);
+				}
+				waiters.resize(kept);
+			}
+
+			/* Awaiting a dropped section again watches it anew */
+			for (size_t i = nb; drop && i > 0; i--) {
+				if (err[i - 1] == 0)
+					continue;
+				mIndex.erase(watches[i - 1]->ctx);
+				watches.erase(watches.begin() + (i - 1));
+			}
+
+			lock.unlock();
+			for (auto &waiter : ready)
+				waiter.handle.resume();
+			ready.clear();
+			/* Do not spin on persistent errors */
+			if (ret < 0 && !drop)
+				clock_nanosleep(CLOCK_MONOTONIC,
+						TIMER_ABSTIME, &timeout,
+						nullptr);
+			lock.lock();
+		}
+	}
+
+	std::mutex mMutex;
+	std::vector<Watcher> mWatchers;
+	std::unordered_map<shd_ctx *, Watch *> mIndex;
+	bool mStop = false;
+};
+
+/**
+ * Awaitable returned by Notifier::next_commit()
+ */
+class Notifier::Awaitable {
+public:
+	Awaitable(Notifier &notifier, shd_ctx *ctx, uint32_t &seq) noexcept
+		: mNotifier(notifier), mCtx(ctx), mSeq(&seq), mResult(0)
+	{
+	}
+
+	/* The section is probed along with the watching threads, once
+	 * suspended */
+	bool await_ready() noexcept
+	{
+		return false;
+	}
+
+	bool await_suspend(std::coroutine_handle<> handle) noexcept
+	{
+		std::lock_guard<std::mutex> lock(mNotifier.mMutex);
+
+		/* The watching thread sees the commits which occur after this
+		 * check, as it only resumes coroutines whose sequence number
+		 * differs from the one of the section */
+		mResult = mNotifier.probe(mCtx, *mSeq);
+		if (mResult != -ETIMEDOUT)
+			return false;
+
+		mResult = mNotifier.add_waiter(mCtx,
+				Waiter{ handle, mSeq, &mResult });
+		return mResult == 0;
+	}
+
+	int await_resume() const noexcept
+	{
+		return mResult < 0 ? mResult : 0;
+	}
+
+private:
+	Notifier &mNotifier;
+	shd_ctx *mCtx;
+	uint32_t *mSeq;
+	int mResult;
+};
+
+inline Notifier::Awaitable Notifier::next_commit(shd_ctx *ctx, uint32_t &seq)
+		noexcept
+{
+	return Awaitable(*this, ctx, seq);
+}
+
+/**
+ * Commits of a section seen by a coroutine
+ */
+template <typename Blob>
+class Subscription {
+public:
+	/**
+	 * @brief Subscribe to the commits which occur from now on
+	 */
+	Subscription(Notifier &notifier, Consumer<Blob> &consumer) noexcept
+		: mNotifier(notifier), mConsumer(consumer), mSeq(0)
+	{
+		notifier.last_commit(consumer.get(), mSeq);
+	}
+
+	/**
+	 * @brief Await a sample committed since the last one seen
+	 *
+	 * @return : see Notifier::next_commit()
+	 */
+	Notifier::Awaitable next_sample() noexcept
+	{
+		return mNotifier.next_commit(mConsumer.get(), mSeq);
+	}
+
+	Consumer<Blob> &consumer() const noexcept { return mConsumer; }
+
+private:
+	Notifier &mNotifier;
+	Consumer<Blob> &mConsumer;
+	uint32_t mSeq;
+};
+
+/**
+ * Coroutine return type for fire-and-forget tasks : the coroutine starts at
+ * once, and its frame is freed when it completes
+ */
+struct Task {
+	struct promise_type {
+		Task get_return_object() noexcept { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() noexcept {}
+		void unhandled_exception() noexcept { std::terminate(); }
+	};
+};
+
+} /* namespace shd */
+
+#endif /* _LIBSHDATA_CORO_HPP_ */
@@ -77,6 +77,10 @@
  * -----------------------------------------------------              |
  * |                  ...                              |              |
  * -----------------------------------------------------              v
+ * -----------------------------------------------------
+ * | <tracked quantities> | <bitmap per sample>        | dirty_map (optional,
+ * -----------------------------------------------------  see
+ *                                                        shd_create_tracked())
  *
  *
  * Shared memory access :
@@ -96,6 +100,33 @@
  *   In both cases, it must first select the samples it wishes to read, and
  * then read the quantities of its choice in a subset of those samples.
  *
+ * Record sections :
+ *
+ *   Logs and event streams are made of records of variable length, which
+ * would waste most of a fixed-size slot or be truncated. A record section
+ * (see shd_rec_create()) copies them into a byte ring, which takes the place
+ * of the blob metadata header. Its samples form the timestamp index of the
+ * records : they are searched with the usual methods, then shd_rec_read()
+ * copies the records they index.
+ *
+ * Downsampled tiers :
+ *
+ *   A section only holds max_nb_samples samples, which may cover a few
+ * seconds at high rates. A producer can create it with tiers (see
+ * shd_create_tiered()) : each tier keeps the mean, minimum and maximum of
+ * the numeric fields of the blob schema over buckets of consecutive samples,
+ * so that a long history takes little memory. Consumers search and read the
+ * section as usual : searches which start before the oldest sample of the
+ * section are served by the finest tier which covers them.
+ *
+ * Columnar recordings :
+ *
+ *   For offline analysis, a consumer can record a section into a file (see
+ * shd_col_record_start()), which holds each numeric element of the blob
+ * schema in a column of its own. Rows are grouped in chunks indexed by
+ * timestamp : readers m'map the file (see shd_col_open()), and get typed
+ * pointers to the columns of a time range without parsing nor copying them.
+ *
  */
 
 #ifndef _LIBSHDATA_H_
@@ -112,8 +143,8 @@
 extern "C" {
 #endif
 
-#define SHD_VERSION_MAJOR 6
-#define SHD_VERSION_MINOR 0
+#define SHD_VERSION_MAJOR 7
+#define SHD_VERSION_MINOR 1
 #define SHD_MAGIC_NUMBER 0x65756821
 
 /**
@@ -125,6 +156,24 @@ extern "C" {
  */
 struct shd_ctx;
 
+/**
+ * subscription to the changes of a quantity : opaque structure created by
+ * shd_subscribe()
+ */
+struct shd_sub;
+
+/**
+ * writer of a columnar recording : opaque structure created by
+ * shd_col_record_start()
+ */
+struct shd_col_writer;
+
+/**
+ * columnar recording open for reading : opaque structure created by
+ * shd_col_open()
+ */
+struct shd_col_file;
+
 /**
  * shared memory section header info
  */
@@ -133,7 +182,8 @@ struct shd_hdr_user_info {
 	size_t blob_size;
 	/* max number of samples (history depth) */
 	uint32_t max_nb_samples;
-	/* informal producer write period in us */
+	/* informal producer write period in us, used by
+	 * shd_wait_next_expected() until the period can be measured */
 	uint32_t rate;
 	/* blob metadata header size */
 	size_t blob_metadata_hdr_size;
@@ -146,9 +196,11 @@ enum shd_search_method_t {
 	/* Latest sample */
 	SHD_LATEST,
 	/* Sample with the timestamp closest to the given date, either
-	 * after or before */
+	 * after or before. If all the samples are after the date, the sample
+	 * selected by SHD_OLDEST */
 	SHD_CLOSEST,
-	/* Sample whose timestamp is immediately after the given date */
+	/* Sample whose timestamp is immediately after the given date. If all
+	 * the samples are after the date, the sample selected by SHD_OLDEST */
 	SHD_FIRST_AFTER,
 	/* Sample whose timestamp is immediately before the given date */
 	SHD_FIRST_BEFORE,
@@ -227,6 +279,188 @@ struct shd_quantity_sample {
 	size_t size;
 };
 
+/**
+ * Record copied out of a record section by shd_rec_read()
+ */
+struct shd_rec_record {
+	/* sequence number of the record : it is incremented by one for each
+	 * record written in the section, so that gaps show lost records */
+	uint64_t seq;
+	/* record timestamp */
+	struct timespec ts;
+	/* record data, within the buffer given to shd_rec_read() */
+	const void *data;
+	/* length of the record data */
+	size_t len;
+};
+
+/* Maximum number of downsampled tiers of a section */
+#define SHD_MAX_TIERS 4
+
+/**
+ * Downsampled tier of a section (see shd_create_tiered())
+ */
+struct shd_tier_info {
+	/* number of consecutive samples of the section aggregated in each
+	 * sample of the tier : at least 2, and greater than the factor of the
+	 * previous tier */
+	uint32_t factor;
+	/* number of samples of the tier (history depth) */
+	uint32_t max_nb_samples;
+};
+
+/**
+ * Statistic held by a sample of a downsampled tier
+ */
+enum shd_tier_stat {
+	/* mean of the bucket, rounded to the nearest integer for integer
+	 * fields */
+	SHD_TIER_MEAN = 0,
+	/* minimum of the bucket */
+	SHD_TIER_MIN,
+	/* maximum of the bucket */
+	SHD_TIER_MAX,
+};
+
+/**
+ * Type of a field of the blob, as described in a blob schema
+ */
+enum shd_field_type {
+	SHD_FIELD_UINT8,
+	SHD_FIELD_INT8,
+	SHD_FIELD_UINT16,
+	SHD_FIELD_INT16,
+	SHD_FIELD_UINT32,
+	SHD_FIELD_INT32,
+	SHD_FIELD_UINT64,
+	SHD_FIELD_INT64,
+	SHD_FIELD_FLOAT,
+	SHD_FIELD_DOUBLE,
+	/* Opaque bytes */
+	SHD_FIELD_BYTES,
+	/* Group of fields sharing a common name prefix (only output by
+	 * shd_quantity_resolve()) */
+	SHD_FIELD_GROUP,
+};
+
+/**
+ * Description of a field of the blob, used by a producer to build a blob
+ * schema
+ */
+struct shd_field_desc {
+	/* name of the field ; nested fields are named after their parents,
+	 * with dot separators (e.g. "imu.accel") */
+	const char *name;
+	/* type of the field (or of its elements if it is an array) */
+	enum shd_field_type type;
+	/* offset from start of blob at which the field is located */
+	ptrdiff_t offset;
+	/* number of elements of the field (1 if it is not an array) */
+	uint32_t count;
+};
+
+/**
+ * Quantity resolved by name from the blob schema of a section
+ */
+struct shd_quantity_info {
+	/* quantity to use with read functions */
+	struct shd_quantity quantity;
+	/* type of the quantity (or of its elements if it is an array) */
+	enum shd_field_type type;
+	/* number of elements of the quantity */
+	uint32_t count;
+};
+
+/**
+ * Condition on which a subscription reports a sample (see shd_subscribe())
+ */
+enum shd_sub_mode {
+	/* the bytes of the quantity changed, or only the bits of mask if it
+	 * is not 0 */
+	SHD_SUB_CHANGED = 0,
+	/* the value of the quantity moved by more than deadband from the
+	 * last reported one */
+	SHD_SUB_DEADBAND,
+};
+
+/**
+ * Subscription to the changes of a quantity
+ */
+struct shd_sub_info {
+	/* quantity to watch (see shd_quantity_resolve()) : the type is only
+	 * used by SHD_SUB_DEADBAND, and if mask is not 0 */
+	struct shd_quantity_info quantity;
+	/* condition on which samples are reported */
+	enum shd_sub_mode mode;
+	/* SHD_SUB_DEADBAND : threshold, which must not be negative */
+	double deadband;
+	/* SHD_SUB_CHANGED : bits of an integer quantity that are compared, 0
+	 * to compare the whole quantity */
+	uint64_t mask;
+};
+
+/**
+ * Comparison made by a predicate (see shd_read_filtered())
+ */
+enum shd_predicate_op {
+	/* the quantity is equal to value */
+	SHD_PRED_EQUAL = 0,
+	/* the bits of mask in the quantity are equal to those of value */
+	SHD_PRED_MASK,
+	/* the quantity is within [min, max] */
+	SHD_PRED_RANGE,
+};
+
+/**
+ * Predicate on a quantity, which selects the samples of a window
+ */
+struct shd_predicate {
+	/* quantity compared (see shd_quantity_resolve()), made of a single
+	 * numeric value */
+	struct shd_quantity_info quantity;
+	/* comparison made */
+	enum shd_predicate_op op;
+	/* SHD_PRED_EQUAL, SHD_PRED_MASK : integer quantities only, compared
+	 * bit by bit (as two's complement for signed types, truncated to the
+	 * size of the quantity) */
+	uint64_t value;
+	uint64_t mask;
+	/* SHD_PRED_RANGE : inclusive bounds, compared as double ; min == max
+	 * tests the equality of floating-point quantities */
+	double min;
+	double max;
+};
+
+/**
+ * Statistics of an element of a quantity over a window of samples, as
+ * computed by shd_aggregate()
+ */
+struct shd_aggregate {
+	/* minimum value */
+	double min;
+	/* maximum value */
+	double max;
+	/* arithmetic mean */
+	double mean;
+	/* root mean square */
+	double rms;
+};
+
+/**
+ * Rows of a columnar recording within a time range, as output by
+ * shd_col_slice() : the values of each column are read with shd_col_get()
+ */
+struct shd_col_slice {
+	/* timestamps of the rows, in nanoseconds */
+	const uint64_t *ts_ns;
+	/* number of rows */
+	uint32_t nb_rows;
+	/* chunk of the rows in the recording */
+	uint32_t chunk;
+	/* index of the first row in its chunk */
+	uint32_t first_row;
+};
+
 /**
  * Opaque structure used to check whether the structure of the shared memory
  * section as seen by a consumer is up-to-date with regards to the producer
@@ -234,6 +468,38 @@ struct shd_quantity_sample {
  */
 struct shd_revision;
 
+/* Maximum size of a blob name, including the terminating null byte, for the
+ * section to be recorded in the section registry */
+#define SHD_SECTION_NAME_MAX 256
+
+/**
+ * Backend which holds a shared memory section
+ */
+enum shd_section_backend_type {
+	SHD_SECTION_BACKEND_SHM,
+	SHD_SECTION_BACKEND_DEV_MEM,
+	SHD_SECTION_BACKEND_OTHER
+};
+
+/**
+ * Description of a shared memory section, as recorded in the section
+ * registry
+ */
+struct shd_section_info {
+	/* name of the blob */
+	char name[SHD_SECTION_NAME_MAX];
+	/* backend which holds the section */
+	enum shd_section_backend_type backend;
+	/* total size of the section */
+	uint64_t size;
+	/* revision number of the section when it was last created */
+	int revision;
+	/* pid of the process which last created the section */
+	pid_t producer_pid;
+	/* header info of the section */
+	struct shd_hdr_user_info hdr_info;
+};
+
 /**
  * @brief Create/Open a shared memory section for writer.
  *
@@ -254,6 +520,110 @@ struct shd_ctx *shd_create(const char *blob_name, const char *shd_root,
 			   const struct shd_hdr_user_info *hdr_info,
 			   const void *blob_metadata_hdr);
 
+/* Maximum number of quantities tracked in a section */
+#define SHD_DIRTY_MAX_QUANTITIES 64
+
+/**
+ * @brief Create/Open a shared memory section for a writer which tracks the
+ * quantities written in each sample
+ *
+ * Each sample carries a bitmap whose bit #i is set if any part of tracked[i]
+ * was written in it, by shd_write_quantity() or by the blob write functions
+ * (which set all bits). Consumers get these bitmaps with shd_read_dirty(), so
+ * that they can skip the quantities which were not updated, and producers
+ * writing some quantities at different rates can share one section.
+ *
+ * @param blob_name name of shared memory section
+ * @param shd_root: root directory where shared memory section is located (see
+ * shd_create())
+ * @param hdr_info shared memory header info
+ * @param blob_metadata_hdr blob metadata header buffer
+ * @param tracked quantities to track, which must lie within the blob
+ * @param nb_tracked number of tracked quantities, at most
+ * SHD_DIRTY_MAX_QUANTITIES (if 0, this is equivalent to shd_create())
+ *
+ * @return shared memory context with write attribute,
+ *         NULL on error (see shd_create(), or if tracked quantities are
+ * invalid)
+ */
+struct shd_ctx *shd_create_tracked(const char *blob_name,
+			const char *shd_root,
+			const struct shd_hdr_user_info *hdr_info,
+			const void *blob_metadata_hdr,
+			const struct shd_quantity tracked[],
+			size_t nb_tracked);
+
+/**
+ * @brief Create/Open a shared memory section for a writer of variable-length
+ * records
+ *
+ * Records are stored one after the other in a byte ring of ring_size bytes,
+ * each one taking its length plus a header of a few dozen bytes. The
+ * samples of the section index the records by timestamp : consumers open the
+ * section with shd_open(), search records with shd_select_samples() or
+ * shd_read_from_sample() and copy them with shd_rec_read().
+ *
+ * The oldest records are lost when either the byte ring or the index is
+ * full.
+ *
+ * @param blob_name name of the blob
+ * @param shd_root: root directory where shared memory section is located. If
+ * NULL, defaults to /dev/shm
+ * @param ring_size number of bytes available for the records
+ * @param max_nb_records number of records that can be indexed
+ *
+ * @return shared memory context with write attribute,
+ *         NULL on error :
+ *           - if arguments are invalid (including ring_size too small to
+ * hold a record)
+ *           - if blob_name exceeds max length
+ *           - if blob_name contains a "/"
+ */
+struct shd_ctx *shd_rec_create(const char *blob_name, const char *shd_root,
+			size_t ring_size, uint32_t max_nb_records);
+
+/**
+ * @brief Create/Open a shared memory section for a writer, along with
+ * downsampled tiers of the section
+ *
+ * Tier #i is a section named "<blob_name>-tier<i>", with i starting from 1.
+ * Each time tiers[i - 1].factor samples have been committed in the section,
+ * one sample is written in the tier : its timestamp is the one of the first
+ * sample of the bucket, its expiration date the one of the last sample. It
+ * holds the mean, minimum and maximum of each numeric field of the blob
+ * schema (see shd_blob_schema_write()) over the bucket, 64-bit integers
+ * being aggregated as doubles. Other bytes of the blob hold the value of the
+ * last sample of the bucket : without blob schema, tiers only decimate the
+ * section.
+ *
+ * Consumers open the section with shd_open() : the tiers are open on their
+ * first search. A search whose date is older than the oldest sample of the
+ * section is done in the finest tier whose history covers it (or else the
+ * coarsest one), nb_values_before_date and nb_values_after_date then being
+ * counted in tier samples. shd_get_read_factor() tells which one was chosen,
+ * and shd_tier_quantity() gives the location of each statistic of a
+ * quantity. Reading the whole blob of a tier sample reads the mean.
+ *
+ * @param blob_name name of the blob, which must leave room for the suffix of
+ * the tiers
+ * @param shd_root: root directory where shared memory section is located (see
+ * shd_create())
+ * @param hdr_info shared memory header info
+ * @param blob_metadata_hdr blob metadata header buffer
+ * @param tiers tiers of the section, finest first
+ * @param nb_tiers number of tiers, from 1 to SHD_MAX_TIERS
+ *
+ * @return shared memory context with write attribute,
+ *         NULL on error (see shd_create(), or if tiers are invalid or could
+ * not be created)
+ */
+struct shd_ctx *shd_create_tiered(const char *blob_name,
+			const char *shd_root,
+			const struct shd_hdr_user_info *hdr_info,
+			const void *blob_metadata_hdr,
+			const struct shd_tier_info tiers[],
+			size_t nb_tiers);
+
 /**
  * @brief Open shared memory section for reader.
  *
@@ -271,6 +641,31 @@ struct shd_ctx *shd_create(const char *blob_name, const char *shd_root,
 struct shd_ctx *shd_open(const char *blob_name, const char *shd_root,
 			 struct shd_revision **rev);
 
+/**
+ * @brief Open several shared memory sections for reader.
+ *
+ * Sections are looked up in the section registry, so that each of them can be
+ * mapped at once without reading its header first. Sections which are not
+ * registered, or whose registry entry is out of date, are open with
+ * shd_open().
+ *
+ * @param[in] blob_names : names of the shared memory sections
+ * @param[in] nb_sections : number of sections to open
+ * @param shd_root: root directory where shared memory sections are located
+ * (see shd_open())
+ * @param[out] ctx : array of nb_sections contexts, filled with the context of
+ * each section, or NULL if it could not be open
+ * @param[out] rev : array of nb_sections pointers to the revision structure
+ * of each section (allocated by the library)
+ *
+ * @return : number of sections successfully open,
+ *           -EINVAL if arguments are invalid
+ */
+int shd_open_many(const char * const blob_names[], size_t nb_sections,
+			const char *shd_root,
+			struct shd_ctx *ctx[],
+			struct shd_revision *rev[]);
+
 /**
  * @brief Close shared memory.
  *
@@ -288,6 +683,189 @@ struct shd_ctx *shd_open(const char *blob_name, const char *shd_root,
  */
 int shd_close(struct shd_ctx *ctx, struct shd_revision *rev);
 
+/**
+ * @brief List the shared memory sections recorded in the section registry.
+ *
+ * Every section created with shd_create() is recorded in the registry, along
+ * with its size, its revision number and the pid of its producer. A section
+ * is not listed anymore once its producer has closed it, or is gone.
+ *
+ * @param[out] infos : array filled with the description of the sections
+ * @param[in] max_infos : number of elements in infos
+ *
+ * @return : total number of listed sections, which can be greater than
+ * max_infos,
+ *           -EINVAL if infos is NULL while max_infos is not 0,
+ *           -ENOENT if the registry does not exist
+ */
+int shd_list_sections(struct shd_section_info *infos, size_t max_infos);
+
+/**
+ * @brief Enable or disable automatic reconnection of a consumer context.
+ *
+ * By default, once a producer has re-created a section, read functions return
+ * -ENODEV until the consumer closes and re-opens its context. With automatic
+ * reconnection, the context is transparently remapped to the new section
+ * (whose header info may have changed) :
+ *    - a read started after the section was re-created is done on the new
+ * section,
+ *    - a read in progress while the section was re-created is ended by
+ * shd_end_read() with -EAGAIN, the next read being done on the new section,
+ *    - the revision structure of the consumer is updated accordingly.
+ * If the section is still being re-created, read functions return -EAGAIN.
+ *
+ * @param[in,out] ctx : consumer context, as returned by shd_open()
+ * @param[in] enable : true to enable automatic reconnection
+ *
+ * @return : 0 on success,
+ *           -EINVAL if ctx is NULL
+ */
+int shd_set_auto_reconnect(struct shd_ctx *ctx, bool enable);
+
+/**
+ * @brief Enable or disable the notification of commits to waiting consumers
+ *
+ * Consumers waiting with shd_wait_sample() or shd_wait_any() are woken up by
+ * the producer on each commit, at the cost of a system call per commit. Without
+ * notification, they poll the section every millisecond. The setting is lost
+ * when the section is re-created.
+ *
+ * @param[in,out] ctx : producer context, as returned by shd_create()
+ * @param[in] enable : true to wake up waiting consumers on each commit
+ *
+ * @return : 0 on success,
+ *           -EINVAL if ctx is NULL
+ */
+int shd_set_commit_notify(struct shd_ctx *ctx, bool enable);
+
+/* Size of the copies from which SHD_WRITE_MODE_AUTO uses streaming stores */
+#define SHD_WRITE_STREAMING_THRESHOLD (256 * 1024)
+
+/* How the producer copies data into the section */
+enum shd_write_mode {
+	/* Streaming stores for copies of at least
+	 * SHD_WRITE_STREAMING_THRESHOLD bytes, regular copies otherwise */
+	SHD_WRITE_MODE_AUTO = 0,
+	/* Regular copies, which go through the producer's cache */
+	SHD_WRITE_MODE_CACHED,
+	/* Non-temporal stores, which bypass the producer's cache */
+	SHD_WRITE_MODE_STREAMING,
+};
+
+/**
+ * @brief Select how data is copied into the section by a producer
+ *
+ * Large blobs written with regular copies evict the producer's own working
+ * set from its cache, although it never reads them back. Streaming stores
+ * write them straight to memory instead ; they are ordered before the commit
+ * of the sample, so consumers never see partially written data. On
+ * architectures without streaming stores, all modes use regular copies.
+ *
+ * @param[in,out] ctx : producer context, as returned by shd_create()
+ * @param[in] mode : write mode to use for the next writes
+ *
+ * @return : 0 on success,
+ *           -EINVAL if ctx is NULL or mode is unknown
+ */
+int shd_set_write_mode(struct shd_ctx *ctx, enum shd_write_mode mode);
+
+/* Maximum number of sections waited for at once by shd_wait_any() */
+#define SHD_WAIT_MAX_SECTIONS 128
+
+/**
+ * @brief Wait until a new sample is committed in a section
+ *
+ * The caller keeps track of the commits it has seen with a commit sequence
+ * number : the function returns at once if a sample has been committed since
+ * *seq was obtained, and blocks until the next commit otherwise. Calling it
+ * with a timeout in the past is a way to get the current sequence number.
+ * The re-creation of the section by its producer also counts as a commit.
+ *
+ * @param[in] ctx : consumer context
+ * @param[in,out] seq : commit sequence number last seen by the caller,
+ * updated on return
+ * @param[in] timeout : absolute CLOCK_MONOTONIC date at which to give up
+ * waiting, NULL to wait forever
+ *
+ * @return : 1 if a sample has been committed since *seq,
+ *           -ETIMEDOUT if timeout was reached before any commit,
+ *           -EINTR if the wait was interrupted by a signal,
+ *           -EINVAL if ctx or seq is NULL
+ */
+int shd_wait_sample(struct shd_ctx *ctx, uint32_t *seq,
+			const struct timespec *timeout);
+
+/**
+ * @brief Wait until a new sample is committed in any of a set of sections
+ *
+ * Same as shd_wait_sample(), for up to SHD_WAIT_MAX_SECTIONS sections with
+ * one commit sequence number per section.
+ *
+ * @param[in] ctx : array of consumer contexts
+ * @param[in,out] seq : array of commit sequence numbers last seen by the
+ * caller, updated on return for the sections in which a sample was committed
+ * @param[in] nb_ctx : number of contexts in ctx
+ * @param[in] timeout : absolute CLOCK_MONOTONIC date at which to give up
+ * waiting, NULL to wait forever
+ *
+ * @return : number of sections in which a sample has been committed,
+ *           -ETIMEDOUT if timeout was reached before any commit,
+ *           -EINTR if the wait was interrupted by a signal,
+ *           -EINVAL if any argument is invalid
+ */
+int shd_wait_any(struct shd_ctx *ctx[], uint32_t seq[], size_t nb_ctx,
+			const struct timespec *timeout);
+
+/**
+ * @brief Wait until a new sample is committed in a section, sleeping until
+ * shortly before it is expected
+ *
+ * Same as shd_wait_sample(), for consumers of producers which do not notify
+ * their commits (see shd_set_commit_notify()) : instead of polling, the
+ * consumer sleeps until the next commit is expected, then spins on the commit
+ * sequence number until the commit. The next commit is expected one period
+ * after the latest one, the period being measured from the timestamps of the
+ * latest samples (see shd_get_measured_rate()), or else the rate declared in
+ * the section header. The spin margin adapts to the deviation of the commits
+ * from their expected dates, up to 200 us. If no commit occurs by the end
+ * of the margin, if the commits deviate too much for this margin, or if the
+ * period is unknown, the function waits like shd_wait_sample().
+ *
+ * The dates of the commits are only estimated if the function is called in a
+ * loop, with the same context, as soon as each sample has been processed.
+ *
+ * @param[in] ctx : consumer context
+ * @param[in,out] seq : commit sequence number last seen by the caller,
+ * updated on return
+ * @param[in] timeout : absolute CLOCK_MONOTONIC date at which to give up
+ * waiting, NULL to wait forever
+ *
+ * @return : 1 if a sample has been committed since *seq,
+ *           -ETIMEDOUT if timeout was reached before any commit,
+ *           -EINTR if the wait was interrupted by a signal,
+ *           -EINVAL if ctx or seq is NULL
+ */
+int shd_wait_next_expected(struct shd_ctx *ctx, uint32_t *seq,
+			const struct timespec *timeout);
+
+/**
+ * @brief Get the period at which the producer of a section actually writes
+ * samples
+ *
+ * The period is measured from the timestamps of the latest samples, so it is
+ * expressed in the time base of the producer's timestamps.
+ *
+ * @param[in] ctx : shared memory context
+ * @param[out] rate : measured period, in us, like the rate declared in the
+ * section header
+ *
+ * @return : 0 on success,
+ *           -EINVAL if ctx or rate is NULL,
+ *           -EAGAIN if less than two samples have been written yet,
+ *           -ERANGE if the timestamps of the latest samples do not increase
+ */
+int shd_get_measured_rate(struct shd_ctx *ctx, uint32_t *rate);
+
 /**
  * @brief Write a whole new blob into shared memory.
  * Unlike the case where quantities within a new sample are written one after
@@ -315,6 +893,54 @@ int shd_write_new_blob(struct shd_ctx *ctx,
 			const size_t size,
 			const struct shd_sample_metadata *metadata);
 
+/**
+ * @brief Write several whole new blobs into shared memory at once
+ *
+ * The blobs are written into consecutive samples, which are published to
+ * consumers at once when the last one is written : searches see either none
+ * or all of them. Until then, the reading of a window which starts on one of
+ * the samples being overwritten fails with -EFAULT at shd_end_read(). Unlike
+ * successive calls to shd_write_new_blob(), the write session is only started
+ * and ended once, whatever the number of blobs. As the sample which follows
+ * the latest one is never read, a batch can not hold more than
+ * max_nb_samples - 1 blobs
+ *
+ * @param[in,out] ctx : shared memory context
+ * @param[in] src : array of nb blobs to be written, in chronological order
+ * @param[in] size : number of bytes in each blob (should be equal to
+ * blob_size)
+ * @param[in] metadata : array of nb metadata, associated to the blobs of the
+ * same rank
+ * @param[in] nb : number of blobs to write
+ *
+ * @return 0 on success (nothing is written if nb is 0),
+ *         -EINVAL if any argument is NULL, if size is greater than blob_size
+ * or if nb is not lower than the number of samples in the section,
+ *         other errors as shd_write_new_blob()
+ */
+int shd_write_new_blobs(struct shd_ctx *ctx,
+			const void *src,
+			const size_t size,
+			const struct shd_sample_metadata metadata[],
+			size_t nb);
+
+/**
+ * @brief Write a record into a record section
+ *
+ * @param[in,out] ctx : shared memory context, created with shd_rec_create()
+ * @param[in] ts : record timestamp, by which it is indexed
+ * @param[in] data : record data
+ * @param[in] len : length of the record data, which must leave room for the
+ * record header in the byte ring
+ *
+ * @return 0 on success,
+ *         -EINVAL if any argument is NULL, or if len is too large,
+ *         -EOPNOTSUPP if the section is not a record section,
+ *         any error returned by shd_new_sample()
+ */
+int shd_rec_write(struct shd_ctx *ctx, const struct timespec *ts,
+			const void *data, size_t len);
+
 /**
  * @brief Read quantities from a sample that matches given search criterias
  *
@@ -344,6 +970,222 @@ int shd_read_from_sample(struct shd_ctx *ctx,
 				const struct shd_quantity quantity[],
 				struct shd_quantity_sample qty_samples[]);
 
+/**
+ * @brief Read quantities from the latest sample, only if a sample has been
+ * committed since the caller's last read
+ *
+ * The caller keeps track of the commits it has seen with a commit sequence
+ * number, the same as the one of shd_wait_sample() : if no sample has been
+ * committed since *last_seen, the function returns at once, without
+ * selecting nor copying anything. Otherwise it behaves like
+ * shd_read_from_sample() with the SHD_LATEST method.
+ *
+ * @post shd_end_read should be called after, unless 0 or an error was
+ * returned
+ *
+ * @param[in] ctx : Shared memory context
+ * @param[in,out] last_seen : commit sequence number of the caller's last read,
+ * updated if the latest sample is read (it can be initialized with 0, or
+ * with shd_wait_sample())
+ * @param[in] n_quantities : number of different quantities to read (set to
+ * zero to read the whole blob)
+ * @param[in] quantity : pointer to an array of structures describing the
+ * quantities to read (irrelevant if n_quantities is set to 0)
+ * @param[in,out] qty_samples : pointer to an array of structures that describe
+ * the buffer where to output the quantities of the latest sample and their
+ * metadata
+ *
+ * @return number of quantities written in dest if the latest sample was read,
+ *         0 if no sample has been committed since *last_seen,
+ *         any error returned by shd_read_from_sample()
+ */
+int shd_read_latest_if_new(struct shd_ctx *ctx,
+				uint32_t *last_seen,
+				int n_quantities,
+				const struct shd_quantity quantity[],
+				struct shd_quantity_sample qty_samples[]);
+
+/**
+ * @brief Subscribe to the changes of a quantity
+ *
+ * The subscription keeps a cursor over the samples of the section : each
+ * call to shd_sub_read() scans the samples committed since the previous one,
+ * in place, and only copies those which satisfy the condition of the
+ * subscription. The first sample read is always reported, as the reference
+ * for the next ones.
+ *
+ * @param[in] ctx : consumer context, which must outlive the subscription
+ * @param[in] info : quantity to watch and condition on which samples are
+ * reported. SHD_SUB_DEADBAND is only supported for single numeric values,
+ * a non-zero mask for single integer values.
+ *
+ * @return subscription on success,
+ *         NULL if any argument is invalid or on allocation failure
+ */
+struct shd_sub *shd_subscribe(struct shd_ctx *ctx,
+				const struct shd_sub_info *info);
+
+/**
+ * @brief Read the samples committed since the previous call which satisfy
+ * the condition of a subscription
+ *
+ * Samples are reported oldest first, until samples is full : the next call
+ * resumes after the last reported one. If the producer overwrote samples
+ * which were not scanned yet, the scan resumes from the oldest sample of the
+ * section. Unlike other read functions, no read sequence is involved : the
+ * reported samples are checked before the function returns.
+ *
+ * @param[in,out] sub : subscription
+ * @param[in,out] samples : destination of the quantity and metadata of each
+ * reported sample, whose buffers must have room for the quantity
+ * @param[in] max_samples : number of elements of samples
+ *
+ * @return number of samples reported, 0 if none satisfies the condition,
+ *         -EINVAL if any argument is invalid,
+ *         -EAGAIN if the samples were overwritten during the scan, which
+ * can be retried,
+ *         -ENODEV if blob format changed since the memory section was open
+ * (so that memory section should be closed and re-open properly)
+ */
+int shd_sub_read(struct shd_sub *sub,
+			struct shd_quantity_sample samples[],
+			size_t max_samples);
+
+/**
+ * @brief Destroy a subscription
+ *
+ * @param[in] sub : subscription to destroy
+ *
+ * @return 0 on success,
+ *         -EINVAL if sub is NULL
+ */
+int shd_unsubscribe(struct shd_sub *sub);
+
+/**
+ * @brief Compute the minimum, maximum, mean and RMS of a numeric quantity
+ * over a window of samples
+ *
+ * Values are reduced directly in the shared memory section, in one pass over
+ * the window for up to 16 elements, without copying them : this is cheaper
+ * than reading the quantity with shd_select_samples() and shd_read_quantity()
+ * to compute the same statistics. Like any data read, the results are only
+ * valid if shd_end_read() succeeds.
+ *
+ * When the search is served by a downsampled tier (see shd_create_tiered()),
+ * the window is made of tier samples : the minimum and maximum are those of
+ * the base samples of their buckets, while the mean and RMS are computed from
+ * the means of the buckets.
+ *
+ * @post shd_end_read should be called after
+ *
+ * @param[in] ctx : shared memory context
+ * @param[in] search : sample search parameters. The window is given by
+ * nb_values_before_date and nb_values_after_date, unless duration is set.
+ * @param[in] duration : if not NULL, the window is made of the samples whose
+ * timestamp is at most duration before the reference sample of the search,
+ * whose nb_values_before_date and nb_values_after_date must then be 0
+ * @param[in] info : quantity to aggregate (see shd_quantity_resolve()), made
+ * of count elements of a numeric type
+ * @param[out] results : statistics of each element of the quantity, which
+ * must have room for count of them
+ *
+ * @return number of samples aggregated on success,
+ *         -EINVAL if any argument is invalid,
+ *         -EAGAIN if no value has yet been produced in that memory section
+ *         -ENOENT if no sample has been found to match the search,
+ *         -EFAULT if the window was overwritten during the search
+ */
+int shd_aggregate(struct shd_ctx *ctx,
+			const struct shd_sample_search *search,
+			const struct timespec *duration,
+			const struct shd_quantity_info *info,
+			struct shd_aggregate results[]);
+
+/**
+ * @brief Copy a quantity out of the samples of a window which satisfy a
+ * predicate
+ *
+ * The predicate is evaluated in place, in the samples of the section, so
+ * that only matching samples are copied. Like any read, the copied data is
+ * only valid if shd_end_read() succeeds.
+ *
+ * @post shd_end_read should be called after, if the search succeeded
+ *
+ * @param[in] ctx : shared memory context
+ * @param[in] search : sample search parameters, which define the window
+ * @param[in] pred : predicate on a quantity of the samples
+ * @param[in] quantity : quantity to copy out of each matching sample
+ * @param[in,out] samples : destination of the quantity and metadata of each
+ * matching sample, oldest first, whose buffers must have room for the
+ * quantity
+ * @param[in] max_samples : number of elements of samples : further matching
+ * samples are ignored
+ *
+ * @return number of matching samples copied on success,
+ *         -EINVAL if any argument is invalid,
+ *         -EAGAIN if no value has yet been produced in that memory section
+ *         -ENOENT if no sample has been found to match the search,
+ *         -EFAULT if the window was overwritten during the search
+ */
+int shd_read_filtered(struct shd_ctx *ctx,
+			const struct shd_sample_search *search,
+			const struct shd_predicate *pred,
+			const struct shd_quantity *quantity,
+			struct shd_quantity_sample samples[],
+			size_t max_samples);
+
+/**
+ * @brief Read the bitmaps of the quantities written in the selected samples
+ *
+ * Bit #i of a bitmap is set if tracked quantity #i was written in the sample
+ * (see shd_create_tracked()). Like the data read in the same sequence, the
+ * bitmaps are only valid if shd_end_read() succeeds.
+ *
+ * @pre shd_select_samples or shd_read_from_sample must have be called before
+ * @post shd_end_read should be called after
+ *
+ * @param[in] ctx : shared memory context
+ * @param[out] dst : destination array, filled in the same order as the
+ * quantities read in the same sequence
+ * @param[in] nb : number of elements of dst
+ *
+ * @return number of matching samples on success,
+ *         -EINVAL if any argument is invalid, or dst is too small,
+ *         -EPERM if the function was called out of sequence,
+ *         -ENODATA if the producer of the section does not track quantities
+ */
+int shd_read_dirty(struct shd_ctx *ctx, uint64_t dst[], size_t nb);
+
+/**
+ * @brief Copy the records indexed by the selected samples
+ *
+ * Records are copied oldest first, each one at an 8-byte aligned offset of
+ * buf, until all of them are copied or records or buf is full. Records which
+ * were overwritten in the byte ring are skipped (their sequence numbers are
+ * missing). Like the data read in the same sequence, the records are only
+ * valid if shd_end_read() succeeds.
+ *
+ * @pre shd_select_samples or shd_read_from_sample must have be called before
+ * @post shd_end_read should be called after
+ *
+ * @param[in] ctx : shared memory context
+ * @param[out] records : descriptions of the copied records, whose data
+ * points into buf
+ * @param[in] max_records : number of elements of records
+ * @param[out] buf : destination buffer for the record data
+ * @param[in] buf_size : size of buf
+ *
+ * @return number of records copied on success,
+ *         -EINVAL if any argument is invalid,
+ *         -EPERM if the function was called out of sequence,
+ *         -EOPNOTSUPP if the section is not a record section
+ */
+int shd_rec_read(struct shd_ctx *ctx,
+			struct shd_rec_record records[],
+			size_t max_records,
+			void *buf,
+			size_t buf_size);
+
 /**
  * @brief Signal end of reading job for a process
  *
@@ -358,9 +1200,45 @@ int shd_read_from_sample(struct shd_ctx *ctx,
  * sequence
  *           -ENODEV if blob format changed since the memory section was open
  * (so that memory section should be closed and re-open properly)
+ *           -EAGAIN if blob format changed during the reading sequence, in
+ * automatic reconnection mode (see shd_set_auto_reconnect())
  */
 int shd_end_read(struct shd_ctx *ctx, struct shd_revision *rev);
 
+/**
+ * @brief Get the number of samples of the section aggregated in each of the
+ * samples selected in the current reading sequence
+ *
+ * @pre shd_select_samples or shd_read_from_sample must have be called before
+ *
+ * @param[in] ctx : shared memory context
+ *
+ * @return : aggregation factor of the downsampled tier which was searched,
+ * 1 if the samples were selected in the section itself,
+ *           -EINVAL if ctx is NULL
+ */
+int shd_get_read_factor(struct shd_ctx *ctx);
+
+/**
+ * @brief Get the location of a statistic of a quantity in the samples
+ * selected in the current reading sequence
+ *
+ * @pre shd_select_samples or shd_read_from_sample must have be called before
+ *
+ * @param[in] ctx : shared memory context
+ * @param[in] quantity : quantity of the blob of the section
+ * @param[in] stat : statistic to read
+ * @param[out] out : quantity to read with shd_read_quantity(). If the samples
+ * were selected in the section itself, this is quantity, whatever stat.
+ *
+ * @return : 0 on success,
+ *           -EINVAL if any argument is invalid
+ */
+int shd_tier_quantity(struct shd_ctx *ctx,
+			const struct shd_quantity *quantity,
+			enum shd_tier_stat stat,
+			struct shd_quantity *out);
+
 /**
  * @brief Read section header info from shared memory
  *
@@ -392,6 +1270,8 @@ int shd_read_section_hdr(struct shd_ctx *ctx,
  * @return : 0 on success,
  *           -ENOMEM if dst_size does not match that of the metadata header,
  *           -EINVAL if any pointer argument is NULL,
+ *           -ENODATA if the section is a record section (see
+ * shd_rec_create()), whose blob metadata header holds the records,
  *           -ENODEV if blob format changed since the memory section was open
  * (so that memory section should be closed and re-open properly)
  */
@@ -400,6 +1280,241 @@ int shd_read_blob_metadata_hdr(struct shd_ctx *ctx,
 				size_t dst_size,
 				struct shd_revision *rev);
 
+/**
+ * @brief Get the size of a blob metadata header which holds a blob schema
+ *
+ * The schema is appended to the user metadata, which stays at the start of
+ * the blob metadata header. The returned size should be used as
+ * blob_metadata_hdr_size in the header info given to shd_create().
+ *
+ * @param[in] user_mdata_size : size of the user metadata (can be 0)
+ * @param[in] fields : description of the fields of the blob
+ * @param[in] nb_fields : number of elements in fields
+ *
+ * @return : size of the blob metadata header,
+ *           0 if fields are invalid
+ */
+size_t shd_blob_schema_get_size(size_t user_mdata_size,
+				const struct shd_field_desc fields[],
+				size_t nb_fields);
+
+/**
+ * @brief Build a blob metadata header which holds a blob schema
+ *
+ * @param[out] blob_metadata_hdr : blob metadata header to pass to
+ * shd_create()
+ * @param[in] size : size of blob_metadata_hdr, as returned by
+ * shd_blob_schema_get_size()
+ * @param[in] user_mdata : user metadata (can be NULL if user_mdata_size is 0)
+ * @param[in] user_mdata_size : size of the user metadata
+ * @param[in] fields : description of the fields of the blob
+ * @param[in] nb_fields : number of elements in fields
+ *
+ * @return : 0 on success,
+ *           -EINVAL if any argument is invalid,
+ *           -ENOMEM if size does not match the size of the header
+ */
+int shd_blob_schema_write(void *blob_metadata_hdr, size_t size,
+				const void *user_mdata, size_t user_mdata_size,
+				const struct shd_field_desc fields[],
+				size_t nb_fields);
+
+/**
+ * @brief Resolve a quantity by name from the blob schema of a section
+ *
+ * The returned quantity info does not depend on the name anymore, and can be
+ * used for all subsequent reads, until the section is re-created by its
+ * producer. A name which is the prefix of nested fields (e.g. "imu" for
+ * "imu.accel" and "imu.gyro") resolves to a quantity of type SHD_FIELD_GROUP
+ * that spans all of them.
+ *
+ * @param[in,out] ctx : shared memory context
+ * @param[in] name : name of the quantity
+ * @param[out] info : resolved quantity
+ * @param[in] rev : pointer to the revision structure that was output when
+ * section was open
+ *
+ * @return : 0 on success,
+ *           -EINVAL if any pointer argument is NULL,
+ *           -ENODATA if the section has no blob schema, as record
+ * sections,
+ *           -EPROTO if the blob schema of the section is invalid,
+ *           -ENOENT if no field matches name,
+ *           -ENODEV if blob format changed since the memory section was open
+ * (so that memory section should be closed and re-open properly)
+ */
+int shd_quantity_resolve(struct shd_ctx *ctx,
+				const char *name,
+				struct shd_quantity_info *info,
+				struct shd_revision *rev);
+
+/**
+ * @brief Get the quantities tracked by the producer of a section
+ *
+ * @param[in] ctx : shared memory context
+ * @param[out] quantities : destination array, where quantity #i is the one
+ * of bit #i in the bitmaps returned by shd_read_dirty()
+ * @param[in] max_quantities : number of elements of quantities
+ * @param[in] rev : pointer to the revision structure that was output when
+ * section was open
+ *
+ * @return : number of tracked quantities, which may be greater than
+ * max_quantities, in which case only the first ones are copied,
+ *           -EINVAL if any pointer argument is NULL,
+ *           -ENODATA if the producer of the section does not track
+ * quantities,
+ *           -ENODEV if blob format changed since the memory section was open
+ * (so that memory section should be closed and re-open properly)
+ */
+int shd_get_tracked_quantities(struct shd_ctx *ctx,
+				struct shd_quantity quantities[],
+				size_t max_quantities,
+				struct shd_revision *rev);
+
+/**
+ * @brief Start a columnar recording of a section
+ *
+ * Each numeric element described by the blob schema of the section is
+ * recorded in a column of its own. Rows are written to the file by chunks of
+ * chunk_rows, and the footer which indexes them is written by
+ * shd_col_record_stop() : the file can only be read once the recording has
+ * been stopped.
+ *
+ * @param[in] ctx : consumer context of the section, which must outlive the
+ * recording
+ * @param[in] path : path of the file of the recording, which is truncated if
+ * it exists
+ * @param[in] chunk_rows : number of rows of a chunk, not 0
+ * @param[in] rev : pointer to the revision structure that was output when
+ * section was open
+ *
+ * @return writer of the recording on success,
+ *         NULL if any argument is invalid, if the section has no blob schema
+ * with numeric fields (as record sections), or if the file could not be
+ * created
+ */
+struct shd_col_writer *shd_col_record_start(struct shd_ctx *ctx,
+					const char *path,
+					uint32_t chunk_rows,
+					struct shd_revision *rev);
+
+/**
+ * @brief Record the samples committed since the previous call
+ *
+ * The samples of the section whose timestamp is after the last recorded one
+ * are recorded, oldest first : timestamps are expected to increase. The first
+ * call records all the samples of the section. This function performs a
+ * whole reading sequence, shd_end_read() must not be called after it.
+ *
+ * @param[in,out] writer : writer of the recording
+ * @param[in] rev : pointer to the revision structure that was output when
+ * section was open
+ *
+ * @return number of recorded samples on success,
+ *         -EINVAL if any argument is invalid,
+ *         -EAGAIN if no value has yet been produced in that memory section,
+ * or if the section was re-created during the read,
+ *         -EFAULT if the samples were overwritten during the read, in which
+ * case none is recorded,
+ *         -ENODEV if blob format changed since the memory section was open
+ * (so that memory section should be closed and re-open properly),
+ *         -errno if the recording could not be written
+ */
+int shd_col_record(struct shd_col_writer *writer, struct shd_revision *rev);
+
+/**
+ * @brief Stop a columnar recording : write its last rows and its footer
+ *
+ * @param[in] writer : writer of the recording, which is destroyed
+ *
+ * @return 0 on success,
+ *         -EINVAL if writer is NULL,
+ *         -errno if the recording could not be written
+ */
+int shd_col_record_stop(struct shd_col_writer *writer);
+
+/**
+ * @brief Open a columnar recording for reading
+ *
+ * The file is m'mapped : the pointers returned by shd_col_slice() and
+ * shd_col_get() point into the mapping, and stay valid until shd_col_close().
+ *
+ * @param[in] path : path of the file of the recording
+ *
+ * @return recording on success,
+ *         NULL if path is NULL, or if the file could not be mapped or is not
+ * a valid recording
+ */
+struct shd_col_file *shd_col_open(const char *path);
+
+/**
+ * @brief Close a columnar recording
+ *
+ * @param[in] file : recording to close
+ *
+ * @return 0 on success,
+ *         -EINVAL if file is NULL
+ */
+int shd_col_close(struct shd_col_file *file);
+
+/**
+ * @brief Find the columns of a quantity of a columnar recording
+ *
+ * @param[in] file : recording
+ * @param[in] name : name of a numeric field in the blob schema of the
+ * recorded section
+ * @param[out] info : resolved quantity : its count elements are recorded in
+ * consecutive columns
+ *
+ * @return index of the column of the first element of the quantity,
+ *         -EINVAL if any argument is NULL,
+ *         -ENOENT if no numeric field matches name,
+ *         -EPROTO if the blob schema of the recording is invalid
+ */
+int shd_col_find(const struct shd_col_file *file,
+			const char *name,
+			struct shd_quantity_info *info);
+
+/**
+ * @brief Get the rows of a columnar recording within a time range
+ *
+ * The rows of a time range may span several chunks : they are returned as
+ * one slice per chunk, oldest first.
+ *
+ * @param[in] file : recording
+ * @param[in] start : start of the time range, NULL for the start of the
+ * recording
+ * @param[in] end : end of the time range (included), NULL for the end of the
+ * recording
+ * @param[out] slices : destination array
+ * @param[in] max_slices : number of elements of slices
+ *
+ * @return number of slices, which may be greater than max_slices, in which
+ * case only the first ones are filled,
+ *         -EINVAL if any argument is invalid
+ */
+int shd_col_slice(const struct shd_col_file *file,
+			const struct timespec *start,
+			const struct timespec *end,
+			struct shd_col_slice slices[],
+			size_t max_slices);
+
+/**
+ * @brief Get the values of a column of a columnar recording in a slice
+ *
+ * @param[in] file : recording
+ * @param[in] slice : slice output by shd_col_slice()
+ * @param[in] column : index of the column (see shd_col_find())
+ * @param[out] type : if not NULL, type of the values of the column
+ *
+ * @return pointer to the slice->nb_rows values of the column, of type *type,
+ *         NULL if any argument is invalid
+ */
+const void *shd_col_get(const struct shd_col_file *file,
+			const struct shd_col_slice *slice,
+			uint32_t column,
+			enum shd_field_type *type);
+
 #ifdef SHD_ADVANCED_WRITE_API
 
 /**
@@ -429,6 +1544,38 @@ int shd_read_blob_metadata_hdr(struct shd_ctx *ctx,
 int shd_new_sample(struct shd_ctx *ctx,
 			const struct shd_sample_metadata *metadata);
 
+/**
+ * @brief Declare start of the writing process of a new sample, initialized
+ * from the latest committed sample.
+ * The blob of the latest committed sample is copied into the new sample,
+ * except the quantities listed in "written", which the producer is about to
+ * write with shd_write_quantity(). This lets producers which only update a
+ * few quantities at each cycle publish consistent samples without keeping
+ * their own copy of the whole blob.
+ *
+ * @post shd_commit_sample must be called to signal the end of the write
+ * process
+ *
+ * @note If no sample was committed yet, nothing is copied. Copied quantities
+ * are not marked in the dirty map of sections created with
+ * shd_create_tracked().
+ *
+ * @param[in,out] ctx : shared memory context
+ * @param[in] metadata : metadata that will be associated to this sample
+ * @param[in] written : quantities which will be written in the new sample,
+ * in any order (may be NULL if nb_written is 0, to copy the whole blob)
+ * @param[in] nb_written : number of quantities in the written array
+ *
+ * @return 0 on success,
+ *         -EINVAL if ctx or metadata is NULL, or if a quantity is out of the
+ * blob,
+ *         any error returned by shd_new_sample()
+ */
+int shd_new_sample_from_previous(struct shd_ctx *ctx,
+			const struct shd_sample_metadata *metadata,
+			const struct shd_quantity written[],
+			size_t nb_written);
+
 
 /**
  * @brief Write a given quantity into the new sample
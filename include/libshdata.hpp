@@ -0,0 +1,519 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file libshdata.hpp
+ *
+ * @brief C++17 typed layer over the shared memory data low level api.
+ *
+ * @details This header-only layer adds type safety to libshdata without
+ * adding any cost to its C api :
+ *   - shd::Producer<Blob> and shd::Consumer<Blob> own a section context, and
+ * only accept blobs of type Blob ;
+ *   - quantities are designated by pointers to data members of Blob (e.g.
+ * &Blob::acc), which are turned into shd_quantity constants : the offset of
+ * a member is taken on a static object, which compilers fold into a constant
+ * as no standard constant expression can compute it ;
+ *   - shd::ReadSession wraps a shd_select_samples()/shd_end_read() sequence,
+ * the read being ended when the session goes out of scope ;
+ *   - window reads are done into caller-provided shd::span buffers, without
+ * any allocation.
+ *
+ * Errors are reported as in the C api, with negative errno values, except by
+ * constructors which throw std::system_error.
+ *
+ * Example :
+ *   shd::Consumer<imu_blob> cons("imu");
+ *   std::array<acceleration, 10> acc;
+ *   auto session = cons.select({ {}, SHD_LATEST, 9, 0 });
+ *   if (session.read<&imu_blob::acc>(acc) > 0 && session.end() == 0)
+ *       process(acc.data(), session.size());
+ */
+
+#ifndef _LIBSHDATA_HPP_
+#define _LIBSHDATA_HPP_
+
+#if defined(_LIBSHDATA_H_) && !defined(SHD_ADVANCED_READ_API)
+#error "libshdata.hpp should be included before libshdata.h"
+#endif
+
+#ifndef SHD_ADVANCED_READ_API
+#define SHD_ADVANCED_READ_API
+#endif
+
+#include <cerrno>
+#include <cstddef>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include "libshdata.h"
+
+namespace shd {
+
+/**
+ * Non-owning view over a contiguous array, until std::span (C++20) is
+ * available
+ */
+template <typename T>
+class span {
+public:
+	constexpr span() noexcept : mData(nullptr), mSize(0) {}
+	constexpr span(T *data, std::size_t size) noexcept
+		: mData(data), mSize(size) {}
+	template <std::size_t N>
+	constexpr span(T (&array)[N]) noexcept : mData(array), mSize(N) {}
+	/* Any contiguous container : std::array, std::vector, ... */
+	template <typename C, typename = decltype(std::declval<C &>().data())>
+	constexpr span(C &container) noexcept
+		: mData(container.data()), mSize(container.size()) {}
+
+	constexpr T *data() const noexcept { return mData; }
+	constexpr std::size_t size() const noexcept { return mSize; }
+	constexpr std::size_t size_bytes() const noexcept
+	{
+		return mSize * sizeof(T);
+	}
+	constexpr bool empty() const noexcept { return mSize == 0; }
+	constexpr T &operator[](std::size_t i) const noexcept
+	{
+		return mData[i];
+	}
+	constexpr T *begin() const noexcept { return mData; }
+	constexpr T *end() const noexcept { return mData + mSize; }
+
+private:
+	T *mData;
+	std::size_t mSize;
+};
+
+namespace detail {
+
+template <auto Member>
+struct member_traits;
+
+template <typename C, typename T, T C::*Member>
+struct member_traits<Member> {
+	using blob_type = C;
+	using value_type = T;
+};
+
+template <typename Blob>
+constexpr void check_blob()
+{
+	static_assert(std::is_trivially_copyable_v<Blob>,
+			"blobs are copied bytewise in shared memory");
+	static_assert(std::is_standard_layout_v<Blob>,
+			"quantities are located by their offset in blobs");
+}
+
+} /* namespace detail */
+
+/**
+ * Blob type and value type of the quantity designated by a pointer to data
+ * member
+ */
+template <auto Member>
+using blob_of = typename detail::member_traits<Member>::blob_type;
+template <auto Member>
+using value_of = typename detail::member_traits<Member>::value_type;
+
+/**
+ * @brief Get the shd_quantity of a member of a blob
+ *
+ * @return : quantity, folded into a constant by compilers when inlined
+ */
+template <auto Member>
+inline shd_quantity quantity() noexcept
+{
+	using Blob = blob_of<Member>;
+	alignas(Blob) static const unsigned char storage[sizeof(Blob)] = {};
+	const Blob *blob = reinterpret_cast<const Blob *>(storage);
+
+	detail::check_blob<Blob>();
+	return shd_quantity{
+		reinterpret_cast<const unsigned char *>(&(blob->*Member))
+				- storage,
+		sizeof(value_of<Member>),
+	};
+}
+
+/**
+ * Read session on a window of samples of a section, ended by end() or when
+ * the session is destroyed
+ */
+template <typename Blob>
+class ReadSession {
+public:
+	ReadSession(ReadSession &&other) noexcept
+		: mCtx(std::exchange(other.mCtx, nullptr)), mRev(other.mRev),
+		  mStatus(other.mStatus), mMetadata(other.mMetadata),
+		  mResult(other.mResult)
+	{
+	}
+	ReadSession(const ReadSession &) = delete;
+	ReadSession &operator=(const ReadSession &) = delete;
+	ReadSession &operator=(ReadSession &&) = delete;
+
+	~ReadSession()
+	{
+		end();
+	}
+
+	/**
+	 * @brief Get the result of the sample selection
+	 *
+	 * @return : 0 if samples were selected,
+	 *           negative errno value returned by shd_select_samples()
+	 * otherwise
+	 */
+	int status() const noexcept { return mStatus; }
+	explicit operator bool() const noexcept { return mStatus == 0; }
+
+	/* Number of selected samples */
+	std::size_t size() const noexcept
+	{
+		return mStatus == 0 ? mResult.nb_matches : 0;
+	}
+
+	/* Index of the reference sample in the window */
+	int reference_index() const noexcept { return mResult.r_sample_idx; }
+
+	/* Metadata of the selected samples, valid until the session ends */
+	span<const shd_sample_metadata> metadata() const noexcept
+	{
+		return span<const shd_sample_metadata>(mMetadata, size());
+	}
+
+	/**
+	 * @brief Read a quantity of all the selected samples
+	 *
+	 * @param[out] dst : buffer of at least size() elements
+	 *
+	 * @return : number of samples read,
+	 *           negative errno value otherwise (see shd_read_quantity())
+	 */
+	template <auto Member>
+	int read(span<value_of<Member>> dst) const noexcept
+	{
+		static_assert(std::is_same_v<blob_of<Member>, Blob>,
+				"quantity is not a member of the blob");
+		const shd_quantity q = quantity<Member>();
+
+		if (mStatus < 0)
+			return mStatus;
+		return shd_read_quantity(mCtx, &q, dst.data(),
+				dst.size_bytes());
+	}
+
+	/**
+	 * @brief Read all the selected samples as whole blobs
+	 *
+	 * @param[out] dst : buffer of at least size() elements
+	 *
+	 * @return : number of samples read,
+	 *           negative errno value otherwise (see shd_read_quantity())
+	 */
+	int read(span<Blob> dst) const noexcept
+	{
+		if (mStatus < 0)
+			return mStatus;
+		return shd_read_quantity(mCtx, nullptr, dst.data(),
+				dst.size_bytes());
+	}
+
+	/**
+	 * @brief End the read session, and check whether the data read is
+	 * valid
+	 *
+	 * @return : 0 if data read is valid (or if the session was already
+	 * ended),
+	 *           negative errno value otherwise (see shd_end_read())
+	 */
+	int end() noexcept
+	{
+		shd_ctx *ctx = std::exchange(mCtx, nullptr);
+
+		if (ctx == nullptr || mStatus < 0)
+			return mStatus < 0 ? mStatus : 0;
+		return shd_end_read(ctx, mRev);
+	}
+
+private:
+	template <typename>
+	friend class Consumer;
+
+	ReadSession(shd_ctx *ctx, shd_revision *rev,
+			const shd_sample_search &search) noexcept
+		: mCtx(ctx), mRev(rev), mMetadata(nullptr), mResult()
+	{
+		mStatus = shd_select_samples(mCtx, &search, &mMetadata,
+				&mResult);
+	}
+
+	shd_ctx *mCtx;
+	shd_revision *mRev;
+	int mStatus;
+	shd_sample_metadata *mMetadata;
+	shd_search_result mResult;
+};
+
+/**
+ * Producer of a section whose blobs are of type Blob
+ */
+template <typename Blob>
+class Producer {
+public:
+	/**
+	 * @brief Create the section
+	 *
+	 * @param[in] name : name of the section
+	 * @param[in] max_nb_samples : max number of samples (history depth)
+	 * @param[in] rate : informal producer write period in us
+	 * @param[in] blob_metadata_hdr : blob metadata header
+	 * @param[in] shd_root : root directory of the section (see
+	 * shd_create())
+	 *
+	 * @throw std::system_error if the section could not be created
+	 */
+	template <typename MetadataHdr>
+	Producer(const char *name, uint32_t max_nb_samples, uint32_t rate,
+			const MetadataHdr &blob_metadata_hdr,
+			const char *shd_root = nullptr)
+	{
+		const shd_hdr_user_info hdr_info = {
+			sizeof(Blob), max_nb_samples, rate,
+			sizeof(MetadataHdr),
+		};
+
+		detail::check_blob<Blob>();
+		mCtx = shd_create(name, shd_root, &hdr_info,
+				&blob_metadata_hdr);
+		if (mCtx == nullptr)
+			throw std::system_error(EINVAL, std::generic_category(),
+					"shd_create");
+	}
+
+	Producer(Producer &&other) noexcept
+		: mCtx(std::exchange(other.mCtx, nullptr))
+	{
+	}
+	Producer(const Producer &) = delete;
+	Producer &operator=(const Producer &) = delete;
+	Producer &operator=(Producer &&) = delete;
+
+	~Producer()
+	{
+		if (mCtx != nullptr)
+			shd_close(mCtx, nullptr);
+	}
+
+	/**
+	 * @brief Write a new blob
+	 *
+	 * @return : see shd_write_new_blob()
+	 */
+	int write(const Blob &blob, const shd_sample_metadata &metadata)
+			noexcept
+	{
+		return shd_write_new_blob(mCtx, &blob, sizeof(blob), &metadata);
+	}
+
+	/**
+	 * @brief Enable or disable the notification of commits
+	 *
+	 * @return : see shd_set_commit_notify()
+	 */
+	int set_commit_notify(bool enable) noexcept
+	{
+		return shd_set_commit_notify(mCtx, enable);
+	}
+
+	/**
+	 * @brief Select how blobs are copied into the section
+	 *
+	 * @return : see shd_set_write_mode()
+	 */
+	int set_write_mode(shd_write_mode mode) noexcept
+	{
+		return shd_set_write_mode(mCtx, mode);
+	}
+
+	/* Underlying context, for the functions of the C api */
+	shd_ctx *get() const noexcept { return mCtx; }
+
+private:
+	shd_ctx *mCtx;
+};
+
+/**
+ * Consumer of a section whose blobs are of type Blob
+ */
+template <typename Blob>
+class Consumer {
+public:
+	/**
+	 * @brief Open the section
+	 *
+	 * @param[in] name : name of the section
+	 * @param[in] shd_root : root directory of the section (see shd_open())
+	 *
+	 * @throw std::system_error if the section could not be open, or if
+	 * its blobs are not of the size of Blob
+	 */
+	explicit Consumer(const char *name, const char *shd_root = nullptr)
+	{
+		shd_hdr_user_info hdr_info;
+		int ret;
+
+		detail::check_blob<Blob>();
+		mCtx = shd_open(name, shd_root, &mRev);
+		if (mCtx == nullptr)
+			throw std::system_error(ENOENT, std::generic_category(),
+					"shd_open");
+
+		ret = shd_read_section_hdr(mCtx, &hdr_info, mRev);
+		if (ret == 0 && hdr_info.blob_size != sizeof(Blob))
+			ret = -EPROTO;
+		if (ret < 0) {
+			shd_close(mCtx, mRev);
+			throw std::system_error(-ret, std::generic_category(),
+					"shd_read_section_hdr");
+		}
+	}
+
+	Consumer(Consumer &&other) noexcept
+		: mCtx(std::exchange(other.mCtx, nullptr)), mRev(other.mRev)
+	{
+	}
+	Consumer(const Consumer &) = delete;
+	Consumer &operator=(const Consumer &) = delete;
+	Consumer &operator=(Consumer &&) = delete;
+
+	~Consumer()
+	{
+		if (mCtx != nullptr)
+			shd_close(mCtx, mRev);
+	}
+
+	/**
+	 * @brief Start a read session on the samples matching a search
+	 *
+	 * @return : read session, whose status() is that of
+	 * shd_select_samples()
+	 */
+	ReadSession<Blob> select(const shd_sample_search &search) noexcept
+	{
+		return ReadSession<Blob>(mCtx, mRev, search);
+	}
+
+	/**
+	 * @brief Read a quantity of the sample matching a search
+	 *
+	 * @param[in] search : search of a single sample
+	 * @param[out] value : value of the quantity
+	 * @param[out] metadata : metadata of the sample (can be NULL)
+	 *
+	 * @return : 1 on success,
+	 *           negative errno value otherwise (see shd_read_from_sample()
+	 * and shd_end_read())
+	 */
+	template <auto Member>
+	int read(const shd_sample_search &search, value_of<Member> &value,
+			shd_sample_metadata *metadata = nullptr) noexcept
+	{
+		static_assert(std::is_same_v<blob_of<Member>, Blob>,
+				"quantity is not a member of the blob");
+		const shd_quantity q = quantity<Member>();
+
+		return read_from_sample(search, 1, &q, &value, sizeof(value),
+				metadata);
+	}
+
+	/**
+	 * @brief Read the whole blob of the sample matching a search
+	 *
+	 * @return : see read()
+	 */
+	int read(const shd_sample_search &search, Blob &blob,
+			shd_sample_metadata *metadata = nullptr) noexcept
+	{
+		return read_from_sample(search, 0, nullptr, &blob,
+				sizeof(blob), metadata);
+	}
+
+	/**
+	 * @brief Enable or disable automatic reconnection
+	 *
+	 * @return : see shd_set_auto_reconnect()
+	 */
+	int set_auto_reconnect(bool enable) noexcept
+	{
+		return shd_set_auto_reconnect(mCtx, enable);
+	}
+
+	/**
+	 * @brief Wait until a new sample is committed
+	 *
+	 * @return : see shd_wait_sample()
+	 */
+	int wait(uint32_t &seq, const timespec *timeout = nullptr) noexcept
+	{
+		return shd_wait_sample(mCtx, &seq, timeout);
+	}
+
+	/* Underlying context and revision, for the functions of the C api */
+	shd_ctx *get() const noexcept { return mCtx; }
+	shd_revision *revision() const noexcept { return mRev; }
+
+private:
+	int read_from_sample(const shd_sample_search &search, int n,
+			const shd_quantity *q, void *dst, std::size_t size,
+			shd_sample_metadata *metadata) noexcept
+	{
+		shd_quantity_sample qty_sample;
+		int ret, end;
+
+		qty_sample.ptr = dst;
+		qty_sample.size = size;
+		ret = shd_read_from_sample(mCtx, n, &search, q, &qty_sample);
+		/* No read session is started if no sample was found */
+		if (ret == -EAGAIN || ret == -ENOENT || ret == -EINVAL)
+			return ret;
+
+		end = shd_end_read(mCtx, mRev);
+		if (ret < 0 || end < 0)
+			return ret < 0 ? ret : end;
+		if (metadata != nullptr)
+			*metadata = qty_sample.meta;
+		return ret;
+	}
+
+	shd_ctx *mCtx;
+	shd_revision *mRev;
+};
+
+} /* namespace shd */
+
+#endif /* _LIBSHDATA_HPP_ */
@@ -34,7 +34,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
-#include <unistd.h>		/* For ftruncate */
+#include <unistd.h>		/* For ftruncate and pread */
 #include <limits.h>		/* For NAME_MAX macro */
 #include <sys/file.h>		/* for flock */
 #include <sys/mman.h>		/* For shm and PROT flags */
@@ -67,14 +67,11 @@ static int shd_shm_open_internal(struct shd_shm_priv *self,
 		return -ENOMEM;
 
 	self->fd = shm_open(path, flags, mode);
-	if (self->fd == -1) {
+	if (self->fd == -1)
 		ret = -errno;
-		goto error;
-	}
+	else
+		ret = 0;
 
-	return 0;
-
-error:
 	free(path);
 
 	return ret;
@@ -216,28 +213,21 @@ static int shd_shm_close(void *priv)
 static int shd_shm_read_header(struct shd_hdr *hdr, void *priv)
 {
 	struct shd_shm_priv *self = priv;
-	void *ptr;
-	int ret;
-
-	if (lseek(self->fd, 0, SEEK_END) <= 0) {
-		ULOGW("Can not m'map in zero-sized file");
-		return -ENOMEM;
-	}
+	ssize_t ret;
 
-	ptr = mmap(0,
-		   sizeof(hdr),
-		   PROT_READ,
-		   MAP_SHARED,
-		   self->fd,
-		   0);
-	if (ptr == MAP_FAILED) {
+	/* The header is read rather than m'mapped, so that the section is
+	 * m'mapped only once when it is open */
+	ret = pread(self->fd, hdr, sizeof(*hdr), 0);
+	if (ret < 0) {
 		ret = -errno;
-		ULOGW("Could not allocate memory : %m");
+		ULOGW("Could not read section header : %m");
 		return ret;
 	}
 
-	memcpy(hdr, ptr, sizeof(*hdr));
-	munmap(ptr, sizeof(*hdr));
+	if ((size_t) ret < sizeof(*hdr)) {
+		ULOGW("Section is too small to hold a header");
+		return -ENOMEM;
+	}
 
 	return 0;
 }
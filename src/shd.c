@@ -35,6 +35,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include "futils/timetools.h"
 
 #define SHD_ADVANCED_WRITE_API
 #define SHD_ADVANCED_READ_API
@@ -44,32 +45,70 @@
 #include "shd_hdr.h"
 #include "shd_data.h"
 #include "shd_mdata_hdr.h"
+#include "shd_schema.h"
+#include "shd_dirty.h"
+#include "shd_rec.h"
+#include "shd_tier.h"
+#include "shd_aggregate.h"
+#include "shd_filter.h"
+#include "shd_col.h"
+#include "shd_rate.h"
+#include "shd_sub.h"
 #include "shd_private.h"
+#include "shd_registry.h"
+#include "shd_trace.h"
+#include "shd_utils.h"
 
 #if defined(BUILD_LIBULOG)
 ULOG_DECLARE_TAG(libshdata);
 #endif
 
-struct shd_ctx *shd_create(const char *blob_name, const char *shd_root,
-			   const struct shd_hdr_user_info *hdr_info,
-			   const void *blob_metadata_hdr)
+/*
+ * Format of a section, besides its header info
+ */
+struct section_format {
+	/* blob metadata header, NULL for record sections */
+	const void *blob_metadata_hdr;
+	/* tracked quantities, if the section holds a dirty map */
+	const struct shd_quantity *tracked;
+	size_t nb_tracked;
+	/* size of the byte ring, 0 if this is not a record section */
+	size_t ring_size;
+	/* whether the section has downsampled tiers */
+	bool tiers;
+};
+
+/*
+ * Create or re-create a section for writing, its arguments having already
+ * been checked
+ */
+static struct shd_ctx *create_section(const char *blob_name,
+			const struct shd_hdr_user_info *hdr_info,
+			const struct section_format *format)
 {
 	struct shd_ctx *ctx = NULL;
 	int ret = -1;
 	int rev_nb;
 	bool first_creation;
+	bool dirty_map = format->nb_tracked > 0;
+	uint64_t flags = 0;
 	struct shd_section_id id;
 	size_t section_size;
 
-	if (blob_name == NULL
-		|| hdr_info == NULL
-		|| blob_metadata_hdr == NULL) {
-		ULOGE("Invalid arguments for shared memory section creation");
+	if (dirty_map)
+		flags |= SHD_HDR_FLAG_DIRTY_MAP;
+	if (format->ring_size > 0)
+		flags |= SHD_HDR_FLAG_RECORD_RING;
+	if (format->tiers)
+		flags |= SHD_HDR_FLAG_TIERS;
+
+	section_size = shd_section_get_total_size(hdr_info, dirty_map);
+	if (section_size == (size_t) -1) {
+		ULOGE("Shared memory section \"%s\" is too large",
+				blob_name);
 		goto error;
 	}
 
-	section_size = shd_section_get_total_size(hdr_info);
-
 	ret = shd_section_create(blob_name, section_size, &id, &first_creation);
 	if (ret < 0) {
 		ULOGE("Could not add new shared memory section \"%s\" : %s",
@@ -106,7 +145,7 @@ struct shd_ctx *shd_create(const char *blob_name, const char *shd_root,
 	/* Create associated context */
 	ctx = shd_ctx_new(&id, blob_name);
 
-	ret = shd_ctx_mmap(ctx, hdr_info);
+	ret = shd_ctx_mmap(ctx, hdr_info, dirty_map);
 	if (ret < 0) {
 		ULOGE("Could not RW-map the shared memory section \"%s\" : %s",
 				blob_name,
@@ -114,16 +153,32 @@ struct shd_ctx *shd_create(const char *blob_name, const char *shd_root,
 		goto error;
 	}
 
+	/* A section left behind by another version of the library does not
+	 * have the same layout : initialize it as a new one */
+	if (!first_creation
+		&& !shd_hdr_is_compatible(ctx->sect_mmap->section_top)) {
+		ULOGI("Memory section \"%s\" was created by another version of "
+				"the library", blob_name);
+		first_creation = true;
+	}
+
 	shd_sync_invalidate_section(ctx->sync_ctx,
 					ctx->sect_mmap->sync_top,
 					first_creation);
 
 	/* Write section and metadata headers */
-	shd_hdr_write(ctx->sect_mmap->section_top, hdr_info);
-	shd_mdata_hdr_write(ctx->sect_mmap->metadata_blob_top,
-				blob_metadata_hdr,
+	shd_hdr_write(ctx->sect_mmap->section_top, hdr_info, flags);
+	if (format->ring_size > 0)
+		shd_rec_init(ctx->sect_mmap->metadata_blob_top,
+				format->ring_size);
+	else
+		shd_mdata_hdr_write(ctx->sect_mmap->metadata_blob_top,
+				format->blob_metadata_hdr,
 				hdr_info->blob_metadata_hdr_size);
 	shd_data_clear_section(ctx->desc);
+	if (dirty_map)
+		shd_dirty_init(ctx->sect_mmap->dirty_top, format->tracked,
+				format->nb_tracked, hdr_info->max_nb_samples);
 
 	rev_nb = shd_sync_update_global_revision_nb(ctx->sync_ctx,
 						ctx->sect_mmap->sync_top);
@@ -132,6 +187,10 @@ struct shd_ctx *shd_create(const char *blob_name, const char *shd_root,
 		goto error;
 	}
 
+	/* Wake up the consumers waiting on the previous revision : commits
+	 * are not notified until the new producer enables it */
+	shd_sync_notify_commit(ctx->sync_ctx, ctx->sect_mmap->sync_top);
+
 	SHD_HOOK(HOOK_SECTION_CREATED_BEFORE_UNLOCK);
 
 	/* Unlock the shared memory section */
@@ -147,6 +206,15 @@ struct shd_ctx *shd_create(const char *blob_name, const char *shd_root,
 			blob_name,
 			first_creation ? "created" : "reopen for writing",
 			rev_nb);
+	SHD_TRACE(section_create, blob_name, rev_nb);
+
+	/* The section is usable even if it could not be registered */
+	ret = shd_registry_add(blob_name, &id, hdr_info, section_size, rev_nb);
+	if (ret < 0)
+		ULOGW("Could not register memory section \"%s\" : %s",
+				blob_name, strerror(-ret));
+	else
+		ctx->registered_rev = rev_nb;
 
 	return ctx;
 
@@ -158,13 +226,118 @@ error:
 	return NULL;
 }
 
-struct shd_ctx *shd_open(const char *blob_name, const char *shd_root,
+struct shd_ctx *shd_create(const char *blob_name, const char *shd_root,
+			   const struct shd_hdr_user_info *hdr_info,
+			   const void *blob_metadata_hdr)
+{
+	return shd_create_tracked(blob_name, shd_root, hdr_info,
+				blob_metadata_hdr, NULL, 0);
+}
+
+struct shd_ctx *shd_create_tracked(const char *blob_name,
+			const char *shd_root,
+			const struct shd_hdr_user_info *hdr_info,
+			const void *blob_metadata_hdr,
+			const struct shd_quantity tracked[],
+			size_t nb_tracked)
+{
+	struct section_format format = {
+		.blob_metadata_hdr = blob_metadata_hdr,
+		.tracked = tracked,
+		.nb_tracked = nb_tracked,
+	};
+
+	if (blob_name == NULL
+		|| hdr_info == NULL
+		|| blob_metadata_hdr == NULL
+		|| (nb_tracked > 0 && shd_dirty_check(tracked, nb_tracked,
+						hdr_info->blob_size) < 0)) {
+		ULOGE("Invalid arguments for shared memory section creation");
+		return NULL;
+	}
+
+	return create_section(blob_name, hdr_info, &format);
+}
+
+struct shd_ctx *shd_rec_create(const char *blob_name, const char *shd_root,
+			size_t ring_size, uint32_t max_nb_records)
+{
+	struct section_format format = {
+		.ring_size = ring_size,
+	};
+	/* Records are indexed by the samples of the section */
+	struct shd_hdr_user_info hdr_info = {
+		.blob_size = sizeof(struct shd_rec_index),
+		.max_nb_samples = max_nb_records,
+		.rate = 0,
+		.blob_metadata_hdr_size = shd_rec_get_size(ring_size),
+	};
+
+	if (blob_name == NULL || ring_size == 0 || max_nb_records == 0
+			|| hdr_info.blob_metadata_hdr_size == (size_t) -1) {
+		ULOGE("Invalid arguments for record section creation");
+		return NULL;
+	}
+
+	return create_section(blob_name, &hdr_info, &format);
+}
+
+struct shd_ctx *shd_create_tiered(const char *blob_name,
+			const char *shd_root,
+			const struct shd_hdr_user_info *hdr_info,
+			const void *blob_metadata_hdr,
+			const struct shd_tier_info tiers[],
+			size_t nb_tiers)
+{
+	struct section_format format = {
+		.blob_metadata_hdr = blob_metadata_hdr,
+		.tiers = true,
+	};
+	struct shd_tiers *tier_sections;
+	struct shd_ctx *ctx;
+
+	if (blob_name == NULL
+		|| hdr_info == NULL
+		|| blob_metadata_hdr == NULL
+		|| hdr_info->blob_size > SIZE_MAX / 3
+		|| shd_tiers_check(tiers, nb_tiers) < 0) {
+		ULOGE("Invalid arguments for tiered section creation");
+		return NULL;
+	}
+
+	/* Tiers are created first, so that consumers find them as soon as
+	 * the section is flagged */
+	tier_sections = shd_tiers_create(blob_name, hdr_info,
+			blob_metadata_hdr, tiers, nb_tiers);
+	if (tier_sections == NULL)
+		return NULL;
+
+	ctx = create_section(blob_name, hdr_info, &format);
+	if (ctx == NULL) {
+		shd_tiers_destroy(tier_sections);
+		return NULL;
+	}
+
+	ctx->tiers = tier_sections;
+
+	return ctx;
+}
+
+/*
+ * Open a section for reading. If hdr_info is not NULL, the section is mapped
+ * using this header info (e.g. found in the section registry) instead of
+ * reading it from the section beforehand, and fails if it turns out to be
+ * out of date.
+ */
+static struct shd_ctx *open_section(const char *blob_name,
+		const struct shd_hdr_user_info *hdr_info,
 		struct shd_revision **rev)
 {
 	int rev_nb = -1;
 	int ret = -1;
 	struct shd_ctx *ctx = NULL;
 	struct shd_section_id id;
+	uint64_t start_ns = 0;
 
 	/* Init rev pointer to NULL so that a free on this pointer in case of
 	* error doesn't hurt */
@@ -175,6 +348,9 @@ struct shd_ctx *shd_open(const char *blob_name, const char *shd_root,
 		goto error;
 	}
 
+	if (SHD_TRACE_ENABLED(section_open))
+		start_ns = shd_trace_now_ns();
+
 	SHD_HOOK(HOOK_SECTION_OPEN_START);
 
 	ret = shd_section_open(blob_name, &id);
@@ -197,7 +373,7 @@ struct shd_ctx *shd_open(const char *blob_name, const char *shd_root,
 	if (*rev == NULL)
 		goto error;
 
-	ret = shd_ctx_mmap(ctx, NULL);
+	ret = shd_ctx_mmap(ctx, hdr_info, false);
 	if (ret < 0) {
 		ULOGE("Could not RO-map the shared memory section \"%s\" : %s",
 				blob_name,
@@ -207,6 +383,21 @@ struct shd_ctx *shd_open(const char *blob_name, const char *shd_root,
 
 	SHD_HOOK(HOOK_SECTION_OPEN_MMAP_DONE);
 
+	/* Registry entries do not tell whether sections hold a dirty map,
+	 * such sections are open the usual way */
+	if (hdr_info != NULL && (!shd_hdr_is_compatible(
+				ctx->sect_mmap->section_top)
+			|| shd_hdr_has_dirty_map(ctx->sect_mmap->section_top)
+			|| memcmp(ctx->sect_mmap->header_top, hdr_info,
+				sizeof(*hdr_info)) != 0)) {
+		ULOGD("Registry entry of section \"%s\" is out of date",
+				blob_name);
+		goto error;
+	}
+
+	if (hdr_info != NULL)
+		SHD_HOOK(HOOK_SECTION_OPEN_FROM_REGISTRY);
+
 	rev_nb = shd_sync_update_local_revision_nb(ctx->sync_ctx,
 					ctx->sect_mmap->sync_top);
 	if (rev_nb == -EAGAIN) {
@@ -218,17 +409,262 @@ struct shd_ctx *shd_open(const char *blob_name, const char *shd_root,
 
 	ULOGI("Memory section \"%s\" successfully open "
 			"with revision number : %d", blob_name, rev_nb);
+	if (SHD_TRACE_ENABLED(section_open))
+		SHD_TRACE(section_open, blob_name, rev_nb,
+				shd_trace_now_ns() - start_ns);
 
 	(*rev)->nb_creations = rev_nb;
 	return ctx;
 
 error:
 	free(*rev);
+	*rev = NULL;
 	if (ctx != NULL)
 		shd_ctx_destroy(ctx);
 	return NULL;
 }
 
+struct shd_ctx *shd_open(const char *blob_name, const char *shd_root,
+		struct shd_revision **rev)
+{
+	return open_section(blob_name, NULL, rev);
+}
+
+/*
+ * Replace the mapping of a consumer context by a new mapping of its section,
+ * which has been re-created by its producer
+ */
+static int reconnect(struct shd_ctx *ctx)
+{
+	struct shd_ctx *new_ctx;
+	struct shd_revision *new_rev;
+	struct shd_ctx tmp;
+
+	/* Fails e.g. if the producer is still re-creating the section */
+	new_ctx = open_section(ctx->blob_name, NULL, &new_rev);
+	if (new_ctx == NULL)
+		return -EAGAIN;
+	free(new_rev);
+
+	/* Swap the contents of both contexts so that the caller's pointer
+	 * stays valid : the old mapping is released along with new_ctx */
+	new_ctx->hint = ctx->hint;
+	new_ctx->auto_reconnect = ctx->auto_reconnect;
+	tmp = *ctx;
+	*ctx = *new_ctx;
+	*new_ctx = tmp;
+	shd_ctx_destroy(new_ctx);
+
+	ULOGI("Memory section \"%s\" remapped with revision number : %d",
+			ctx->blob_name, ctx->sync_ctx->revision.nb_creations);
+
+	return 0;
+}
+
+/*
+ * In auto-reconnect mode, remap the context if its section has been
+ * re-created, and keep the revision structure of the caller up to date
+ */
+static int check_reconnect(struct shd_ctx *ctx, struct shd_revision *rev)
+{
+	int ret;
+
+	if (!ctx->auto_reconnect)
+		return 0;
+
+	if (shd_sync_check_revision_nb(&ctx->sync_ctx->revision,
+					ctx->sect_mmap->sync_top) < 0) {
+		ret = reconnect(ctx);
+		if (ret < 0)
+			return ret;
+	}
+
+	if (rev != NULL)
+		rev->nb_creations = ctx->sync_ctx->revision.nb_creations;
+
+	return 0;
+}
+
+int shd_open_many(const char * const blob_names[], size_t nb_sections,
+			const char *shd_root,
+			struct shd_ctx *ctx[],
+			struct shd_revision *rev[])
+{
+	struct shd_registry *reg;
+	struct shd_section_info info;
+	size_t i;
+	int nb_open = 0;
+
+	if ((nb_sections > 0 && blob_names == NULL)
+			|| ctx == NULL || rev == NULL)
+		return -EINVAL;
+
+	/* Without registry, sections are all open the usual way */
+	reg = shd_registry_open();
+
+	for (i = 0; i < nb_sections; i++) {
+		ctx[i] = NULL;
+		if (reg != NULL && blob_names[i] != NULL
+				&& shd_registry_find(reg, blob_names[i],
+							&info) == 0)
+			ctx[i] = open_section(blob_names[i], &info.hdr_info,
+						&rev[i]);
+		if (ctx[i] == NULL)
+			ctx[i] = shd_open(blob_names[i], shd_root, &rev[i]);
+		if (ctx[i] != NULL)
+			nb_open++;
+	}
+
+	shd_registry_close(reg);
+
+	return nb_open;
+}
+
+int shd_list_sections(struct shd_section_info *infos, size_t max_infos)
+{
+	struct shd_registry *reg;
+	int ret;
+
+	if (infos == NULL && max_infos > 0)
+		return -EINVAL;
+
+	reg = shd_registry_open();
+	if (reg == NULL)
+		return -ENOENT;
+
+	ret = shd_registry_list(reg, infos, max_infos);
+	shd_registry_close(reg);
+
+	return ret;
+}
+
+int shd_set_auto_reconnect(struct shd_ctx *ctx, bool enable)
+{
+	if (ctx == NULL)
+		return -EINVAL;
+
+	ctx->auto_reconnect = enable;
+
+	return 0;
+}
+
+int shd_set_commit_notify(struct shd_ctx *ctx, bool enable)
+{
+	if (ctx == NULL)
+		return -EINVAL;
+
+	shd_sync_set_notify(ctx->sync_ctx, ctx->sect_mmap->sync_top, enable);
+
+	return 0;
+}
+
+int shd_set_write_mode(struct shd_ctx *ctx, enum shd_write_mode mode)
+{
+	if (ctx == NULL)
+		return -EINVAL;
+
+	switch (mode) {
+	case SHD_WRITE_MODE_AUTO:
+	case SHD_WRITE_MODE_CACHED:
+	case SHD_WRITE_MODE_STREAMING:
+		ctx->write_mode = mode;
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+int shd_wait_sample(struct shd_ctx *ctx, uint32_t *seq,
+			const struct timespec *timeout)
+{
+	if (ctx == NULL || seq == NULL)
+		return -EINVAL;
+
+	return shd_wait_any(&ctx, seq, 1, timeout);
+}
+
+int shd_wait_any(struct shd_ctx *ctx[], uint32_t seq[], size_t nb_ctx,
+			const struct timespec *timeout)
+{
+	struct shd_sync_hdr *hdr[SHD_WAIT_MAX_SECTIONS];
+	size_t i;
+	int ret;
+
+	if (ctx == NULL || seq == NULL || nb_ctx == 0
+			|| nb_ctx > SHD_WAIT_MAX_SECTIONS)
+		return -EINVAL;
+
+	for (i = 0; i < nb_ctx; i++) {
+		if (ctx[i] == NULL)
+			return -EINVAL;
+
+		ret = check_reconnect(ctx[i], NULL);
+		if (ret < 0)
+			return ret;
+
+		hdr[i] = ctx[i]->sect_mmap->sync_top;
+	}
+
+	return shd_sync_wait_commit(hdr, seq, nb_ctx, timeout);
+}
+
+/* Number of periods over which the rate of a producer is measured */
+#define RATE_NB_PERIODS 16
+
+/*
+ * Get the period of the producer of a section : measured if there are enough
+ * samples, declared in the section header otherwise, 0 if unknown
+ */
+static uint64_t get_period_ns(struct shd_ctx *ctx)
+{
+	const struct shd_hdr_user_info *hdr_info = ctx->sect_mmap->header_top;
+	uint64_t period_ns;
+
+	if (shd_data_get_period(ctx, RATE_NB_PERIODS, &period_ns) == 0)
+		return period_ns;
+
+	return (uint64_t) hdr_info->rate * 1000;
+}
+
+int shd_wait_next_expected(struct shd_ctx *ctx, uint32_t *seq,
+			const struct timespec *timeout)
+{
+	int ret;
+
+	if (ctx == NULL || seq == NULL)
+		return -EINVAL;
+
+	ret = check_reconnect(ctx, NULL);
+	if (ret < 0)
+		return ret;
+
+	return shd_rate_wait(&ctx->rate, ctx->sect_mmap->sync_top,
+			get_period_ns(ctx), seq, timeout);
+}
+
+int shd_get_measured_rate(struct shd_ctx *ctx, uint32_t *rate)
+{
+	uint64_t period_ns;
+	int ret;
+
+	if (ctx == NULL || rate == NULL)
+		return -EINVAL;
+
+	ret = check_reconnect(ctx, NULL);
+	if (ret < 0)
+		return ret;
+
+	ret = shd_data_get_period(ctx, RATE_NB_PERIODS, &period_ns);
+	if (ret < 0)
+		return ret;
+
+	/* Same unit as the rate declared in the section header */
+	period_ns = (period_ns + 500) / 1000;
+	*rate = period_ns > UINT32_MAX ? UINT32_MAX : period_ns;
+
+	return 0;
+}
+
 int shd_close(struct shd_ctx *ctx, struct shd_revision *rev)
 {
 	if (ctx == NULL)
@@ -236,6 +672,10 @@ int shd_close(struct shd_ctx *ctx, struct shd_revision *rev)
 
 	ULOGI("Trying to close memory section \"%s\"", ctx->blob_name);
 
+	/* The section is not destroyed, but it is not listed anymore */
+	if (ctx->registered_rev >= 0)
+		shd_registry_remove(ctx->blob_name, ctx->registered_rev);
+
 	free(rev);
 	shd_ctx_destroy(ctx);
 
@@ -259,6 +699,35 @@ int shd_new_sample(struct shd_ctx *ctx,
 	return shd_data_write_metadata(ctx, metadata);
 }
 
+int shd_new_sample_from_previous(struct shd_ctx *ctx,
+			const struct shd_sample_metadata *metadata,
+			const struct shd_quantity written[],
+			size_t nb_written)
+{
+	int ret;
+	size_t i;
+
+	if (ctx == NULL || metadata == NULL
+			|| (written == NULL && nb_written > 0))
+		return -EINVAL;
+
+	for (i = 0; i < nb_written; i++) {
+		if (written[i].quantity_offset < 0
+				|| (size_t) written[i].quantity_offset
+					> ctx->desc->blob_size
+				|| written[i].quantity_size >
+					ctx->desc->blob_size
+					- written[i].quantity_offset)
+			return -EINVAL;
+	}
+
+	ret = shd_new_sample(ctx, metadata);
+	if (ret < 0)
+		return ret;
+
+	return shd_data_copy_previous(ctx, written, nb_written);
+}
+
 int shd_write_quantity(struct shd_ctx *ctx,
 			const struct shd_quantity *quantity,
 			const void *src)
@@ -269,12 +738,30 @@ int shd_write_quantity(struct shd_ctx *ctx,
 	return shd_data_write_quantity(ctx, quantity, src);
 }
 
+/*
+ * Commit the nb samples of the current write session, and aggregate them into
+ * the downsampled tiers of the section
+ */
+static int commit_samples(struct shd_ctx *ctx, size_t nb)
+{
+	int ret;
+
+	ret = shd_data_end_write(ctx);
+	if (ret < 0 || ctx->tiers == NULL)
+		return ret;
+
+	while (nb-- > 0)
+		shd_tiers_feed(ctx->tiers, shd_data_get_committed(ctx, nb));
+
+	return 0;
+}
+
 int shd_commit_sample(struct shd_ctx *ctx)
 {
 	if (ctx == NULL)
 		return -EINVAL;
 
-	return shd_data_end_write(ctx);
+	return commit_samples(ctx, 1);
 }
 
 int shd_write_new_blob(struct shd_ctx *ctx,
@@ -313,11 +800,85 @@ int shd_write_new_blob(struct shd_ctx *ctx,
 	return 0;
 }
 
+int shd_write_new_blobs(struct shd_ctx *ctx,
+			const void *src,
+			const size_t size,
+			const struct shd_sample_metadata metadata[],
+			size_t nb)
+{
+	int ret;
+
+	if (ctx == NULL || src == NULL || metadata == NULL
+			|| size > ctx->desc->blob_size
+			|| nb >= ctx->desc->nb_samples)
+		return -EINVAL;
+
+	if (nb == 0)
+		return 0;
+
+	SHD_HOOK(HOOK_SAMPLE_WRITE_START);
+
+	ret = shd_data_reserve_write(ctx);
+	if (ret < 0)
+		return ret;
+
+	ret = shd_data_write_blobs(ctx, src, size, metadata, nb);
+	if (ret < 0)
+		return ret;
+
+	SHD_HOOK(HOOK_SAMPLE_WRITE_BEFORE_COMMIT);
+
+	ret = commit_samples(ctx, nb);
+	if (ret < 0)
+		return ret;
+
+	SHD_HOOK(HOOK_SAMPLE_WRITE_AFTER_COMMIT);
+
+	return 0;
+}
+
+/*
+ * Get the context of the section read in the current reading sequence : the
+ * section itself or one of its downsampled tiers
+ */
+static struct shd_ctx *get_read_ctx(struct shd_ctx *ctx)
+{
+	struct shd_ctx *tier_ctx = NULL;
+
+	if (ctx->tiers != NULL)
+		tier_ctx = shd_tiers_get_read(ctx->tiers, NULL);
+
+	return tier_ctx != NULL ? tier_ctx : ctx;
+}
+
+/*
+ * Choose the section to search, opening the downsampled tiers of the section
+ * on the first search
+ */
+static struct shd_ctx *select_ctx(struct shd_ctx *ctx,
+			const struct shd_sample_search *search)
+{
+	if (ctx->tiers == NULL && !ctx->tiers_open_tried
+			&& shd_hdr_has_tiers(ctx->sect_mmap->section_top)) {
+		ctx->tiers_open_tried = true;
+		ctx->tiers = shd_tiers_open(ctx->blob_name);
+		if (ctx->tiers == NULL)
+			ULOGW("Could not open tiers of memory section \"%s\"",
+					ctx->blob_name);
+	}
+
+	if (ctx->tiers == NULL)
+		return ctx;
+
+	return shd_tiers_select(ctx->tiers, ctx, search);
+}
+
 int shd_select_samples(struct shd_ctx *ctx,
 			const struct shd_sample_search *search,
 			struct shd_sample_metadata **metadata,
 			struct shd_search_result *result)
 {
+	struct shd_ctx *read_ctx;
 	int ret = -1;
 
 	if (ctx == NULL || search == NULL
@@ -326,13 +887,19 @@ int shd_select_samples(struct shd_ctx *ctx,
 		goto exit;
 	}
 
-	ret = shd_data_find(ctx, search);
+	ret = check_reconnect(ctx, NULL);
+	if (ret < 0)
+		goto exit;
+
+	read_ctx = select_ctx(ctx, search);
+
+	ret = shd_data_find(read_ctx, search);
 	if (ret < 0)
 		goto exit;
 
 	result->nb_matches = ret;
 
-	ret = shd_data_read_metadata(ctx, metadata);
+	ret = shd_data_read_metadata(read_ctx, metadata);
 	if (ret < 0)
 		goto exit;
 
@@ -349,6 +916,8 @@ int shd_read_quantity(struct shd_ctx *ctx,
 			void *dst,
 			size_t dst_size)
 {
+	struct shd_ctx *read_ctx;
+	struct shd_quantity mean;
 	int ret = -1;
 
 	if (ctx == NULL || dst == NULL) {
@@ -356,21 +925,87 @@ int shd_read_quantity(struct shd_ctx *ctx,
 		goto exit;
 	}
 
-	if (quantity == NULL)
+	read_ctx = get_read_ctx(ctx);
+	if (quantity == NULL && read_ctx != ctx) {
+		/* The blob of a tier sample starts with the mean */
+		mean.quantity_offset = 0;
+		mean.quantity_size = ctx->desc->blob_size;
+		ret = shd_data_read_quantity(read_ctx, &mean, dst, dst_size);
+	} else if (quantity == NULL) {
 		ret = shd_data_read_blob(ctx, dst, dst_size);
-	else
-		ret = shd_data_read_quantity(ctx, quantity, dst, dst_size);
+	} else {
+		ret = shd_data_read_quantity(read_ctx, quantity, dst,
+				dst_size);
+	}
 
 exit:
 	return ret;
 }
 
+int shd_read_dirty(struct shd_ctx *ctx, uint64_t dst[], size_t nb)
+{
+	if (ctx == NULL || dst == NULL)
+		return -EINVAL;
+
+	return shd_data_read_dirty(get_read_ctx(ctx), dst, nb);
+}
+
+int shd_rec_write(struct shd_ctx *ctx, const struct timespec *ts,
+			const void *data, size_t len)
+{
+	void *rec_top;
+	struct shd_rec_index index;
+	struct shd_quantity q_index = { 0, sizeof(index) };
+	struct shd_sample_metadata metadata;
+	int ret;
+
+	if (ctx == NULL || ts == NULL || (data == NULL && len > 0))
+		return -EINVAL;
+
+	if (!shd_hdr_has_record_ring(ctx->sect_mmap->section_top))
+		return -EOPNOTSUPP;
+
+	rec_top = ctx->sect_mmap->metadata_blob_top;
+	if (len > shd_rec_get_max_len(rec_top))
+		return -EINVAL;
+
+	metadata.ts = *ts;
+	metadata.exp = *ts;
+	ret = shd_new_sample(ctx, &metadata);
+	if (ret < 0)
+		return ret;
+
+	/* The record is in the byte ring before its index is published */
+	shd_rec_append(rec_top, ts, data, len, &index);
+
+	ret = shd_write_quantity(ctx, &q_index, &index);
+	if (ret < 0)
+		return ret;
+
+	return shd_commit_sample(ctx);
+}
+
+int shd_rec_read(struct shd_ctx *ctx,
+			struct shd_rec_record records[],
+			size_t max_records,
+			void *buf,
+			size_t buf_size)
+{
+	if (ctx == NULL || (records == NULL && max_records > 0)
+			|| (buf == NULL && buf_size > 0))
+		return -EINVAL;
+
+	return shd_data_read_records(ctx, records, max_records, buf,
+			buf_size);
+}
+
 int shd_read_from_sample(struct shd_ctx *ctx,
 				int n_quantities,
 				const struct shd_sample_search *search,
 				const struct shd_quantity quantity[],
 				struct shd_quantity_sample qty_samples[])
 {
+	struct shd_ctx *read_ctx;
 	int ret = -ENOSYS;
 
 	if (ctx == NULL || search == NULL
@@ -383,19 +1018,25 @@ int shd_read_from_sample(struct shd_ctx *ctx,
 		goto exit;
 	}
 
-	ret = shd_data_find(ctx, search);
+	ret = check_reconnect(ctx, NULL);
+	if (ret < 0)
+		goto exit;
+
+	read_ctx = select_ctx(ctx, search);
+
+	ret = shd_data_find(read_ctx, search);
 	if (ret < 0)
 		goto exit;
 
 	if (n_quantities > 0) {
-		ret = shd_data_read_quantity_sample(ctx, n_quantities,
+		ret = shd_data_read_quantity_sample(read_ctx, n_quantities,
 						quantity, qty_samples);
 	} else {
 		struct shd_quantity fake_qty[1] = {
 			{ 0, ctx->desc->blob_size }
 		};
 
-		ret = shd_data_read_quantity_sample(ctx, 1, fake_qty,
+		ret = shd_data_read_quantity_sample(read_ctx, 1, fake_qty,
 				qty_samples);
 	}
 
@@ -432,8 +1073,201 @@ exit:
 	return ret;
 }
 
+/* The version of the section is checked once and for all at open and
+ * reconnection : idle consumers only load the sync header line, with the
+ * revision number and the commit sequence number */
+_Static_assert(offsetof(struct shd_hdr, sync_info.revision) / CACHE_LINE_SIZE
+		== offsetof(struct shd_hdr, sync_info.commit_seq)
+			/ CACHE_LINE_SIZE,
+		"revision and commit sequence number on distinct lines");
+
+int shd_read_latest_if_new(struct shd_ctx *ctx,
+				uint32_t *last_seen,
+				int n_quantities,
+				const struct shd_quantity quantity[],
+				struct shd_quantity_sample qty_samples[])
+{
+	const struct shd_sample_search search = {
+		.method = SHD_LATEST,
+	};
+	uint32_t seq;
+	int ret;
+
+	if (ctx == NULL || last_seen == NULL)
+		return -EINVAL;
+
+	ret = check_reconnect(ctx, NULL);
+	if (ret < 0)
+		return ret;
+
+	/* Idle consumers stop here, after loading a single shared cache
+	 * line */
+	seq = shd_sync_get_commit_seq(ctx->sect_mmap->sync_top);
+	if (seq == *last_seen)
+		return 0;
+
+	ret = shd_read_from_sample(ctx, n_quantities, &search, quantity,
+			qty_samples);
+	if (ret > 0)
+		*last_seen = seq;
+
+	return ret;
+}
+
+struct shd_sub *shd_subscribe(struct shd_ctx *ctx,
+				const struct shd_sub_info *info)
+{
+	struct shd_sub *sub;
+
+	if (ctx == NULL || info == NULL
+			|| shd_sub_check(info, ctx->desc->blob_size) < 0) {
+		ULOGE("Invalid subscription");
+		return NULL;
+	}
+
+	sub = shd_sub_new(ctx, info);
+	if (sub == NULL)
+		ULOGE("Could not allocate subscription");
+
+	return sub;
+}
+
+int shd_sub_read(struct shd_sub *sub,
+			struct shd_quantity_sample samples[],
+			size_t max_samples)
+{
+	struct shd_ctx *ctx;
+	size_t i;
+	int ret;
+
+	if (sub == NULL || samples == NULL || max_samples == 0)
+		return -EINVAL;
+	for (i = 0; i < max_samples; i++) {
+		if (samples[i].ptr == NULL || samples[i].size
+				< sub->info.quantity.quantity.quantity_size)
+			return -EINVAL;
+	}
+
+	ctx = sub->ctx;
+	ret = check_reconnect(ctx, NULL);
+	if (ret < 0)
+		return ret;
+
+	ret = shd_sync_check_revision_nb(&ctx->sync_ctx->revision,
+					ctx->sect_mmap->sync_top);
+	if (ret < 0)
+		return ret;
+
+	/* The section may have been re-created with another blob format */
+	if (shd_sub_check(&sub->info, ctx->desc->blob_size) < 0)
+		return -ENODEV;
+
+	return shd_sub_scan(sub, samples, max_samples);
+}
+
+int shd_unsubscribe(struct shd_sub *sub)
+{
+	if (sub == NULL)
+		return -EINVAL;
+
+	shd_sub_destroy(sub);
+
+	return 0;
+}
+
+int shd_aggregate(struct shd_ctx *ctx,
+			const struct shd_sample_search *search,
+			const struct timespec *duration,
+			const struct shd_quantity_info *info,
+			struct shd_aggregate results[])
+{
+	struct shd_ctx *read_ctx;
+	int ret;
+
+	if (ctx == NULL || search == NULL || info == NULL || results == NULL
+			|| shd_aggregate_check(info, ctx->desc->blob_size) < 0
+			|| (duration != NULL
+				&& (search->nb_values_before_date > 0
+				|| search->nb_values_after_date > 0
+				|| duration->tv_sec < 0
+				|| duration->tv_nsec < 0
+				|| duration->tv_nsec >= 1000000000)))
+		return -EINVAL;
+
+	ret = check_reconnect(ctx, NULL);
+	if (ret < 0)
+		return ret;
+
+	/* The blobs of tier samples hold statistics of base blobs */
+	read_ctx = select_ctx(ctx, search);
+
+	return shd_data_aggregate(read_ctx, search, duration, info,
+			read_ctx != ctx ? ctx->desc->blob_size : 0, results);
+}
+
+int shd_read_filtered(struct shd_ctx *ctx,
+			const struct shd_sample_search *search,
+			const struct shd_predicate *pred,
+			const struct shd_quantity *quantity,
+			struct shd_quantity_sample samples[],
+			size_t max_samples)
+{
+	struct shd_ctx *read_ctx;
+	size_t i;
+	int ret;
+
+	if (ctx == NULL || search == NULL || pred == NULL || quantity == NULL
+			|| samples == NULL
+			|| shd_filter_check(pred, quantity,
+						ctx->desc->blob_size) < 0)
+		return -EINVAL;
+	for (i = 0; i < max_samples; i++) {
+		if (samples[i].ptr == NULL
+				|| samples[i].size < quantity->quantity_size)
+			return -EINVAL;
+	}
+
+	ret = check_reconnect(ctx, NULL);
+	if (ret < 0)
+		return ret;
+
+	/* Tier samples are filtered and copied through their mean */
+	read_ctx = select_ctx(ctx, search);
+
+	return shd_data_read_filtered(read_ctx, search, pred, quantity,
+			samples, max_samples);
+}
+
+/*
+ * End a reading sequence done in a downsampled tier of the section
+ */
+static int end_tier_read(struct shd_ctx *ctx, struct shd_ctx *tier_ctx,
+			struct shd_revision *tier_rev)
+{
+	int ret;
+
+	shd_tiers_end_read(ctx->tiers);
+
+	ret = shd_data_check_validity(tier_ctx, tier_rev);
+	if (ret == -ENODEV) {
+		/* The tiers have been re-created along with the section :
+		 * they are open again on the next search */
+		(void)shd_data_end_read(tier_ctx);
+		shd_tiers_destroy(ctx->tiers);
+		ctx->tiers = NULL;
+		ctx->tiers_open_tried = false;
+		return -EAGAIN;
+	} else if (ret < 0) {
+		return ret;
+	}
+
+	return shd_data_end_read(tier_ctx);
+}
+
 int shd_end_read(struct shd_ctx *ctx, struct shd_revision *rev)
 {
+	struct shd_ctx *tier_ctx = NULL;
+	struct shd_revision *tier_rev;
 	int ret = -ENOSYS;
 
 	if (ctx == NULL || rev == NULL) {
@@ -441,12 +1275,36 @@ int shd_end_read(struct shd_ctx *ctx, struct shd_revision *rev)
 		goto error;
 	}
 
+	if (ctx->tiers != NULL)
+		tier_ctx = shd_tiers_get_read(ctx->tiers, &tier_rev);
+	if (tier_ctx != NULL) {
+		ret = end_tier_read(ctx, tier_ctx, tier_rev);
+		if (ret < 0)
+			goto error;
+		return ret;
+	}
+
+	/* The context may have been remapped when the read started */
+	if (ctx->auto_reconnect)
+		rev->nb_creations = ctx->sync_ctx->revision.nb_creations;
+
 	ret = shd_data_check_validity(ctx, rev);
 	if (ret < 0) {
-		/* If data validity check indicates that section revision
-		 * number has changed, end read but return -ENODEV anyway */
-		if (ret == -ENODEV)
+		if (ctx->auto_reconnect && shd_sync_check_revision_nb(rev,
+					ctx->sect_mmap->sync_top) < 0) {
+			/* The section has been re-created during the read
+			 * (which may also have invalidated the samples) : the
+			 * data that was read is invalid, but the next read
+			 * will be done on the new section */
+			(void)shd_data_end_read(ctx);
+			(void)check_reconnect(ctx, rev);
+			ret = -EAGAIN;
+		} else if (ret == -ENODEV) {
+			/* If data validity check indicates that section
+			 * revision number has changed, end read but return
+			 * -ENODEV anyway */
 			(void)shd_data_end_read(ctx);
+		}
 		goto error;
 	}
 
@@ -462,6 +1320,30 @@ error:
 	return ret;
 }
 
+int shd_get_read_factor(struct shd_ctx *ctx)
+{
+	if (ctx == NULL)
+		return -EINVAL;
+
+	return shd_tiers_get_read_factor(ctx->tiers);
+}
+
+int shd_tier_quantity(struct shd_ctx *ctx,
+			const struct shd_quantity *quantity,
+			enum shd_tier_stat stat,
+			struct shd_quantity *out)
+{
+	if (ctx == NULL || quantity == NULL || out == NULL
+			|| stat < SHD_TIER_MEAN || stat > SHD_TIER_MAX)
+		return -EINVAL;
+
+	*out = *quantity;
+	if (get_read_ctx(ctx) != ctx)
+		out->quantity_offset += stat * ctx->desc->blob_size;
+
+	return 0;
+}
+
 int shd_read_section_hdr(struct shd_ctx *ctx,
 				struct shd_hdr_user_info *hdr_info,
 				struct shd_revision *rev)
@@ -473,11 +1355,16 @@ int shd_read_section_hdr(struct shd_ctx *ctx,
 		goto exit;
 	}
 
+	ret = check_reconnect(ctx, rev);
+	if (ret < 0)
+		goto exit;
+
 	ret = shd_sync_check_revision_nb(rev, ctx->sect_mmap->sync_top);
 	if (ret < 0)
 		goto exit;
 
-	ret = shd_hdr_read(&ctx->id, ctx->sect_mmap->section_top, hdr_info);
+	ret = shd_hdr_read(&ctx->id, ctx->sect_mmap->section_top, hdr_info,
+			NULL);
 
 exit:
 	if (ret < 0)
@@ -498,6 +1385,16 @@ int shd_read_blob_metadata_hdr(struct shd_ctx *ctx,
 		goto exit;
 	}
 
+	ret = check_reconnect(ctx, rev);
+	if (ret < 0)
+		goto exit;
+
+	/* The blob metadata header of a record section holds its records */
+	if (shd_hdr_has_record_ring(ctx->sect_mmap->section_top)) {
+		ret = -ENODATA;
+		goto exit;
+	}
+
 	if (size != shd_hdr_get_mdata_size(ctx->sect_mmap->header_top)) {
 		ret = -ENOMEM;
 		goto exit;
@@ -517,3 +1414,234 @@ exit:
 				ctx ? ctx->blob_name : "??", strerror(-ret));
 	return ret;
 }
+
+size_t shd_blob_schema_get_size(size_t user_mdata_size,
+				const struct shd_field_desc fields[],
+				size_t nb_fields)
+{
+	return shd_schema_get_size(user_mdata_size, fields, nb_fields);
+}
+
+int shd_blob_schema_write(void *blob_metadata_hdr, size_t size,
+				const void *user_mdata, size_t user_mdata_size,
+				const struct shd_field_desc fields[],
+				size_t nb_fields)
+{
+	return shd_schema_write(blob_metadata_hdr, size, user_mdata,
+				user_mdata_size, fields, nb_fields);
+}
+
+int shd_quantity_resolve(struct shd_ctx *ctx,
+				const char *name,
+				struct shd_quantity_info *info,
+				struct shd_revision *rev)
+{
+	int ret = -ENOSYS;
+
+	if (ctx == NULL || name == NULL || info == NULL || rev == NULL) {
+		ret = -EINVAL;
+		goto exit;
+	}
+
+	ret = check_reconnect(ctx, rev);
+	if (ret < 0)
+		goto exit;
+
+	ret = shd_sync_check_revision_nb(rev, ctx->sect_mmap->sync_top);
+	if (ret < 0)
+		goto exit;
+
+	if (shd_hdr_has_record_ring(ctx->sect_mmap->section_top)) {
+		ret = -ENODATA;
+		goto exit;
+	}
+
+	ret = shd_schema_resolve(ctx->sect_mmap->metadata_blob_top,
+			shd_hdr_get_mdata_size(ctx->sect_mmap->header_top),
+			ctx->desc->blob_size, name, info);
+
+exit:
+	if (ret < 0)
+		ULOGW("%s: Resolution of quantity \"%s\" ended with error : %s",
+				ctx ? ctx->blob_name : "??",
+				name ? name : "??", strerror(-ret));
+	return ret;
+}
+
+int shd_get_tracked_quantities(struct shd_ctx *ctx,
+				struct shd_quantity quantities[],
+				size_t max_quantities,
+				struct shd_revision *rev)
+{
+	int ret;
+
+	if (ctx == NULL || (quantities == NULL && max_quantities > 0)
+			|| rev == NULL)
+		return -EINVAL;
+
+	ret = check_reconnect(ctx, rev);
+	if (ret < 0)
+		return ret;
+
+	ret = shd_sync_check_revision_nb(rev, ctx->sect_mmap->sync_top);
+	if (ret < 0)
+		return ret;
+
+	if (ctx->sect_mmap->dirty_top == NULL)
+		return -ENODATA;
+
+	ret = shd_dirty_get_quantities(ctx->sect_mmap->dirty_top, quantities,
+			max_quantities);
+
+	/* The list is only valid if the section was not re-created while it
+	 * was copied */
+	if (shd_sync_check_revision_nb(rev, ctx->sect_mmap->sync_top) < 0)
+		return -ENODEV;
+
+	return ret;
+}
+
+struct shd_col_writer *shd_col_record_start(struct shd_ctx *ctx,
+					const char *path,
+					uint32_t chunk_rows,
+					struct shd_revision *rev)
+{
+	struct shd_col_writer *writer;
+
+	if (ctx == NULL || path == NULL || chunk_rows == 0 || rev == NULL) {
+		ULOGE("Invalid recording arguments");
+		return NULL;
+	}
+
+	if (check_reconnect(ctx, rev) < 0
+			|| shd_sync_check_revision_nb(rev,
+					ctx->sect_mmap->sync_top) < 0)
+		return NULL;
+
+	if (shd_hdr_has_record_ring(ctx->sect_mmap->section_top)) {
+		ULOGE("%s: Record sections have no blob schema",
+				ctx->blob_name);
+		return NULL;
+	}
+
+	writer = shd_col_writer_new(ctx, path,
+			ctx->sect_mmap->metadata_blob_top,
+			shd_hdr_get_mdata_size(ctx->sect_mmap->header_top),
+			ctx->desc->blob_size, ctx->desc->nb_samples,
+			chunk_rows);
+	if (writer == NULL)
+		ULOGE("%s: Could not start recording into \"%s\"",
+				ctx->blob_name, path);
+
+	return writer;
+}
+
+int shd_col_record(struct shd_col_writer *writer, struct shd_revision *rev)
+{
+	struct shd_sample_search search = {
+		.method = SHD_LATEST,
+	};
+	struct shd_ctx *ctx;
+	int ret;
+
+	if (writer == NULL || rev == NULL)
+		return -EINVAL;
+
+	ctx = writer->ctx;
+	ret = check_reconnect(ctx, rev);
+	if (ret < 0)
+		return ret;
+
+	/* The section may have been re-created with another blob format */
+	if (ctx->desc->blob_size != writer->blob_size
+			|| ctx->desc->nb_samples > writer->max_staged)
+		return -ENODEV;
+
+	/* Like SHD_OLDEST, the oldest slot is skipped since it may be being
+	 * overwritten */
+	if (ctx->desc->nb_samples > 1)
+		search.nb_values_before_date = ctx->desc->nb_samples - 2;
+
+	ret = shd_data_find(ctx, &search);
+	if (ret < 0)
+		return ret;
+
+	shd_col_writer_stage(writer, ctx->window, ctx->desc);
+
+	ret = shd_end_read(ctx, rev);
+	if (ret < 0) {
+		shd_col_writer_drop(writer);
+		return ret;
+	}
+
+	return shd_col_writer_commit(writer);
+}
+
+int shd_col_record_stop(struct shd_col_writer *writer)
+{
+	if (writer == NULL)
+		return -EINVAL;
+
+	return shd_col_writer_close(writer);
+}
+
+struct shd_col_file *shd_col_open(const char *path)
+{
+	if (path == NULL)
+		return NULL;
+
+	return shd_col_file_open(path);
+}
+
+int shd_col_close(struct shd_col_file *file)
+{
+	if (file == NULL)
+		return -EINVAL;
+
+	shd_col_file_close(file);
+
+	return 0;
+}
+
+int shd_col_find(const struct shd_col_file *file,
+			const char *name,
+			struct shd_quantity_info *info)
+{
+	if (file == NULL || name == NULL || info == NULL)
+		return -EINVAL;
+
+	return shd_col_file_find(file, name, info);
+}
+
+int shd_col_slice(const struct shd_col_file *file,
+			const struct timespec *start,
+			const struct timespec *end,
+			struct shd_col_slice slices[],
+			size_t max_slices)
+{
+	uint64_t start_ns = 0;
+	uint64_t end_ns = UINT64_MAX;
+
+	if (file == NULL || (slices == NULL && max_slices > 0)
+			|| (start != NULL && start->tv_sec < 0)
+			|| (end != NULL && end->tv_sec < 0))
+		return -EINVAL;
+
+	if (start != NULL)
+		time_timespec_to_ns(start, &start_ns);
+	if (end != NULL)
+		time_timespec_to_ns(end, &end_ns);
+
+	return shd_col_file_slice(file, start_ns, end_ns, slices, max_slices);
+}
+
+const void *shd_col_get(const struct shd_col_file *file,
+			const struct shd_col_slice *slice,
+			uint32_t column,
+			enum shd_field_type *type)
+{
+	if (file == NULL || slice == NULL)
+		return NULL;
+
+	return shd_col_file_get(file, slice, column, type);
+}
@@ -0,0 +1,264 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_aggregate.c
+ *
+ * @brief Reductions of a quantity over a window of samples.
+ *
+ * @details The window is scanned by shd_scan(), with a kernel specialized for
+ * the type of the elements. The elements of an array, which are contiguous in
+ * a slot, are reduced together, two per vector, and so are the extrema of the
+ * buckets of a tier : a window is read once for up to AGG_BLOCK elements.
+ *
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include "shd_private.h"
+#include "shd_sample.h"
+#include "shd_scan.h"
+#include "shd_schema.h"
+#include "shd_utils.h"
+#include "shd_aggregate.h"
+
+/* Number of elements reduced at once */
+#define AGG_BLOCK 16
+
+/* Vector of two doubles, which the compiler maps to SSE2 or NEON registers */
+typedef double agg_vec_t __attribute__((vector_size(2 * sizeof(double))));
+typedef int64_t agg_mask_t __attribute__((vector_size(2 * sizeof(double))));
+
+/* Accumulators of a block of elements, the element e being in lane e % 2 of
+ * vector e / 2 */
+struct agg_acc {
+	agg_vec_t sum[AGG_BLOCK / 2];
+	agg_vec_t sum_sq[AGG_BLOCK / 2];
+	agg_vec_t min[AGG_BLOCK / 2];
+	agg_vec_t max[AGG_BLOCK / 2];
+};
+
+/* Reduction in progress over the slots of a window, for a block of elements */
+struct agg_state {
+	struct agg_acc *acc;
+	/* number of elements of the block */
+	uint32_t count;
+	/* offset of the values whose minimum and maximum are computed,
+	 * relative to the reduced ones : 0, or the size of a statistic of the
+	 * buckets of a tier, followed by their maximums */
+	size_t extremum_offset;
+};
+
+static inline agg_vec_t agg_vec_select(agg_mask_t mask, agg_vec_t a,
+					agg_vec_t b)
+{
+	return (agg_vec_t)((mask & (agg_mask_t)a) | (~mask & (agg_mask_t)b));
+}
+
+/* Load the values of type _type at p0 and p1 into a vector */
+#define AGG_LOADER(_name, _type)					\
+static inline agg_vec_t _name##_load(const char *p0, const char *p1)	\
+{									\
+	_type v0, v1;							\
+									\
+	memcpy(&v0, p0, sizeof(v0));					\
+	memcpy(&v1, p1, sizeof(v1));					\
+	return (agg_vec_t){ v0, v1 };					\
+}
+
+/*
+ * Reduce the elements of type _type of the slots. An odd last element is
+ * loaded in both lanes of its vector.
+ */
+#define AGG_KERNEL(_name, _type)					\
+AGG_LOADER(_name, _type)						\
+									\
+static uint32_t _name(const char *p, size_t stride, uint32_t n,		\
+			uint32_t distance, const void *arg)		\
+{									\
+	const struct agg_state *st = arg;				\
+	struct agg_acc *acc = st->acc;					\
+	const size_t lo_offset = st->extremum_offset;			\
+	const size_t hi_offset = 2 * st->extremum_offset;		\
+	const uint32_t nb_vec = (st->count + 1) / 2;			\
+	size_t e;							\
+	agg_vec_t v, lo, hi;						\
+	const char *q;							\
+	uint32_t i, k;							\
+									\
+	for (i = 0; i < n; i++, p += stride) {				\
+		SHD_SCAN_PREFETCH(p, stride, distance);			\
+		for (k = 0; k < nb_vec; k++) {				\
+			q = p + 2 * k * sizeof(_type);			\
+			e = 2 * k + 1 < st->count ? sizeof(_type) : 0;	\
+			v = _name##_load(q, q + e);			\
+			lo = _name##_load(q + lo_offset,		\
+					q + lo_offset + e);		\
+			hi = _name##_load(q + hi_offset,		\
+					q + hi_offset + e);		\
+			acc->sum[k] += v;				\
+			acc->sum_sq[k] += v * v;			\
+			acc->min[k] = agg_vec_select(lo < acc->min[k],	\
+						lo, acc->min[k]);	\
+			acc->max[k] = agg_vec_select(hi > acc->max[k],	\
+						hi, acc->max[k]);	\
+		}							\
+	}								\
+									\
+	return n;							\
+}
+
+/*
+ * Reduce a single element of type _type, the accumulators being kept in
+ * registers : two independent chains are kept so that the loop is bound by
+ * the memory loads rather than by the latency of the additions.
+ */
+#define AGG_SCALAR_KERNEL(_name, _type)					\
+AGG_LOADER(_name, _type)						\
+									\
+static uint32_t _name(const char *p, size_t stride, uint32_t n,		\
+			uint32_t distance, const void *arg)		\
+{									\
+	const struct agg_state *st = arg;				\
+	struct agg_acc *acc = st->acc;					\
+	const size_t lo_offset = st->extremum_offset;			\
+	const size_t hi_offset = 2 * st->extremum_offset;		\
+	agg_vec_t v, lo, hi;						\
+	agg_vec_t sum = { 0, 0 }, sum_sq = { 0, 0 };			\
+	agg_vec_t vmin = { acc->min[0][0], acc->min[0][0] };		\
+	agg_vec_t vmax = { acc->max[0][0], acc->max[0][0] };		\
+	uint32_t i;							\
+									\
+	for (i = 0; i + 1 < n; i += 2, p += 2 * stride) {		\
+		SHD_SCAN_PREFETCH(p, stride, distance);			\
+		v = _name##_load(p, p + stride);			\
+		lo = _name##_load(p + lo_offset,			\
+				p + lo_offset + stride);		\
+		hi = _name##_load(p + hi_offset,			\
+				p + hi_offset + stride);		\
+		sum += v;						\
+		sum_sq += v * v;					\
+		vmin = agg_vec_select(lo < vmin, lo, vmin);		\
+		vmax = agg_vec_select(hi > vmax, hi, vmax);		\
+	}								\
+	if (i < n) {							\
+		v = _name##_load(p, p);					\
+		lo = _name##_load(p + lo_offset, p + lo_offset);	\
+		hi = _name##_load(p + hi_offset, p + hi_offset);	\
+		v[1] = 0;						\
+		sum += v;						\
+		sum_sq += v * v;					\
+		vmin = agg_vec_select(lo < vmin, lo, vmin);		\
+		vmax = agg_vec_select(hi > vmax, hi, vmax);		\
+	}								\
+									\
+	acc->sum[0][0] += sum[0] + sum[1];				\
+	acc->sum_sq[0][0] += sum_sq[0] + sum_sq[1];			\
+	acc->min[0][0] = vmin[0] < vmin[1] ? vmin[0] : vmin[1];		\
+	acc->max[0][0] = vmax[0] > vmax[1] ? vmax[0] : vmax[1];		\
+									\
+	return n;							\
+}
+
+SHD_SCAN_NUMERIC_KERNELS(AGG_KERNEL, agg)
+SHD_SCAN_NUMERIC_KERNELS(AGG_SCALAR_KERNEL, agg_scalar)
+
+static const shd_scan_kernel_t s_kernels[SHD_SCAN_NB_TYPES] = {
+	SHD_SCAN_NUMERIC_TABLE(agg)
+};
+
+static const shd_scan_kernel_t s_scalar_kernels[SHD_SCAN_NB_TYPES] = {
+	SHD_SCAN_NUMERIC_TABLE(agg_scalar)
+};
+
+/* Kernel reducing blocks of count elements of the given type */
+static shd_scan_kernel_t get_kernel(enum shd_field_type type, uint32_t count)
+{
+	return shd_scan_get_kernel(count == 1 ? s_scalar_kernels : s_kernels,
+					type);
+}
+
+int shd_aggregate_check(const struct shd_quantity_info *info,
+			size_t blob_size)
+{
+	size_t type_size = shd_schema_get_type_size(info->type);
+
+	if (get_kernel(info->type, info->count) == NULL || info->count == 0
+			|| info->quantity.quantity_size
+				!= type_size * info->count
+			|| info->quantity.quantity_offset < 0
+			|| (size_t) info->quantity.quantity_offset > blob_size
+			|| info->quantity.quantity_size
+				> blob_size - info->quantity.quantity_offset)
+		return -EINVAL;
+
+	return 0;
+}
+
+int shd_aggregate_window(const struct shd_window *window,
+			const struct shd_data_section_desc *desc,
+			const struct shd_quantity_info *info,
+			size_t stat_size,
+			struct shd_aggregate results[])
+{
+	shd_scan_kernel_t kernel = get_kernel(info->type, info->count);
+	size_t type_size = shd_schema_get_type_size(info->type);
+	uint32_t nb = window->nb_matches;
+	struct agg_acc acc;
+	/* The extrema of the buckets of a tier, rather than those of their
+	 * means */
+	struct agg_state st = {
+		.acc = &acc,
+		.extremum_offset = stat_size,
+	};
+	uint32_t block, e, k;
+
+	for (block = 0; block < info->count; block += AGG_BLOCK) {
+		st.count = min(info->count - block, AGG_BLOCK);
+		for (k = 0; k < AGG_BLOCK / 2; k++) {
+			acc.sum[k] = (agg_vec_t){ 0, 0 };
+			acc.sum_sq[k] = (agg_vec_t){ 0, 0 };
+			acc.min[k] = (agg_vec_t){ INFINITY, INFINITY };
+			acc.max[k] = (agg_vec_t){ -INFINITY, -INFINITY };
+		}
+
+		shd_scan(desc, window->start_idx, 0, nb,
+				info->quantity.quantity_offset
+					+ block * type_size,
+				kernel, &st);
+
+		for (e = 0; e < st.count; e++) {
+			k = e / 2;
+			results[block + e].min = acc.min[k][e % 2];
+			results[block + e].max = acc.max[k][e % 2];
+			results[block + e].mean = acc.sum[k][e % 2] / nb;
+			results[block + e].rms =
+					sqrt(acc.sum_sq[k][e % 2] / nb);
+		}
+	}
+
+	return nb;
+}
@@ -0,0 +1,86 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_aggregate.h
+ *
+ * @brief Reductions of a quantity over a window of samples.
+ *
+ * @details Values are reduced in place, in the mapped slots : like any read
+ * of the section, the result is only valid if the read session ends
+ * successfully.
+ *
+ */
+
+#ifndef _SHD_AGGREGATE_H_
+#define _SHD_AGGREGATE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "shd_data.h"
+#include "shd_window.h"
+#include "libshdata.h"
+
+/*
+ * @brief Check whether a quantity can be aggregated
+ *
+ * @param[in] info : quantity, with the type and number of its elements
+ * @param[in] blob_size : size of a blob
+ *
+ * @return : 0 if the quantity is made of numeric elements within the blob,
+ *           -EINVAL otherwise
+ */
+int shd_aggregate_check(const struct shd_quantity_info *info,
+			size_t blob_size);
+
+/*
+ * @brief Compute the minimum, maximum, mean and RMS of each element of a
+ * quantity over a window of samples
+ *
+ * @param[in] window : window of samples, not empty
+ * @param[in] desc : description of the data section
+ * @param[in] info : quantity, previously checked with shd_aggregate_check()
+ * @param[in] stat_size : for a downsampled tier, size of each statistic in
+ * its blobs, where the means are followed by the minimums and maximums ; 0
+ * for other sections
+ * @param[out] results : one result per element of the quantity
+ *
+ * @return : number of samples aggregated
+ */
+int shd_aggregate_window(const struct shd_window *window,
+			const struct shd_data_section_desc *desc,
+			const struct shd_quantity_info *info,
+			size_t stat_size,
+			struct shd_aggregate results[]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SHD_AGGREGATE_H_ */
@@ -0,0 +1,645 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_col.c
+ *
+ * @brief Columnar recordings of a section.
+ *
+ * @details Layout of a recording, in which every part starts on an 8-byte
+ * boundary so that the columns can be used in place once m'mapped :
+ *    - file header
+ *    - chunks : timestamps of the rows (in nanoseconds), then the values of
+ * each column, in the order of the columns
+ *    - blob metadata header of the section, which holds its blob schema
+ *    - column table
+ *    - chunk table, in the order of the timestamps
+ *    - trailer, which locates the footer made of the three parts above
+ *
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>		/* For O_* constants */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>		/* For mmap */
+#include <sys/stat.h>		/* For fstat */
+#include "futils/timetools.h"
+#include "shd_private.h"
+#include "shd_sample.h"
+#include "shd_sync.h"
+#include "shd_utils.h"
+#include "shd_col.h"
+
+#define SHD_COL_MAGIC		0x73686463	/* "shdc" */
+#define SHD_COL_VERSION		1
+#define COL_ALIGN		8
+
+/* Only fixed-size fields, so that recordings can be shared by 32-bit and
+ * 64-bit processes */
+struct shd_col_hdr {
+	uint32_t magic;
+	uint32_t version;
+};
+
+struct shd_col_column {
+	/* offset of the element from start of blob */
+	uint32_t offset;
+	/* type of the element */
+	uint32_t type;
+};
+
+struct shd_col_chunk {
+	/* timestamps of the first and last rows, in nanoseconds */
+	uint64_t first_ns;
+	uint64_t last_ns;
+	/* offset of the chunk from start of file */
+	uint64_t offset;
+	/* number of rows of the chunk */
+	uint32_t nb_rows;
+	uint32_t reserved;
+};
+
+struct shd_col_trailer {
+	/* offsets of the parts of the footer from start of file */
+	uint64_t mdata_offset;
+	uint64_t columns_offset;
+	uint64_t chunks_offset;
+	uint32_t mdata_size;
+	uint32_t blob_size;
+	uint32_t nb_columns;
+	uint32_t nb_chunks;
+	uint32_t version;
+	uint32_t magic;
+};
+
+struct shd_col_file {
+	/* m'mapped file */
+	void *map;
+	size_t size;
+	const struct shd_col_trailer *trailer;
+	const struct shd_col_column *columns;
+	const struct shd_col_chunk *chunks;
+	const void *mdata;
+};
+
+static uint64_t get_column_size(enum shd_field_type type, uint32_t nb_rows)
+{
+	return ALIGN((uint64_t)shd_schema_get_type_size(type) * nb_rows,
+			COL_ALIGN);
+}
+
+static int write_all(int fd, const void *buf, size_t size)
+{
+	const char *p = buf;
+	ssize_t ret;
+
+	while (size > 0) {
+		ret = write(fd, p, size);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		p += ret;
+		size -= ret;
+	}
+
+	return 0;
+}
+
+/*
+ * Write a part of the file, padded up to the next 8-byte boundary
+ */
+static int write_part(struct shd_col_writer *writer, const void *buf,
+			size_t size)
+{
+	static const char zeros[COL_ALIGN];
+	size_t pad = ALIGN(size, COL_ALIGN) - size;
+	int ret;
+
+	ret = write_all(writer->fd, buf, size);
+	if (ret == 0)
+		ret = write_all(writer->fd, zeros, pad);
+	if (ret < 0) {
+		ULOGE("Could not write recording : %s", strerror(-ret));
+		return ret;
+	}
+
+	writer->offset += size + pad;
+
+	return 0;
+}
+
+struct shd_col_writer *shd_col_writer_new(struct shd_ctx *ctx,
+				const char *path,
+				const void *mdata, size_t mdata_size,
+				size_t blob_size, uint32_t nb_samples,
+				uint32_t chunk_rows)
+{
+	const struct shd_col_hdr hdr = {
+		.magic = SHD_COL_MAGIC,
+		.version = SHD_COL_VERSION,
+	};
+	struct shd_col_writer *writer;
+	size_t offset;
+	uint32_t i;
+	int ret;
+
+	writer = calloc(1, sizeof(*writer));
+	if (writer == NULL)
+		return NULL;
+	writer->ctx = ctx;
+	writer->fd = -1;
+	writer->blob_size = blob_size;
+	writer->chunk_rows = chunk_rows;
+	writer->max_staged = nb_samples;
+
+	/* Columns are the numeric elements described by the schema */
+	ret = shd_schema_get_numeric(mdata, mdata_size, blob_size, NULL, 0);
+	if (ret <= 0) {
+		ULOGE("Section has no numeric field to record");
+		goto error;
+	}
+	writer->nb_columns = ret;
+	writer->elems = calloc(writer->nb_columns, sizeof(*writer->elems));
+	writer->column_offsets = calloc(writer->nb_columns,
+			sizeof(*writer->column_offsets));
+	writer->mdata = malloc(mdata_size);
+	if (writer->elems == NULL || writer->column_offsets == NULL
+			|| writer->mdata == NULL)
+		goto error;
+	shd_schema_get_numeric(mdata, mdata_size, blob_size, writer->elems,
+			writer->nb_columns);
+	memcpy(writer->mdata, mdata, mdata_size);
+	writer->mdata_size = mdata_size;
+
+	offset = (size_t) chunk_rows * sizeof(uint64_t);
+	for (i = 0; i < writer->nb_columns; i++) {
+		writer->column_offsets[i] = offset;
+		offset += get_column_size(writer->elems[i].type, chunk_rows);
+	}
+	writer->chunk = malloc(offset);
+	writer->staged = malloc((size_t) nb_samples * blob_size);
+	writer->staged_ns = calloc(nb_samples, sizeof(*writer->staged_ns));
+	if (writer->chunk == NULL || writer->staged == NULL
+			|| writer->staged_ns == NULL)
+		goto error;
+
+	writer->fd = open(path, O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC,
+			0644);
+	if (writer->fd < 0) {
+		ULOGE("Could not open recording \"%s\" : %s", path,
+				strerror(errno));
+		goto error;
+	}
+
+	if (write_part(writer, &hdr, sizeof(hdr)) < 0)
+		goto error;
+
+	return writer;
+
+error:
+	if (writer->fd >= 0)
+		close(writer->fd);
+	free(writer->staged_ns);
+	free(writer->staged);
+	free(writer->chunk);
+	free(writer->mdata);
+	free(writer->column_offsets);
+	free(writer->elems);
+	free(writer);
+	return NULL;
+}
+
+int shd_col_writer_stage(struct shd_col_writer *writer,
+				const struct shd_window *window,
+				const struct shd_data_section_desc *desc)
+{
+	struct shd_sample *samp;
+	uint32_t nb = window->nb_matches;
+	uint32_t m, i;
+	uint64_t ts_ns = 0;
+	int index;
+
+	/* Only the samples after the last recorded row are new : they are
+	 * at the end of the window, which starts with slots which were never
+	 * written if the section has not wrapped yet */
+	for (m = 0; m < nb && m < writer->max_staged; m++) {
+		samp = shd_data_get_sample_ptr(desc, index_n_after(
+				window->start_idx, nb - 1 - m, desc));
+		if (!shd_sync_is_sample_valid(&samp->sync))
+			break;
+		time_timespec_to_ns(&samp->metadata.ts, &ts_ns);
+		if (writer->has_last && ts_ns <= writer->last_ns)
+			break;
+	}
+
+	index = index_n_after(window->start_idx, nb - m, desc);
+	for (i = 0; i < m; i++, index = index_next(index, desc)) {
+		samp = shd_data_get_sample_ptr(desc, index);
+		shd_sample_read(samp, offsetof(struct shd_sample, blob),
+				writer->staged + (size_t) i * writer->blob_size,
+				writer->blob_size);
+		time_timespec_to_ns(&samp->metadata.ts, &writer->staged_ns[i]);
+	}
+	writer->nb_staged = m;
+
+	return m;
+}
+
+void shd_col_writer_drop(struct shd_col_writer *writer)
+{
+	writer->nb_staged = 0;
+}
+
+static int flush_chunk(struct shd_col_writer *writer)
+{
+	const uint64_t *ts_ns = (const uint64_t *)writer->chunk;
+	struct shd_col_chunk *chunk;
+	void *chunks;
+	uint32_t max;
+	uint32_t i;
+	int ret;
+
+	if (writer->nb_chunks == writer->max_chunks) {
+		max = writer->max_chunks ? 2 * writer->max_chunks : 16;
+		chunks = realloc(writer->chunks, max * sizeof(*chunk));
+		if (chunks == NULL)
+			return -ENOMEM;
+		writer->chunks = chunks;
+		writer->max_chunks = max;
+	}
+
+	chunk = &writer->chunks[writer->nb_chunks];
+	chunk->first_ns = ts_ns[0];
+	chunk->last_ns = ts_ns[writer->nb_rows - 1];
+	chunk->offset = writer->offset;
+	chunk->nb_rows = writer->nb_rows;
+	chunk->reserved = 0;
+
+	ret = write_part(writer, writer->chunk,
+			writer->nb_rows * sizeof(uint64_t));
+	for (i = 0; ret == 0 && i < writer->nb_columns; i++)
+		ret = write_part(writer,
+				writer->chunk + writer->column_offsets[i],
+				shd_schema_get_type_size(writer->elems[i].type)
+					* writer->nb_rows);
+	if (ret < 0)
+		return ret;
+
+	writer->nb_chunks++;
+	writer->nb_rows = 0;
+
+	return 0;
+}
+
+int shd_col_writer_commit(struct shd_col_writer *writer)
+{
+	const struct shd_schema_elem *elem;
+	const char *blob;
+	uint64_t *ts_ns = (uint64_t *)writer->chunk;
+	size_t size;
+	uint32_t r, i;
+	int ret;
+
+	for (r = 0; r < writer->nb_staged; r++) {
+		blob = writer->staged + (size_t) r * writer->blob_size;
+		ts_ns[writer->nb_rows] = writer->staged_ns[r];
+		for (i = 0; i < writer->nb_columns; i++) {
+			elem = &writer->elems[i];
+			size = shd_schema_get_type_size(elem->type);
+			memcpy(writer->chunk + writer->column_offsets[i]
+					+ writer->nb_rows * size,
+				blob + elem->offset, size);
+		}
+		writer->nb_rows++;
+		writer->last_ns = writer->staged_ns[r];
+		writer->has_last = true;
+
+		if (writer->nb_rows == writer->chunk_rows) {
+			ret = flush_chunk(writer);
+			if (ret < 0) {
+				writer->nb_staged = 0;
+				return ret;
+			}
+		}
+	}
+
+	ret = writer->nb_staged;
+	writer->nb_staged = 0;
+
+	return ret;
+}
+
+int shd_col_writer_close(struct shd_col_writer *writer)
+{
+	struct shd_col_trailer trailer = {
+		.mdata_size = writer->mdata_size,
+		.blob_size = writer->blob_size,
+		.nb_columns = writer->nb_columns,
+		.version = SHD_COL_VERSION,
+		.magic = SHD_COL_MAGIC,
+	};
+	struct shd_col_column column;
+	uint32_t i;
+	int ret = 0;
+
+	if (writer->nb_rows > 0)
+		ret = flush_chunk(writer);
+	trailer.nb_chunks = writer->nb_chunks;
+
+	if (ret == 0) {
+		trailer.mdata_offset = writer->offset;
+		ret = write_part(writer, writer->mdata, writer->mdata_size);
+	}
+	if (ret == 0)
+		trailer.columns_offset = writer->offset;
+	for (i = 0; ret == 0 && i < writer->nb_columns; i++) {
+		column.offset = writer->elems[i].offset;
+		column.type = writer->elems[i].type;
+		ret = write_part(writer, &column, sizeof(column));
+	}
+	if (ret == 0) {
+		trailer.chunks_offset = writer->offset;
+		ret = write_part(writer, writer->chunks,
+				writer->nb_chunks * sizeof(*writer->chunks));
+	}
+	if (ret == 0)
+		ret = write_part(writer, &trailer, sizeof(trailer));
+
+	if (close(writer->fd) < 0 && ret == 0)
+		ret = -errno;
+	free(writer->chunks);
+	free(writer->staged_ns);
+	free(writer->staged);
+	free(writer->chunk);
+	free(writer->mdata);
+	free(writer->column_offsets);
+	free(writer->elems);
+	free(writer);
+
+	return ret;
+}
+
+/* Size of a chunk, and offsets of its columns */
+static uint64_t get_chunk_size(const struct shd_col_file *file,
+				uint32_t nb_rows, uint32_t column)
+{
+	uint64_t size = (uint64_t)nb_rows * sizeof(uint64_t);
+	uint32_t i;
+
+	for (i = 0; i < column; i++)
+		size += get_column_size(file->columns[i].type, nb_rows);
+
+	return size;
+}
+
+static bool file_is_valid(const struct shd_col_file *file)
+{
+	const struct shd_col_hdr *hdr = file->map;
+	const struct shd_col_trailer *trailer = file->trailer;
+	const struct shd_col_chunk *chunk;
+	uint64_t end;
+	size_t type_size;
+	uint32_t i;
+
+	if (hdr->magic != SHD_COL_MAGIC || hdr->version != SHD_COL_VERSION
+			|| trailer->magic != SHD_COL_MAGIC
+			|| trailer->version != SHD_COL_VERSION)
+		return false;
+
+	/* The footer is made of the metadata, column and chunk tables, in
+	 * that order, right before the trailer */
+	end = (const char *)trailer - (const char *)file->map;
+	if (trailer->mdata_offset < sizeof(*hdr)
+			|| trailer->mdata_offset % COL_ALIGN != 0
+			|| trailer->columns_offset < trailer->mdata_offset
+				+ trailer->mdata_size
+			|| trailer->columns_offset % COL_ALIGN != 0
+			|| trailer->chunks_offset < trailer->columns_offset
+				+ (uint64_t)trailer->nb_columns
+					* sizeof(*file->columns)
+			|| trailer->chunks_offset > end
+			|| trailer->chunks_offset % COL_ALIGN != 0
+			|| (end - trailer->chunks_offset) / sizeof(*file->chunks)
+				< trailer->nb_chunks)
+		return false;
+
+	for (i = 0; i < trailer->nb_columns; i++) {
+		type_size = shd_schema_get_type_size(file->columns[i].type);
+		if (type_size == 0 || type_size > trailer->blob_size
+				|| file->columns[i].offset
+					> trailer->blob_size - type_size)
+			return false;
+	}
+
+	for (i = 0; i < trailer->nb_chunks; i++) {
+		chunk = &file->chunks[i];
+		if (chunk->offset < sizeof(*hdr)
+				|| chunk->offset % COL_ALIGN != 0
+				|| chunk->offset > trailer->mdata_offset
+				|| get_chunk_size(file, chunk->nb_rows,
+						trailer->nb_columns)
+					> trailer->mdata_offset - chunk->offset)
+			return false;
+	}
+
+	return true;
+}
+
+struct shd_col_file *shd_col_file_open(const char *path)
+{
+	struct shd_col_file *file;
+	struct stat st;
+	int fd;
+
+	file = calloc(1, sizeof(*file));
+	if (file == NULL)
+		return NULL;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		ULOGE("Could not open recording \"%s\" : %s", path,
+				strerror(errno));
+		goto error;
+	}
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size
+			< sizeof(struct shd_col_hdr)
+				+ sizeof(struct shd_col_trailer)
+			|| st.st_size % COL_ALIGN != 0) {
+		ULOGE("Invalid recording \"%s\"", path);
+		close(fd);
+		goto error;
+	}
+
+	file->size = st.st_size;
+	file->map = mmap(NULL, file->size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (file->map == MAP_FAILED) {
+		ULOGE("Could not map recording \"%s\" : %s", path,
+				strerror(errno));
+		goto error;
+	}
+
+	file->trailer = (const struct shd_col_trailer *)((const char *)
+			file->map + file->size - sizeof(*file->trailer));
+	file->columns = (const struct shd_col_column *)((const char *)
+			file->map + file->trailer->columns_offset);
+	file->chunks = (const struct shd_col_chunk *)((const char *)
+			file->map + file->trailer->chunks_offset);
+	file->mdata = (const char *)file->map + file->trailer->mdata_offset;
+	if (!file_is_valid(file)) {
+		ULOGE("Invalid recording \"%s\"", path);
+		munmap(file->map, file->size);
+		goto error;
+	}
+
+	return file;
+
+error:
+	free(file);
+	return NULL;
+}
+
+void shd_col_file_close(struct shd_col_file *file)
+{
+	munmap(file->map, file->size);
+	free(file);
+}
+
+int shd_col_file_find(const struct shd_col_file *file, const char *name,
+			struct shd_quantity_info *info)
+{
+	uint32_t i;
+	int ret;
+
+	ret = shd_schema_resolve(file->mdata, file->trailer->mdata_size,
+			file->trailer->blob_size, name, info);
+	if (ret < 0)
+		return ret == -ENODATA ? -EPROTO : ret;
+
+	/* Elements of an array are recorded in consecutive columns */
+	for (i = 0; i < file->trailer->nb_columns; i++) {
+		if (file->columns[i].offset == info->quantity.quantity_offset
+				&& file->columns[i].type == info->type)
+			return i;
+	}
+
+	return -ENOENT;
+}
+
+static const uint64_t *get_ts(const struct shd_col_file *file,
+				const struct shd_col_chunk *chunk)
+{
+	return (const uint64_t *)((const char *)file->map + chunk->offset);
+}
+
+/* Index of the first row of a chunk whose timestamp is not before ts_ns */
+static uint32_t lower_bound(const uint64_t *ts, uint32_t nb, uint64_t ts_ns)
+{
+	uint32_t lo = 0, hi = nb, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (ts[mid] < ts_ns)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+int shd_col_file_slice(const struct shd_col_file *file, uint64_t start_ns,
+			uint64_t end_ns, struct shd_col_slice slices[],
+			size_t max_slices)
+{
+	const struct shd_col_chunk *chunk;
+	const uint64_t *ts;
+	uint32_t lo = 0, hi = file->trailer->nb_chunks, mid;
+	uint32_t first, last;
+	size_t nb = 0;
+
+	/* First chunk which ends within the range */
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (file->chunks[mid].last_ns < start_ns)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (; lo < file->trailer->nb_chunks; lo++) {
+		chunk = &file->chunks[lo];
+		if (chunk->first_ns > end_ns)
+			break;
+
+		ts = get_ts(file, chunk);
+		first = lower_bound(ts, chunk->nb_rows, start_ns);
+		last = end_ns == UINT64_MAX ? chunk->nb_rows
+				: lower_bound(ts, chunk->nb_rows, end_ns + 1);
+		if (first >= last)
+			continue;
+
+		if (nb < max_slices) {
+			slices[nb].ts_ns = ts + first;
+			slices[nb].nb_rows = last - first;
+			slices[nb].chunk = lo;
+			slices[nb].first_row = first;
+		}
+		nb++;
+	}
+
+	return nb;
+}
+
+const void *shd_col_file_get(const struct shd_col_file *file,
+				const struct shd_col_slice *slice,
+				uint32_t column,
+				enum shd_field_type *type)
+{
+	const struct shd_col_chunk *chunk;
+
+	if (column >= file->trailer->nb_columns
+			|| slice->chunk >= file->trailer->nb_chunks)
+		return NULL;
+
+	chunk = &file->chunks[slice->chunk];
+	if (slice->first_row > chunk->nb_rows
+			|| slice->nb_rows > chunk->nb_rows - slice->first_row)
+		return NULL;
+
+	if (type != NULL)
+		*type = file->columns[column].type;
+
+	return (const char *)file->map + chunk->offset
+			+ get_chunk_size(file, chunk->nb_rows, column)
+			+ (size_t) slice->first_row
+				* shd_schema_get_type_size(
+					file->columns[column].type);
+}
@@ -0,0 +1,233 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_col.h
+ *
+ * @brief Columnar recordings of a section.
+ *
+ * @details A recording holds the numeric elements described by the blob
+ * schema of a section, each in a column of its own, along with a column of
+ * timestamps. Rows are grouped in chunks : each chunk holds the timestamps of
+ * its rows, then each column, stored contiguously. A footer at the end of the
+ * file indexes the chunks by timestamp, so that a recording is read by
+ * m'mapping it, without parsing nor copying its contents.
+ *
+ */
+
+#ifndef _SHD_COL_H_
+#define _SHD_COL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "shd_ctx.h"
+#include "shd_data.h"
+#include "shd_schema.h"
+#include "shd_window.h"
+#include "libshdata.h"
+
+struct shd_col_chunk;
+struct shd_col_file;
+
+/*
+ * @brief Writer of a recording
+ */
+struct shd_col_writer {
+	/* consumer context of the recorded section */
+	struct shd_ctx *ctx;
+	/* file of the recording */
+	int fd;
+	/* size of the file written so far */
+	uint64_t offset;
+	/* blob metadata header of the section, which holds its schema */
+	void *mdata;
+	size_t mdata_size;
+	size_t blob_size;
+	/* numeric elements of the blob, one per column */
+	struct shd_schema_elem *elems;
+	uint32_t nb_columns;
+	/* chunk being filled : timestamps, then each column, laid out for
+	 * chunk_rows rows */
+	char *chunk;
+	size_t *column_offsets;
+	uint32_t chunk_rows;
+	uint32_t nb_rows;
+	/* index of the chunks written so far */
+	struct shd_col_chunk *chunks;
+	uint32_t nb_chunks;
+	uint32_t max_chunks;
+	/* samples copied out of the section, waiting for their read session
+	 * to be checked */
+	char *staged;
+	uint64_t *staged_ns;
+	uint32_t nb_staged;
+	uint32_t max_staged;
+	/* timestamp of the last recorded row, in nanoseconds */
+	uint64_t last_ns;
+	bool has_last;
+};
+
+/*
+ * @brief Create a new recording
+ *
+ * @param[in] ctx : consumer context of the recorded section
+ * @param[in] path : path of the file of the recording, which is truncated if
+ * it exists
+ * @param[in] mdata : blob metadata header of the section, which holds its
+ * blob schema
+ * @param[in] mdata_size : size of the blob metadata header
+ * @param[in] blob_size : size of a blob
+ * @param[in] nb_samples : number of samples of the section
+ * @param[in] chunk_rows : number of rows of a chunk
+ *
+ * @return : an allocated recording writer,
+ *           NULL in case of error
+ */
+struct shd_col_writer *shd_col_writer_new(struct shd_ctx *ctx,
+				const char *path,
+				const void *mdata, size_t mdata_size,
+				size_t blob_size, uint32_t nb_samples,
+				uint32_t chunk_rows);
+
+/*
+ * @brief Copy the samples of a window which are more recent than the last
+ * recorded row
+ *
+ * The copied samples are only recorded by shd_col_writer_commit(), once the
+ * read session of the window has been checked.
+ *
+ * @param[in,out] writer : recording writer
+ * @param[in] window : window of samples, in the order of their timestamps
+ * @param[in] desc : description of the data section
+ *
+ * @return : number of copied samples
+ */
+int shd_col_writer_stage(struct shd_col_writer *writer,
+				const struct shd_window *window,
+				const struct shd_data_section_desc *desc);
+
+/*
+ * @brief Discard the samples copied by shd_col_writer_stage()
+ *
+ * @param[in,out] writer : recording writer
+ */
+void shd_col_writer_drop(struct shd_col_writer *writer);
+
+/*
+ * @brief Record the samples copied by shd_col_writer_stage(), writing the
+ * chunks which are full to the file
+ *
+ * @param[in,out] writer : recording writer
+ *
+ * @return : number of recorded rows,
+ *           -errno if a chunk could not be written
+ */
+int shd_col_writer_commit(struct shd_col_writer *writer);
+
+/*
+ * @brief Write the last chunk and the footer of a recording, and destroy its
+ * writer
+ *
+ * @param[in] writer : recording writer
+ *
+ * @return : 0 in case of success,
+ *           -errno if the file could not be written
+ */
+int shd_col_writer_close(struct shd_col_writer *writer);
+
+/*
+ * @brief Map a recording
+ *
+ * @param[in] path : path of the file of the recording
+ *
+ * @return : an allocated recording,
+ *           NULL in case of error
+ */
+struct shd_col_file *shd_col_file_open(const char *path);
+
+/*
+ * @brief Unmap a recording
+ *
+ * @param[in] file : recording to unmap
+ */
+void shd_col_file_close(struct shd_col_file *file);
+
+/*
+ * @brief Find the columns of a quantity of a recording
+ *
+ * @param[in] file : recording
+ * @param[in] name : name of the quantity in the blob schema
+ * @param[out] info : resolved quantity
+ *
+ * @return : index of the column of the first element of the quantity,
+ *           -ENOENT if no numeric field matches name,
+ *           -EPROTO if the blob schema of the recording is invalid
+ */
+int shd_col_file_find(const struct shd_col_file *file, const char *name,
+			struct shd_quantity_info *info);
+
+/*
+ * @brief Get the slices of the chunks of a recording which hold the rows of
+ * a time range
+ *
+ * @param[in] file : recording
+ * @param[in] start_ns : start of the time range, in nanoseconds
+ * @param[in] end_ns : end of the time range, in nanoseconds
+ * @param[out] slices : destination array
+ * @param[in] max_slices : number of elements of slices
+ *
+ * @return : number of slices, which may be greater than max_slices, in which
+ * case only the first ones are filled
+ */
+int shd_col_file_slice(const struct shd_col_file *file, uint64_t start_ns,
+			uint64_t end_ns, struct shd_col_slice slices[],
+			size_t max_slices);
+
+/*
+ * @brief Get the values of a column in a slice
+ *
+ * @param[in] file : recording
+ * @param[in] slice : slice returned by shd_col_file_slice()
+ * @param[in] column : index of the column
+ * @param[out] type : type of the values of the column
+ *
+ * @return : pointer to the value of the first row of the slice,
+ *           NULL if column is out of range
+ */
+const void *shd_col_file_get(const struct shd_col_file *file,
+				const struct shd_col_slice *slice,
+				uint32_t column,
+				enum shd_field_type *type);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SHD_COL_H_ */
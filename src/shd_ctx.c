@@ -40,12 +40,14 @@
 #include "shd_ctx.h"
 #include "shd_window.h"
 #include "shd_sync.h"
+#include "shd_tier.h"
 #include "libshdata.h"
 
 struct shd_ctx *shd_ctx_new(struct shd_section_id *id, const char *blob_name)
 {
 	struct shd_ctx *ctx;
 	const char *env_search_method;
+	const char *env_prefetch;
 
 	/* Allocate context structure */
 	ctx = calloc(1, sizeof(*ctx));
@@ -54,6 +56,7 @@ struct shd_ctx *shd_ctx_new(struct shd_section_id *id, const char *blob_name)
 
 	ctx->blob_name = strdup(blob_name);
 	ctx->id = *id;
+	ctx->registered_rev = -1;
 	ctx->sync_ctx = shd_sync_ctx_new(id);
 	if (ctx->sync_ctx == NULL)
 		goto error;
@@ -78,6 +81,10 @@ struct shd_ctx *shd_ctx_new(struct shd_section_id *id, const char *blob_name)
 			ctx->hint = SHD_WINDOW_REF_SEARCH_NAIVE;
 	}
 
+	/* Software prefetching is enabled unless explicitly disabled */
+	env_prefetch = getenv("LIBSHDATA_CONFIG_INTERNAL_PREFETCH");
+	ctx->prefetch = env_prefetch == NULL || strcmp(env_prefetch, "OFF");
+
 	return ctx;
 
 error:
@@ -90,12 +97,14 @@ error:
 }
 
 int shd_ctx_mmap(struct shd_ctx *ctx,
-			const struct shd_hdr_user_info *hdr_info)
+			const struct shd_hdr_user_info *hdr_info,
+			bool dirty_map)
 {
 	if (ctx == NULL)
 		return -EINVAL;
 
-	ctx->sect_mmap = shd_section_mapping_new(&ctx->id, hdr_info);
+	ctx->sect_mmap = shd_section_mapping_new(&ctx->id, hdr_info,
+						dirty_map);
 	if (ctx->sect_mmap == NULL)
 		return -EFAULT;
 	ctx->desc = shd_data_section_desc_new(ctx, hdr_info);
@@ -114,6 +123,7 @@ int shd_ctx_destroy(struct shd_ctx *ctx)
 		free(ctx->blob_name);
 		free(ctx->desc);
 		shd_window_destroy(ctx->window);
+		shd_tiers_destroy(ctx->tiers);
 		free(ctx);
 	}
 
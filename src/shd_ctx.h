@@ -37,7 +37,9 @@ extern "C" {
 #endif
 
 #include <stddef.h>
+#include <stdint.h>
 #include "shd_section.h"
+#include "shd_rate.h"
 #include "libshdata.h"
 
 struct shd_ctx {
@@ -55,8 +57,34 @@ struct shd_ctx {
 	struct shd_window *window;
 	/* Favored method of search, setup by environment variable */
 	enum shd_ref_sample_search_hint hint;
+	/* Whether slots are prefetched when stepping through large samples,
+	 * setup by environment variable */
+	bool prefetch;
 	/* Pointer to the library-allocated metadata */
 	struct shd_sample_metadata *metadata;
+	/* Date of the start of the current write, only recorded when the
+	 * write commit tracepoint is enabled */
+	uint64_t write_start_ns;
+	/* Whether the context is remapped when its section is re-created */
+	bool auto_reconnect;
+	/* How the producer copies data into the section */
+	enum shd_write_mode write_mode;
+	/* Whether the current write used streaming stores, which must be
+	 * fenced before the commit */
+	bool streamed;
+	/* Number of samples of the current batch write held until its commit,
+	 * the latest one being at the local write index */
+	size_t nb_held;
+	/* Downsampled tiers of the section, NULL if it has none or if they
+	 * have not been open yet */
+	struct shd_tiers *tiers;
+	/* Whether a consumer already tried to open the tiers */
+	bool tiers_open_tried;
+	/* Estimate of the commit dates, used by shd_wait_next_expected() */
+	struct shd_rate rate;
+	/* Revision number under which the producer recorded the section in
+	 * the registry, -1 if it did not */
+	int registered_rev;
 };
 
 /*
@@ -77,13 +105,16 @@ struct shd_ctx *shd_ctx_new(struct shd_section_id *id, const char *blob_name);
  * @param[in] ctx : context to m'map
  * @param[in] hdr_info : pointer to the header structure that contains all info
  * regarding the shared memory section
+ * @param[in] dirty_map : whether the section holds a dirty map (only used if
+ * hdr_info is not NULL)
  *
  * @return : 0 in case of success,
  *           -EINVAL if ctx is NULL
  *           -EFAULT if a fault is detected while m'maping
  */
 int shd_ctx_mmap(struct shd_ctx *ctx,
-			const struct shd_hdr_user_info *hdr_info);
+			const struct shd_hdr_user_info *hdr_info,
+			bool dirty_map);
 
 /*
  * @brief Destroys a shared memory context
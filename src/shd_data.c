@@ -38,6 +38,7 @@
 #include <stdlib.h>			/* For memory allocation functions */
 #include <errno.h>
 #include <time.h>
+#include "futils/timetools.h"
 #include "shd_ctx.h"
 #include "shd_sync.h"
 #include "shd_data.h"
@@ -46,24 +47,32 @@
 #include "shd_sample.h"
 #include "shd_window.h"
 #include "shd_section.h"
+#include "shd_trace.h"
+#include "shd_dirty.h"
+#include "shd_hdr.h"
+#include "shd_rec.h"
+#include "shd_aggregate.h"
+#include "shd_filter.h"
 #include "libshdata.h"
 
 struct shd_sample *
 shd_data_get_sample_ptr(const struct shd_data_section_desc *desc,
 				int index)
 {
+	/* Offsets may exceed 4 GiB in large sections */
 	return (struct shd_sample *) ((char *)desc->data_section_start
-			+ index * shd_sample_get_size(desc->blob_size));
+			+ (size_t) index * shd_sample_get_size(desc->blob_size));
 }
 
 int shd_data_clear_section(const struct shd_data_section_desc *desc)
 {
 	unsigned int i;
-	memset(desc->data_section_start,
-		0,
-		shd_data_get_total_size(desc->blob_size, desc->nb_samples));
+
+	/* Only clear sample headers : blobs of invalid samples are never read,
+	 * and touching them would fault in every page of large sections */
 	for (i = 0; i < desc->nb_samples; i++) {
 		struct shd_sample *samp = shd_data_get_sample_ptr(desc, i);
+		memset(&samp->metadata, 0, sizeof(samp->metadata));
 		shd_sync_invalidate_sample(&samp->sync);
 	}
 
@@ -95,9 +104,34 @@ int shd_data_reserve_write(struct shd_ctx *ctx)
 	if (ret < 0)
 		return ret;
 
+	if (ctx->sect_mmap->dirty_top != NULL)
+		shd_dirty_reset(ctx->sect_mmap->dirty_top, index);
+
+	if (SHD_TRACE_ENABLED(sample_write_commit))
+		ctx->write_start_ns = shd_trace_now_ns();
+	SHD_TRACE(sample_write_start, ctx->blob_name, index);
+
 	return 0;
 }
 
+/*
+ * @brief Copy data into a sample according to the write mode of the context
+ */
+static void write_data(struct shd_ctx *ctx, struct shd_sample *sample,
+			ptrdiff_t offset, const void *src, size_t length)
+{
+	bool stream = ctx->write_mode == SHD_WRITE_MODE_STREAMING
+		|| (ctx->write_mode == SHD_WRITE_MODE_AUTO
+			&& length >= SHD_WRITE_STREAMING_THRESHOLD);
+
+	if (stream) {
+		shd_sample_write_stream(sample, offset, src, length);
+		ctx->streamed = true;
+	} else {
+		shd_sample_write(sample, offset, src, length);
+	}
+}
+
 int shd_data_write_metadata(struct shd_ctx *ctx,
 				const struct shd_sample_metadata *metadata)
 {
@@ -115,6 +149,59 @@ int shd_data_write_metadata(struct shd_ctx *ctx,
 				sizeof(*metadata));
 }
 
+int shd_data_copy_previous(struct shd_ctx *ctx,
+				const struct shd_quantity written[],
+				size_t nb_written)
+{
+	struct shd_sample *curr_sample, *prev_sample;
+	ptrdiff_t blob_offset = offsetof(struct shd_sample, blob);
+	size_t blob_size = ctx->desc->blob_size;
+	size_t pos = 0, next, end, q_start, q_end;
+	int prev_index;
+	size_t i;
+	int index = shd_sync_get_local_write_index(ctx->sync_ctx);
+	if (index == -1)
+		return -EPERM;
+
+	/* The write index of the header still points to the latest committed
+	 * sample until the end of the write session */
+	prev_index = shd_sync_get_last_write_index(ctx->sect_mmap->sync_top);
+	if (prev_index == -1 || prev_index == index)
+		return 0;
+
+	curr_sample = shd_data_get_sample_ptr(ctx->desc, index);
+	prev_sample = shd_data_get_sample_ptr(ctx->desc, prev_index);
+
+	/* Copy the gaps between the written quantities, which may be given in
+	 * any order and overlap */
+	while (pos < blob_size) {
+		next = blob_size;
+		end = pos;
+		for (i = 0; i < nb_written; i++) {
+			q_start = written[i].quantity_offset;
+			q_end = q_start + written[i].quantity_size;
+			if (q_end <= pos)
+				continue;
+			if (q_start <= pos)
+				end = q_end > end ? q_end : end;
+			else if (q_start < next)
+				next = q_start;
+		}
+
+		if (end > pos) {
+			pos = end;
+			continue;
+		}
+
+		write_data(ctx, curr_sample, blob_offset + pos,
+				(const char *)&prev_sample->blob + pos,
+				next - pos);
+		pos = next;
+	}
+
+	return 0;
+}
+
 int shd_data_write_quantity(struct shd_ctx *ctx,
 				const struct shd_quantity *quantity,
 				const void *src)
@@ -131,20 +218,200 @@ int shd_data_write_quantity(struct shd_ctx *ctx,
 
 	blob_offset = offsetof(struct shd_sample, blob);
 
-	return shd_sample_write(curr_sample,
-				blob_offset + quantity->quantity_offset,
-				src,
-				quantity->quantity_size);
+	write_data(ctx, curr_sample,
+			blob_offset + quantity->quantity_offset,
+			src,
+			quantity->quantity_size);
+
+	if (ctx->sect_mmap->dirty_top != NULL)
+		shd_dirty_mark(ctx->sect_mmap->dirty_top, index,
+				shd_dirty_get_mask(ctx->sect_mmap->dirty_top,
+					quantity->quantity_offset,
+					quantity->quantity_size));
+
+	return 0;
+}
+
+int shd_data_write_blobs(struct shd_ctx *ctx,
+				const void *src,
+				size_t size,
+				const struct shd_sample_metadata metadata[],
+				size_t nb)
+{
+	struct shd_sample *curr_sample;
+	ptrdiff_t blob_offset = offsetof(struct shd_sample, blob);
+	void *dirty_top = ctx->sect_mmap->dirty_top;
+	uint64_t dirty_mask = 0;
+	int index = shd_sync_get_local_write_index(ctx->sync_ctx);
+	size_t i;
+	int ret;
+
+	if (index == -1)
+		return -EPERM;
+
+	if (dirty_top != NULL)
+		dirty_mask = shd_dirty_get_mask(dirty_top, 0, size);
+
+	/* All the samples of the batch are held before any of them is
+	 * overwritten, so that windows which start on one of them fail to
+	 * read until the whole batch is published */
+	curr_sample = shd_data_get_sample_ptr(ctx->desc, index);
+	shd_sync_hold_sample(&curr_sample->sync);
+	ctx->nb_held = 1;
+	for (i = 1; i < nb; i++) {
+		curr_sample = shd_data_get_sample_ptr(ctx->desc,
+				index_n_after(index, i, ctx->desc));
+		ret = shd_sync_continue_sample_write(ctx->sync_ctx,
+						&curr_sample->sync,
+						ctx->desc);
+		if (ret < 0)
+			return ret;
+		ctx->nb_held++;
+	}
+
+	for (i = 0; i < nb; i++) {
+		curr_sample = shd_data_get_sample_ptr(ctx->desc, index);
+		shd_sample_write(curr_sample, 0, &metadata[i],
+				sizeof(metadata[i]));
+		write_data(ctx, curr_sample, blob_offset,
+				(const char *)src + i * size, size);
+		if (dirty_top != NULL) {
+			shd_dirty_reset(dirty_top, index);
+			shd_dirty_mark(dirty_top, index, dirty_mask);
+		}
+		index = index_next(index, ctx->desc);
+	}
+
+	return 0;
 }
 
 int shd_data_end_write(struct shd_ctx *ctx)
 {
+	int ret;
 	int index = shd_sync_get_local_write_index(ctx->sync_ctx);
 	if (index == -1)
 		return -EPERM;
 
-	return shd_sync_end_write_session(ctx->sync_ctx,
+	if (ctx->streamed) {
+		shd_sample_stream_fence();
+		ctx->streamed = false;
+	}
+
+	/* The latest sample of a batch is released before the write index is
+	 * published, so that a window never holds new samples before old
+	 * ones. The other held samples are released before consumers are
+	 * notified : in between, windows which start on them fail to read */
+	if (ctx->nb_held > 0) {
+		ctx->nb_held--;
+		shd_sync_release_sample(&shd_data_get_sample_ptr(ctx->desc,
+							index)->sync);
+	}
+
+	ret = shd_sync_end_write_session(ctx->sync_ctx,
 						ctx->sect_mmap->sync_top);
+	if (ret < 0)
+		return ret;
+
+	for (; ctx->nb_held > 0; ctx->nb_held--)
+		shd_sync_release_sample(&shd_data_get_sample_ptr(ctx->desc,
+				index_n_before(index, ctx->nb_held,
+						ctx->desc))->sync);
+	shd_sync_notify_commit(ctx->sync_ctx, ctx->sect_mmap->sync_top);
+
+	if (SHD_TRACE_ENABLED(sample_write_commit)) {
+		/* The tracer may have been attached in the middle of the
+		 * write, in which case its duration is unknown */
+		SHD_TRACE(sample_write_commit, ctx->blob_name, index,
+				ctx->write_start_ns != 0 ?
+				shd_trace_now_ns() - ctx->write_start_ns : 0);
+		ctx->write_start_ns = 0;
+	}
+
+	return 0;
+}
+
+const struct shd_sample *shd_data_get_committed(struct shd_ctx *ctx, int n)
+{
+	int index = shd_sync_get_last_write_index(ctx->sect_mmap->sync_top);
+	if (index == -1)
+		return NULL;
+
+	return shd_data_get_sample_ptr(ctx->desc,
+			index_n_before(index, n, ctx->desc));
+}
+
+int shd_data_get_oldest_date(struct shd_ctx *ctx, struct timespec *date)
+{
+	struct shd_sample *samp;
+	int index;
+
+	index = shd_sync_get_last_write_index(ctx->sect_mmap->sync_top);
+	if (index == -1)
+		return -EAGAIN;
+
+	/* The slot after the latest sample is the oldest one, unless the
+	 * section has not wrapped yet. It may be being overwritten, so the
+	 * next one is used instead, like SHD_OLDEST does */
+	index = index_next(index, ctx->desc);
+	samp = shd_data_get_sample_ptr(ctx->desc, index);
+	if (!shd_sync_is_sample_valid(&samp->sync))
+		index = 0;
+	else
+		index = index_next(index, ctx->desc);
+
+	samp = shd_data_get_sample_ptr(ctx->desc, index);
+	*date = samp->metadata.ts;
+
+	return 0;
+}
+
+int shd_data_get_period(struct shd_ctx *ctx, uint32_t nb, uint64_t *period_ns)
+{
+	struct shd_sample *first, *last;
+	struct timespec first_ts, last_ts;
+	uint64_t first_ns, last_ns;
+	int index, nb_writes;
+
+	index = shd_sync_get_last_write_index(ctx->sect_mmap->sync_top);
+	if (index == -1)
+		return -EAGAIN;
+
+	/* The slot after the latest sample is the next one written by the
+	 * producer : measure from the one after it at most */
+	if (ctx->desc->nb_samples < 2)
+		nb = 0;
+	else if (nb > ctx->desc->nb_samples - 2)
+		nb = ctx->desc->nb_samples - 2;
+	first = shd_data_get_sample_ptr(ctx->desc,
+			index_n_before(index, nb, ctx->desc));
+	/* The section has not wrapped yet : measure from its first slot. Samples
+	 * held by a batch write are caught by the check below */
+	if (shd_sync_get_nb_writes(&first->sync) == -1) {
+		nb = index;
+		first = shd_data_get_sample_ptr(ctx->desc, 0);
+	}
+	if (nb == 0)
+		return -EAGAIN;
+	last = shd_data_get_sample_ptr(ctx->desc, index);
+
+	/* Only the oldest sample can be overwritten during the measure */
+	nb_writes = shd_sync_get_nb_writes(&first->sync);
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	first_ts = first->metadata.ts;
+	last_ts = last->metadata.ts;
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (nb_writes < 0
+			|| nb_writes != shd_sync_get_nb_writes(&first->sync))
+		return -EAGAIN;
+
+	time_timespec_to_ns(&first_ts, &first_ns);
+	time_timespec_to_ns(&last_ts, &last_ns);
+	if (last_ns <= first_ns)
+		return -ERANGE;
+
+	*period_ns = (last_ns - first_ns) / nb;
+
+	return 0;
 }
 
 int shd_data_find(struct shd_ctx *ctx,
@@ -153,6 +420,7 @@ int shd_data_find(struct shd_ctx *ctx,
 	int ret;
 	struct shd_sample *wstart;
 	int t_index;
+	uint64_t start_ns = 0;
 
 	t_index = shd_sync_get_last_write_index(ctx->sect_mmap->sync_top);
 	if (t_index == -1)
@@ -165,10 +433,18 @@ int shd_data_find(struct shd_ctx *ctx,
 			> ctx->desc->nb_samples)
 		return -EINVAL;
 
+	if (SHD_TRACE_ENABLED(search_over))
+		start_ns = shd_trace_now_ns();
+	SHD_TRACE(search_start, ctx->blob_name, search->method);
+
 	ret = shd_window_set(ctx->window, ctx->sect_mmap->sync_top,
 				search, ctx->desc,
 				ctx->hint);
 
+	if (SHD_TRACE_ENABLED(search_over))
+		SHD_TRACE(search_over, ctx->blob_name, search->method, ret,
+				shd_trace_now_ns() - start_ns);
+
 	if (ret < 0) {
 		return ret;
 	} else {
@@ -179,6 +455,99 @@ int shd_data_find(struct shd_ctx *ctx,
 	}
 }
 
+/*
+ * Shrink the window to the samples at most duration older than its
+ * reference sample, which is its most recent one
+ */
+static void shrink_window(struct shd_ctx *ctx, const struct timespec *duration)
+{
+	struct shd_window *window = ctx->window;
+	struct shd_sample *samp;
+	struct timespec bound;
+	int s_index = window->ref_idx;
+	int old_nb_writes;
+	int nb = 1;
+	int prev;
+
+	samp = shd_data_get_sample_ptr(ctx->desc, s_index);
+	bound.tv_sec = samp->metadata.ts.tv_sec - duration->tv_sec;
+	bound.tv_nsec = samp->metadata.ts.tv_nsec - duration->tv_nsec;
+	if (bound.tv_nsec < 0) {
+		bound.tv_nsec += 1000000000;
+		bound.tv_sec--;
+	}
+
+	while (nb < window->nb_matches) {
+		prev = index_n_before(s_index, 1, ctx->desc);
+		samp = shd_data_get_sample_ptr(ctx->desc, prev);
+		if (time_timespec_cmp(&samp->metadata.ts, &bound) < 0)
+			break;
+		s_index = prev;
+		nb++;
+	}
+
+	if (nb == window->nb_matches)
+		return;
+
+	/* The read session is moved to the new start of the window, only if
+	 * the old one, which is overwritten first, is still intact once it is
+	 * armed : otherwise, shd_end_read() reports the overwrite */
+	old_nb_writes = ctx->sync_ctx->nb_writes;
+	shd_sync_start_read_session(ctx->sync_ctx,
+			&shd_data_get_sample_ptr(ctx->desc, s_index)->sync);
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	samp = shd_data_get_sample_ptr(ctx->desc, window->start_idx);
+	if (shd_sync_get_nb_writes(&samp->sync) != old_nb_writes) {
+		ctx->sync_ctx->nb_writes = old_nb_writes;
+		return;
+	}
+
+	window->start_idx = s_index;
+	window->nb_matches = nb;
+}
+
+int shd_data_aggregate(struct shd_ctx *ctx,
+			const struct shd_sample_search *search,
+			const struct timespec *duration,
+			const struct shd_quantity_info *info,
+			size_t stat_size,
+			struct shd_aggregate results[])
+{
+	struct shd_sample_search window_search = *search;
+	int ret;
+
+	/* The time window is taken out of the largest count window */
+	if (duration != NULL)
+		window_search.nb_values_before_date = ctx->desc->nb_samples - 1;
+
+	ret = shd_data_find(ctx, &window_search);
+	if (ret < 0)
+		return ret;
+
+	if (duration != NULL)
+		shrink_window(ctx, duration);
+
+	return shd_aggregate_window(ctx->window, ctx->desc, info, stat_size,
+			results);
+}
+
+int shd_data_read_filtered(struct shd_ctx *ctx,
+				const struct shd_sample_search *search,
+				const struct shd_predicate *pred,
+				const struct shd_quantity *quantity,
+				struct shd_quantity_sample samples[],
+				size_t max_samples)
+{
+	int ret;
+
+	ret = shd_data_find(ctx, search);
+	if (ret < 0)
+		return ret;
+
+	return shd_filter_window(ctx->window, ctx->desc, pred, quantity,
+			samples, max_samples);
+}
+
 int shd_data_read_metadata(struct shd_ctx *ctx,
 				struct shd_sample_metadata **metadata)
 {
@@ -220,7 +589,7 @@ int shd_data_read_blob(struct shd_ctx *ctx, void *dst, size_t dst_size)
 		goto exit;
 	}
 
-	req_size = ctx->desc->blob_size * ctx->window->nb_matches;
+	req_size = ctx->desc->blob_size * (size_t) ctx->window->nb_matches;
 	if (dst_size < req_size) {
 		ret = -EINVAL;
 		goto exit;
@@ -247,7 +616,7 @@ int shd_data_read_quantity(struct shd_ctx *ctx,
 		goto exit;
 	}
 
-	req_size = quantity->quantity_size * ctx->window->nb_matches;
+	req_size = quantity->quantity_size * (size_t) ctx->window->nb_matches;
 	if (dst_size < req_size) {
 		ret = -EINVAL;
 		goto exit;
@@ -261,6 +630,73 @@ exit:
 	return ret;
 }
 
+int shd_data_read_dirty(struct shd_ctx *ctx, uint64_t dst[], size_t nb)
+{
+	int s_index;
+	int d_index;
+
+	if (ctx->sect_mmap->dirty_top == NULL)
+		return -ENODATA;
+	if (ctx->window->nb_matches < 0)
+		return -EPERM;
+	if (nb < (size_t) ctx->window->nb_matches)
+		return -EINVAL;
+
+	for (s_index = ctx->window->start_idx, d_index = 0;
+		d_index < ctx->window->nb_matches;
+		s_index = index_next(s_index, ctx->desc), d_index++)
+		dst[d_index] = shd_dirty_get(ctx->sect_mmap->dirty_top,
+						s_index);
+
+	return d_index;
+}
+
+int shd_data_read_records(struct shd_ctx *ctx,
+				struct shd_rec_record records[],
+				size_t max_records,
+				void *buf,
+				size_t buf_size)
+{
+	const void *rec_top = ctx->sect_mmap->metadata_blob_top;
+	struct shd_rec_index index;
+	struct shd_sample *samp;
+	size_t used = 0;
+	size_t nb = 0;
+	int s_index;
+	int i;
+
+	if (!shd_hdr_has_record_ring(ctx->sect_mmap->section_top))
+		return -EOPNOTSUPP;
+	if (ctx->window->nb_matches < 0)
+		return -EPERM;
+
+	for (s_index = ctx->window->start_idx, i = 0;
+		i < ctx->window->nb_matches && nb < max_records;
+		s_index = index_next(s_index, ctx->desc), i++) {
+		samp = shd_data_get_sample_ptr(ctx->desc, s_index);
+		memcpy(&index, &samp->blob, sizeof(index));
+
+		/* Records are returned in order : stop at the first one that
+		 * does not fit */
+		if (index.len > buf_size - used)
+			break;
+
+		/* Records overwritten in the byte ring are skipped, the gap
+		 * shows in the sequence numbers */
+		if (shd_rec_copy(rec_top, &index, &records[nb],
+					(char *)buf + used) < 0)
+			continue;
+
+		/* Keep the next record aligned for the caller */
+		used += ALIGN((size_t) index.len, 8);
+		if (used > buf_size)
+			used = buf_size;
+		nb++;
+	}
+
+	return nb;
+}
+
 int shd_data_read_quantity_sample(struct shd_ctx *ctx,
 				int n_quantities,
 				const struct shd_quantity quantity[],
@@ -342,13 +778,14 @@ int shd_data_end_read(struct shd_ctx *ctx)
 
 exit:
 	free(ctx->metadata);
+	ctx->metadata = NULL;
 	return 0;
 }
 
 size_t shd_data_get_total_size(size_t blob_size,
 				uint32_t max_nb_samples)
 {
-	return max_nb_samples * shd_sample_get_size(blob_size);
+	return (size_t) max_nb_samples * shd_sample_get_size(blob_size);
 }
 
 struct shd_data_section_desc *shd_data_section_desc_new(struct shd_ctx *ctx,
@@ -369,6 +806,18 @@ struct shd_data_section_desc *shd_data_section_desc_new(struct shd_ctx *ctx,
 		user_info = hdr_info;
 	desc->blob_size = user_info->blob_size;
 	desc->nb_samples = user_info->max_nb_samples;
+	/* Ring index arithmetic can use a mask instead of a modulo if the
+	 * number of samples is a power of two */
+	if (desc->nb_samples > 1
+			&& (desc->nb_samples & (desc->nb_samples - 1)) == 0)
+		desc->index_mask = desc->nb_samples - 1;
+	else
+		desc->index_mask = 0;
+	if (ctx->prefetch && shd_sample_get_size(desc->blob_size)
+				>= PREFETCH_MIN_STRIDE)
+		desc->prefetch_distance = PREFETCH_DISTANCE;
+	else
+		desc->prefetch_distance = 0;
 
 	return desc;
 }
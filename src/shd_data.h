@@ -46,6 +46,12 @@ struct shd_data_section_desc {
 	size_t blob_size;
 	/* Total number of samples */
 	uint32_t nb_samples;
+	/* nb_samples - 1 if nb_samples is a power of two, 0 otherwise */
+	uint32_t index_mask;
+	/* Number of slots ahead which are prefetched when stepping through
+	 * the section, 0 if samples are close enough for hardware
+	 * prefetchers */
+	uint32_t prefetch_distance;
 };
 
 #include "libshdata.h"
@@ -98,6 +104,22 @@ int shd_data_reserve_write(struct shd_ctx *ctx);
 int shd_data_write_metadata(struct shd_ctx *ctx,
 				const struct shd_sample_metadata *metadata);
 
+/*
+ * @brief Copy the blob of the latest committed sample into the current data
+ * slot, except the ranges of the quantities about to be written
+ *
+ * @param[in,out] ctx : current shared memory context
+ * @param[in] written : quantities which will be written in the current slot
+ * @param[in] nb_written : number of quantities in the written array
+ *
+ * @return : 0 in case of success (including when no sample was committed
+ * yet, in which case nothing is copied),
+ *           -EPERM if the operation is not permitted (out-of-sequence call)
+ */
+int shd_data_copy_previous(struct shd_ctx *ctx,
+				const struct shd_quantity written[],
+				size_t nb_written);
+
 /*
  * @brief Write quantity into the current data slot
  *
@@ -112,6 +134,25 @@ int shd_data_write_quantity(struct shd_ctx *ctx,
 				const struct shd_quantity *quantity,
 				const void *src);
 
+/*
+ * @brief Write whole blobs into consecutive data slots, the first of which
+ * was reserved by shd_data_reserve_write()
+ *
+ * @param[in,out] ctx : current shared memory context
+ * @param[in] src : array of nb blobs of size bytes each
+ * @param[in] size : size of a blob
+ * @param[in] metadata : array of nb sample metadata
+ * @param[in] nb : number of blobs to write
+ *
+ * @return : 0 in case of success,
+ *           -EPERM if the operation is not permitted (out-of-sequence call)
+ */
+int shd_data_write_blobs(struct shd_ctx *ctx,
+				const void *src,
+				size_t size,
+				const struct shd_sample_metadata metadata[],
+				size_t nb);
+
 /*
  * @brief End write operation to current data slot
  *
@@ -122,6 +163,48 @@ int shd_data_write_quantity(struct shd_ctx *ctx,
  */
 int shd_data_end_write(struct shd_ctx *ctx);
 
+/*
+ * @brief Get a sample committed by the producer of a section
+ *
+ * @param[in] ctx : current shared memory context, open for writing
+ * @param[in] n : number of samples committed after the wanted one (0 for the
+ * latest one)
+ *
+ * @return : pointer to the sample,
+ *           NULL if no sample has been committed yet
+ */
+const struct shd_sample *shd_data_get_committed(struct shd_ctx *ctx, int n);
+
+/*
+ * @brief Get the date of the oldest sample of a section
+ *
+ * The date is read without starting a read session : it is only a hint,
+ * e.g. to choose which section to search.
+ *
+ * @param[in] ctx : current shared memory context
+ * @param[out] date : timestamp of the oldest sample
+ *
+ * @return : 0 in case of success,
+ *           -EAGAIN if no sample has been written yet
+ */
+int shd_data_get_oldest_date(struct shd_ctx *ctx, struct timespec *date);
+
+/*
+ * @brief Measure the period of the producer, from the timestamps of the
+ * latest samples
+ *
+ * @param[in] ctx : current shared memory context
+ * @param[in] nb : number of periods to measure, if there are enough samples
+ * in the section
+ * @param[out] period_ns : mean period, in nanoseconds
+ *
+ * @return : 0 in case of success,
+ *           -EAGAIN if less than two samples have been written, or if they
+ * were overwritten during the measure,
+ *           -ERANGE if the timestamps of the samples do not increase
+ */
+int shd_data_get_period(struct shd_ctx *ctx, uint32_t nb, uint64_t *period_ns);
+
 /*
  * @brief Find the set of samples that match a given search
  *
@@ -137,6 +220,49 @@ int shd_data_end_write(struct shd_ctx *ctx);
 int shd_data_find(struct shd_ctx *ctx,
 			const struct shd_sample_search *search);
 
+/*
+ * @brief Find a window of samples and aggregate a quantity over it
+ *
+ * @param[in,out] ctx : current shared memory context
+ * @param[in] search : search parameters
+ * @param[in] duration : if not NULL, the window is shrunk to the samples at
+ * most duration older than the reference sample
+ * @param[in] info : quantity to aggregate, previously checked with
+ * shd_aggregate_check()
+ * @param[in] stat_size : see shd_aggregate_window()
+ * @param[out] results : one result per element of the quantity
+ *
+ * @return : number of samples aggregated in case of success,
+ *           any error returned by shd_data_find()
+ */
+int shd_data_aggregate(struct shd_ctx *ctx,
+			const struct shd_sample_search *search,
+			const struct timespec *duration,
+			const struct shd_quantity_info *info,
+			size_t stat_size,
+			struct shd_aggregate results[]);
+
+/*
+ * @brief Search for a window of samples, and copy a quantity out of those
+ * which satisfy a predicate
+ *
+ * @param[in,out] ctx : current shared memory context
+ * @param[in] search : search parameters
+ * @param[in] pred : predicate, previously checked with shd_filter_check()
+ * @param[in] quantity : quantity to copy out of the matching samples
+ * @param[out] samples : destination of the matching samples
+ * @param[in] max_samples : number of elements of samples
+ *
+ * @return : number of matching samples copied in case of success,
+ *           any error returned by shd_data_find()
+ */
+int shd_data_read_filtered(struct shd_ctx *ctx,
+				const struct shd_sample_search *search,
+				const struct shd_predicate *pred,
+				const struct shd_quantity *quantity,
+				struct shd_quantity_sample samples[],
+				size_t max_samples);
+
 /*
  * @brief Allocate and fill a structure describing metadata for a range of
  * samples that matched a previous search
@@ -166,6 +292,41 @@ int shd_data_read_metadata(struct shd_ctx *ctx,
  */
 int shd_data_read_blob(struct shd_ctx *ctx, void *dst, size_t dst_size);
 
+/*
+ * @brief Copy the dirty bitmaps of the previously selected samples into a
+ * user-defined array
+ *
+ * @param[in] ctx : current shared memory context
+ * @param[out] dst : destination array
+ * @param[in] nb : number of elements of the destination array
+ *
+ * @return : number of samples whose bitmap was read on success,
+ *           -EINVAL if the destination array is too small
+ *           -EPERM if the function was called out of sequence
+ *           -ENODATA if the section has no dirty map
+ */
+int shd_data_read_dirty(struct shd_ctx *ctx, uint64_t dst[], size_t nb);
+
+/*
+ * @brief Copy the records indexed by the previously selected samples into a
+ * user-defined buffer
+ *
+ * @param[in] ctx : current shared memory context
+ * @param[out] records : descriptions of the copied records
+ * @param[in] max_records : number of elements of the records array
+ * @param[out] buf : destination buffer for the record data
+ * @param[in] buf_size : size of the destination buffer
+ *
+ * @return : number of records copied on success,
+ *           -EPERM if the function was called out of sequence
+ *           -EOPNOTSUPP if the section is not a record section
+ */
+int shd_data_read_records(struct shd_ctx *ctx,
+				struct shd_rec_record records[],
+				size_t max_records,
+				void *buf,
+				size_t buf_size);
+
 /*
  * @brief Copy a given quantity of the previously selected samples into a user-
  * defined buffer
@@ -0,0 +1,160 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_dirty.c
+ *
+ * @brief Per-sample bitmaps of the quantities written by the producer.
+ *
+ * @details Layout of the dirty map :
+ *   - header holding the list of tracked quantities, with room for
+ *   SHD_DIRTY_MAX_QUANTITIES of them ;
+ *   - one 64-bit bitmap per sample slot, in slot order.
+ * Only fixed-size types are used, so that processes with 32-bit and 64-bit
+ * address spaces agree on the layout.
+ *
+ */
+
+#include <errno.h>
+#include <string.h>
+#include "shd_private.h"
+#include "shd_dirty.h"
+
+struct shd_dirty_quantity {
+	/* offset from start of blob */
+	uint64_t offset;
+	/* size of the quantity */
+	uint64_t size;
+};
+
+struct shd_dirty_hdr {
+	/* number of tracked quantities */
+	uint32_t nb_quantities;
+	uint32_t reserved;
+	struct shd_dirty_quantity quantities[SHD_DIRTY_MAX_QUANTITIES];
+};
+
+static uint64_t *get_bitmaps(const void *dirty_top)
+{
+	return (uint64_t *)((char *)dirty_top + sizeof(struct shd_dirty_hdr));
+}
+
+size_t shd_dirty_get_size(uint32_t max_nb_samples)
+{
+	return sizeof(struct shd_dirty_hdr)
+			+ (size_t) max_nb_samples * sizeof(uint64_t);
+}
+
+int shd_dirty_check(const struct shd_quantity tracked[], size_t nb_tracked,
+			size_t blob_size)
+{
+	size_t i;
+
+	if (tracked == NULL || nb_tracked == 0
+			|| nb_tracked > SHD_DIRTY_MAX_QUANTITIES)
+		return -EINVAL;
+
+	for (i = 0; i < nb_tracked; i++) {
+		if (tracked[i].quantity_offset < 0
+				|| tracked[i].quantity_size == 0
+				|| (size_t) tracked[i].quantity_offset
+					> blob_size
+				|| tracked[i].quantity_size > blob_size
+					- tracked[i].quantity_offset)
+			return -EINVAL;
+	}
+
+	return 0;
+}
+
+void shd_dirty_init(void *dirty_top, const struct shd_quantity tracked[],
+			size_t nb_tracked, uint32_t max_nb_samples)
+{
+	struct shd_dirty_hdr *hdr = dirty_top;
+	size_t i;
+
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->nb_quantities = nb_tracked;
+	for (i = 0; i < nb_tracked; i++) {
+		hdr->quantities[i].offset = tracked[i].quantity_offset;
+		hdr->quantities[i].size = tracked[i].quantity_size;
+	}
+	memset(get_bitmaps(dirty_top), 0,
+			(size_t) max_nb_samples * sizeof(uint64_t));
+}
+
+uint64_t shd_dirty_get_mask(const void *dirty_top, ptrdiff_t offset,
+			size_t size)
+{
+	const struct shd_dirty_hdr *hdr = dirty_top;
+	uint64_t start = offset;
+	uint64_t end = start + size;
+	uint64_t mask = 0;
+	uint32_t i;
+
+	for (i = 0; i < hdr->nb_quantities; i++) {
+		const struct shd_dirty_quantity *q = &hdr->quantities[i];
+
+		if (q->offset < end && start < q->offset + q->size)
+			mask |= UINT64_C(1) << i;
+	}
+
+	return mask;
+}
+
+void shd_dirty_reset(void *dirty_top, int index)
+{
+	get_bitmaps(dirty_top)[index] = 0;
+}
+
+void shd_dirty_mark(void *dirty_top, int index, uint64_t bits)
+{
+	get_bitmaps(dirty_top)[index] |= bits;
+}
+
+uint64_t shd_dirty_get(const void *dirty_top, int index)
+{
+	return get_bitmaps(dirty_top)[index];
+}
+
+int shd_dirty_get_quantities(const void *dirty_top,
+			struct shd_quantity quantities[],
+			size_t max_quantities)
+{
+	const struct shd_dirty_hdr *hdr = dirty_top;
+	uint32_t nb = hdr->nb_quantities;
+	uint32_t i;
+
+	/* The header may be rewritten by a new producer at any time */
+	if (nb > SHD_DIRTY_MAX_QUANTITIES)
+		nb = SHD_DIRTY_MAX_QUANTITIES;
+
+	for (i = 0; i < nb && i < max_quantities; i++) {
+		quantities[i].quantity_offset = hdr->quantities[i].offset;
+		quantities[i].quantity_size = hdr->quantities[i].size;
+	}
+
+	return nb;
+}
@@ -0,0 +1,141 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_dirty.h
+ *
+ * @brief Per-sample bitmaps of the quantities written by the producer.
+ *
+ * @details A producer can declare a list of tracked quantities when it
+ * creates a section. Each sample then carries a bitmap whose bit #i is set if
+ * tracked quantity #i was written in that sample. The list and the bitmaps
+ * are stored in a dirty map, placed after the data section.
+ *
+ */
+
+#ifndef _SHD_DIRTY_H_
+#define _SHD_DIRTY_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "libshdata.h"
+
+/*
+ * @brief Get the size of the dirty map of a section
+ *
+ * @param[in] max_nb_samples : number of samples in the section
+ *
+ * @return : size of the dirty map
+ */
+size_t shd_dirty_get_size(uint32_t max_nb_samples);
+
+/*
+ * @brief Check a list of tracked quantities
+ *
+ * @param[in] tracked : tracked quantities
+ * @param[in] nb_tracked : number of tracked quantities
+ * @param[in] blob_size : size of a blob
+ *
+ * @return : 0 if the list is valid,
+ *           -EINVAL otherwise
+ */
+int shd_dirty_check(const struct shd_quantity tracked[], size_t nb_tracked,
+			size_t blob_size);
+
+/*
+ * @brief Write the list of tracked quantities and clear all bitmaps
+ *
+ * @param[in] dirty_top : pointer to the start of the dirty map
+ * @param[in] tracked : tracked quantities, previously checked with
+ * shd_dirty_check()
+ * @param[in] nb_tracked : number of tracked quantities
+ * @param[in] max_nb_samples : number of samples in the section
+ */
+void shd_dirty_init(void *dirty_top, const struct shd_quantity tracked[],
+			size_t nb_tracked, uint32_t max_nb_samples);
+
+/*
+ * @brief Get the bits of the tracked quantities that overlap a range of the
+ * blob
+ *
+ * @param[in] dirty_top : pointer to the start of the dirty map
+ * @param[in] offset : offset of the range from start of blob
+ * @param[in] size : size of the range
+ *
+ * @return : bitmap of the overlapping tracked quantities
+ */
+uint64_t shd_dirty_get_mask(const void *dirty_top, ptrdiff_t offset,
+			size_t size);
+
+/*
+ * @brief Clear the bitmap of a sample
+ *
+ * @param[in] dirty_top : pointer to the start of the dirty map
+ * @param[in] index : index of the sample
+ */
+void shd_dirty_reset(void *dirty_top, int index);
+
+/*
+ * @brief Set bits in the bitmap of a sample
+ *
+ * @param[in] dirty_top : pointer to the start of the dirty map
+ * @param[in] index : index of the sample
+ * @param[in] bits : bits to set
+ */
+void shd_dirty_mark(void *dirty_top, int index, uint64_t bits);
+
+/*
+ * @brief Get the bitmap of a sample
+ *
+ * @param[in] dirty_top : pointer to the start of the dirty map
+ * @param[in] index : index of the sample
+ *
+ * @return : bitmap of the quantities written in the sample
+ */
+uint64_t shd_dirty_get(const void *dirty_top, int index);
+
+/*
+ * @brief Copy the list of tracked quantities
+ *
+ * @param[in] dirty_top : pointer to the start of the dirty map
+ * @param[out] quantities : destination array
+ * @param[in] max_quantities : number of elements of the destination array
+ *
+ * @return : number of tracked quantities, which may be greater than
+ * max_quantities, in which case only the first ones are copied
+ */
+int shd_dirty_get_quantities(const void *dirty_top,
+			struct shd_quantity quantities[],
+			size_t max_quantities);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SHD_DIRTY_H_ */
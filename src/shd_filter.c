@@ -0,0 +1,174 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_filter.c
+ *
+ * @brief Reads of the samples of a window which satisfy a predicate.
+ *
+ * @details The window is scanned by shd_scan(), with a kernel specialized
+ * for the comparison and the type of the quantity.
+ *
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <string.h>
+#include "shd_private.h"
+#include "shd_sample.h"
+#include "shd_scan.h"
+#include "shd_schema.h"
+#include "shd_utils.h"
+#include "shd_filter.h"
+
+/* Find the first value whose bits of the mask are equal to those of the
+ * value of the predicate */
+#define MASK_KERNEL(_name, _type)					\
+static uint32_t _name(const char *p, size_t stride, uint32_t n,		\
+			uint32_t distance, const void *arg)		\
+{									\
+	const struct shd_predicate *pred = arg;				\
+	_type mask = pred->op == SHD_PRED_EQUAL ? (_type)~0		\
+			: (_type)pred->mask;				\
+	_type value = (_type)pred->value & mask;			\
+	_type v;							\
+	uint32_t i;							\
+									\
+	for (i = 0; i < n; i++, p += stride) {				\
+		SHD_SCAN_PREFETCH(p, stride, distance);			\
+		memcpy(&v, p, sizeof(v));				\
+		if ((v & mask) == value)				\
+			break;						\
+	}								\
+									\
+	return i;							\
+}
+
+/* Find the first value within the bounds of the range of the predicate */
+#define RANGE_KERNEL(_name, _type)					\
+static uint32_t _name(const char *p, size_t stride, uint32_t n,		\
+			uint32_t distance, const void *arg)		\
+{									\
+	const struct shd_predicate *pred = arg;				\
+	double lo = pred->min, hi = pred->max;				\
+	double d;							\
+	_type v;							\
+	uint32_t i;							\
+									\
+	for (i = 0; i < n; i++, p += stride) {				\
+		SHD_SCAN_PREFETCH(p, stride, distance);			\
+		memcpy(&v, p, sizeof(v));				\
+		d = v;							\
+		if (d >= lo && d <= hi)					\
+			break;						\
+	}								\
+									\
+	return i;							\
+}
+
+SHD_SCAN_INTEGER_KERNELS(MASK_KERNEL, mask)
+SHD_SCAN_NUMERIC_KERNELS(RANGE_KERNEL, range)
+
+static const shd_scan_kernel_t s_mask_kernels[SHD_SCAN_NB_TYPES] = {
+	SHD_SCAN_INTEGER_TABLE(mask)
+};
+
+static const shd_scan_kernel_t s_range_kernels[SHD_SCAN_NB_TYPES] = {
+	SHD_SCAN_NUMERIC_TABLE(range)
+};
+
+static shd_scan_kernel_t get_kernel(const struct shd_predicate *pred)
+{
+	switch (pred->op) {
+	case SHD_PRED_EQUAL:
+	case SHD_PRED_MASK:
+		return shd_scan_get_kernel(s_mask_kernels,
+						pred->quantity.type);
+	case SHD_PRED_RANGE:
+		return shd_scan_get_kernel(s_range_kernels,
+						pred->quantity.type);
+	default:
+		return NULL;
+	}
+}
+
+static bool is_in_blob(const struct shd_quantity *quantity, size_t blob_size)
+{
+	return quantity->quantity_offset >= 0
+			&& (size_t) quantity->quantity_offset <= blob_size
+			&& quantity->quantity_size
+				<= blob_size - quantity->quantity_offset;
+}
+
+int shd_filter_check(const struct shd_predicate *pred,
+			const struct shd_quantity *quantity,
+			size_t blob_size)
+{
+	const struct shd_quantity_info *info = &pred->quantity;
+
+	if (get_kernel(pred) == NULL || info->count != 1
+			|| info->quantity.quantity_size
+				!= shd_schema_get_type_size(info->type)
+			|| !is_in_blob(&info->quantity, blob_size)
+			|| quantity->quantity_size == 0
+			|| !is_in_blob(quantity, blob_size))
+		return -EINVAL;
+
+	return 0;
+}
+
+int shd_filter_window(const struct shd_window *window,
+			const struct shd_data_section_desc *desc,
+			const struct shd_predicate *pred,
+			const struct shd_quantity *quantity,
+			struct shd_quantity_sample samples[],
+			size_t max_samples)
+{
+	shd_scan_kernel_t kernel = get_kernel(pred);
+	uint32_t nb = window->nb_matches;
+	uint32_t pos = 0;
+	struct shd_sample *samp;
+	size_t n = 0;
+
+	while (n < max_samples) {
+		pos = shd_scan(desc, window->start_idx, pos, nb,
+				pred->quantity.quantity.quantity_offset,
+				kernel, pred);
+		if (pos == nb)
+			break;
+
+		samp = shd_data_get_sample_ptr(desc,
+				index_n_after(window->start_idx, pos, desc));
+		shd_sample_read(samp, quantity->quantity_offset
+					+ offsetof(struct shd_sample, blob),
+				samples[n].ptr, quantity->quantity_size);
+		shd_sample_read(samp, offsetof(struct shd_sample, metadata),
+				&samples[n].meta, sizeof(samples[n].meta));
+		n++;
+		pos++;
+	}
+
+	return n;
+}
@@ -0,0 +1,88 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_filter.h
+ *
+ * @brief Reads of the samples of a window which satisfy a predicate.
+ *
+ * @details The predicate is evaluated in place, in the mapped slots : like
+ * any read of the section, the copied data is only valid if the read session
+ * ends successfully.
+ *
+ */
+
+#ifndef _SHD_FILTER_H_
+#define _SHD_FILTER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "shd_data.h"
+#include "shd_window.h"
+#include "libshdata.h"
+
+/*
+ * @brief Check whether a predicate and the quantity to copy are valid
+ *
+ * @param[in] pred : predicate on a quantity
+ * @param[in] quantity : quantity to copy out of the matching samples
+ * @param[in] blob_size : size of a blob
+ *
+ * @return : 0 if both are valid,
+ *           -EINVAL otherwise
+ */
+int shd_filter_check(const struct shd_predicate *pred,
+			const struct shd_quantity *quantity,
+			size_t blob_size);
+
+/*
+ * @brief Copy a quantity out of the samples of a window which satisfy a
+ * predicate
+ *
+ * @param[in] window : window of samples, not empty
+ * @param[in] desc : description of the data section
+ * @param[in] pred : predicate, previously checked with shd_filter_check()
+ * @param[in] quantity : quantity to copy
+ * @param[out] samples : destination of the matching samples, oldest first
+ * @param[in] max_samples : number of elements of samples
+ *
+ * @return : number of matching samples copied
+ */
+int shd_filter_window(const struct shd_window *window,
+			const struct shd_data_section_desc *desc,
+			const struct shd_predicate *pred,
+			const struct shd_quantity *quantity,
+			struct shd_quantity_sample samples[],
+			size_t max_samples);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SHD_FILTER_H_ */
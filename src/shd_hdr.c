@@ -30,6 +30,7 @@
  */
 
 #include <errno.h>
+#include <stdint.h>
 #include <string.h>		/* for memcpy function */
 #include <stdlib.h>		/* For memory allocation functions */
 #include <sys/types.h>
@@ -39,7 +40,8 @@
 #include "libshdata.h"
 
 
-int shd_hdr_write(void *hdr_start, const struct shd_hdr_user_info *user_hdr)
+int shd_hdr_write(void *hdr_start, const struct shd_hdr_user_info *user_hdr,
+			uint64_t flags)
 {
 	int ret;
 	struct shd_hdr *hdr = hdr_start;
@@ -60,12 +62,16 @@ int shd_hdr_write(void *hdr_start, const struct shd_hdr_user_info *user_hdr)
 	hdr->magic_number = SHD_MAGIC_NUMBER;
 	hdr->lib_version_maj = SHD_VERSION_MAJOR;
 	hdr->lib_version_min = SHD_VERSION_MINOR;
+	hdr->flags = flags & ~SHD_HDR_FLAG_LARGE_SECTION;
+	if (shd_section_get_total_size(user_hdr,
+			(flags & SHD_HDR_FLAG_DIRTY_MAP) != 0) > UINT32_MAX)
+		hdr->flags |= SHD_HDR_FLAG_LARGE_SECTION;
 
 	return ret;
 }
 
 int shd_hdr_read(const struct shd_section_id *id, void *hdr_start,
-			struct shd_hdr_user_info *hdr_user)
+			struct shd_hdr_user_info *hdr_user, uint64_t *flags)
 {
 	int ret;
 
@@ -78,14 +84,20 @@ int shd_hdr_read(const struct shd_section_id *id, void *hdr_start,
 		struct shd_hdr *hdr = hdr_start;
 
 		memcpy(hdr_user, &hdr->user_info, sizeof(*hdr_user));
+		if (flags != NULL)
+			*flags = hdr->flags;
 	} else {
 		struct shd_hdr hdr;
 
 		ret = (*id->backend.hdr_read) (&hdr, id->instance);
+		if (ret < 0)
+			goto exit;
 
 		/* Copy the header and library version into user own memory in
-		 * all cases, then unmap the shared memory region */
+		 * all cases */
 		memcpy(hdr_user, &hdr.user_info, sizeof(*hdr_user));
+		if (flags != NULL)
+			*flags = hdr.flags;
 
 		/* Check whether the section that was read and is supposed to
 		 * be a shared memory section is a shared memory section indeed.
@@ -99,9 +111,7 @@ int shd_hdr_read(const struct shd_section_id *id, void *hdr_start,
 
 		/* If the library version registered in the shared memory
 		 * region does not match the one we are using, return an error.
-		 * The memcpy was therefore useless but is completely harmless,
-		 * and the code to remove the mapping from memory is kept
-		 * common.
+		 * The memcpy was therefore useless but is completely harmless.
 		 */
 		if (hdr.lib_version_maj != SHD_VERSION_MAJOR) {
 			ULOGE("Trying to read a section created with another "
@@ -110,6 +120,15 @@ int shd_hdr_read(const struct shd_section_id *id, void *hdr_start,
 			ret = -EFAULT;
 			goto exit;
 		}
+
+		/* A large section cannot be addressed with a 32-bit size_t */
+		if ((hdr.flags & SHD_HDR_FLAG_LARGE_SECTION)
+				&& SIZE_MAX <= UINT32_MAX) {
+			ULOGE("Section is too large to be mapped by this "
+				"process");
+			ret = -EFBIG;
+			goto exit;
+		}
 	}
 	ret = 0;
 
@@ -117,6 +136,35 @@ exit:
 	return ret;
 }
 
+bool shd_hdr_is_compatible(const void *hdr_start)
+{
+	const struct shd_hdr *hdr = hdr_start;
+
+	return hdr->magic_number == SHD_MAGIC_NUMBER
+			&& hdr->lib_version_maj == SHD_VERSION_MAJOR;
+}
+
+bool shd_hdr_has_dirty_map(const void *hdr_start)
+{
+	const struct shd_hdr *hdr = hdr_start;
+
+	return (hdr->flags & SHD_HDR_FLAG_DIRTY_MAP) != 0;
+}
+
+bool shd_hdr_has_record_ring(const void *hdr_start)
+{
+	const struct shd_hdr *hdr = hdr_start;
+
+	return (hdr->flags & SHD_HDR_FLAG_RECORD_RING) != 0;
+}
+
+bool shd_hdr_has_tiers(const void *hdr_start)
+{
+	const struct shd_hdr *hdr = hdr_start;
+
+	return (hdr->flags & SHD_HDR_FLAG_TIERS) != 0;
+}
+
 size_t shd_hdr_get_mdata_size(void *hdr_start)
 {
 	struct shd_hdr_user_info *hdr = hdr_start;
@@ -37,10 +37,24 @@ extern "C" {
 #endif
 
 #include <stddef.h>
+#include <stdbool.h>
 #include "shd_sync.h"
 #include "shd_section.h"
 #include "libshdata.h"
 
+/* Section format flags */
+/* Section is larger than 4 GiB : it can only be mapped by processes with a
+ * 64-bit address space */
+#define SHD_HDR_FLAG_LARGE_SECTION	(1 << 0)
+/* Section holds a dirty map after its data section (see shd_dirty.h) */
+#define SHD_HDR_FLAG_DIRTY_MAP		(1 << 1)
+/* Section holds variable-length records, its blob metadata header being a
+ * byte ring (see shd_rec.h) */
+#define SHD_HDR_FLAG_RECORD_RING	(1 << 2)
+/* Section has downsampled tiers, which are sections of their own (see
+ * shd_tier.h) */
+#define SHD_HDR_FLAG_TIERS		(1 << 3)
+
 struct shd_hdr {
 	/* Magic number */
 	uint64_t magic_number;
@@ -48,6 +62,9 @@ struct shd_hdr {
 	uint32_t lib_version_maj;
 	/* Library version minor */
 	uint32_t lib_version_min;
+	/* Section format flags (SHD_HDR_FLAG_*). Kept before user info so that
+	 * its offset does not depend on the size of size_t */
+	uint64_t flags;
 	/* user-defined info */
 	struct shd_hdr_user_info user_info;
 	/* sync-related info */
@@ -62,12 +79,16 @@ struct shd_hdr {
  *
  * @param[in] hdr_start : pointer to the start of the shared memory header
  * @param[in] hdr : pointer to the memory structure describing the header
+ * @param[in] flags : section format flags (SHD_HDR_FLAG_DIRTY_MAP,
+ * SHD_HDR_FLAG_RECORD_RING, SHD_HDR_FLAG_TIERS), SHD_HDR_FLAG_LARGE_SECTION
+ * being set according to the size of the section
  *
  * @return : 0 if the header that was already present in the memory section
  * was already filled with the new header value,
  *           -1 otherwise
  */
-int shd_hdr_write(void *hdr_start, const struct shd_hdr_user_info *hdr);
+int shd_hdr_write(void *hdr_start, const struct shd_hdr_user_info *hdr,
+			uint64_t flags);
 
 /*
  * @brief Copy user info from header of shared memory section
@@ -81,16 +102,58 @@ int shd_hdr_write(void *hdr_start, const struct shd_hdr_user_info *hdr);
  * @param[in] hdr_start : pointer to the start of the shared memory header
  * @param[out] hdr_user : pointer to a user-allocated destination buffer for
  * the user info
+ * @param[out] flags : section format flags (SHD_HDR_FLAG_*), can be NULL
  *
  * @return : 0 in case of success,
  *           -EINVAL if the arguments are invalid
  *           -ENOMEM if the header could not be mapped
  *           -EFAULT if the shared memory section was created using another
  * library version, or the mapped memory section is not a shared memory section
+ *           -EFBIG if the section is too large to be mapped by this process
  */
 int shd_hdr_read(const struct shd_section_id *id,
 			void *hdr_start,
-			struct shd_hdr_user_info *hdr_user);
+			struct shd_hdr_user_info *hdr_user,
+			uint64_t *flags);
+
+/*
+ * @brief Check whether a section header was written by a compatible version
+ * of the library
+ *
+ * @param[in] hdr_start : pointer to the start of the shared memory header
+ *
+ * @return : true if the section has a layout known by this library,
+ *           false otherwise
+ */
+bool shd_hdr_is_compatible(const void *hdr_start);
+
+/*
+ * @brief Check whether a section holds a dirty map
+ *
+ * @param[in] hdr_start : pointer to the start of the shared memory header
+ *
+ * @return : true if the producer of the section tracks the quantities
+ * written in each sample, false otherwise
+ */
+bool shd_hdr_has_dirty_map(const void *hdr_start);
+
+/*
+ * @brief Check whether a section holds variable-length records
+ *
+ * @param[in] hdr_start : pointer to the start of the shared memory header
+ *
+ * @return : true if the section was created with shd_rec_create(),
+ *           false otherwise
+ */
+bool shd_hdr_has_record_ring(const void *hdr_start);
+
+/*
+ * @brief Check whether a section has downsampled tiers
+ * @param[in] hdr_start : pointer to the start of the shared memory header
+ * @return : true if the section was created with shd_create_tiered(),
+ *           false otherwise
+ */
+bool shd_hdr_has_tiers(const void *hdr_start);
 
 /*
  * @brief Get size of metadata header
@@ -0,0 +1,176 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_rate.c
+ *
+ * @brief Wait for the next sample at the date it is expected.
+ *
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include "shd_private.h"
+#include "shd_rate.h"
+
+/* Minimum spin margin around the expected date of a commit, which covers the
+ * wake-up latency of the consumer */
+#define SPIN_MIN_NS		20000
+/* Maximum spin margin : producers which deviate more than this from their
+ * expected dates are waited for without spinning */
+#define SPIN_MAX_NS		200000
+/* Weight of the latest deviation in the mean deviation, as a power of two */
+#define JITTER_SHIFT		3
+
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define cpu_relax() __asm__ __volatile__("yield")
+#else
+#define cpu_relax() do {} while (0)
+#endif
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void ns_to_timespec(uint64_t ns, struct timespec *ts)
+{
+	ts->tv_sec = ns / 1000000000ULL;
+	ts->tv_nsec = ns % 1000000000ULL;
+}
+
+static void update_jitter(struct shd_rate *rate, uint64_t seen,
+				uint64_t expected)
+{
+	int64_t dev = seen > expected ? seen - expected : expected - seen;
+
+	rate->jitter_ns += (dev - (int64_t)rate->jitter_ns)
+			/ (1 << JITTER_SHIFT);
+}
+
+/* Wait for the next commit without spinning */
+static int wait_commit(struct shd_rate *rate, struct shd_sync_hdr *hdr,
+			uint32_t *seq, const struct timespec *timeout)
+{
+	int ret;
+
+	ret = shd_sync_wait_commit(&hdr, seq, 1, timeout);
+	if (ret > 0)
+		rate->seen_ns = now_ns();
+
+	return ret;
+}
+
+int shd_rate_wait(struct shd_rate *rate, struct shd_sync_hdr *hdr,
+			uint64_t period_ns, uint32_t *seq,
+			const struct timespec *timeout)
+{
+	uint64_t timeout_ns = UINT64_MAX;
+	uint64_t now, expected, margin, wake;
+	struct timespec date;
+	uint32_t cur;
+	int ret;
+
+	if (timeout != NULL)
+		timeout_ns = (uint64_t)timeout->tv_sec * 1000000000ULL
+				+ timeout->tv_nsec;
+
+	now = now_ns();
+	cur = shd_sync_get_commit_seq(hdr);
+	if (cur != *seq) {
+		/* The commit was missed : assume it was on time, so that the
+		 * estimate stays in phase with the producer */
+		if (rate->seen_ns == 0 || period_ns == 0)
+			rate->seen_ns = now;
+		else if (now >= rate->seen_ns + period_ns)
+			rate->seen_ns += (now - rate->seen_ns) / period_ns
+					* period_ns;
+		*seq = cur;
+		return 1;
+	}
+
+	if (period_ns == 0 || rate->seen_ns == 0)
+		return wait_commit(rate, hdr, seq, timeout);
+
+	margin = 2 * rate->jitter_ns + SPIN_MIN_NS;
+	if (margin > SPIN_MAX_NS) {
+		/* Too irregular a producer for spinning : the jitter decays
+		 * meanwhile, so that spinning is tried again once in a
+		 * while */
+		update_jitter(rate, 0, 0);
+		return wait_commit(rate, hdr, seq, timeout);
+	}
+	if (margin > period_ns / 2)
+		margin = period_ns / 2;
+
+	/* Skip the dates at which the producer did not commit */
+	expected = rate->seen_ns + period_ns;
+	if (expected + margin <= now)
+		expected += ((now - expected - margin) / period_ns + 1)
+				* period_ns;
+
+	wake = expected - margin;
+	if (wake > now) {
+		ns_to_timespec(wake < timeout_ns ? wake : timeout_ns, &date);
+		ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &date,
+				NULL);
+		if (ret == EINTR)
+			return -EINTR;
+	}
+
+	/* Spin around the expected date */
+	while ((cur = shd_sync_get_commit_seq(hdr)) == *seq) {
+		now = now_ns();
+		if (now >= timeout_ns)
+			return -ETIMEDOUT;
+		if (now >= expected + margin)
+			break;
+		cpu_relax();
+	}
+
+	if (cur != *seq) {
+		now = now_ns();
+		update_jitter(rate, now, expected);
+		rate->seen_ns = now;
+		*seq = cur;
+		return 1;
+	}
+
+	/* The producer is late : wait for it the usual way */
+	ret = shd_sync_wait_commit(&hdr, seq, 1, timeout);
+	if (ret > 0) {
+		now = now_ns();
+		update_jitter(rate, now, expected);
+		rate->seen_ns = now;
+	}
+
+	return ret;
+}
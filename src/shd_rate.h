@@ -0,0 +1,87 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_rate.h
+ *
+ * @brief Wait for the next sample at the date it is expected.
+ *
+ * @details Consumers which do not rely on commit notifications sleep until
+ * shortly before the next commit is expected, then spin on the commit
+ * sequence number. The expected date is the date at which the latest commit
+ * was seen plus the period of the producer, and the spin margin follows the
+ * deviation of the commits from their expected dates. Beyond a maximum
+ * margin, consumers wait for the commits without spinning.
+ *
+ */
+
+#ifndef _SHD_RATE_H_
+#define _SHD_RATE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <time.h>
+#include "shd_sync.h"
+
+/*
+ * @brief Estimate of the commit dates of a section, kept by a consumer
+ */
+struct shd_rate {
+	/* CLOCK_MONOTONIC date at which the latest commit was seen, in
+	 * nanoseconds, 0 if none was seen yet */
+	uint64_t seen_ns;
+	/* mean deviation of the commits from their expected dates, in
+	 * nanoseconds */
+	uint64_t jitter_ns;
+};
+
+/*
+ * @brief Wait until the next commit in a section, sleeping until shortly
+ * before it is expected
+ *
+ * @param[in,out] rate : estimate of the commit dates of the section
+ * @param[in] hdr : pointer to the synchronization part of the section header
+ * @param[in] period_ns : period of the producer, 0 if unknown (the wait then
+ * falls back to shd_sync_wait_commit())
+ * @param[in,out] seq : commit sequence number last seen by the caller,
+ * updated on return
+ * @param[in] timeout : absolute CLOCK_MONOTONIC date, NULL to wait forever
+ *
+ * @return : 1 if a commit occurred since *seq,
+ *           -ETIMEDOUT if timeout was reached,
+ *           -EINTR if the wait was interrupted by a signal
+ */
+int shd_rate_wait(struct shd_rate *rate, struct shd_sync_hdr *hdr,
+			uint64_t period_ns, uint32_t *seq,
+			const struct timespec *timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SHD_RATE_H_ */
@@ -0,0 +1,200 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_rec.c
+ *
+ * @brief Variable-length records stored in a byte ring.
+ *
+ * @details Layout of the byte ring :
+ *   - header holding the size of the ring and the positions of its first
+ *   valid byte and of its end ;
+ *   - the ring itself, in which records are written one after the other,
+ *   each one being preceded by a record header and padded to 8 bytes. A
+ *   record may wrap around the end of the ring.
+ * Positions count the bytes written since the creation of the section, so
+ * that a consumer can tell whether a record has been overwritten by comparing
+ * its position with the position of the first valid byte.
+ * Only fixed-size types are used, so that processes with 32-bit and 64-bit
+ * address spaces agree on the layout.
+ *
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include "shd_private.h"
+#include "shd_utils.h"
+#include "shd_rec.h"
+
+struct shd_rec_ring_hdr {
+	/* number of bytes available for the records */
+	uint64_t ring_size;
+	/* position of the first byte which has not been overwritten */
+	uint64_t tail;
+	/* position of the end of the latest record */
+	uint64_t head;
+	/* sequence number of the next record */
+	uint64_t next_seq;
+};
+
+struct shd_rec_hdr {
+	/* sequence number of the record */
+	uint64_t seq;
+	/* record timestamp */
+	int64_t ts_sec;
+	int64_t ts_nsec;
+	/* length of the record data */
+	uint32_t len;
+	uint32_t reserved;
+};
+
+static char *get_ring(const void *rec_top)
+{
+	return (char *)rec_top + sizeof(struct shd_rec_ring_hdr);
+}
+
+static uint64_t get_record_size(size_t len)
+{
+	return ALIGN(sizeof(struct shd_rec_hdr) + (uint64_t) len, 8);
+}
+
+/* Copy to the ring, wrapping around its end */
+static void ring_write(char *ring, uint64_t ring_size, uint64_t pos,
+			const void *src, size_t size)
+{
+	size_t offset = pos % ring_size;
+	size_t first = size < ring_size - offset ? size : ring_size - offset;
+
+	memcpy(ring + offset, src, first);
+	memcpy(ring, (const char *)src + first, size - first);
+}
+
+/* Copy from the ring, wrapping around its end */
+static void ring_read(const char *ring, uint64_t ring_size, uint64_t pos,
+			void *dst, size_t size)
+{
+	size_t offset = pos % ring_size;
+	size_t first = size < ring_size - offset ? size : ring_size - offset;
+
+	memcpy(dst, ring + offset, first);
+	memcpy((char *)dst + first, ring, size - first);
+}
+
+size_t shd_rec_get_size(size_t ring_size)
+{
+	if (ring_size < sizeof(struct shd_rec_hdr) || ring_size > SIZE_MAX / 2)
+		return -1;
+
+	return sizeof(struct shd_rec_ring_hdr) + ALIGN(ring_size, 8);
+}
+
+void shd_rec_init(void *rec_top, size_t ring_size)
+{
+	struct shd_rec_ring_hdr *hdr = rec_top;
+
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->ring_size = ALIGN(ring_size, 8);
+}
+
+size_t shd_rec_get_max_len(const void *rec_top)
+{
+	const struct shd_rec_ring_hdr *hdr = rec_top;
+
+	if (hdr->ring_size < sizeof(struct shd_rec_hdr))
+		return 0;
+
+	return hdr->ring_size - sizeof(struct shd_rec_hdr);
+}
+
+void shd_rec_append(void *rec_top, const struct timespec *ts,
+			const void *data, size_t len,
+			struct shd_rec_index *index)
+{
+	struct shd_rec_ring_hdr *hdr = rec_top;
+	struct shd_rec_hdr rec_hdr = {
+		.seq = hdr->next_seq,
+		.ts_sec = ts->tv_sec,
+		.ts_nsec = ts->tv_nsec,
+		.len = len,
+	};
+	uint64_t pos = hdr->head;
+	uint64_t end = pos + get_record_size(len);
+
+	/* Consumers must see that the oldest records are gone before their
+	 * bytes are overwritten */
+	if (end - hdr->tail > hdr->ring_size) {
+		hdr->tail = end - hdr->ring_size;
+		__sync_synchronize();
+	}
+
+	ring_write(get_ring(rec_top), hdr->ring_size, pos, &rec_hdr,
+			sizeof(rec_hdr));
+	ring_write(get_ring(rec_top), hdr->ring_size, pos + sizeof(rec_hdr),
+			data, len);
+
+	__atomic_store_n(&hdr->head, end, __ATOMIC_RELEASE);
+	hdr->next_seq++;
+
+	index->pos = pos;
+	index->seq = rec_hdr.seq;
+	index->len = len;
+	index->reserved = 0;
+}
+
+int shd_rec_copy(const void *rec_top, const struct shd_rec_index *index,
+			struct shd_rec_record *record, void *dst)
+{
+	const struct shd_rec_ring_hdr *hdr = rec_top;
+	struct shd_rec_hdr rec_hdr;
+	uint64_t ring_size = hdr->ring_size;
+	uint64_t tail;
+
+	/* The index may have been overwritten while it was read : the read
+	 * sequence would then fail, but the copy must stay within bounds */
+	if (ring_size == 0 || index->len > shd_rec_get_max_len(rec_top))
+		return -EFAULT;
+
+	ring_read(get_ring(rec_top), ring_size, index->pos, &rec_hdr,
+			sizeof(rec_hdr));
+	ring_read(get_ring(rec_top), ring_size, index->pos + sizeof(rec_hdr),
+			dst, index->len);
+
+	/* The copy is only valid if the record was not overwritten until its
+	 * end, which is checked once all its bytes have been read */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	tail = __atomic_load_n(&hdr->tail, __ATOMIC_RELAXED);
+	if (index->pos < tail || rec_hdr.seq != index->seq
+			|| rec_hdr.len != index->len)
+		return -EFAULT;
+
+	record->seq = rec_hdr.seq;
+	record->ts.tv_sec = rec_hdr.ts_sec;
+	record->ts.tv_nsec = rec_hdr.ts_nsec;
+	record->data = dst;
+	record->len = rec_hdr.len;
+
+	return 0;
+}
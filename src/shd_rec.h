@@ -0,0 +1,127 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_rec.h
+ *
+ * @brief Variable-length records stored in a byte ring.
+ *
+ * @details In a record section, each record is copied into a byte ring, with
+ * a header holding its sequence number, timestamp and length. The byte ring
+ * takes the place of the blob metadata header. The samples of the section
+ * form the timestamp index of the records : their blob is a struct
+ * shd_rec_index, which locates a record in the byte ring, so that records are
+ * searched like any other samples.
+ *
+ */
+
+#ifndef _SHD_REC_H_
+#define _SHD_REC_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "libshdata.h"
+
+/*
+ * Blob of the samples of a record section
+ */
+struct shd_rec_index {
+	/* position of the record in the byte stream written since the
+	 * creation of the section */
+	uint64_t pos;
+	/* sequence number of the record */
+	uint64_t seq;
+	/* length of the record data */
+	uint32_t len;
+	uint32_t reserved;
+};
+
+/*
+ * @brief Get the size of the byte ring of a record section, including its
+ * header
+ *
+ * @param[in] ring_size : number of bytes available for the records
+ *
+ * @return : size of the byte ring,
+ *           (size_t) -1 if ring_size is too small to hold a record, or if the
+ * byte ring can not be addressed by this process
+ */
+size_t shd_rec_get_size(size_t ring_size);
+
+/*
+ * @brief Initialize an empty byte ring
+ *
+ * @param[in] rec_top : pointer to the start of the byte ring
+ * @param[in] ring_size : number of bytes available for the records
+ */
+void shd_rec_init(void *rec_top, size_t ring_size);
+
+/*
+ * @brief Get the maximum length of a record
+ *
+ * @param[in] rec_top : pointer to the start of the byte ring
+ *
+ * @return : maximum length of the data of a record
+ */
+size_t shd_rec_get_max_len(const void *rec_top);
+
+/*
+ * @brief Append a record to the byte ring, overwriting the oldest records if
+ * required
+ *
+ * @param[in] rec_top : pointer to the start of the byte ring
+ * @param[in] ts : record timestamp
+ * @param[in] data : record data
+ * @param[in] len : length of the record data, at most
+ * shd_rec_get_max_len()
+ * @param[out] index : location of the new record
+ */
+void shd_rec_append(void *rec_top, const struct timespec *ts,
+			const void *data, size_t len,
+			struct shd_rec_index *index);
+
+/*
+ * @brief Copy a record out of the byte ring
+ *
+ * @param[in] rec_top : pointer to the start of the byte ring
+ * @param[in] index : location of the record
+ * @param[out] record : description of the copied record
+ * @param[out] dst : destination buffer, at least index->len bytes long
+ *
+ * @return : 0 in case of success,
+ *           -EFAULT if the record was overwritten before or during the copy
+ */
+int shd_rec_copy(const void *rec_top, const struct shd_rec_index *index,
+			struct shd_rec_record *record, void *dst);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SHD_REC_H_ */
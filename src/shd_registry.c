@@ -0,0 +1,477 @@
+/*
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_registry.c
+ *
+ * @brief Registry of the sections created on the system.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>		/* For error codes */
+#include <fcntl.h>		/* For O_* constants */
+#include <signal.h>		/* For kill */
+#include <stdlib.h>		/* For getenv */
+#include <string.h>		/* String operations */
+#include <stdint.h>		/* SIZE_MAX */
+#include <unistd.h>		/* For ftruncate */
+#include <sys/file.h>		/* for flock */
+#include <sys/mman.h>		/* For shm and PROT flags */
+#include <sys/stat.h>		/* For fstat */
+#include "shd_private.h"
+#include "shd_registry.h"
+#include "backend/shd_shm.h"
+#include "backend/shd_dev_mem.h"
+
+/* Does not start with the prefix of the sections, so that it can not collide
+ * with a blob name */
+#define SHD_REGISTRY_PATH		"/shd-registry"
+#define SHD_REGISTRY_MAGIC		0x73686472
+#define SHD_REGISTRY_VERSION		2
+/* Must be a power of two */
+#define SHD_REGISTRY_NB_ENTRIES		1024
+/* Maximum number of attempts to read an entry which is being written */
+#define SHD_REGISTRY_READ_RETRIES	1000
+/* Reserved hash values : the entry has never been used, or it has been
+ * removed (in which case lookups must go on probing past it) */
+#define SHD_REGISTRY_HASH_FREE		0
+#define SHD_REGISTRY_HASH_REMOVED	1
+
+/* Only fixed-size fields, so that the registry can be shared by 32-bit and
+ * 64-bit processes */
+struct shd_registry_entry {
+	/* Sequence counter : odd while the entry is being written */
+	uint32_t seq;
+	/* Hash of the blob name, or one of the reserved hash values */
+	uint32_t hash;
+	char name[SHD_SECTION_NAME_MAX];
+	uint32_t backend;
+	int32_t revision;
+	int32_t producer_pid;
+	uint32_t max_nb_samples;
+	uint32_t rate;
+	uint32_t reserved;
+	uint64_t size;
+	uint64_t blob_size;
+	uint64_t blob_metadata_hdr_size;
+};
+
+struct shd_registry {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t nb_entries;
+	uint32_t nb_used;
+	struct shd_registry_entry entries[SHD_REGISTRY_NB_ENTRIES];
+};
+
+static inline uint32_t read_u32(const uint32_t *ptr)
+{
+	return *(const volatile uint32_t *)ptr;
+}
+
+/* FNV-1a hash of the blob name */
+static uint32_t name_hash(const char *blob_name)
+{
+	uint32_t hash = 2166136261u;
+
+	while (*blob_name != '\0') {
+		hash ^= (uint8_t)*blob_name++;
+		hash *= 16777619u;
+	}
+
+	/* Do not collide with the reserved values */
+	return hash > SHD_REGISTRY_HASH_REMOVED ? hash : hash + 2;
+}
+
+static inline bool hash_is_used(uint32_t hash)
+{
+	return hash > SHD_REGISTRY_HASH_REMOVED;
+}
+
+/* The name of the registry can be overridden, e.g. so that tests do not
+ * alter the registry of the system */
+static const char *registry_path(void)
+{
+	const char *path = getenv("LIBSHDATA_CONFIG_INTERNAL_REGISTRY");
+
+	return path != NULL ? path : SHD_REGISTRY_PATH;
+}
+
+static bool producer_is_alive(pid_t pid)
+{
+	return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+static bool registry_is_valid(const struct shd_registry *reg)
+{
+	return reg->magic == SHD_REGISTRY_MAGIC
+			&& reg->version == SHD_REGISTRY_VERSION
+			&& reg->nb_entries == SHD_REGISTRY_NB_ENTRIES;
+}
+
+static enum shd_section_backend_type
+get_backend_type(const struct shd_section_id *id)
+{
+	if (id->backend.open == shd_shm_backend.open)
+		return SHD_SECTION_BACKEND_SHM;
+	else if (id->backend.open == shd_dev_mem_backend.open)
+		return SHD_SECTION_BACKEND_DEV_MEM;
+	else
+		return SHD_SECTION_BACKEND_OTHER;
+}
+
+/*
+ * Copy an entry that may be concurrently written by a producer
+ */
+static int read_entry(const struct shd_registry_entry *entry,
+			struct shd_section_info *info)
+{
+	struct shd_registry_entry copy;
+	uint32_t seq;
+	int i;
+
+	for (i = 0; i < SHD_REGISTRY_READ_RETRIES; i++) {
+		seq = read_u32(&entry->seq);
+		if (seq & 1)
+			continue;
+		__sync_synchronize();
+		memcpy(&copy, entry, sizeof(copy));
+		__sync_synchronize();
+		if (read_u32(&entry->seq) == seq)
+			break;
+	}
+	if (i == SHD_REGISTRY_READ_RETRIES)
+		return -EAGAIN;
+
+	/* Removed or reused in the meantime */
+	if (!hash_is_used(copy.hash))
+		return -ENOENT;
+
+	if (copy.blob_size > SIZE_MAX
+			|| copy.blob_metadata_hdr_size > SIZE_MAX)
+		return -EFBIG;
+
+	memcpy(info->name, copy.name, sizeof(info->name));
+	info->name[sizeof(info->name) - 1] = '\0';
+	info->backend = copy.backend;
+	info->size = copy.size;
+	info->revision = copy.revision;
+	info->producer_pid = copy.producer_pid;
+	info->hdr_info.blob_size = copy.blob_size;
+	info->hdr_info.max_nb_samples = copy.max_nb_samples;
+	info->hdr_info.rate = copy.rate;
+	info->hdr_info.blob_metadata_hdr_size = copy.blob_metadata_hdr_size;
+
+	return 0;
+}
+
+/*
+ * Find the entry of a blob. If the blob is not registered and reusable is not
+ * NULL, it is set to the entry where it should be added : the first removed
+ * entry, or the first entry left behind by a producer which is gone, or else
+ * the free entry which ends the probe sequence. Only called by producers, with
+ * the registry lock taken
+ */
+static struct shd_registry_entry *find_entry_locked(struct shd_registry *reg,
+				const char *blob_name,
+				uint32_t hash,
+				struct shd_registry_entry **reusable)
+{
+	struct shd_registry_entry *entry;
+	uint32_t mask = SHD_REGISTRY_NB_ENTRIES - 1;
+	uint32_t i;
+
+	if (reusable != NULL)
+		*reusable = NULL;
+
+	for (i = 0; i < SHD_REGISTRY_NB_ENTRIES; i++) {
+		entry = &reg->entries[(hash + i) & mask];
+		if (entry->hash == SHD_REGISTRY_HASH_FREE)
+			break;
+		if (entry->hash == hash && !strcmp(entry->name, blob_name))
+			return entry;
+		if (reusable != NULL && *reusable == NULL
+				&& (entry->hash == SHD_REGISTRY_HASH_REMOVED
+				|| !producer_is_alive(entry->producer_pid)))
+			*reusable = entry;
+	}
+
+	if (reusable != NULL && *reusable == NULL
+			&& i < SHD_REGISTRY_NB_ENTRIES)
+		*reusable = entry;
+
+	return NULL;
+}
+
+static int map_registry_locked(int fd, struct shd_registry **reg)
+{
+	struct stat st;
+	void *ptr;
+
+	if (fstat(fd, &st) < 0)
+		return -errno;
+
+	if ((size_t)st.st_size != sizeof(**reg)
+			&& ftruncate(fd, sizeof(**reg)) < 0)
+		return -errno;
+
+	ptr = mmap(NULL, sizeof(**reg), PROT_READ | PROT_WRITE, MAP_SHARED,
+			fd, 0);
+	if (ptr == MAP_FAILED)
+		return -errno;
+
+	*reg = ptr;
+
+	/* Either a new registry, or one left behind by another version of the
+	 * library */
+	if (!registry_is_valid(*reg)) {
+		ULOGI("Initializing section registry");
+		memset(*reg, 0, sizeof(**reg));
+		(*reg)->version = SHD_REGISTRY_VERSION;
+		(*reg)->nb_entries = SHD_REGISTRY_NB_ENTRIES;
+		__sync_synchronize();
+		(*reg)->magic = SHD_REGISTRY_MAGIC;
+	}
+
+	return 0;
+}
+
+static void unlock_registry(int fd, struct shd_registry *reg)
+{
+	if (reg != NULL)
+		munmap(reg, sizeof(*reg));
+	flock(fd, LOCK_UN);
+	close(fd);
+}
+
+/*
+ * Open, lock and map the registry for writing, creating it if needed
+ */
+static int lock_registry(int *fd, struct shd_registry **reg)
+{
+	int ret;
+
+	*reg = NULL;
+	*fd = shm_open(registry_path(), O_CREAT | O_RDWR, 0666);
+	if (*fd < 0)
+		return -errno;
+
+	if (flock(*fd, LOCK_EX) < 0) {
+		ret = -errno;
+		close(*fd);
+		return ret;
+	}
+
+	ret = map_registry_locked(*fd, reg);
+	if (ret < 0) {
+		unlock_registry(*fd, NULL);
+		return ret;
+	}
+
+	return 0;
+}
+
+int shd_registry_add(const char *blob_name,
+			const struct shd_section_id *id,
+			const struct shd_hdr_user_info *hdr_info,
+			size_t size,
+			int revision)
+{
+	struct shd_registry *reg;
+	struct shd_registry_entry *entry, *reusable;
+	uint32_t hash;
+	int fd;
+	int ret;
+
+	if (strlen(blob_name) >= SHD_SECTION_NAME_MAX)
+		return -ENAMETOOLONG;
+
+	ret = lock_registry(&fd, &reg);
+	if (ret < 0)
+		return ret;
+
+	hash = name_hash(blob_name);
+	entry = find_entry_locked(reg, blob_name, hash, &reusable);
+	if (entry == NULL)
+		entry = reusable;
+	if (entry == NULL) {
+		ret = -ENOSPC;
+		goto unlock;
+	}
+
+	entry->seq++;
+	__sync_synchronize();
+	/* The entry may be reused for another blob : make sure that readers do
+	 * not match its former name while it is being written */
+	if (entry->hash != hash && hash_is_used(entry->hash)) {
+		entry->hash = SHD_REGISTRY_HASH_REMOVED;
+		reg->nb_used--;
+		__sync_synchronize();
+	}
+	memcpy(entry->name, blob_name, strlen(blob_name) + 1);
+	entry->backend = get_backend_type(id);
+	entry->revision = revision;
+	entry->producer_pid = getpid();
+	entry->size = size;
+	entry->blob_size = hdr_info->blob_size;
+	entry->max_nb_samples = hdr_info->max_nb_samples;
+	entry->rate = hdr_info->rate;
+	entry->blob_metadata_hdr_size = hdr_info->blob_metadata_hdr_size;
+	__sync_synchronize();
+	if (entry->hash != hash) {
+		entry->hash = hash;
+		reg->nb_used++;
+	}
+	__sync_synchronize();
+	entry->seq++;
+
+	ret = 0;
+
+unlock:
+	unlock_registry(fd, reg);
+	return ret;
+}
+
+int shd_registry_remove(const char *blob_name, int revision)
+{
+	struct shd_registry *reg;
+	struct shd_registry_entry *entry;
+	int fd;
+	int ret;
+
+	ret = lock_registry(&fd, &reg);
+	if (ret < 0)
+		return ret;
+
+	/* The section may have been re-created by another producer since */
+	entry = find_entry_locked(reg, blob_name, name_hash(blob_name), NULL);
+	if (entry == NULL || entry->revision != revision
+			|| entry->producer_pid != getpid()) {
+		ret = -ENOENT;
+		goto unlock;
+	}
+
+	entry->seq++;
+	__sync_synchronize();
+	entry->hash = SHD_REGISTRY_HASH_REMOVED;
+	reg->nb_used--;
+	__sync_synchronize();
+	entry->seq++;
+
+	ret = 0;
+
+unlock:
+	unlock_registry(fd, reg);
+	return ret;
+}
+
+struct shd_registry *shd_registry_open(void)
+{
+	struct shd_registry *reg;
+	struct stat st;
+	void *ptr;
+	int fd;
+
+	fd = shm_open(registry_path(), O_RDONLY, 0);
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(*reg)) {
+		close(fd);
+		return NULL;
+	}
+
+	ptr = mmap(NULL, sizeof(*reg), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (ptr == MAP_FAILED)
+		return NULL;
+
+	reg = ptr;
+	if (!registry_is_valid(reg)) {
+		munmap(reg, sizeof(*reg));
+		return NULL;
+	}
+
+	return reg;
+}
+
+void shd_registry_close(struct shd_registry *reg)
+{
+	if (reg != NULL)
+		munmap(reg, sizeof(*reg));
+}
+
+int shd_registry_find(const struct shd_registry *reg,
+			const char *blob_name,
+			struct shd_section_info *info)
+{
+	const struct shd_registry_entry *entry;
+	uint32_t mask = SHD_REGISTRY_NB_ENTRIES - 1;
+	uint32_t hash = name_hash(blob_name);
+	uint32_t entry_hash;
+	uint32_t i;
+
+	for (i = 0; i < SHD_REGISTRY_NB_ENTRIES; i++) {
+		entry = &reg->entries[(hash + i) & mask];
+		entry_hash = read_u32(&entry->hash);
+		if (entry_hash == SHD_REGISTRY_HASH_FREE)
+			break;
+		if (entry_hash != hash)
+			continue;
+		if (read_entry(entry, info) == 0
+				&& !strcmp(info->name, blob_name))
+			return 0;
+	}
+
+	return -ENOENT;
+}
+
+int shd_registry_list(const struct shd_registry *reg,
+			struct shd_section_info *infos,
+			size_t max_infos)
+{
+	const struct shd_registry_entry *entry;
+	size_t nb_sections = 0;
+	uint32_t i;
+
+	struct shd_section_info info;
+
+	for (i = 0; i < SHD_REGISTRY_NB_ENTRIES; i++) {
+		entry = &reg->entries[i];
+		if (!hash_is_used(read_u32(&entry->hash)))
+			continue;
+		/* Entries of producers which are gone without closing their
+		 * section are only reclaimed by the next registration */
+		if (read_entry(entry, &info) < 0
+				|| !producer_is_alive(info.producer_pid))
+			continue;
+		if (nb_sections < max_infos)
+			infos[nb_sections] = info;
+		nb_sections++;
+	}
+
+	return nb_sections;
+}
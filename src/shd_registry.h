@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * shd_registry.h
+ *
+ * @brief Registry of the sections created on the system.
+ *
+ * @details Each producer records the sections it creates in a shared memory
+ * segment (/dev/shm/shd-registry), which is an open addressing hash table
+ * indexed by blob name. An entry is removed when the producer which registered
+ * the section closes it. Entries left behind by producers which are gone
+ * without closing their section are not listed, and are reused by later
+ * registrations.
+ * Producers serialize their updates with a lock on the registry file, while
+ * consumers read it without locking : each entry is protected by a sequence
+ * counter which is odd while the entry is being written.
+ *
+ */
+
+#ifndef _SHD_REGISTRY_H_
+#define _SHD_REGISTRY_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "shd_section.h"
+#include "libshdata.h"
+
+struct shd_registry;
+
+/*
+ * @brief Record a section in the registry, or update its entry
+ *
+ * The registry is created if it does not exist yet.
+ *
+ * @param[in] blob_name : name of the blob
+ * @param[in] id : identifier of the section
+ * @param[in] hdr_info : header info of the section
+ * @param[in] size : total size of the section
+ * @param[in] revision : revision number of the section
+ *
+ * @return : 0 in case of success,
+ *           -ENAMETOOLONG if blob_name is too long to be registered,
+ *           -ENOSPC if the registry is full,
+ *           other negative errno in case of error
+ */
+int shd_registry_add(const char *blob_name,
+			const struct shd_section_id *id,
+			const struct shd_hdr_user_info *hdr_info,
+			size_t size,
+			int revision);
+
+/*
+ * @brief Remove a section from the registry
+ *
+ * Nothing is done if the section has been registered since by another
+ * producer, or with another revision number.
+ *
+ * @param[in] blob_name : name of the blob
+ * @param[in] revision : revision number under which the calling process
+ * registered the section
+ *
+ * @return : 0 in case of success,
+ *           -ENOENT if the section is not registered by the calling process
+ * with this revision number,
+ *           other negative errno in case of error
+ */
+int shd_registry_remove(const char *blob_name, int revision);
+
+/*
+ * @brief Map the registry for reading
+ *
+ * @return : the registry,
+ *           NULL if it does not exist or is not valid
+ */
+struct shd_registry *shd_registry_open(void);
+
+/*
+ * @brief Unmap the registry
+ *
+ * @param[in] reg : registry to unmap (can be NULL)
+ */
+void shd_registry_close(struct shd_registry *reg);
+
+/*
+ * @brief Find a section in the registry
+ *
+ * @param[in] reg : registry to look into
+ * @param[in] blob_name : name of the blob to look for
+ * @param[out] info : information about the section
+ *
+ * @return : 0 in case of success,
+ *           -ENOENT if the section is not registered
+ */
+int shd_registry_find(const struct shd_registry *reg,
+			const char *blob_name,
+			struct shd_section_info *info);
+
+/*
+ * @brief List the sections of the registry
+ *
+ * @param[in] reg : registry to look into
+ * @param[out] infos : array filled with information about the sections
+ * @param[in] max_infos : number of elements in infos
+ *
+ * @return : total number of registered sections whose producer is still
+ * alive (which can be greater than max_infos)
+ */
+int shd_registry_list(const struct shd_registry *reg,
+			struct shd_section_info *infos,
+			size_t max_infos);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SHD_REGISTRY_H_ */
@@ -30,12 +30,17 @@
  */
 
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>			/* for memcpy function */
 #include "futils/timetools.h"
 #include "shd_utils.h"
 #include "shd_private.h"
 #include "shd_sample.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 size_t shd_sample_get_size(size_t blob_size)
 {
 	return ALIGN_UP(offsetof(struct shd_sample, blob) + blob_size);
@@ -59,6 +64,74 @@ int shd_sample_write(struct shd_sample *sample,
 	return 0;
 }
 
+/* Streaming copies proceed by chunks of 64 bytes, i.e. one cache line */
+#define STREAM_CHUNK 64
+
+int shd_sample_write_stream(struct shd_sample *sample,
+				ptrdiff_t offset,
+				const void *src,
+				size_t length)
+{
+#if defined(__SSE2__) || defined(__aarch64__)
+	char *d = (char *)sample + offset;
+	const char *s = src;
+	size_t head = (STREAM_CHUNK - ((uintptr_t)d % STREAM_CHUNK))
+			% STREAM_CHUNK;
+
+	if (length < head + STREAM_CHUNK)
+		return shd_sample_write(sample, offset, src, length);
+
+	/* Bring the destination to a cache line boundary, so that each chunk
+	 * fills a whole line and never has to be merged with cached data */
+	memcpy(d, s, head);
+	d += head;
+	s += head;
+	length -= head;
+
+	for (; length >= STREAM_CHUNK; length -= STREAM_CHUNK) {
+#if defined(__SSE2__)
+		__m128i v0 = _mm_loadu_si128((const __m128i *)s);
+		__m128i v1 = _mm_loadu_si128((const __m128i *)(s + 16));
+		__m128i v2 = _mm_loadu_si128((const __m128i *)(s + 32));
+		__m128i v3 = _mm_loadu_si128((const __m128i *)(s + 48));
+
+		_mm_stream_si128((__m128i *)d, v0);
+		_mm_stream_si128((__m128i *)(d + 16), v1);
+		_mm_stream_si128((__m128i *)(d + 32), v2);
+		_mm_stream_si128((__m128i *)(d + 48), v3);
+#else
+		__asm__ volatile(
+			"ldp q0, q1, [%1]\n\t"
+			"ldp q2, q3, [%1, #32]\n\t"
+			"stnp q0, q1, [%0]\n\t"
+			"stnp q2, q3, [%0, #32]\n\t"
+			:
+			: "r" (d), "r" (s)
+			: "v0", "v1", "v2", "v3", "memory");
+#endif
+		d += STREAM_CHUNK;
+		s += STREAM_CHUNK;
+	}
+
+	memcpy(d, s, length);
+
+	return 0;
+#else
+	return shd_sample_write(sample, offset, src, length);
+#endif
+}
+
+void shd_sample_stream_fence(void)
+{
+#if defined(__SSE2__)
+	/* Streaming stores may become visible after later plain stores,
+	 * such as the ones publishing the sample */
+	_mm_sfence();
+#else
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+#endif
+}
+
 int shd_sample_timestamp_cmp(struct shd_sample *sample,
 				struct timespec date)
 {
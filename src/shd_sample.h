@@ -83,6 +83,30 @@ int shd_sample_write(struct shd_sample *sample,
 				const void *src,
 				size_t length);
 
+/*
+ * @brief Write some data into a given sample with streaming stores
+ *
+ * Streaming stores bypass the cache of the writer, and are weakly ordered :
+ * shd_sample_stream_fence() must be called before the write is published.
+ * Architectures without streaming stores fall back to a regular copy.
+ *
+ * @param[in] sample : pointer to the sample to write to
+ * @param[in] offset : offset within the sample at which data should be written
+ * @param[in] src : data to copy
+ * @param[in] length : length of the data to copy
+ *
+ * @return : 0 in any case
+ */
+int shd_sample_write_stream(struct shd_sample *sample,
+				ptrdiff_t offset,
+				const void *src,
+				size_t length);
+
+/*
+ * @brief Order all previous streaming stores before subsequent stores
+ */
+void shd_sample_stream_fence(void);
+
 /*
  * @brief Compare a sample timestamp against a given date
  *
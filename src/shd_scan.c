@@ -0,0 +1,69 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file shd_scan.c
+ *
+ * @brief Strided scans of a quantity over consecutive samples.
+ *
+ */
+
+#include "shd_private.h"
+#include "shd_sample.h"
+#include "shd_utils.h"
+#include "shd_scan.h"
+
+shd_scan_kernel_t shd_scan_get_kernel(
+			const shd_scan_kernel_t kernels[SHD_SCAN_NB_TYPES],
+			enum shd_field_type type)
+{
+	if ((unsigned int) type >= SHD_SCAN_NB_TYPES)
+		return NULL;
+
+	return kernels[type];
+}
+
+uint32_t shd_scan(const struct shd_data_section_desc *desc, int start,
+			uint32_t pos, uint32_t nb, ptrdiff_t offset,
+			shd_scan_kernel_t kernel, const void *arg)
+{
+	size_t stride = shd_sample_get_size(desc->blob_size);
+	const char *first = (const char *)shd_data_get_sample_ptr(desc, 0)
+			+ offsetof(struct shd_sample, blob) + offset;
+	uint32_t run, found;
+	int index;
+
+	while (pos < nb) {
+		index = index_n_after(start, pos, desc);
+		/* Up to the end of the data section, then from its start */
+		run = min(nb - pos, desc->nb_samples - index);
+		found = kernel(first + (size_t) index * stride, stride, run,
+				desc->prefetch_distance, arg);
+		pos += found;
+		if (found < run)
+			break;
+	}
+
+	return pos;
+}
@@ -0,0 +1,150 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file shd_scan.h
+ *
+ * @brief Strided scans of a quantity over consecutive samples.
+ *
+ * @details The samples to scan are made of at most two runs of consecutive
+ * slots, depending on whether they wrap around the end of the data section.
+ * Each run is scanned by a kernel specialized for the type of the quantity,
+ * which steps through the slots with a constant stride and may stop at any
+ * of them : aggregations reduce all the slots, while filters and
+ * subscriptions stop at the next sample to copy out of the section. Slots are
+ * prefetched "distance" slots ahead if hardware prefetchers can not follow
+ * the stride. Values may not be aligned within the blob : kernels read them
+ * with memcpy(), which the compiler turns into a plain load.
+ *
+ */
+
+#ifndef _SHD_SCAN_H_
+#define _SHD_SCAN_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "shd_data.h"
+#include "libshdata.h"
+
+/*
+ * @brief Kernel scanning the values of n slots, stride bytes apart
+ *
+ * @param[in] p : first value
+ * @param[in] stride : size of a slot
+ * @param[in] n : number of slots to scan
+ * @param[in] distance : prefetch distance in slots, 0 to disable prefetching
+ * @param[in] arg : argument of the scan
+ *
+ * @return : number of slots scanned before the one at which the kernel
+ * stopped, n if it did not stop
+ */
+typedef uint32_t (*shd_scan_kernel_t)(const char *p, size_t stride,
+					uint32_t n, uint32_t distance,
+					const void *arg);
+
+/* Prefetch the slot "distance" slots after the one at _p */
+#define SHD_SCAN_PREFETCH(_p, _stride, _distance)			\
+	do {								\
+		if ((_distance) != 0)					\
+			__builtin_prefetch((_p) + (_distance) * (_stride), \
+					0, 0);				\
+	} while (0)
+
+/* Instantiate _kernel(<_prefix>_<type>, <type>) for each integer type */
+#define SHD_SCAN_INTEGER_KERNELS(_kernel, _prefix)			\
+	_kernel(_prefix##_uint8, uint8_t)				\
+	_kernel(_prefix##_int8, int8_t)					\
+	_kernel(_prefix##_uint16, uint16_t)				\
+	_kernel(_prefix##_int16, int16_t)				\
+	_kernel(_prefix##_uint32, uint32_t)				\
+	_kernel(_prefix##_int32, int32_t)				\
+	_kernel(_prefix##_uint64, uint64_t)				\
+	_kernel(_prefix##_int64, int64_t)
+
+/* Instantiate _kernel(<_prefix>_<type>, <type>) for each numeric type */
+#define SHD_SCAN_NUMERIC_KERNELS(_kernel, _prefix)			\
+	SHD_SCAN_INTEGER_KERNELS(_kernel, _prefix)			\
+	_kernel(_prefix##_float, float)					\
+	_kernel(_prefix##_double, double)
+
+/* Number of entries of a table of kernels indexed by field type */
+#define SHD_SCAN_NB_TYPES (SHD_FIELD_DOUBLE + 1)
+
+/* Initializer of a table of the kernels instantiated for integer types */
+#define SHD_SCAN_INTEGER_TABLE(_prefix)					\
+	[SHD_FIELD_UINT8] = _prefix##_uint8,				\
+	[SHD_FIELD_INT8] = _prefix##_int8,				\
+	[SHD_FIELD_UINT16] = _prefix##_uint16,				\
+	[SHD_FIELD_INT16] = _prefix##_int16,				\
+	[SHD_FIELD_UINT32] = _prefix##_uint32,				\
+	[SHD_FIELD_INT32] = _prefix##_int32,				\
+	[SHD_FIELD_UINT64] = _prefix##_uint64,				\
+	[SHD_FIELD_INT64] = _prefix##_int64
+
+/* Initializer of a table of the kernels instantiated for numeric types */
+#define SHD_SCAN_NUMERIC_TABLE(_prefix)					\
+	SHD_SCAN_INTEGER_TABLE(_prefix),				\
+	[SHD_FIELD_FLOAT] = _prefix##_float,				\
+	[SHD_FIELD_DOUBLE] = _prefix##_double
+
+/*
+ * @brief Get the kernel of a table for a field type
+ *
+ * @param[in] kernels : table of kernels indexed by field type
+ * @param[in] type : type of the quantity
+ *
+ * @return : kernel for the type,
+ *           NULL if the table has none
+ */
+shd_scan_kernel_t shd_scan_get_kernel(
+			const shd_scan_kernel_t kernels[SHD_SCAN_NB_TYPES],
+			enum shd_field_type type);
+
+/*
+ * @brief Scan consecutive samples from the pos-th one until the kernel stops
+ *
+ * @param[in] desc : description of the data section
+ * @param[in] start : index of the first sample
+ * @param[in] pos : position of the sample to scan first, from the first one
+ * @param[in] nb : number of samples
+ * @param[in] offset : offset of the quantity within the blob
+ * @param[in] kernel : kernel for the type of the quantity
+ * @param[in] arg : argument passed to the kernel
+ *
+ * @return : position from the first sample of the one at which the kernel
+ * stopped, nb if it did not stop
+ */
+uint32_t shd_scan(const struct shd_data_section_desc *desc, int start,
+			uint32_t pos, uint32_t nb, ptrdiff_t offset,
+			shd_scan_kernel_t kernel, const void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SHD_SCAN_H_ */
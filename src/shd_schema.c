@@ -0,0 +1,338 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_schema.c
+ *
+ * @brief Blob schema stored in the blob metadata header.
+ *
+ * @details Layout of a metadata header holding a schema :
+ *   - user metadata, padded to 8 bytes ;
+ *   - array of field entries ;
+ *   - field names, with their terminating null byte, padded to 4 bytes ;
+ *   - trailer, whose size field is that of the whole schema (user metadata
+ *   excluded).
+ * All fields are in host byte order. Entries and trailer are copied in and
+ * out of the header, so that no alignment is assumed on its start.
+ *
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "shd_private.h"
+#include "shd_schema.h"
+
+#define SHD_SCHEMA_MAGIC	0x73686473	/* "shds" */
+#define SHD_SCHEMA_VERSION	1
+
+struct shd_schema_field {
+	/* offset from start of blob */
+	uint32_t offset;
+	/* number of elements */
+	uint32_t count;
+	/* enum shd_field_type */
+	uint16_t type;
+	/* length of the name, without terminating null byte */
+	uint16_t name_len;
+	/* offset of the name from start of schema */
+	uint32_t name_offset;
+};
+
+struct shd_schema_trailer {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t nb_fields;
+	/* size of the schema, trailer included */
+	uint32_t size;
+	uint32_t reserved;
+};
+
+static const size_t s_field_type_size[] = {
+	[SHD_FIELD_UINT8] = sizeof(uint8_t),
+	[SHD_FIELD_INT8] = sizeof(int8_t),
+	[SHD_FIELD_UINT16] = sizeof(uint16_t),
+	[SHD_FIELD_INT16] = sizeof(int16_t),
+	[SHD_FIELD_UINT32] = sizeof(uint32_t),
+	[SHD_FIELD_INT32] = sizeof(int32_t),
+	[SHD_FIELD_UINT64] = sizeof(uint64_t),
+	[SHD_FIELD_INT64] = sizeof(int64_t),
+	[SHD_FIELD_FLOAT] = sizeof(float),
+	[SHD_FIELD_DOUBLE] = sizeof(double),
+	[SHD_FIELD_BYTES] = 1,
+};
+
+#define ALIGN_UP(_x, _a) (((_x) + (_a) - 1) & ~((size_t)(_a) - 1))
+
+static bool field_is_valid(const struct shd_field_desc *field)
+{
+	size_t name_len;
+
+	if (field->name == NULL
+		|| (unsigned int)field->type >= SHD_FIELD_GROUP
+		|| field->offset < 0 || field->offset > UINT32_MAX
+		|| field->count == 0)
+		return false;
+
+	name_len = strlen(field->name);
+	return name_len > 0 && name_len <= UINT16_MAX;
+}
+
+size_t shd_schema_get_size(size_t user_mdata_size,
+				const struct shd_field_desc fields[],
+				size_t nb_fields)
+{
+	size_t names_size = 0;
+	size_t i;
+
+	if (fields == NULL || nb_fields == 0 || nb_fields > UINT16_MAX)
+		return 0;
+
+	for (i = 0; i < nb_fields; i++) {
+		if (!field_is_valid(&fields[i]))
+			return 0;
+		names_size += strlen(fields[i].name) + 1;
+	}
+
+	return ALIGN_UP(user_mdata_size, 8)
+		+ nb_fields * sizeof(struct shd_schema_field)
+		+ ALIGN_UP(names_size, 4)
+		+ sizeof(struct shd_schema_trailer);
+}
+
+int shd_schema_write(void *dst, size_t size,
+			const void *user_mdata, size_t user_mdata_size,
+			const struct shd_field_desc fields[],
+			size_t nb_fields)
+{
+	struct shd_schema_trailer trailer;
+	struct shd_schema_field entry;
+	uint8_t *schema;
+	size_t schema_size;
+	size_t name_offset;
+	size_t i;
+
+	if (dst == NULL || (user_mdata == NULL && user_mdata_size != 0))
+		return -EINVAL;
+
+	if (size == 0
+		|| size != shd_schema_get_size(user_mdata_size,
+						fields, nb_fields))
+		return -ENOMEM;
+
+	memset(dst, 0, size);
+	if (user_mdata_size != 0)
+		memcpy(dst, user_mdata, user_mdata_size);
+
+	schema = (uint8_t *)dst + ALIGN_UP(user_mdata_size, 8);
+	schema_size = size - ALIGN_UP(user_mdata_size, 8);
+	name_offset = nb_fields * sizeof(entry);
+
+	for (i = 0; i < nb_fields; i++) {
+		entry.offset = fields[i].offset;
+		entry.count = fields[i].count;
+		entry.type = fields[i].type;
+		entry.name_len = strlen(fields[i].name);
+		entry.name_offset = name_offset;
+		memcpy(schema + i * sizeof(entry), &entry, sizeof(entry));
+		memcpy(schema + name_offset, fields[i].name, entry.name_len);
+		name_offset += entry.name_len + 1;
+	}
+
+	trailer.magic = SHD_SCHEMA_MAGIC;
+	trailer.version = SHD_SCHEMA_VERSION;
+	trailer.nb_fields = nb_fields;
+	trailer.size = schema_size;
+	trailer.reserved = 0;
+	memcpy(schema + schema_size - sizeof(trailer), &trailer,
+			sizeof(trailer));
+
+	return 0;
+}
+
+/*
+ * @brief Check whether name designates a group of nested fields that
+ * field_name belongs to
+ */
+static bool name_is_parent(const char *name, size_t len,
+				const char *field_name, size_t field_len)
+{
+	return field_len > len && field_name[len] == '.'
+			&& memcmp(field_name, name, len) == 0;
+}
+
+/*
+ * @brief Locate the schema at the end of a metadata header
+ */
+static int get_schema(const void *mdata_hdr_start, size_t mdata_size,
+			struct shd_schema_trailer *trailer,
+			const uint8_t **schema)
+{
+	if (mdata_size < sizeof(*trailer))
+		return -ENODATA;
+
+	memcpy(trailer, (const uint8_t *)mdata_hdr_start + mdata_size
+			- sizeof(*trailer), sizeof(*trailer));
+	if (trailer->magic != SHD_SCHEMA_MAGIC)
+		return -ENODATA;
+
+	if (trailer->version != SHD_SCHEMA_VERSION
+		|| trailer->size > mdata_size
+		|| trailer->size < (size_t)trailer->nb_fields
+			* sizeof(struct shd_schema_field) + sizeof(*trailer))
+		return -EPROTO;
+
+	*schema = (const uint8_t *)mdata_hdr_start + mdata_size
+			- trailer->size;
+
+	return 0;
+}
+
+/*
+ * @brief Copy a field entry out of a schema and check it
+ */
+static int get_entry(const uint8_t *schema,
+			const struct shd_schema_trailer *trailer,
+			uint16_t i, size_t blob_size,
+			struct shd_schema_field *entry)
+{
+	size_t entries_size = (size_t)trailer->nb_fields * sizeof(*entry);
+
+	memcpy(entry, schema + i * sizeof(*entry), sizeof(*entry));
+	if (entry->type >= SHD_FIELD_GROUP
+		|| entry->name_offset < entries_size
+		|| entry->name_offset + entry->name_len
+			>= trailer->size - sizeof(*trailer))
+		return -EPROTO;
+
+	if (entry->offset + (size_t)entry->count
+			* s_field_type_size[entry->type] > blob_size)
+		return -EPROTO;
+
+	return 0;
+}
+
+int shd_schema_resolve(const void *mdata_hdr_start, size_t mdata_size,
+			size_t blob_size, const char *name,
+			struct shd_quantity_info *info)
+{
+	const uint8_t *schema;
+	struct shd_schema_trailer trailer;
+	struct shd_schema_field entry;
+	size_t len;
+	size_t start = SIZE_MAX, end = 0, field_end;
+	const char *field_name;
+	bool found = false;
+	uint16_t i;
+	int ret;
+
+	ret = get_schema(mdata_hdr_start, mdata_size, &trailer, &schema);
+	if (ret < 0)
+		return ret;
+
+	len = strlen(name);
+
+	for (i = 0; i < trailer.nb_fields; i++) {
+		ret = get_entry(schema, &trailer, i, blob_size, &entry);
+		if (ret < 0)
+			return ret;
+
+		field_end = entry.offset + (size_t)entry.count
+				* s_field_type_size[entry.type];
+
+		field_name = (const char *)schema + entry.name_offset;
+		if (entry.name_len == len
+			&& memcmp(field_name, name, len) == 0) {
+			info->quantity.quantity_offset = entry.offset;
+			info->quantity.quantity_size = field_end
+							- entry.offset;
+			info->type = entry.type;
+			info->count = entry.count;
+			return 0;
+		}
+
+		if (name_is_parent(name, len, field_name, entry.name_len)) {
+			if (entry.offset < start)
+				start = entry.offset;
+			if (field_end > end)
+				end = field_end;
+			found = true;
+		}
+	}
+
+	if (!found)
+		return -ENOENT;
+
+	info->quantity.quantity_offset = start;
+	info->quantity.quantity_size = end - start;
+	info->type = SHD_FIELD_GROUP;
+	info->count = 1;
+
+	return 0;
+}
+
+int shd_schema_get_numeric(const void *mdata_hdr_start, size_t mdata_size,
+			size_t blob_size, struct shd_schema_elem elems[],
+			size_t max_elems)
+{
+	const uint8_t *schema;
+	struct shd_schema_trailer trailer;
+	struct shd_schema_field entry;
+	size_t nb = 0;
+	uint32_t j;
+	uint16_t i;
+	int ret;
+
+	ret = get_schema(mdata_hdr_start, mdata_size, &trailer, &schema);
+	if (ret < 0)
+		return ret;
+
+	for (i = 0; i < trailer.nb_fields; i++) {
+		ret = get_entry(schema, &trailer, i, blob_size, &entry);
+		if (ret < 0)
+			return ret;
+
+		if (entry.type == SHD_FIELD_BYTES)
+			continue;
+
+		for (j = 0; j < entry.count; j++, nb++) {
+			if (nb >= max_elems)
+				continue;
+			elems[nb].offset = entry.offset
+				+ j * s_field_type_size[entry.type];
+			elems[nb].type = entry.type;
+		}
+	}
+
+	/* Element counts are bounded by the blob size, checked above */
+	return nb;
+}
+
+size_t shd_schema_get_type_size(enum shd_field_type type)
+{
+	return (unsigned int)type < SHD_FIELD_GROUP ? s_field_type_size[type]
+			: 0;
+}
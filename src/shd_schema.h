@@ -0,0 +1,144 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_schema.h
+ *
+ * @brief Blob schema stored in the blob metadata header.
+ *
+ * @details A blob schema describes the name, type, offset and number of
+ * elements of the fields of a blob. It is appended to the user metadata of
+ * the blob metadata header, and ends with a trailer which identifies it, so
+ * that sections created without schema are told apart.
+ *
+ */
+
+#ifndef _SHD_SCHEMA_H_
+#define _SHD_SCHEMA_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "libshdata.h"
+
+/*
+ * Numeric element of a blob : a field which is not an array, or one element
+ * of an array field
+ */
+struct shd_schema_elem {
+	/* offset from start of blob */
+	uint32_t offset;
+	/* type of the element */
+	enum shd_field_type type;
+};
+
+/*
+ * @brief Get the size of a blob metadata header holding a schema
+ *
+ * @param[in] user_mdata_size : size of the user metadata
+ * @param[in] fields : description of the fields of the blob
+ * @param[in] nb_fields : number of fields
+ *
+ * @return : size of the blob metadata header,
+ *           0 if fields are invalid
+ */
+size_t shd_schema_get_size(size_t user_mdata_size,
+				const struct shd_field_desc fields[],
+				size_t nb_fields);
+
+/*
+ * @brief Write a blob metadata header holding a schema
+ *
+ * @param[out] dst : destination buffer
+ * @param[in] size : size of the destination buffer
+ * @param[in] user_mdata : user metadata
+ * @param[in] user_mdata_size : size of the user metadata
+ * @param[in] fields : description of the fields of the blob
+ * @param[in] nb_fields : number of fields
+ *
+ * @return : 0 on success,
+ *           -EINVAL if fields are invalid,
+ *           -ENOMEM if size does not match the size of the header
+ */
+int shd_schema_write(void *dst, size_t size,
+			const void *user_mdata, size_t user_mdata_size,
+			const struct shd_field_desc fields[],
+			size_t nb_fields);
+
+/*
+ * @brief Resolve a quantity by name from the schema of a blob metadata header
+ *
+ * @param[in] mdata_hdr_start : pointer to the start of the metadata header
+ * @param[in] mdata_size : size of the metadata header
+ * @param[in] blob_size : size of a blob
+ * @param[in] name : name of the quantity
+ * @param[out] info : resolved quantity
+ *
+ * @return : 0 on success,
+ *           -ENODATA if the metadata header holds no schema,
+ *           -EPROTO if the schema is invalid,
+ *           -ENOENT if no field matches name
+ */
+int shd_schema_resolve(const void *mdata_hdr_start, size_t mdata_size,
+			size_t blob_size, const char *name,
+			struct shd_quantity_info *info);
+
+/*
+ * @brief List the numeric elements of the blob described by the schema of a
+ * blob metadata header
+ *
+ * @param[in] mdata_hdr_start : pointer to the start of the metadata header
+ * @param[in] mdata_size : size of the metadata header
+ * @param[in] blob_size : size of a blob
+ * @param[out] elems : destination array
+ * @param[in] max_elems : number of elements of the destination array
+ *
+ * @return : number of numeric elements, which may be greater than max_elems,
+ * in which case only the first ones are copied,
+ *           -ENODATA if the metadata header holds no schema,
+ *           -EPROTO if the schema is invalid
+ */
+int shd_schema_get_numeric(const void *mdata_hdr_start, size_t mdata_size,
+			size_t blob_size, struct shd_schema_elem elems[],
+			size_t max_elems);
+
+/*
+ * @brief Get the size of a field element
+ *
+ * @param[in] type : type of the field
+ *
+ * @return : size of an element of the field,
+ *           0 for groups and invalid types
+ */
+size_t shd_schema_get_type_size(enum shd_field_type type);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SHD_SCHEMA_H_ */
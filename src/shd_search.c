@@ -37,21 +37,15 @@
 #include "shd_private.h"
 #include "shd_search.h"
 
-unsigned int shd_search_get_max_depth(const struct shd_data_section_desc *desc,
-					const struct search_ctx *ctx)
+RING_INLINE unsigned int get_valid_depth(
+				const struct shd_data_section_desc *desc,
+				const struct search_ctx *ctx,
+				bool pow2)
 {
 	unsigned int depth;
 
-	/* If the top sample has been written at least twice, it means that the
-	 * whole section has been written at least once, and the whole
-	 * section is eligible for research */
-	if (ctx->nb_writes_top > 0)
-		return desc->nb_samples;
-
-	/* Else, we run through the whole buffer and stop as soon as a sample
-	 * is invalid */
 	for (depth = 0; depth < desc->nb_samples; depth++) {
-		int idx = index_n_before(ctx->t_index, depth, desc->nb_samples);
+		int idx = ring_n_before(ctx->t_index, depth, desc, pow2);
 		struct shd_sample *curr = shd_data_get_sample_ptr(desc, idx);
 
 		if (!shd_sync_is_sample_valid(&curr->sync))
@@ -61,26 +55,47 @@ unsigned int shd_search_get_max_depth(const struct shd_data_section_desc *desc,
 	return depth;
 }
 
-static bool search_reference_sample_naive(
-				const struct shd_data_section_desc *desc,
+unsigned int shd_search_get_max_depth(const struct shd_data_section_desc *desc,
+					const struct search_ctx *ctx)
+{
+	/* If the top sample has been written at least twice, it means that the
+	 * whole section has been written at least once, and the whole
+	 * section is eligible for research */
+	if (ctx->nb_writes_top > 0)
+		return desc->nb_samples;
+
+	/* Else, we run through the whole buffer and stop as soon as a sample
+	 * is invalid */
+	if (desc->index_mask)
+		return get_valid_depth(desc, ctx, true);
+	return get_valid_depth(desc, ctx, false);
+}
+
+RING_INLINE bool search_naive(const struct shd_data_section_desc *desc,
 				const struct timespec *date,
-				const struct search_ctx *ctx,
+				int max_depth,
 				int *m_index,
-				uint32_t *s_searched)
+				uint32_t *s_searched,
+				bool pow2)
 {
 	bool found_ref = false;
 	struct shd_sample *curr;
-	int max_depth = shd_search_get_max_depth(desc, ctx);
 	int searched = 0;
 
-	*m_index = ctx->t_index;
-
 	while (searched < max_depth && !found_ref) {
+		/* Only the timestamps of the samples are compared */
+		if (desc->prefetch_distance != 0 && searched
+				+ (int)desc->prefetch_distance < max_depth)
+			prefetch_range(shd_data_get_sample_ptr(desc,
+					ring_n_before(*m_index,
+						desc->prefetch_distance,
+						desc, pow2)),
+					sizeof(struct shd_sample_metadata));
 		curr = shd_data_get_sample_ptr(desc, *m_index);
 		if (shd_sample_timestamp_cmp(curr, *date) < 0)
 			found_ref = true;
 		else
-			index_decrement(m_index, desc->nb_samples);
+			*m_index = ring_n_before(*m_index, 1, desc, pow2);
 		searched++;
 	}
 
@@ -88,12 +103,30 @@ static bool search_reference_sample_naive(
 	return found_ref;
 }
 
-static bool search_reference_sample_binary(
+static bool search_reference_sample_naive(
 				const struct shd_data_section_desc *desc,
 				const struct timespec *date,
 				const struct search_ctx *ctx,
 				int *m_index,
 				uint32_t *s_searched)
+{
+	int max_depth = shd_search_get_max_depth(desc, ctx);
+
+	*m_index = ctx->t_index;
+
+	if (desc->index_mask)
+		return search_naive(desc, date, max_depth, m_index,
+				s_searched, true);
+	return search_naive(desc, date, max_depth, m_index, s_searched,
+			false);
+}
+
+RING_INLINE bool search_binary(const struct shd_data_section_desc *desc,
+				const struct timespec *date,
+				const struct search_ctx *ctx,
+				int *m_index,
+				uint32_t *s_searched,
+				bool pow2)
 {
 	int imin = 0, imax = 0, imid = 0, max_depth = 0;
 	struct shd_sample *curr = NULL;
@@ -110,9 +143,9 @@ static bool search_reference_sample_binary(
 		imid = (imin + imax) / 2;
 
 		/* Get real index of sample */
-		*m_index = index_n_before(ctx->t_index,
-					  max_depth - 1 - imid,
-					  desc->nb_samples);
+		*m_index = ring_n_before(ctx->t_index,
+					 max_depth - 1 - imid,
+					 desc, pow2);
 		curr = shd_data_get_sample_ptr(desc, *m_index);
 		(*s_searched)++;
 
@@ -126,9 +159,9 @@ static bool search_reference_sample_binary(
 
 	/* imin is the closest value, recompute only if we don't have it */
 	if (imin != imid) {
-		*m_index = index_n_before(ctx->t_index,
-					  max_depth - 1 - imin,
-					  desc->nb_samples);
+		*m_index = ring_n_before(ctx->t_index,
+					 max_depth - 1 - imin,
+					 desc, pow2);
 		curr = shd_data_get_sample_ptr(desc, *m_index);
 		res = shd_sample_timestamp_cmp(curr, *date);
 	}
@@ -136,7 +169,7 @@ static bool search_reference_sample_binary(
 	if (res >= 0) {
 		/* Need to get previous */
 		if (imin > 0) {
-			index_decrement(m_index, desc->nb_samples);
+			*m_index = ring_n_before(*m_index, 1, desc, pow2);
 			return true;
 		} else {
 			/* No match */
@@ -148,6 +181,19 @@ static bool search_reference_sample_binary(
 	}
 }
 
+static bool search_reference_sample_binary(
+				const struct shd_data_section_desc *desc,
+				const struct timespec *date,
+				const struct search_ctx *ctx,
+				int *m_index,
+				uint32_t *s_searched)
+{
+	if (desc->index_mask)
+		return search_binary(desc, date, ctx, m_index, s_searched,
+				true);
+	return search_binary(desc, date, ctx, m_index, s_searched, false);
+}
+
 /*
  * @brief Search reference sample in the section
  *
@@ -210,12 +256,14 @@ int shd_search_oldest(const struct shd_data_section_desc *desc,
 	int ret_index = -1;
 	unsigned int max_depth = shd_search_get_max_depth(desc, ctx);
 
-	if (max_depth == desc->nb_samples)
-		ret_index = index_n_after(ctx->t_index, 2, desc->nb_samples);
+	if (max_depth == 0)
+		ret_index = ctx->t_index;
+	else if (max_depth == desc->nb_samples)
+		ret_index = index_n_after(ctx->t_index, 2, desc);
 	else
 		ret_index = index_n_before(ctx->t_index,
 				 max_depth - 1,
-				 desc->nb_samples);
+				 desc);
 
 	return ret_index;
 }
@@ -237,14 +285,14 @@ int shd_search_first_match_after(const struct shd_data_section_desc *desc,
 		 * in the past of the search date : the only case where there
 		 * is something to do is if the reference index is different */
 		if (m_index != ctx->t_index) {
-			ret_index = index_next(m_index, desc->nb_samples);
+			ret_index = index_next(m_index, desc);
 			found_ref = true;
 		}
 	} else {
 		/* If no reference sample has been found, it means that all
 		 * the samples are set after the search date, so we return
-		 * the oldest sample */
-		ret_index = index_next(ctx->t_index, desc->nb_samples);
+		 * the oldest sample, as SHD_OLDEST does */
+		ret_index = shd_search_oldest(desc, ctx);
 		found_ref = true;
 	}
 
@@ -291,8 +339,9 @@ int shd_search_closest_match(const struct shd_data_section_desc *desc,
 					ctx, &b_index,
 					&s_searched, hint)) {
 		/* All the samples are set in the future of the searched date,
-		 * and so the closest sample is in fact the oldest one */
-		ret_index = index_next(ctx->t_index, desc->nb_samples);
+		 * and so the closest sample is in fact the oldest one, as
+		 * SHD_OLDEST returns it */
+		ret_index = shd_search_oldest(desc, ctx);
 	} else if (b_index == ctx->t_index) {
 		/* All the samples are set in the past of the searched date,
 		* and so the closest sample is in fact the latest one */
@@ -300,7 +349,7 @@ int shd_search_closest_match(const struct shd_data_section_desc *desc,
 	} else {
 		/* b_index has been set to the date of the sample right before
 		 * the search date */
-		int a_index = index_next(b_index, desc->nb_samples);
+		int a_index = index_next(b_index, desc);
 
 		struct shd_sample *b_s = shd_data_get_sample_ptr(desc, b_index);
 		struct shd_sample *a_s = shd_data_get_sample_ptr(desc, a_index);
@@ -339,8 +388,7 @@ bool shd_search_end(const struct shd_sync_hdr *hdr,
 	int t_index_new = shd_sync_get_last_write_index(hdr);
 	/* Number of samples between the most recent sample at the start of the
 	 * search and the start of the window */
-	int margin = interval_between(index_next(ctx->t_index,
-						desc->nb_samples),
+	int margin = interval_between(index_next(ctx->t_index, desc),
 					w_start_idx,
 					desc->nb_samples);
 	/* Number of samples that were added to the section during the start
@@ -35,6 +35,8 @@
 #include <fcntl.h>		/* For O_* constants */
 #include <string.h>		/* String operations */
 #include <stddef.h>		/* NULL pointer */
+#include <stdint.h>		/* SIZE_MAX */
+#include <limits.h>		/* INT_MAX */
 #include <stdlib.h>		/* For memory allocation functions */
 #include <sys/file.h>		/* for flock */
 #include <unistd.h>		/* For ftruncate */
@@ -42,7 +44,9 @@
 #include "shd_section.h"
 #include "shd_hdr.h"
 #include "shd_data.h"
+#include "shd_sample.h"
 #include "shd_utils.h"
+#include "shd_dirty.h"
 
 struct shd_section_mapping {
 	ptrdiff_t metadata_offset;
@@ -52,9 +56,12 @@ struct shd_section_mapping {
 	size_t total_size;
 	ptrdiff_t hdr_offset;
 	ptrdiff_t sync_offset;
+	/* -1 if the section has no dirty map */
+	ptrdiff_t dirty_offset;
 };
 
 static void get_offsets(const struct shd_hdr_user_info *hdr_info,
+			bool dirty_map,
 			struct shd_section_mapping *offsets)
 {
 	offsets->metadata_offset = ALIGN_UP(sizeof(struct shd_hdr));
@@ -66,6 +73,14 @@ static void get_offsets(const struct shd_hdr_user_info *hdr_info,
 	offsets->data_size = shd_data_get_total_size(hdr_info->blob_size,
 						hdr_info->max_nb_samples);
 	offsets->total_size = offsets->data_offset + offsets->data_size;
+	if (dirty_map) {
+		/* Bitmaps are accessed as 64-bit words */
+		offsets->dirty_offset = ALIGN(offsets->total_size, 8);
+		offsets->total_size = offsets->dirty_offset
+			+ shd_dirty_get_size(hdr_info->max_nb_samples);
+	} else {
+		offsets->dirty_offset = -1;
+	}
 }
 
 static struct shd_section *get_mmap(char *ptr,
@@ -82,6 +97,8 @@ static struct shd_section *get_mmap(char *ptr,
 	map->sync_top = ptr + offsets->sync_offset;
 	map->metadata_blob_top = ptr + offsets->metadata_offset;
 	map->data_top = ptr + offsets->data_offset;
+	map->dirty_top = offsets->dirty_offset >= 0 ?
+			ptr + offsets->dirty_offset : NULL;
 	map->total_size = offsets->total_size;
 
 	return map;
@@ -157,10 +174,12 @@ int shd_section_free(const struct shd_section_id *id)
 }
 
 struct shd_section *shd_section_mapping_new(const struct shd_section_id *id,
-			const struct shd_hdr_user_info *hdr_info)
+			const struct shd_hdr_user_info *hdr_info,
+			bool dirty_map)
 {
 	struct shd_section *map = NULL;
 	struct shd_hdr_user_info src_hdr_user;
+	uint64_t flags = 0;
 	struct shd_section_mapping offsets;
 	void *ptr = NULL;
 	int ret;
@@ -170,12 +189,19 @@ struct shd_section *shd_section_mapping_new(const struct shd_section_id *id,
 	if (hdr_info != NULL) {
 		src_hdr_user = *hdr_info;
 	} else {
-		ret = shd_hdr_read(id, NULL, &src_hdr_user);
+		ret = shd_hdr_read(id, NULL, &src_hdr_user, &flags);
 		if (ret < 0)
 			goto error;
+		dirty_map = (flags & SHD_HDR_FLAG_DIRTY_MAP) != 0;
+	}
+
+	if (shd_section_get_total_size(&src_hdr_user, dirty_map)
+			== (size_t) -1) {
+		ULOGE("Section size can not be addressed by this process");
+		goto error;
 	}
 
-	get_offsets(&src_hdr_user, &offsets);
+	get_offsets(&src_hdr_user, dirty_map, &offsets);
 
 	ret = (*id->backend.get_section_start) (offsets.total_size,
 						&ptr, id->instance);
@@ -186,6 +212,18 @@ struct shd_section *shd_section_mapping_new(const struct shd_section_id *id,
 
 	map = get_mmap(ptr, &offsets);
 
+	/* The header was read before the section was m'mapped : check that
+	 * the section has not been re-created with another format in the
+	 * meantime */
+	if (map != NULL && hdr_info == NULL && (memcmp(map->header_top,
+				&src_hdr_user, sizeof(src_hdr_user)) != 0
+			|| shd_hdr_has_dirty_map(map->section_top)
+				!= dirty_map)) {
+		ULOGW("Section header changed while the section was m'mapped");
+		shd_section_mapping_destroy(map);
+		goto error;
+	}
+
 	return map;
 
 error:
@@ -199,14 +237,42 @@ int shd_section_mapping_destroy(struct shd_section *map)
 	return 0;
 }
 
-size_t shd_section_get_total_size(const struct shd_hdr_user_info *hdr_info)
+size_t shd_section_get_total_size(const struct shd_hdr_user_info *hdr_info,
+			bool dirty_map)
 {
+	size_t hdr_size;
+	size_t sample_size;
+	size_t data_size;
+	size_t dirty_size;
+
 	if (hdr_info == NULL)
 		return -1;
 
-	return ALIGN_UP(sizeof(struct shd_hdr))
-			+ ALIGN_UP(hdr_info->blob_metadata_hdr_size)
-			+ shd_data_get_total_size(hdr_info->blob_size,
+	/* Sample indexes are handled as int */
+	if (hdr_info->max_nb_samples > INT_MAX)
+		return -1;
+
+	/* Check that the whole section fits in size_t, which is only 32 bits
+	 * wide on some platforms */
+	if (hdr_info->blob_size > SIZE_MAX / 2
+			|| hdr_info->blob_metadata_hdr_size > SIZE_MAX / 2)
+		return -1;
+	hdr_size = ALIGN_UP(sizeof(struct shd_hdr))
+			+ ALIGN_UP(hdr_info->blob_metadata_hdr_size);
+	sample_size = shd_sample_get_size(hdr_info->blob_size);
+	if (hdr_info->max_nb_samples != 0 && sample_size >
+			(SIZE_MAX - hdr_size) / hdr_info->max_nb_samples)
+		return -1;
+
+	data_size = hdr_size + shd_data_get_total_size(hdr_info->blob_size,
 					hdr_info->max_nb_samples);
+	if (!dirty_map)
+		return data_size;
+
+	dirty_size = shd_dirty_get_size(hdr_info->max_nb_samples);
+	if (data_size > SIZE_MAX - 8 - dirty_size)
+		return -1;
+
+	return ALIGN(data_size, 8) + dirty_size;
 }
 
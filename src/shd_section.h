@@ -177,6 +177,9 @@ struct shd_section {
 	void *metadata_blob_top;
 	/* m'mapped pointer to the top of the data section */
 	void *data_top;
+	/* m'mapped pointer to the top of the dirty map, NULL if the section
+	 * has none */
+	void *dirty_top;
 	/* Total shared memory section size */
 	size_t total_size;
 };
@@ -261,12 +264,15 @@ int shd_section_free(const struct shd_section_id *id);
  * @param[in] id : identifier for the open shared memory section
  * @param[in] hdr_info : header info for that memory section (NULL if this
  * information is not available from caller's private memory)
+ * @param[in] dirty_map : whether the section holds a dirty map (only used if
+ * hdr_info is not NULL)
  *
  * @return : pointer to the mapping,
  *           NULL in case of error
  */
 struct shd_section *shd_section_mapping_new(const struct shd_section_id *id,
-			const struct shd_hdr_user_info *hdr_info);
+			const struct shd_hdr_user_info *hdr_info,
+			bool dirty_map);
 
 /*
  * @brief Destroy a memory section mapping
@@ -282,11 +288,14 @@ int shd_section_mapping_destroy(struct shd_section *map);
  *
  * @param[in] hdr_info : header info for that memory section (NULL if this
  * information is not available from caller's private memory)
+ * @param[in] dirty_map : whether the section holds a dirty map
  *
  * @return : size of the section,
- *           -1 in case of error
+ *           -1 in case of error, or if the section is too large to be
+ * addressed by this process
  */
-size_t shd_section_get_total_size(const struct shd_hdr_user_info *hdr_info);
+size_t shd_section_get_total_size(const struct shd_hdr_user_info *hdr_info,
+			bool dirty_map);
 
 /**
  * @brief Find a section from its name
@@ -0,0 +1,333 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_sub.c
+ *
+ * @brief Subscriptions to the changes of a quantity.
+ *
+ * @details The samples produced since the previous scan are scanned by
+ * shd_scan(), with a kernel specialized for the condition and the type of the
+ * quantity.
+ *
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "shd_private.h"
+#include "shd_data.h"
+#include "shd_sample.h"
+#include "shd_scan.h"
+#include "shd_schema.h"
+#include "shd_sync.h"
+#include "shd_utils.h"
+#include "shd_sub.h"
+
+/* Find the first value which moved by more than the deadband from the
+ * reference value */
+#define DEADBAND_KERNEL(_name, _type)					\
+static uint32_t _name(const char *p, size_t stride, uint32_t n,		\
+			uint32_t distance, const void *arg)		\
+{									\
+	const struct shd_sub *sub = arg;				\
+	double deadband = sub->info.deadband;				\
+	double ref, d;							\
+	_type v;							\
+	uint32_t i;							\
+									\
+	memcpy(&v, sub->ref, sizeof(v));				\
+	ref = v;							\
+	for (i = 0; i < n; i++, p += stride) {				\
+		SHD_SCAN_PREFETCH(p, stride, distance);			\
+		memcpy(&v, p, sizeof(v));				\
+		d = v - ref;						\
+		if (d > deadband || d < -deadband)			\
+			break;						\
+	}								\
+									\
+	return i;							\
+}
+
+/* Find the first value whose masked bits differ from the reference value */
+#define CHANGED_KERNEL(_name, _type)					\
+static uint32_t _name(const char *p, size_t stride, uint32_t n,		\
+			uint32_t distance, const void *arg)		\
+{									\
+	const struct shd_sub *sub = arg;				\
+	_type mask = (_type)sub->info.mask;				\
+	_type ref, v;							\
+	uint32_t i;							\
+									\
+	if (mask == 0)							\
+		mask = (_type)~mask;					\
+	memcpy(&ref, sub->ref, sizeof(ref));				\
+	for (i = 0; i < n; i++, p += stride) {				\
+		SHD_SCAN_PREFETCH(p, stride, distance);			\
+		memcpy(&v, p, sizeof(v));				\
+		if ((v ^ ref) & mask)					\
+			break;						\
+	}								\
+									\
+	return i;							\
+}
+
+SHD_SCAN_NUMERIC_KERNELS(DEADBAND_KERNEL, deadband)
+
+CHANGED_KERNEL(changed_8, uint8_t)
+CHANGED_KERNEL(changed_16, uint16_t)
+CHANGED_KERNEL(changed_32, uint32_t)
+CHANGED_KERNEL(changed_64, uint64_t)
+
+static const shd_scan_kernel_t s_deadband_kernels[SHD_SCAN_NB_TYPES] = {
+	SHD_SCAN_NUMERIC_TABLE(deadband)
+};
+
+/* Quantities of any other size are compared as a whole */
+static uint32_t changed_bytes(const char *p, size_t stride, uint32_t n,
+				uint32_t distance, const void *arg)
+{
+	const struct shd_sub *sub = arg;
+	size_t size = sub->info.quantity.quantity.quantity_size;
+	uint32_t i;
+
+	for (i = 0; i < n; i++, p += stride) {
+		SHD_SCAN_PREFETCH(p, stride, distance);
+		if (memcmp(p, sub->ref, size) != 0)
+			break;
+	}
+
+	return i;
+}
+
+static shd_scan_kernel_t get_kernel(const struct shd_sub_info *info)
+{
+	if (info->mode == SHD_SUB_DEADBAND)
+		return shd_scan_get_kernel(s_deadband_kernels,
+						info->quantity.type);
+
+	switch (info->quantity.quantity.quantity_size) {
+	case sizeof(uint8_t):
+		return changed_8;
+	case sizeof(uint16_t):
+		return changed_16;
+	case sizeof(uint32_t):
+		return changed_32;
+	case sizeof(uint64_t):
+		return changed_64;
+	default:
+		return changed_bytes;
+	}
+}
+
+int shd_sub_check(const struct shd_sub_info *info, size_t blob_size)
+{
+	const struct shd_quantity *quantity = &info->quantity.quantity;
+	size_t type_size = shd_schema_get_type_size(info->quantity.type);
+	bool single = info->quantity.count == 1
+			&& quantity->quantity_size == type_size;
+
+	if (quantity->quantity_size == 0
+			|| quantity->quantity_offset < 0
+			|| (size_t) quantity->quantity_offset > blob_size
+			|| quantity->quantity_size
+				> blob_size - quantity->quantity_offset)
+		return -EINVAL;
+
+	switch (info->mode) {
+	case SHD_SUB_CHANGED:
+		if (info->mask != 0 && (!single
+				|| info->quantity.type > SHD_FIELD_INT64))
+			return -EINVAL;
+		return 0;
+	case SHD_SUB_DEADBAND:
+		/* Also rejects a NaN deadband */
+		if (!single || get_kernel(info) == NULL
+				|| !(info->deadband >= 0))
+			return -EINVAL;
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+struct shd_sub *shd_sub_new(struct shd_ctx *ctx,
+				const struct shd_sub_info *info)
+{
+	struct shd_sub *sub;
+	size_t size = info->quantity.quantity.quantity_size;
+
+	sub = calloc(1, sizeof(*sub));
+	if (sub == NULL)
+		return NULL;
+
+	sub->ref = calloc(2, size);
+	if (sub->ref == NULL) {
+		free(sub);
+		return NULL;
+	}
+	sub->saved_ref = (char *)sub->ref + size;
+	sub->ctx = ctx;
+	sub->info = *info;
+	sub->cursor = -1;
+	sub->nb_creations = ctx->sync_ctx->revision.nb_creations;
+
+	return sub;
+}
+
+/*
+ * Get the index of the oldest sample of the section which can be scanned :
+ * like SHD_OLDEST, the slot after the latest sample is skipped since it may
+ * be being overwritten
+ */
+static int get_oldest_index(const struct shd_data_section_desc *desc,
+				int last)
+{
+	int index = index_next(last, desc);
+	struct shd_sample *samp = shd_data_get_sample_ptr(desc, index);
+
+	if (!shd_sync_is_sample_valid(&samp->sync))
+		return 0;
+
+	return index_next(index, desc);
+}
+
+static void report(struct shd_sub *sub, int index,
+			struct shd_quantity_sample *dst)
+{
+	const struct shd_quantity *quantity = &sub->info.quantity.quantity;
+	struct shd_sample *samp = shd_data_get_sample_ptr(sub->ctx->desc,
+								index);
+
+	shd_sample_read(samp, quantity->quantity_offset
+				+ offsetof(struct shd_sample, blob),
+			dst->ptr, quantity->quantity_size);
+	shd_sample_read(samp, offsetof(struct shd_sample, metadata),
+			&dst->meta, sizeof(dst->meta));
+	/* The copy is the reference for the next samples : it is consistent
+	 * with what was reported, even if the slot is being overwritten */
+	memcpy(sub->ref, dst->ptr, quantity->quantity_size);
+	sub->has_ref = true;
+}
+
+int shd_sub_scan(struct shd_sub *sub, struct shd_quantity_sample samples[],
+			size_t max_samples)
+{
+	struct shd_ctx *ctx = sub->ctx;
+	const struct shd_data_section_desc *desc = ctx->desc;
+	shd_scan_kernel_t kernel = get_kernel(&sub->info);
+	ptrdiff_t offset = sub->info.quantity.quantity.quantity_offset;
+	struct shd_sample *start_samp;
+	bool had_ref = sub->has_ref;
+	int start, last, end, index;
+	int start_writes, end_writes;
+	uint32_t nb, pos;
+	size_t n = 0;
+
+	last = shd_sync_get_last_write_index(ctx->sect_mmap->sync_top);
+	if (last == -1)
+		return 0;
+
+	/* The context was remapped on a re-created section */
+	if (sub->nb_creations != ctx->sync_ctx->revision.nb_creations) {
+		sub->nb_creations = ctx->sync_ctx->revision.nb_creations;
+		sub->cursor = -1;
+	}
+
+	if (sub->cursor == -1) {
+		/* Only the latest sample is reported on the first scan */
+		start = had_ref ? get_oldest_index(desc, last) : last;
+	} else if (shd_sync_get_nb_writes(&shd_data_get_sample_ptr(desc,
+				sub->cursor)->sync) != sub->cursor_writes) {
+		/* The producer lapped the cursor */
+		ULOGD("Subscription lapped by the producer, resuming from the "
+				"oldest sample");
+		start = get_oldest_index(desc, last);
+	} else if (sub->cursor == last) {
+		return 0;
+	} else {
+		start = index_next(sub->cursor, desc);
+	}
+
+	start_samp = shd_data_get_sample_ptr(desc, start);
+	start_writes = shd_sync_get_nb_writes(&start_samp->sync);
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (start_writes < 0)
+		return -EAGAIN;
+
+	if (had_ref)
+		memcpy(sub->saved_ref, sub->ref,
+				sub->info.quantity.quantity.quantity_size);
+
+	nb = interval_between(start, last, desc->nb_samples) + 1;
+	pos = 0;
+	end = last;
+	while (pos < nb) {
+		/* Without a reference, the first sample is reported */
+		if (sub->has_ref)
+			pos = shd_scan(desc, start, pos, nb, offset, kernel,
+					sub);
+		if (pos == nb)
+			break;
+
+		index = index_n_after(start, pos, desc);
+		report(sub, index, &samples[n]);
+		n++;
+		pos++;
+		if (n == max_samples) {
+			/* The next read resumes after the last report */
+			end = index;
+			break;
+		}
+	}
+	end_writes = shd_sync_get_nb_writes(&shd_data_get_sample_ptr(desc,
+							end)->sync);
+
+	/* The producer only overwrites the scanned samples in order, starting
+	 * with the first one */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (shd_sync_get_nb_writes(&start_samp->sync) != start_writes) {
+		ULOGW("Scanned samples have been overwritten during the scan");
+		if (had_ref)
+			memcpy(sub->ref, sub->saved_ref,
+				sub->info.quantity.quantity.quantity_size);
+		sub->has_ref = had_ref;
+		return -EAGAIN;
+	}
+
+	sub->cursor = end;
+	sub->cursor_writes = end_writes;
+
+	return n;
+}
+
+void shd_sub_destroy(struct shd_sub *sub)
+{
+	if (sub == NULL)
+		return;
+
+	free(sub->ref);
+	free(sub);
+}
@@ -0,0 +1,118 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_sub.h
+ *
+ * @brief Subscriptions to the changes of a quantity.
+ *
+ * @details A subscription scans the samples committed since its previous
+ * read in place, in the mapped slots, and only copies out those which
+ * satisfy its condition.
+ *
+ */
+
+#ifndef _SHD_SUB_H_
+#define _SHD_SUB_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "shd_ctx.h"
+#include "libshdata.h"
+
+struct shd_sub {
+	/* consumer context of the watched section */
+	struct shd_ctx *ctx;
+	/* quantity and condition of the subscription */
+	struct shd_sub_info info;
+	/* value of the quantity in the last reported sample */
+	void *ref;
+	/* copy of ref, restored if a scan is invalidated */
+	void *saved_ref;
+	/* whether a sample was already reported */
+	bool has_ref;
+	/* index of the last scanned sample, -1 if none was scanned yet */
+	int cursor;
+	/* number of writes of the slot of the last scanned sample */
+	int cursor_writes;
+	/* revision of the section when the cursor was set */
+	int nb_creations;
+};
+
+/*
+ * @brief Check whether a subscription can be made on a section
+ *
+ * @param[in] info : quantity to watch and condition of the subscription
+ * @param[in] blob_size : size of a blob of the section
+ *
+ * @return : 0 if the subscription is valid,
+ *           -EINVAL otherwise
+ */
+int shd_sub_check(const struct shd_sub_info *info, size_t blob_size);
+
+/*
+ * @brief Allocate a new subscription
+ *
+ * @param[in] ctx : consumer context of the watched section
+ * @param[in] info : quantity and condition, previously checked with
+ * shd_sub_check()
+ *
+ * @return : an allocated subscription,
+ *           NULL in case of error
+ */
+struct shd_sub *shd_sub_new(struct shd_ctx *ctx,
+				const struct shd_sub_info *info);
+
+/*
+ * @brief Scan the samples committed since the previous scan and copy those
+ * which satisfy the condition of a subscription
+ *
+ * @param[in,out] sub : subscription
+ * @param[out] samples : destination of the reported samples
+ * @param[in] max_samples : number of elements of samples, not 0
+ *
+ * @return : number of samples reported,
+ *           -EAGAIN if the scanned samples were overwritten during the scan
+ */
+int shd_sub_scan(struct shd_sub *sub, struct shd_quantity_sample samples[],
+			size_t max_samples);
+
+/*
+ * @brief Destroy a subscription
+ *
+ * @param[in] sub : subscription to destroy
+ */
+void shd_sub_destroy(struct shd_sub *sub);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SHD_SUB_H_ */
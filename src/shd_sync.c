@@ -27,12 +27,23 @@
  *
  */
 
+#define _GNU_SOURCE
 #include <stddef.h>		/* For NULL pointer */
 #include <stdlib.h>		/* For memory allocation functions */
 #include <errno.h>
+#include <limits.h>		/* INT_MAX */
+#include <unistd.h>		/* For syscall */
+#include <sys/syscall.h>	/* For SYS_futex */
+#include <linux/futex.h>	/* For futex operations */
 
 #include "shd_private.h"
 #include "shd_utils.h"
+
+/*
+ * Count stored into a sample held during a batch write, and the other way
+ * round : it is always lower than -1, which marks never written samples
+ */
+#define HELD_NB_WRITES(_n) (-2 - (_n))
 #include "shd_data.h"
 #include "shd_section.h"
 #include "shd_sync.h"
@@ -109,7 +120,7 @@ int shd_sync_start_sample_write(struct shd_sync_ctx *ctx,
 	/* Invalidate sample */
 	ctx->primitives.add_and_fetch(&samp->nb_writes, 1);
 	/* Update local index */
-	index_increment_from(&ctx->index, &hdr->write_index, desc->nb_samples);
+	index_increment_from(&ctx->index, &hdr->write_index, desc);
 
 	unexpected_samples = interval_between(ctx->prev_index,
 					ctx->index,
@@ -130,6 +141,45 @@ int shd_sync_start_sample_write(struct shd_sync_ctx *ctx,
 	return 0;
 }
 
+int shd_sync_continue_sample_write(struct shd_sync_ctx *ctx,
+				struct shd_sync_sample *samp,
+				const struct shd_data_section_desc *desc)
+{
+	if (ctx == NULL || samp == NULL)
+		return -EINVAL;
+	if (ctx->index == -1)
+		return -EPERM;
+
+	/* Invalidate sample : the write session is already started, and the
+	 * write index is only published at the end of the batch */
+	ctx->primitives.add_and_fetch(&samp->nb_writes, 1);
+	shd_sync_hold_sample(samp);
+	ctx->index = index_next(ctx->index, desc);
+
+	return 0;
+}
+
+int shd_sync_hold_sample(struct shd_sync_sample *samp)
+{
+	if (samp == NULL)
+		return -EINVAL;
+
+	__atomic_store_n(&samp->nb_writes, HELD_NB_WRITES(samp->nb_writes),
+			__ATOMIC_SEQ_CST);
+	return 0;
+}
+
+int shd_sync_release_sample(struct shd_sync_sample *samp)
+{
+	if (samp == NULL)
+		return -EINVAL;
+
+	/* The count stored is the same as if the sample had not been held */
+	__atomic_store_n(&samp->nb_writes, HELD_NB_WRITES(samp->nb_writes),
+			__ATOMIC_RELEASE);
+	return 0;
+}
+
 int shd_sync_end_write_session(struct shd_sync_ctx *ctx,
 					struct shd_sync_hdr *hdr)
 {
@@ -137,7 +187,8 @@ int shd_sync_end_write_session(struct shd_sync_ctx *ctx,
 		return -EINVAL;
 
 	ULOGD("End of write on sample at index : %d", ctx->index);
-	hdr->write_index = ctx->index;
+	/* The samples written are visible once the index is */
+	__atomic_store_n(&hdr->write_index, ctx->index, __ATOMIC_RELEASE);
 	hdr->nb_ongoing_writes = 0;
 	ctx->prev_index = ctx->index;
 	ctx->index = -1;
@@ -164,7 +215,11 @@ int shd_sync_end_read_session(struct shd_sync_ctx *ctx,
 		goto exit;
 	}
 
-	if (ctx->nb_writes != samp->nb_writes) {
+	if (ctx->nb_writes < -1) {
+		ULOGW("Read session started on a held sample : "
+			"nb_writes : %d", ctx->nb_writes);
+		ret = -EFAULT;
+	} else if (ctx->nb_writes != samp->nb_writes) {
 		ULOGW("Current sample has been overwritten during read : "
 			"expected value : %d, read : %d", ctx->nb_writes,
 							samp->nb_writes);
@@ -192,7 +247,7 @@ int shd_sync_invalidate_sample(struct shd_sync_sample *samp)
 
 bool shd_sync_is_sample_valid(const struct shd_sync_sample *samp)
 {
-	return samp->nb_writes != -1;
+	return samp->nb_writes >= 0;
 }
 
 int shd_sync_invalidate_section(struct shd_sync_ctx *ctx,
@@ -256,7 +311,7 @@ int shd_sync_get_next_write_index(const struct shd_sync_hdr *hdr,
 	if (hdr == NULL)
 		return -1;
 
-	return index_next(hdr->write_index, desc->nb_samples);
+	return index_next(hdr->write_index, desc);
 }
 
 int shd_sync_get_last_write_index(const struct shd_sync_hdr *hdr)
@@ -276,3 +331,171 @@ int shd_sync_primitives_set_builtin(struct shd_sync_primitives *primitives)
 
 	return 0;
 }
+
+#define COMMIT_SEQ_NOTIFY	1u
+#define COMMIT_SEQ_INCREMENT	2u
+
+/* Period at which sections whose producer does not notify commits are
+ * polled */
+#define COMMIT_POLL_PERIOD_NS	1000000
+
+static void futex_wake(uint32_t *word)
+{
+	syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+void shd_sync_notify_commit(const struct shd_sync_ctx *ctx,
+				struct shd_sync_hdr *hdr)
+{
+	uint32_t seq, next;
+
+	/* The producer is the only writer of the commit sequence number : the
+	 * release store publishes the write index along with it */
+	seq = __atomic_load_n(&hdr->commit_seq, __ATOMIC_RELAXED);
+	next = ((seq + COMMIT_SEQ_INCREMENT) & ~COMMIT_SEQ_NOTIFY)
+			| (ctx->notify ? COMMIT_SEQ_NOTIFY : 0);
+	__atomic_store_n(&hdr->commit_seq, next, __ATOMIC_RELEASE);
+
+	/* Consumers only block if commits were notified until now */
+	if ((seq | next) & COMMIT_SEQ_NOTIFY)
+		futex_wake(&hdr->commit_seq);
+}
+
+uint32_t shd_sync_get_commit_seq(const struct shd_sync_hdr *hdr)
+{
+	/* Pairs with the release store of the commit : the write index read
+	 * afterwards is at least as recent */
+	return __atomic_load_n(&hdr->commit_seq, __ATOMIC_ACQUIRE) >> 1;
+}
+
+void shd_sync_set_notify(struct shd_sync_ctx *ctx, struct shd_sync_hdr *hdr,
+				bool enable)
+{
+	uint32_t seq;
+
+	ctx->notify = enable;
+	seq = __atomic_load_n(&hdr->commit_seq, __ATOMIC_RELAXED);
+	if (enable)
+		seq |= COMMIT_SEQ_NOTIFY;
+	else
+		seq &= ~COMMIT_SEQ_NOTIFY;
+	__atomic_store_n(&hdr->commit_seq, seq, __ATOMIC_SEQ_CST);
+
+	/* Blocked consumers switch back to polling */
+	if (!enable)
+		futex_wake(&hdr->commit_seq);
+}
+
+static int futex_wait(uint32_t *word, uint32_t val,
+			const struct timespec *timeout)
+{
+	/* FUTEX_WAIT_BITSET takes an absolute CLOCK_MONOTONIC timeout */
+	if (syscall(SYS_futex, word, FUTEX_WAIT_BITSET, val, timeout, NULL,
+			FUTEX_BITSET_MATCH_ANY) < 0)
+		return -errno;
+	return 0;
+}
+
+static int futex_wait_many(uint32_t *word[], const uint32_t val[],
+				size_t nb, const struct timespec *timeout)
+{
+#ifdef SYS_futex_waitv
+	struct futex_waitv waiters[SHD_WAIT_MAX_SECTIONS];
+	size_t i;
+
+	for (i = 0; i < nb; i++) {
+		waiters[i].val = val[i];
+		waiters[i].uaddr = (uintptr_t)word[i];
+		waiters[i].flags = FUTEX_32;
+		waiters[i].__reserved = 0;
+	}
+
+	if (syscall(SYS_futex_waitv, waiters, nb, 0, timeout,
+			CLOCK_MONOTONIC) < 0)
+		return -errno;
+	return 0;
+#else
+	return -ENOSYS;
+#endif
+}
+
+static void get_poll_date(const struct timespec *now, struct timespec *date)
+{
+	*date = *now;
+	date->tv_nsec += COMMIT_POLL_PERIOD_NS;
+	if (date->tv_nsec >= 1000000000) {
+		date->tv_nsec -= 1000000000;
+		date->tv_sec++;
+	}
+}
+
+static bool timespec_before(const struct timespec *a, const struct timespec *b)
+{
+	return a->tv_sec < b->tv_sec
+		|| (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+int shd_sync_wait_commit(struct shd_sync_hdr *hdr[], uint32_t seq[],
+				size_t nb, const struct timespec *timeout)
+{
+	uint32_t *word[SHD_WAIT_MAX_SECTIONS];
+	uint32_t val[SHD_WAIT_MAX_SECTIONS];
+	struct timespec now, poll_date;
+	const struct timespec *date;
+	bool waitv = nb > 1;
+	bool notified;
+	int nb_ready;
+	size_t i;
+	int ret;
+
+	for (i = 0; i < nb; i++)
+		word[i] = &hdr[i]->commit_seq;
+
+	while (true) {
+		nb_ready = 0;
+		notified = true;
+		for (i = 0; i < nb; i++) {
+			val[i] = __atomic_load_n(word[i], __ATOMIC_ACQUIRE);
+			if ((val[i] >> 1) != seq[i]) {
+				seq[i] = val[i] >> 1;
+				nb_ready++;
+			}
+			if (!(val[i] & COMMIT_SEQ_NOTIFY))
+				notified = false;
+		}
+		if (nb_ready > 0)
+			return nb_ready;
+
+		/* Spare a system call to callers which only check for commits */
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (timeout != NULL && !timespec_before(&now, timeout))
+			return -ETIMEDOUT;
+
+		/* Sections whose producer does not notify commits, or which
+		 * can not all be waited for at once, are polled */
+		date = timeout;
+		if (!notified || (nb > 1 && !waitv)) {
+			get_poll_date(&now, &poll_date);
+			if (timeout == NULL
+				|| timespec_before(&poll_date, timeout))
+				date = &poll_date;
+		}
+
+		/* The wait returns at once if a futex word has changed since
+		 * it was read */
+		if (waitv) {
+			ret = futex_wait_many(word, val, nb, date);
+			if (ret == -ENOSYS) {
+				/* Linux < 5.16 */
+				waitv = false;
+				continue;
+			}
+		} else {
+			ret = futex_wait(word[0], val[0], date);
+		}
+		if (ret == -ETIMEDOUT && date == timeout)
+			return ret;
+		if (ret < 0 && ret != -ETIMEDOUT && ret != -EAGAIN)
+			return ret;
+	}
+}
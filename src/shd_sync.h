@@ -34,6 +34,8 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
 
 struct shd_revision {
 	/*
@@ -59,6 +61,10 @@ struct shd_sync_hdr {
 	/* Number of writes currently going on in the section : in nominal
 	 * function, it should always only be 0 or 1 */
 	int nb_ongoing_writes;
+	/* Commit notification word (futex) : the upper 31 bits count the
+	 * commits, bit 0 is set while the producer notifies them. On the
+	 * cache line of the revision, as both are polled by idle consumers */
+	uint32_t commit_seq;
 };
 
 /*
@@ -86,6 +92,8 @@ struct shd_sync_ctx {
 	int nb_writes;
 	/* Primitives to use on the section */
 	struct shd_sync_primitives primitives;
+	/* Whether commits are notified to waiting consumers */
+	bool notify;
 };
 
 /*
@@ -93,7 +101,8 @@ struct shd_sync_ctx {
  */
 struct shd_sync_sample {
 	/* number of writes to the memory slot currently in use for the
-	 * sample
+	 * sample : -1 if it was never written, lower than -1 while it is held
+	 * by a batch write
 	 */
 	int nb_writes;
 };
@@ -172,7 +181,8 @@ int shd_sync_start_sample_write(struct shd_sync_ctx *ctx,
 				const struct shd_data_section_desc *desc);
 
 /*
- * @brief End write session on a sample
+ * @brief End write session on a sample, publishing its write index. Waiting
+ * consumers are woken up separately by shd_sync_notify_commit()
  *
  * @param[in,out] ctx : current synchronization context
  * @param[in,out] hdr : pointer to the synchronization part of the section
@@ -207,7 +217,7 @@ int shd_sync_start_read_session(struct shd_sync_ctx *ctx,
  * @return : 0 in case of success,
  *           -EINVAL if arguments are invalid,
  *           -EFAULT if read sample(s) was/were overwritten during last reading
- * sequence
+ * sequence, or were held by the producer when it started
  */
 int shd_sync_end_read_session(struct shd_sync_ctx *ctx,
 					struct shd_sync_sample *samp);
@@ -240,6 +250,30 @@ int shd_sync_invalidate_sample(struct shd_sync_sample *samp);
  */
 bool shd_sync_is_sample_valid(const struct shd_sync_sample *samp);
 
+/*
+ * @brief Hold a sample written in a batch : the sample is invalid, and read
+ * sessions started on it fail, until shd_sync_release_sample() is called.
+ * Its number of writes is kept, encoded as a value lower than -1
+ *
+ * @param[in,out] samp : pointer to the sample
+ *
+ * @return : 0 in case of success,
+ *           -EINVAL if samp is NULL
+ */
+int shd_sync_hold_sample(struct shd_sync_sample *samp);
+
+/*
+ * @brief Release a sample held by shd_sync_hold_sample(), restoring its
+ * number of writes. Data written into the sample before the call are visible
+ * to consumers which see it valid
+ *
+ * @param[in,out] samp : pointer to the sample
+ *
+ * @return : 0 in case of success,
+ *           -EINVAL if samp is NULL
+ */
+int shd_sync_release_sample(struct shd_sync_sample *samp);
+
 /*
  * @brief Invalidate a data section
  *
@@ -303,6 +337,23 @@ int shd_sync_check_revision_nb(struct shd_revision *rev,
  */
 int shd_sync_get_local_write_index(const struct shd_sync_ctx *ctx);
 
+/*
+ * @brief Start writing the sample which follows the current one, both being
+ * published at once by the next call to shd_sync_end_write_session(). The
+ * sample is held by shd_sync_hold_sample()
+ *
+ * @param[in,out] ctx : current synchronization context
+ * @param[in,out] samp : synchronization part of the next sample
+ * @param[in] desc : description of the data section
+ *
+ * @return : 0 in case of success,
+ *           -EINVAL if ctx or samp is NULL,
+ *           -EPERM if no sample is currently being written
+ */
+int shd_sync_continue_sample_write(struct shd_sync_ctx *ctx,
+				struct shd_sync_sample *samp,
+				const struct shd_data_section_desc *desc);
+
 /*
  * @brief get next write index
  *
@@ -335,4 +386,53 @@ int shd_sync_get_last_write_index(const struct shd_sync_hdr *hdr);
  */
 int shd_sync_primitives_set_builtin(struct shd_sync_primitives *primitives);
 
+/*
+ * @brief Count a commit in the section, and wake up the consumers waiting for
+ * it if commits are notified
+ *
+ * @param[in] ctx : current synchronization context
+ * @param[in,out] hdr : pointer to the synchronization part of the section
+ * header
+ */
+void shd_sync_notify_commit(const struct shd_sync_ctx *ctx,
+				struct shd_sync_hdr *hdr);
+
+/*
+ * @brief Get the number of commits in the section
+ *
+ * @param[in] hdr : pointer to the synchronization part of the section header
+ *
+ * @return : commit sequence number, as used by shd_sync_wait_commit()
+ */
+uint32_t shd_sync_get_commit_seq(const struct shd_sync_hdr *hdr);
+
+/*
+ * @brief Enable or disable the notification of commits in the section
+ *
+ * @param[in,out] ctx : current synchronization context
+ * @param[in,out] hdr : pointer to the synchronization part of the section
+ * header
+ * @param[in] enable : true to wake up waiting consumers on each commit
+ */
+void shd_sync_set_notify(struct shd_sync_ctx *ctx, struct shd_sync_hdr *hdr,
+				bool enable);
+
+/*
+ * @brief Wait for a commit in any of a set of sections
+ *
+ * @param[in,out] hdr : pointers to the synchronization part of the section
+ * headers
+ * @param[in,out] seq : commit sequence numbers last seen by the caller,
+ * updated for the sections in which a commit occurred
+ * @param[in] nb : number of sections (at most SHD_WAIT_MAX_SECTIONS)
+ * @param[in] timeout : absolute CLOCK_MONOTONIC date, NULL to wait forever
+ *
+ * @return : number of sections in which a commit occurred,
+ *           -ETIMEDOUT if timeout was reached,
+ *           -EINTR if the wait was interrupted by a signal,
+ *           -errno of the futex system call otherwise
+ */
+int shd_sync_wait_commit(struct shd_sync_hdr *hdr[], uint32_t seq[],
+				size_t nb, const struct timespec *timeout);
+
 #endif /* _SHD_SYNC_H_ */
@@ -0,0 +1,529 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_tier.c
+ *
+ * @brief Downsampled tiers of a section.
+ *
+ * @details Tier #i of section "name" is the section "name-tier<i>", whose
+ * blob metadata header is a struct shd_tier_hdr. The producer aggregates the
+ * numeric elements of each committed sample in its own memory, and writes a
+ * tier sample once its bucket is complete. A tier sample is stamped with the
+ * timestamp of the first sample of its bucket and the expiration date of the
+ * last one.
+ *
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "futils/timetools.h"
+#include "shd_private.h"
+#include "shd_ctx.h"
+#include "shd_data.h"
+#include "shd_hdr.h"
+#include "shd_sample.h"
+#include "shd_schema.h"
+#include "shd_tier.h"
+
+/* Blob metadata header of a tier section */
+struct shd_tier_hdr {
+	/* number of base samples aggregated in each tier sample */
+	uint32_t factor;
+	/* level of the tier, starting from 1 */
+	uint32_t level;
+};
+
+struct shd_tier {
+	/* context of the tier section */
+	struct shd_ctx *ctx;
+	/* revision of the tier section (consumer only) */
+	struct shd_revision *rev;
+	/* number of base samples aggregated in each tier sample */
+	uint32_t factor;
+	/* number of samples aggregated in the current bucket (producer
+	 * only) */
+	uint32_t count;
+	/* sum, minimum and maximum of each numeric element over the current
+	 * bucket (producer only) */
+	double *sum;
+	double *min;
+	double *max;
+	/* metadata of the current bucket (producer only) */
+	struct shd_sample_metadata meta;
+};
+
+struct shd_tiers {
+	struct shd_tier tier[SHD_MAX_TIERS];
+	size_t nb_tiers;
+	/* size of a blob of the base section */
+	size_t blob_size;
+	/* numeric elements of the blob (producer only) */
+	struct shd_schema_elem *elems;
+	size_t nb_elems;
+	/* values of the numeric elements of the latest sample, and blob of
+	 * the next tier sample (producer only) */
+	double *values;
+	char *stage;
+	/* index of the tier chosen for the current read sequence, -1 for the
+	 * base section (consumer only) */
+	int read;
+	/* whether the tiers are written by this process */
+	bool producer;
+};
+
+static int get_name(const char *blob_name, size_t level, char *name,
+			size_t size)
+{
+	int ret = snprintf(name, size, "%s-tier%zu", blob_name, level);
+
+	return ret < 0 || (size_t) ret >= size ? -ENAMETOOLONG : 0;
+}
+
+static double get_value(const void *src, enum shd_field_type type)
+{
+	union {
+		uint8_t u8;
+		int8_t i8;
+		uint16_t u16;
+		int16_t i16;
+		uint32_t u32;
+		int32_t i32;
+		uint64_t u64;
+		int64_t i64;
+		float f;
+		double d;
+	} v;
+
+	/* Elements may not be aligned within the blob */
+	memcpy(&v, src, shd_schema_get_type_size(type));
+
+	switch (type) {
+	case SHD_FIELD_UINT8:
+		return v.u8;
+	case SHD_FIELD_INT8:
+		return v.i8;
+	case SHD_FIELD_UINT16:
+		return v.u16;
+	case SHD_FIELD_INT16:
+		return v.i16;
+	case SHD_FIELD_UINT32:
+		return v.u32;
+	case SHD_FIELD_INT32:
+		return v.i32;
+	case SHD_FIELD_UINT64:
+		return v.u64;
+	case SHD_FIELD_INT64:
+		return v.i64;
+	case SHD_FIELD_FLOAT:
+		return v.f;
+	case SHD_FIELD_DOUBLE:
+		return v.d;
+	default:
+		return 0;
+	}
+}
+
+/* Round to nearest, saturating to the range of the destination type */
+static int64_t to_int(double v, int64_t min, int64_t max)
+{
+	if (!(v > (double)min))
+		return min;
+	if (v >= (double)max)
+		return max;
+	return v < 0 ? (int64_t)(v - 0.5) : (int64_t)(v + 0.5);
+}
+
+static uint64_t to_uint(double v, uint64_t max)
+{
+	if (!(v > 0))
+		return 0;
+	if (v >= (double)max)
+		return max;
+	return (uint64_t)(v + 0.5);
+}
+
+static void set_value(void *dst, enum shd_field_type type, double v)
+{
+	union {
+		uint8_t u8;
+		int8_t i8;
+		uint16_t u16;
+		int16_t i16;
+		uint32_t u32;
+		int32_t i32;
+		uint64_t u64;
+		int64_t i64;
+		float f;
+		double d;
+	} out;
+
+	switch (type) {
+	case SHD_FIELD_UINT8:
+		out.u8 = to_uint(v, UINT8_MAX);
+		break;
+	case SHD_FIELD_INT8:
+		out.i8 = to_int(v, INT8_MIN, INT8_MAX);
+		break;
+	case SHD_FIELD_UINT16:
+		out.u16 = to_uint(v, UINT16_MAX);
+		break;
+	case SHD_FIELD_INT16:
+		out.i16 = to_int(v, INT16_MIN, INT16_MAX);
+		break;
+	case SHD_FIELD_UINT32:
+		out.u32 = to_uint(v, UINT32_MAX);
+		break;
+	case SHD_FIELD_INT32:
+		out.i32 = to_int(v, INT32_MIN, INT32_MAX);
+		break;
+	case SHD_FIELD_UINT64:
+		out.u64 = to_uint(v, UINT64_MAX);
+		break;
+	case SHD_FIELD_INT64:
+		out.i64 = to_int(v, INT64_MIN, INT64_MAX);
+		break;
+	case SHD_FIELD_FLOAT:
+		out.f = v;
+		break;
+	case SHD_FIELD_DOUBLE:
+		out.d = v;
+		break;
+	default:
+		return;
+	}
+
+	memcpy(dst, &out, shd_schema_get_type_size(type));
+}
+
+int shd_tiers_check(const struct shd_tier_info tiers[], size_t nb_tiers)
+{
+	uint32_t factor = 1;
+	size_t i;
+
+	if (tiers == NULL || nb_tiers == 0 || nb_tiers > SHD_MAX_TIERS)
+		return -EINVAL;
+
+	/* Tiers are ordered from the finest to the coarsest */
+	for (i = 0; i < nb_tiers; i++) {
+		if (tiers[i].factor <= factor || tiers[i].max_nb_samples == 0)
+			return -EINVAL;
+		factor = tiers[i].factor;
+	}
+
+	return 0;
+}
+
+struct shd_tiers *shd_tiers_create(const char *blob_name,
+			const struct shd_hdr_user_info *hdr_info,
+			const void *blob_metadata_hdr,
+			const struct shd_tier_info tiers_info[],
+			size_t nb_tiers)
+{
+	struct shd_tiers *tiers;
+	struct shd_tier *tier;
+	struct shd_hdr_user_info tier_hdr_info;
+	struct shd_tier_hdr tier_hdr;
+	char name[SHD_SECTION_NAME_MAX];
+	uint64_t rate;
+	int ret;
+	size_t i;
+
+	tiers = calloc(1, sizeof(*tiers));
+	if (tiers == NULL)
+		return NULL;
+
+	tiers->blob_size = hdr_info->blob_size;
+	tiers->read = -1;
+	tiers->producer = true;
+
+	/* Without schema, tiers only decimate the base section */
+	ret = shd_schema_get_numeric(blob_metadata_hdr,
+			hdr_info->blob_metadata_hdr_size, hdr_info->blob_size,
+			NULL, 0);
+	if (ret > 0) {
+		tiers->elems = calloc(ret, sizeof(*tiers->elems));
+		tiers->values = calloc(ret, sizeof(*tiers->values));
+		if (tiers->elems == NULL || tiers->values == NULL)
+			goto error;
+		tiers->nb_elems = shd_schema_get_numeric(blob_metadata_hdr,
+				hdr_info->blob_metadata_hdr_size,
+				hdr_info->blob_size, tiers->elems, ret);
+	} else if (ret == -EPROTO) {
+		ULOGW("Invalid blob schema : tiers of \"%s\" only hold "
+				"decimated samples", blob_name);
+	}
+
+	tiers->stage = malloc(3 * hdr_info->blob_size);
+	if (tiers->stage == NULL)
+		goto error;
+
+	for (i = 0; i < nb_tiers; i++) {
+		tier = &tiers->tier[i];
+		tier->factor = tiers_info[i].factor;
+		if (tiers->nb_elems > 0) {
+			tier->sum = calloc(tiers->nb_elems, sizeof(double));
+			tier->min = calloc(tiers->nb_elems, sizeof(double));
+			tier->max = calloc(tiers->nb_elems, sizeof(double));
+			if (tier->sum == NULL || tier->min == NULL
+					|| tier->max == NULL)
+				goto error;
+		}
+
+		rate = (uint64_t) hdr_info->rate * tier->factor;
+		tier_hdr_info.blob_size = 3 * hdr_info->blob_size;
+		tier_hdr_info.max_nb_samples = tiers_info[i].max_nb_samples;
+		tier_hdr_info.rate = rate > UINT32_MAX ? UINT32_MAX : rate;
+		tier_hdr_info.blob_metadata_hdr_size = sizeof(tier_hdr);
+		tier_hdr.factor = tier->factor;
+		tier_hdr.level = i + 1;
+
+		if (get_name(blob_name, i + 1, name, sizeof(name)) < 0) {
+			ULOGE("Name of the tiers of \"%s\" is too long",
+					blob_name);
+			goto error;
+		}
+
+		tier->ctx = shd_create(name, NULL, &tier_hdr_info, &tier_hdr);
+		if (tier->ctx == NULL) {
+			ULOGE("Could not create tier section \"%s\"", name);
+			goto error;
+		}
+		tiers->nb_tiers++;
+	}
+
+	return tiers;
+
+error:
+	shd_tiers_destroy(tiers);
+	return NULL;
+}
+
+static void write_tier_sample(struct shd_tiers *tiers, struct shd_tier *tier,
+				const struct shd_sample *sample)
+{
+	size_t blob_size = tiers->blob_size;
+	char *mean = tiers->stage;
+	char *min = mean + blob_size;
+	char *max = min + blob_size;
+	const struct shd_schema_elem *elem;
+	size_t i;
+	int ret;
+
+	/* Bytes which are not numeric elements keep their latest value */
+	memcpy(mean, &sample->blob, blob_size);
+	memcpy(min, &sample->blob, blob_size);
+	memcpy(max, &sample->blob, blob_size);
+
+	for (i = 0; i < tiers->nb_elems; i++) {
+		elem = &tiers->elems[i];
+		set_value(mean + elem->offset, elem->type,
+				tier->sum[i] / tier->count);
+		set_value(min + elem->offset, elem->type, tier->min[i]);
+		set_value(max + elem->offset, elem->type, tier->max[i]);
+	}
+
+	tier->meta.exp = sample->metadata.exp;
+	ret = shd_write_new_blob(tier->ctx, tiers->stage, 3 * blob_size,
+			&tier->meta);
+	if (ret < 0)
+		ULOGW("Could not write tier sample of \"%s\" : %s",
+				tier->ctx->blob_name, strerror(-ret));
+}
+
+void shd_tiers_feed(struct shd_tiers *tiers, const struct shd_sample *sample)
+{
+	const char *blob = (const char *)&sample->blob;
+	struct shd_tier *tier;
+	double v;
+	size_t i, j;
+
+	for (j = 0; j < tiers->nb_elems; j++)
+		tiers->values[j] = get_value(blob + tiers->elems[j].offset,
+						tiers->elems[j].type);
+
+	for (i = 0; i < tiers->nb_tiers; i++) {
+		tier = &tiers->tier[i];
+		if (tier->count == 0) {
+			tier->meta.ts = sample->metadata.ts;
+			for (j = 0; j < tiers->nb_elems; j++) {
+				v = tiers->values[j];
+				tier->sum[j] = v;
+				tier->min[j] = v;
+				tier->max[j] = v;
+			}
+		} else {
+			for (j = 0; j < tiers->nb_elems; j++) {
+				v = tiers->values[j];
+				tier->sum[j] += v;
+				if (v < tier->min[j])
+					tier->min[j] = v;
+				if (v > tier->max[j])
+					tier->max[j] = v;
+			}
+		}
+
+		if (++tier->count == tier->factor) {
+			write_tier_sample(tiers, tier, sample);
+			tier->count = 0;
+		}
+	}
+}
+
+struct shd_tiers *shd_tiers_open(const char *blob_name)
+{
+	struct shd_tiers *tiers;
+	struct shd_tier *tier;
+	const struct shd_tier_hdr *tier_hdr;
+	char name[SHD_SECTION_NAME_MAX];
+	size_t i;
+
+	tiers = calloc(1, sizeof(*tiers));
+	if (tiers == NULL)
+		return NULL;
+
+	tiers->read = -1;
+
+	for (i = 0; i < SHD_MAX_TIERS; i++) {
+		tier = &tiers->tier[i];
+		if (get_name(blob_name, i + 1, name, sizeof(name)) < 0)
+			break;
+
+		tier->ctx = shd_open(name, NULL, &tier->rev);
+		if (tier->ctx == NULL)
+			break;
+
+		if (shd_hdr_get_mdata_size(tier->ctx->sect_mmap->header_top)
+				< sizeof(*tier_hdr)) {
+			shd_close(tier->ctx, tier->rev);
+			tier->ctx = NULL;
+			break;
+		}
+
+		tier_hdr = tier->ctx->sect_mmap->metadata_blob_top;
+		tier->factor = tier_hdr->factor;
+		tiers->nb_tiers++;
+	}
+
+	if (tiers->nb_tiers == 0) {
+		free(tiers);
+		return NULL;
+	}
+
+	tiers->blob_size = tiers->tier[0].ctx->desc->blob_size / 3;
+
+	return tiers;
+}
+
+struct shd_ctx *shd_tiers_select(struct shd_tiers *tiers,
+			struct shd_ctx *base,
+			const struct shd_sample_search *search)
+{
+	struct timespec oldest;
+	struct shd_ctx *ctx;
+	uint64_t window = (uint64_t) search->nb_values_before_date
+			+ search->nb_values_after_date + 1;
+	int chosen = -1;
+	size_t i;
+
+	tiers->read = -1;
+
+	/* A producer reads its own section */
+	if (tiers->producer || search->method == SHD_LATEST
+			|| search->method == SHD_OLDEST)
+		return base;
+
+	if (shd_data_get_oldest_date(base, &oldest) < 0
+			|| time_timespec_cmp(&search->date, &oldest) >= 0)
+		return base;
+
+	/* The finest tier covering the date, or else the coarsest one */
+	for (i = 0; i < tiers->nb_tiers; i++) {
+		ctx = tiers->tier[i].ctx;
+		if (window > ctx->desc->nb_samples
+				|| shd_data_get_oldest_date(ctx, &oldest) < 0)
+			continue;
+
+		chosen = i;
+		if (time_timespec_cmp(&search->date, &oldest) >= 0)
+			break;
+	}
+
+	if (chosen < 0)
+		return base;
+
+	tiers->read = chosen;
+	return tiers->tier[chosen].ctx;
+}
+
+struct shd_ctx *shd_tiers_get_read(const struct shd_tiers *tiers,
+			struct shd_revision **rev)
+{
+	if (tiers->read < 0)
+		return NULL;
+
+	if (rev != NULL)
+		*rev = tiers->tier[tiers->read].rev;
+
+	return tiers->tier[tiers->read].ctx;
+}
+
+uint32_t shd_tiers_get_read_factor(const struct shd_tiers *tiers)
+{
+	if (tiers == NULL || tiers->read < 0)
+		return 1;
+
+	return tiers->tier[tiers->read].factor;
+}
+
+void shd_tiers_end_read(struct shd_tiers *tiers)
+{
+	tiers->read = -1;
+}
+
+void shd_tiers_destroy(struct shd_tiers *tiers)
+{
+	size_t i;
+
+	if (tiers == NULL)
+		return;
+
+	for (i = 0; i < SHD_MAX_TIERS; i++) {
+		if (tiers->tier[i].ctx != NULL)
+			shd_close(tiers->tier[i].ctx, tiers->tier[i].rev);
+		free(tiers->tier[i].sum);
+		free(tiers->tier[i].min);
+		free(tiers->tier[i].max);
+	}
+
+	free(tiers->elems);
+	free(tiers->values);
+	free(tiers->stage);
+	free(tiers);
+}
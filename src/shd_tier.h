@@ -0,0 +1,160 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_tier.h
+ *
+ * @brief Downsampled tiers of a section.
+ *
+ * @details A producer can ask for tiers when it creates a section : each tier
+ * is a section of its own, named after the base section, in which every
+ * sample aggregates "factor" consecutive samples of the base section. The
+ * blob of a tier sample is made of three blobs with the layout of the base
+ * blob, holding the mean, minimum and maximum of each numeric element
+ * described by the blob schema. Other bytes hold the value of the last
+ * sample of the bucket.
+ *
+ */
+
+#ifndef _SHD_TIER_H_
+#define _SHD_TIER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "libshdata.h"
+
+struct shd_tiers;
+struct shd_sample;
+
+/*
+ * @brief Check a list of tiers
+ *
+ * @param[in] tiers : tiers, finest first
+ * @param[in] nb_tiers : number of tiers
+ *
+ * @return : 0 if the list is valid,
+ *           -EINVAL otherwise
+ */
+int shd_tiers_check(const struct shd_tier_info tiers[], size_t nb_tiers);
+
+/*
+ * @brief Create the tier sections of a producer
+ *
+ * @param[in] blob_name : name of the base section
+ * @param[in] hdr_info : header info of the base section
+ * @param[in] blob_metadata_hdr : blob metadata header of the base section,
+ * whose schema tells which elements are aggregated
+ * @param[in] tiers : tiers, previously checked with shd_tiers_check()
+ * @param[in] nb_tiers : number of tiers
+ *
+ * @return : tiers of the producer,
+ *           NULL in case of error
+ */
+struct shd_tiers *shd_tiers_create(const char *blob_name,
+			const struct shd_hdr_user_info *hdr_info,
+			const void *blob_metadata_hdr,
+			const struct shd_tier_info tiers[],
+			size_t nb_tiers);
+
+/*
+ * @brief Aggregate a committed sample of the base section into the tiers,
+ * writing the tier samples whose bucket is complete
+ *
+ * @param[in,out] tiers : tiers of the producer
+ * @param[in] sample : committed sample
+ */
+void shd_tiers_feed(struct shd_tiers *tiers, const struct shd_sample *sample);
+
+/*
+ * @brief Open the tier sections of a consumer
+ *
+ * @param[in] blob_name : name of the base section
+ *
+ * @return : tiers of the consumer,
+ *           NULL if no tier could be open
+ */
+struct shd_tiers *shd_tiers_open(const char *blob_name);
+
+/*
+ * @brief Choose the section searched by a consumer : the base section, or the
+ * finest tier covering the date of the search if it is older than the oldest
+ * sample of the base section
+ *
+ * @param[in,out] tiers : tiers of the consumer
+ * @param[in] base : context of the base section
+ * @param[in] search : search parameters
+ *
+ * @return : context of the section to search
+ */
+struct shd_ctx *shd_tiers_select(struct shd_tiers *tiers,
+			struct shd_ctx *base,
+			const struct shd_sample_search *search);
+
+/*
+ * @brief Get the tier chosen by the latest call to shd_tiers_select()
+ *
+ * @param[in] tiers : tiers of the consumer
+ * @param[out] rev : revision of the tier section
+ *
+ * @return : context of the tier section,
+ *           NULL if the base section was chosen
+ */
+struct shd_ctx *shd_tiers_get_read(const struct shd_tiers *tiers,
+			struct shd_revision **rev);
+
+/*
+ * @brief Get the number of base samples aggregated in each sample of the
+ * tier chosen by the latest call to shd_tiers_select()
+ *
+ * @param[in] tiers : tiers of the consumer, can be NULL
+ *
+ * @return : aggregation factor, 1 if the base section was chosen
+ */
+uint32_t shd_tiers_get_read_factor(const struct shd_tiers *tiers);
+
+/*
+ * @brief Forget the tier chosen by the latest call to shd_tiers_select(),
+ * at the end of a read sequence
+ *
+ * @param[in,out] tiers : tiers of the consumer
+ */
+void shd_tiers_end_read(struct shd_tiers *tiers);
+
+/*
+ * @brief Close the tier sections and free the tiers
+ *
+ * @param[in] tiers : tiers to destroy, can be NULL
+ */
+void shd_tiers_destroy(struct shd_tiers *tiers);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SHD_TIER_H_ */
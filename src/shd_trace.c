@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_trace.c
+ *
+ * @brief Semaphores of libshdata static tracepoints.
+ *
+ */
+
+#include "shd_trace.h"
+
+#ifdef SHD_TRACEPOINTS
+
+/* Semaphores are incremented by the tracer when it attaches to the probe of
+ * the same name, they must live in the ".probes" section */
+#define SHD_TRACE_SEMAPHORE_DEFINE(name)				\
+	unsigned short SHD_TRACE_SEMAPHORE(name)			\
+		__attribute__((section(".probes")))
+
+SHD_TRACE_SEMAPHORE_DEFINE(section_create);
+SHD_TRACE_SEMAPHORE_DEFINE(section_open);
+SHD_TRACE_SEMAPHORE_DEFINE(sample_write_start);
+SHD_TRACE_SEMAPHORE_DEFINE(sample_write_commit);
+SHD_TRACE_SEMAPHORE_DEFINE(search_start);
+SHD_TRACE_SEMAPHORE_DEFINE(search_over);
+
+#endif /* SHD_TRACEPOINTS */
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * shd_trace.h
+ *
+ * @brief Static tracepoints of libshdata.
+ *
+ * @details When <sys/sdt.h> is available at build time, the library is built
+ * with USDT probes (provider "libshdata") that can be attached with perf,
+ * bpftrace or systemtap. Each probe is a single nop instruction when no
+ * tracer is attached. Probes which carry a duration are guarded by their
+ * semaphore, so that timestamps are only taken while a tracer is attached.
+ * Defining SHD_NO_TRACEPOINTS removes all the probes from the build.
+ *
+ * Probes and their arguments :
+ *   section_create(blob_name, revision)
+ *   section_open(blob_name, revision, duration_ns)
+ *   sample_write_start(blob_name, index)
+ *   sample_write_commit(blob_name, index, duration_ns)
+ *   search_start(blob_name, method)
+ *   search_over(blob_name, method, result, duration_ns)
+ *
+ * "result" is the number of matching samples, or a negative errno.
+ *
+ * Example :
+ *   bpftrace -e 'usdt:/usr/lib/libshdata.so:libshdata:sample_write_commit
+ *                { @[str(arg0)] = hist(arg2); }'
+ */
+
+#ifndef _SHD_TRACE_H_
+#define _SHD_TRACE_H_
+
+#include <stdint.h>
+#include <time.h>
+
+#if !defined(SHD_NO_TRACEPOINTS) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define SHD_TRACEPOINTS
+#endif
+#endif
+
+#ifdef SHD_TRACEPOINTS
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define SHD_TRACE_SEMAPHORE(name) libshdata_##name##_semaphore
+
+#define SHD_TRACE_SEMAPHORE_DECLARE(name)				\
+	extern unsigned short SHD_TRACE_SEMAPHORE(name)			\
+		__attribute__((visibility("hidden")))
+
+SHD_TRACE_SEMAPHORE_DECLARE(section_create);
+SHD_TRACE_SEMAPHORE_DECLARE(section_open);
+SHD_TRACE_SEMAPHORE_DECLARE(sample_write_start);
+SHD_TRACE_SEMAPHORE_DECLARE(sample_write_commit);
+SHD_TRACE_SEMAPHORE_DECLARE(search_start);
+SHD_TRACE_SEMAPHORE_DECLARE(search_over);
+
+/* True if a tracer is attached to the given probe */
+#define SHD_TRACE_ENABLED(name) \
+	__builtin_expect(SHD_TRACE_SEMAPHORE(name) != 0, 0)
+
+#define SHD_TRACE(name, ...) STAP_PROBEV(libshdata, name, ##__VA_ARGS__)
+
+#else
+
+#define SHD_TRACE_ENABLED(name) 0
+
+/* Arguments still go through a dead branch so that variables only used by
+ * tracepoints don't trigger warnings */
+static inline void shd_trace_discard(int unused, ...)
+{
+	(void)unused;
+}
+
+#define SHD_TRACE(name, ...)					\
+	do {							\
+		if (0)						\
+			shd_trace_discard(0, ##__VA_ARGS__);	\
+	} while (0)
+
+#endif /* SHD_TRACEPOINTS */
+
+/*
+ * @brief Get a monotonic timestamp for tracepoint durations
+ *
+ * @return : current value of the monotonic clock, in ns
+ */
+static inline uint64_t shd_trace_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#endif /* _SHD_TRACE_H_ */
@@ -32,13 +32,40 @@
 #ifndef SHD_UTILS_H_
 #define SHD_UTILS_H_
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include "shd_data.h"
 
 #define ALIGN_UP(x)		ALIGN(x, 4)
 #define ALIGN(x, a)		__ALIGN_MASK(x, (__typeof__(x))(a)-1)
 #define __ALIGN_MASK(x, mask)	(((x)+(mask))&~(mask))
 
 
+/* Sample slots are usually too far apart for hardware prefetchers past this
+ * stride, which do not cross page boundaries */
+#define PREFETCH_MIN_STRIDE	2048
+/* Number of slots prefetched ahead when stepping through large samples */
+#define PREFETCH_DISTANCE	4
+/* Copies longer than this hide the latency of the next slot by themselves,
+ * which is then prefetched only one slot ahead */
+#define PREFETCH_LONG_COPY	4096
+/* Only the start of a copy is prefetched : hardware prefetchers take over
+ * once it streams through its first lines */
+#define PREFETCH_MAX_LINES	4
+#define CACHE_LINE_SIZE		64
+
+static inline void prefetch_range(const void *addr, size_t length)
+{
+	const char *p = addr;
+	size_t i;
+
+	if (length > PREFETCH_MAX_LINES * CACHE_LINE_SIZE)
+		length = PREFETCH_MAX_LINES * CACHE_LINE_SIZE;
+	for (i = 0; i < length; i += CACHE_LINE_SIZE)
+		__builtin_prefetch(p + i, 0, 0);
+}
+
 static inline int max(int a, int b)
 {
 	return a > b ? a : b;
@@ -61,43 +88,77 @@ static inline uint32_t interval_between(int idx1, int idx2, uint32_t size)
 		return idx2 + size - idx1;
 }
 
-static inline int index_n_after(int idx, int n, uint32_t size)
+/*
+ * Ring index arithmetic : when the number of slots in the section is a power
+ * of two, desc->index_mask is set once at map time and the modulo is replaced
+ * by a mask. The ring_*() variants take this choice as a parameter : loops
+ * over many slots test desc->index_mask once, and pass a constant pow2 to a
+ * body inlined with RING_INLINE, so that the choice is made at compile time
+ * instead of at each step
+ */
+#define RING_INLINE	static inline __attribute__((always_inline))
+
+RING_INLINE int ring_n_after(int idx, int n,
+				const struct shd_data_section_desc *desc,
+				bool pow2)
+{
+	if (pow2)
+		return (idx+n) & desc->index_mask;
+	/* Unsigned sum, so that it can not overflow for any valid depth */
+	return ((uint32_t)idx+n)%desc->nb_samples;
+}
+
+RING_INLINE int ring_n_before(int idx, int n,
+				const struct shd_data_section_desc *desc,
+				bool pow2)
+{
+	if (pow2)
+		return (idx-n) & desc->index_mask;
+	return (idx+desc->nb_samples-n)%desc->nb_samples;
+}
+
+static inline int index_n_after(int idx, int n,
+				const struct shd_data_section_desc *desc)
 {
-	return (idx+n)%size;
+	return ring_n_after(idx, n, desc, desc->index_mask != 0);
 }
 
-static inline int index_n_before(int idx, int n, uint32_t size)
+static inline int index_n_before(int idx, int n,
+				const struct shd_data_section_desc *desc)
 {
-	return (idx+size-n)%size;
+	return ring_n_before(idx, n, desc, desc->index_mask != 0);
 }
 
-static inline int index_next(int idx, uint32_t size)
+static inline int index_next(int idx, const struct shd_data_section_desc *desc)
 {
-	return index_n_after(idx, 1, size);
+	return index_n_after(idx, 1, desc);
 }
 
-static inline int index_previous(int idx, uint32_t size)
+static inline int index_previous(int idx,
+				const struct shd_data_section_desc *desc)
 {
-	return index_n_before(idx, 1, size);
+	return index_n_before(idx, 1, desc);
 }
 
-static inline void index_increment(int *idx, uint32_t size)
+static inline void index_increment(int *idx,
+				const struct shd_data_section_desc *desc)
 {
-	int new_idx = index_next(*idx, size);
+	int new_idx = index_next(*idx, desc);
 	*idx = new_idx;
 }
 
 static inline void index_increment_from(int *idx_dest,
-						int *idx_src,
-						uint32_t size)
+					int *idx_src,
+					const struct shd_data_section_desc *desc)
 {
-	int new_idx = index_next(*idx_src, size);
+	int new_idx = index_next(*idx_src, desc);
 	*idx_dest = new_idx;
 }
 
-static inline void index_decrement(int *idx, uint32_t size)
+static inline void index_decrement(int *idx,
+				const struct shd_data_section_desc *desc)
 {
-	int new_idx = index_previous(*idx, size);
+	int new_idx = index_previous(*idx, desc);
 	*idx = new_idx;
 }
 
@@ -104,14 +104,14 @@ int shd_window_set(struct shd_window *window,
 		 * and wr_index. t_index is the most recent sample. t_index+1
 		 * is the oldest. */
 		int nb_older_samples = interval_between(
-				index_next(ctx.t_index, desc->nb_samples),
+				index_next(ctx.t_index, desc),
 				ref_idx,
 				desc->nb_samples);
 
 		int w_start_idx = index_n_before(ref_idx,
 						min(nb_older_samples,
 						search->nb_values_before_date),
-						desc->nb_samples);
+						desc);
 
 		if (shd_search_end(hdr, &ctx, w_start_idx, desc)) {
 			ULOGW("Samples window set during search has been "
@@ -124,12 +124,12 @@ int shd_window_set(struct shd_window *window,
 					ref_idx,
 					min(nb_more_recent_samples,
 						search->nb_values_after_date),
-					desc->nb_samples);
+					desc);
 			window->start_idx = index_n_before(
 					ref_idx,
 					min(nb_older_samples,
 						search->nb_values_before_date),
-					desc->nb_samples);
+					desc);
 			window->nb_matches = 1 + interval_between(
 							window->start_idx,
 							window->end_idx,
@@ -156,15 +156,29 @@ exit:
 	return ret;
 }
 
-int shd_window_read(struct shd_window *window,
-			struct shd_data_section_desc *desc,
-			void *dst,
-			size_t data_size,
-			ptrdiff_t s_offset)
+/* Copy the samples of a window, pow2 being constant (see RING_INLINE) */
+RING_INLINE int window_copy(const struct shd_window *window,
+				const struct shd_data_section_desc *desc,
+				void *dst,
+				size_t data_size,
+				ptrdiff_t s_offset,
+				bool pow2)
 {
 	int s_index; /* index in data section */
 	int d_index; /* index in destination buffer*/
 	struct shd_sample *curr = NULL;
+	int distance = desc->prefetch_distance;
+
+	if (distance != 0 && data_size >= PREFETCH_LONG_COPY)
+		distance = 1;
+
+	/* Slots are prefetched "distance" slots ahead of the copy : prime the
+	 * first ones, the loop takes care of the next ones */
+	for (d_index = 1; d_index < distance && d_index < window->nb_matches;
+			d_index++)
+		prefetch_range((char *)shd_data_get_sample_ptr(desc,
+				ring_n_after(window->start_idx, d_index,
+					desc, pow2)) + s_offset, data_size);
 
 	/*
 	 * Iterate over the whole window of matching samples
@@ -174,17 +188,33 @@ int shd_window_read(struct shd_window *window,
 	 */
 	for (s_index = window->start_idx, d_index = 0;
 		d_index < window->nb_matches;
-		s_index = index_next(s_index, desc->nb_samples),
+		s_index = ring_n_after(s_index, 1, desc, pow2),
 			d_index++) {
 		char *curr_dst;
+		if (distance != 0 && d_index + distance < window->nb_matches)
+			prefetch_range((char *)shd_data_get_sample_ptr(desc,
+					ring_n_after(s_index, distance, desc,
+						pow2)) + s_offset, data_size);
 		curr = shd_data_get_sample_ptr(desc, s_index);
-		curr_dst = (char *) dst + data_size * d_index;
+		curr_dst = (char *) dst + data_size * (size_t) d_index;
 		shd_sample_read(curr, s_offset, curr_dst, data_size);
 	}
 
 	return d_index;
 }
 
+int shd_window_read(struct shd_window *window,
+			struct shd_data_section_desc *desc,
+			void *dst,
+			size_t data_size,
+			ptrdiff_t s_offset)
+{
+	if (desc->index_mask)
+		return window_copy(window, desc, dst, data_size, s_offset,
+				true);
+	return window_copy(window, desc, dst, data_size, s_offset, false);
+}
+
 struct shd_window *shd_window_new(void)
 {
 	struct shd_window *window;
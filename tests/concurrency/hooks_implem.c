@@ -85,11 +85,21 @@ int shd_concurrency_has_thread_completed(int thread_id)
 	return concurrency_env.flags[thread_id][1] == 1;
 }
 
+int shd_concurrency_has_first_action_completed(int thread_id)
+{
+	return concurrency_env.flags[thread_id][0] != 0;
+}
+
 void shd_concurrency_emulate_action_complete()
 {
 	__sync_fetch_and_add(&concurrency_env.parallel_counter, 1);
 }
 
+int shd_concurrency_get_nb_hits(void)
+{
+	return concurrency_env.counter;
+}
+
 void shd_concurrency_hook(enum shd_concurrency_hook hook)
 {
 	switch(concurrency_env.stategy[hook])
@@ -123,6 +133,12 @@ void shd_concurrency_hook(enum shd_concurrency_hook hook)
 		concurrency_env.flags[0][1] = 1;
 		break;
 
+	case FIRST_THREAD_SIGNALS_FIRST_ACTION_WAITS_SECOND_ACTION:
+		__sync_fetch_and_add(&concurrency_env.flags[0][0], 1);
+		WAIT_ON_CONDITION(concurrency_env.flags[1][1] == 0);
+		concurrency_env.flags[0][1] = 1;
+		break;
+
 	case PARALLEL_BOTH_THREADS_SIGNAL_ACTION:
 		__sync_fetch_and_add(&concurrency_env.parallel_counter, 1);
 		break;
@@ -131,6 +147,10 @@ void shd_concurrency_hook(enum shd_concurrency_hook hook)
 		WAIT_ON_CONDITION(concurrency_env.parallel_counter < 2);
 		break;
 
+	case COUNT_HITS:
+		__sync_fetch_and_add(&concurrency_env.counter, 1);
+		break;
+
 	default:
 		break;
 	}
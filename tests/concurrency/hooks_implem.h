@@ -54,11 +54,16 @@ enum concurrency_strategy {
 	SECOND_THREAD_WAITS_FIRST_THREAD_FIRST_ACTION,
 	SECOND_THREAD_SIGNALS_SECOND_ACTION,
 	FIRST_THREAD_WAITS_SECOND_THREAD_SECOND_ACTION,
+	/* Both first thread actions at the same hook point */
+	FIRST_THREAD_SIGNALS_FIRST_ACTION_WAITS_SECOND_ACTION,
 
 	/* Strategies to use when the two threads follow the same execution
 	 * path */
 	PARALLEL_BOTH_THREADS_SIGNAL_ACTION,
-	PARALLEL_BOTH_THREADS_WAIT_ALL_ACTIONS_COMPLETE
+	PARALLEL_BOTH_THREADS_WAIT_ALL_ACTIONS_COMPLETE,
+
+	/* Strategy to use to check that an execution path is followed */
+	COUNT_HITS
 };
 
 /*
@@ -96,6 +101,15 @@ void shd_concurrency_emulate_thread_completion(int thread_id);
  */
 int shd_concurrency_has_thread_completed(int thread_id);
 
+/*
+ * @brief Return whether thread has completed its first action or not
+ *
+ * @details this function is useful if test code should act while the thread
+ * is held at a hook point (see
+ * FIRST_THREAD_SIGNALS_FIRST_ACTION_WAITS_SECOND_ACTION)
+ */
+int shd_concurrency_has_first_action_completed(int thread_id);
+
 /*
  * @brief Emulate end of action
  *
@@ -106,6 +120,12 @@ int shd_concurrency_has_thread_completed(int thread_id);
  */
 void shd_concurrency_emulate_action_complete(void);
 
+/*
+ * @brief Return the number of times hook points with the COUNT_HITS strategy
+ * have been reached since the hooks were cleaned
+ */
+int shd_concurrency_get_nb_hits(void);
+
 /*
  * @brief Entry point for libshdata's main code
  */
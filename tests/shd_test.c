@@ -29,6 +29,7 @@
  *
  */
 
+#include <sys/mman.h>
 #include "libshdata.h"
 #include "shd_test.h"
 #include "stdlib.h"
@@ -42,6 +43,18 @@ extern CU_TestInfo s_func_read_hdr_tests[];
 extern CU_TestInfo s_func_adv_write_tests[];
 extern CU_TestInfo s_error_tests[];
 extern CU_TestInfo s_concurrency_tests[];
+extern CU_TestInfo s_large_section_tests[];
+extern int large_section_cleanup(void);
+extern CU_TestInfo s_registry_tests[];
+extern CU_TestInfo s_schema_tests[];
+extern CU_TestInfo s_notify_tests[];
+extern CU_TestInfo s_dirty_tests[];
+extern CU_TestInfo s_rec_tests[];
+extern CU_TestInfo s_tier_tests[];
+extern CU_TestInfo s_aggregate_tests[];
+extern CU_TestInfo s_sub_tests[];
+extern CU_TestInfo s_filter_tests[];
+extern CU_TestInfo s_col_tests[];
 
 static int use_binary_search(void)
 {
@@ -72,11 +85,30 @@ static CU_SuiteInfo s_suites[] = {
 			NULL, NULL, s_func_adv_write_tests},
 	{(char *)"error cases", NULL, NULL, s_error_tests},
 	{(char *)"concurrency tests", NULL, NULL, s_concurrency_tests},
+	{(char *)"large sections",
+			NULL, large_section_cleanup, s_large_section_tests},
+	{(char *)"section registry", NULL, NULL, s_registry_tests},
+	{(char *)"blob schema", NULL, NULL, s_schema_tests},
+	{(char *)"commit notification", NULL, NULL, s_notify_tests},
+	{(char *)"tracked quantities", NULL, NULL, s_dirty_tests},
+	{(char *)"record sections", NULL, NULL, s_rec_tests},
+	{(char *)"downsampled tiers", NULL, NULL, s_tier_tests},
+	{(char *)"windowed aggregation", NULL, NULL, s_aggregate_tests},
+	{(char *)"subscriptions", NULL, NULL, s_sub_tests},
+	{(char *)"filtered reads", NULL, NULL, s_filter_tests},
+	{(char *)"columnar recordings", NULL, NULL, s_col_tests},
 	CU_SUITE_INFO_NULL,
 };
 
 int main(void)
 {
+	char registry[NAME_MAX];
+
+	/* Do not alter the section registry of the system */
+	snprintf(registry, sizeof(registry), "/shd-registry-test-%d",
+			getpid());
+	setenv("LIBSHDATA_CONFIG_INTERNAL_REGISTRY", registry, 1);
+
 	CU_initialize_registry();
 	CU_register_suites(s_suites);
 	if (getenv("CUNIT_OUT_NAME") != NULL)
@@ -89,5 +121,6 @@ int main(void)
 		CU_basic_run_tests();
 	}
 	CU_cleanup_registry();
+	shm_unlink(registry);
 	return 0;
 }
@@ -0,0 +1,266 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_test_aggregate.c
+ *
+ * @brief Windowed aggregation unit tests.
+ *
+ */
+
+#include <math.h>
+#define SHD_ADVANCED_READ_API
+#include "shd_test.h"
+#include "shd_test_helper.h"
+
+#define NB_AGG_SLOTS 16
+#define NB_AGG_SAMPLES 40
+/* Odd, and more than the elements reduced at once */
+#define NB_AGG_ELEMS 19
+
+struct agg_blob {
+	float f;
+	int16_t s;
+	uint16_t u[NB_AGG_ELEMS];
+	double d[2];
+};
+
+static const struct shd_quantity_info s_agg_f = {
+	{ offsetof(struct agg_blob, f), sizeof(float) }, SHD_FIELD_FLOAT, 1
+};
+static const struct shd_quantity_info s_agg_s = {
+	{ offsetof(struct agg_blob, s), sizeof(int16_t) }, SHD_FIELD_INT16, 1
+};
+static const struct shd_quantity_info s_agg_d = {
+	{ offsetof(struct agg_blob, d), 2 * sizeof(double) }, SHD_FIELD_DOUBLE,
+	2
+};
+static const struct shd_quantity_info s_agg_u = {
+	{ offsetof(struct agg_blob, u), NB_AGG_ELEMS * sizeof(uint16_t) },
+	SHD_FIELD_UINT16, NB_AGG_ELEMS
+};
+
+static void fill_agg_blob(void *p, int k)
+{
+	struct agg_blob *blob = p;
+	int e;
+
+	blob->f = k * 0.5f;
+	blob->s = k - 30;
+	blob->d[0] = k;
+	blob->d[1] = -k;
+	for (e = 0; e < NB_AGG_ELEMS; e++)
+		blob->u[e] = 2 * k + e;
+}
+
+static struct shd_ctx *create_agg_section(const char *blob_name)
+{
+	struct agg_blob blob;
+	struct shd_ctx *ctx;
+
+	ctx = create_test_section(blob_name, sizeof(blob), NB_AGG_SLOTS,
+			NULL, 0, NULL, 0);
+	write_test_samples(ctx, &blob, sizeof(blob), fill_agg_blob, 0,
+			NB_AGG_SAMPLES - 1);
+
+	return ctx;
+}
+
+/* Check the statistics of values a * k + b, for k from first to last */
+static void check_aggregate(const struct shd_aggregate *result, int first,
+				int last, double a, double b)
+{
+	double sum = 0, sum_sq = 0, v;
+	int n = last - first + 1;
+	int k;
+
+	for (k = first; k <= last; k++) {
+		v = a * k + b;
+		sum += v;
+		sum_sq += v * v;
+	}
+
+	CU_ASSERT_DOUBLE_EQUAL(result->min, fmin(a * first, a * last) + b,
+			DOUBLE_PRECISION);
+	CU_ASSERT_DOUBLE_EQUAL(result->max, fmax(a * first, a * last) + b,
+			DOUBLE_PRECISION);
+	CU_ASSERT_DOUBLE_EQUAL(result->mean, sum / n, DOUBLE_PRECISION);
+	CU_ASSERT_DOUBLE_EQUAL(result->rms, sqrt(sum_sq / n),
+			DOUBLE_PRECISION);
+}
+
+static void test_aggregate_count(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_sample_search search = {
+		.method = SHD_LATEST,
+		.nb_values_before_date = NB_AGG_SLOTS - 2,
+	};
+	struct shd_aggregate results[NB_AGG_ELEMS];
+	int ret, e;
+
+	ctx_prod = create_agg_section(BLOB_NAME("agg-count"));
+	ctx_cons = shd_open(BLOB_NAME("agg-count"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	/* The window wraps around the end of the section */
+	ret = shd_aggregate(ctx_cons, &search, NULL, &s_agg_f, results);
+	CU_ASSERT_EQUAL(ret, NB_AGG_SLOTS - 1);
+	check_aggregate(&results[0], 25, 39, 0.5, 0);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	ret = shd_aggregate(ctx_cons, &search, NULL, &s_agg_s, results);
+	CU_ASSERT_EQUAL(ret, NB_AGG_SLOTS - 1);
+	check_aggregate(&results[0], 25, 39, 1, -30);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* Each element of an array is aggregated on its own */
+	search.method = SHD_CLOSEST;
+	search.date.tv_sec = 30;
+	search.date.tv_nsec = 0;
+	search.nb_values_before_date = 2;
+	search.nb_values_after_date = 3;
+	ret = shd_aggregate(ctx_cons, &search, NULL, &s_agg_d, results);
+	CU_ASSERT_EQUAL(ret, 6);
+	check_aggregate(&results[0], 28, 33, 1, 0);
+	check_aggregate(&results[1], 28, 33, -1, 0);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* So is each element of a long array with an odd number of them */
+	ret = shd_aggregate(ctx_cons, &search, NULL, &s_agg_u, results);
+	CU_ASSERT_EQUAL(ret, 6);
+	for (e = 0; e < NB_AGG_ELEMS; e++)
+		check_aggregate(&results[e], 28, 33, 2, e);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+static void test_aggregate_duration(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_sample_search search = {
+		.method = SHD_LATEST,
+	};
+	struct timespec duration = { 3, 500000000 };
+	struct shd_aggregate result;
+	int ret;
+
+	ctx_prod = create_agg_section(BLOB_NAME("agg-duration"));
+	ctx_cons = shd_open(BLOB_NAME("agg-duration"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	ret = shd_aggregate(ctx_cons, &search, &duration, &s_agg_f, &result);
+	CU_ASSERT_EQUAL(ret, 4);
+	check_aggregate(&result, 36, 39, 0.5, 0);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* Bounds are included */
+	search.method = SHD_CLOSEST;
+	search.date.tv_sec = 30;
+	search.date.tv_nsec = 0;
+	duration.tv_sec = 5;
+	duration.tv_nsec = 0;
+	ret = shd_aggregate(ctx_cons, &search, &duration, &s_agg_s, &result);
+	CU_ASSERT_EQUAL(ret, 6);
+	check_aggregate(&result, 25, 30, 1, -30);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* The window is limited to the samples of the section */
+	duration.tv_sec = 1000;
+	ret = shd_aggregate(ctx_cons, &search, &duration, &s_agg_s, &result);
+	CU_ASSERT_EQUAL(ret, 30 - (NB_AGG_SAMPLES - NB_AGG_SLOTS) + 1);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+static void test_aggregate_invalid(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_sample_search search = {
+		.method = SHD_LATEST,
+	};
+	struct timespec duration = { 1, 0 };
+	struct shd_quantity_info info = s_agg_f;
+	struct shd_aggregate result;
+	int ret;
+
+	ctx_prod = create_agg_section(BLOB_NAME("agg-invalid"));
+	ctx_cons = shd_open(BLOB_NAME("agg-invalid"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	ret = shd_aggregate(NULL, &search, NULL, &s_agg_f, &result);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_aggregate(ctx_cons, NULL, NULL, &s_agg_f, &result);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_aggregate(ctx_cons, &search, NULL, NULL, &result);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_aggregate(ctx_cons, &search, NULL, &s_agg_f, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	/* Non-numeric quantity */
+	info.type = SHD_FIELD_BYTES;
+	info.count = sizeof(float);
+	ret = shd_aggregate(ctx_cons, &search, NULL, &info, &result);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	/* Size does not match the type */
+	info.type = SHD_FIELD_DOUBLE;
+	info.count = 1;
+	ret = shd_aggregate(ctx_cons, &search, NULL, &info, &result);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	/* Out of the blob */
+	info = s_agg_d;
+	info.quantity.quantity_offset += sizeof(double);
+	ret = shd_aggregate(ctx_cons, &search, NULL, &info, &result);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	/* A time window can not be combined with a count window */
+	search.nb_values_before_date = 1;
+	ret = shd_aggregate(ctx_cons, &search, &duration, &s_agg_f, &result);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+CU_TestInfo s_aggregate_tests[] = {
+	{(char *)"count window", &test_aggregate_count},
+	{(char *)"time window", &test_aggregate_duration},
+	{(char *)"invalid arguments", &test_aggregate_invalid},
+	CU_TEST_INFO_NULL,
+};
@@ -0,0 +1,278 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_test_col.c
+ *
+ * @brief Columnar recording unit tests.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "shd_test.h"
+#include "shd_test_helper.h"
+
+#define NB_COL_SLOTS 16
+#define NB_COL_CHUNK_ROWS 8
+#define NS_PER_SEC 1000000000ULL
+
+struct col_blob {
+	int32_t i;
+	float f;
+	double v[2];
+	/* not recorded */
+	uint8_t tag[4];
+};
+
+static const struct shd_field_desc s_col_fields[] = {
+	{ "i", SHD_FIELD_INT32, offsetof(struct col_blob, i), 1 },
+	{ "f", SHD_FIELD_FLOAT, offsetof(struct col_blob, f), 1 },
+	{ "v", SHD_FIELD_DOUBLE, offsetof(struct col_blob, v), 2 },
+	{ "tag", SHD_FIELD_BYTES, offsetof(struct col_blob, tag), 4 },
+};
+
+#define NB_COL_FIELDS (sizeof(s_col_fields) / sizeof(s_col_fields[0]))
+
+static void fill_col_blob(void *p, int k)
+{
+	struct col_blob *blob = p;
+
+	blob->i = k;
+	blob->f = k * 0.5f;
+	blob->v[0] = k;
+	blob->v[1] = -k;
+	memset(blob->tag, k, sizeof(blob->tag));
+}
+
+static struct shd_ctx *create_col_section(const char *blob_name)
+{
+	return create_test_section(blob_name, sizeof(struct col_blob),
+			NB_COL_SLOTS, s_col_fields, NB_COL_FIELDS, NULL, 0);
+}
+
+/* One sample per second, from first to last */
+static void write_col_samples(struct shd_ctx *ctx, int first, int last)
+{
+	struct col_blob blob;
+
+	write_test_samples(ctx, &blob, sizeof(blob), fill_col_blob, first,
+			last);
+}
+
+static void get_col_path(char *path, size_t size)
+{
+	int fd;
+
+	snprintf(path, size, "/tmp/shd-test-col-XXXXXX");
+	fd = mkstemp(path);
+	CU_ASSERT_TRUE_FATAL(fd >= 0);
+	close(fd);
+}
+
+/* Check the rows of a slice, whose first row was recorded at first */
+static void check_slice(const struct shd_col_file *file,
+			const struct shd_col_slice *slice, int first)
+{
+	enum shd_field_type type;
+	const int32_t *i;
+	const float *f;
+	const double *v0, *v1;
+	uint32_t r;
+
+	i = shd_col_get(file, slice, 0, &type);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(i);
+	CU_ASSERT_EQUAL(type, SHD_FIELD_INT32);
+	f = shd_col_get(file, slice, 1, &type);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(f);
+	CU_ASSERT_EQUAL(type, SHD_FIELD_FLOAT);
+	v0 = shd_col_get(file, slice, 2, &type);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(v0);
+	CU_ASSERT_EQUAL(type, SHD_FIELD_DOUBLE);
+	v1 = shd_col_get(file, slice, 3, NULL);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(v1);
+
+	for (r = 0; r < slice->nb_rows; r++) {
+		CU_ASSERT_EQUAL(slice->ts_ns[r], (first + r) * NS_PER_SEC);
+		CU_ASSERT_EQUAL(i[r], (int32_t)(first + r));
+		CU_ASSERT_DOUBLE_EQUAL(f[r], (first + r) * 0.5,
+				DOUBLE_PRECISION);
+		CU_ASSERT_DOUBLE_EQUAL(v0[r], first + r, DOUBLE_PRECISION);
+		CU_ASSERT_DOUBLE_EQUAL(v1[r], -(double)(first + r),
+				DOUBLE_PRECISION);
+	}
+}
+
+static void test_col_record(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_col_writer *writer;
+	struct shd_col_file *file;
+	struct shd_col_slice slices[4];
+	struct shd_quantity_info info;
+	struct timespec start = { 5, 0 };
+	struct timespec end = { 12, 0 };
+	char path[64];
+	int ret;
+
+	get_col_path(path, sizeof(path));
+	ctx_prod = create_col_section(BLOB_NAME("col-record"));
+	ctx_cons = shd_open(BLOB_NAME("col-record"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	writer = shd_col_record_start(ctx_cons, path, NB_COL_CHUNK_ROWS, rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(writer);
+
+	/* The section has not wrapped yet */
+	write_col_samples(ctx_prod, 0, 9);
+	ret = shd_col_record(writer, rev);
+	CU_ASSERT_EQUAL(ret, 10);
+
+	/* Only new samples are recorded */
+	write_col_samples(ctx_prod, 10, 21);
+	ret = shd_col_record(writer, rev);
+	CU_ASSERT_EQUAL(ret, 12);
+	ret = shd_col_record(writer, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	ret = shd_col_record_stop(writer);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	file = shd_col_open(path);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(file);
+
+	/* Elements of arrays are recorded in consecutive columns */
+	ret = shd_col_find(file, "i", &info);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(info.type, SHD_FIELD_INT32);
+	ret = shd_col_find(file, "v", &info);
+	CU_ASSERT_EQUAL(ret, 2);
+	CU_ASSERT_EQUAL(info.count, 2);
+	/* Bytes are not recorded */
+	ret = shd_col_find(file, "tag", &info);
+	CU_ASSERT_EQUAL(ret, -ENOENT);
+	ret = shd_col_find(file, "unknown", &info);
+	CU_ASSERT_EQUAL(ret, -ENOENT);
+
+	/* One slice per chunk */
+	ret = shd_col_slice(file, NULL, NULL, slices, 4);
+	CU_ASSERT_EQUAL_FATAL(ret, 3);
+	CU_ASSERT_EQUAL(slices[0].nb_rows, NB_COL_CHUNK_ROWS);
+	CU_ASSERT_EQUAL(slices[1].nb_rows, NB_COL_CHUNK_ROWS);
+	CU_ASSERT_EQUAL(slices[2].nb_rows, 22 - 2 * NB_COL_CHUNK_ROWS);
+	check_slice(file, &slices[0], 0);
+	check_slice(file, &slices[1], NB_COL_CHUNK_ROWS);
+	check_slice(file, &slices[2], 2 * NB_COL_CHUNK_ROWS);
+
+	/* Bounds of time ranges are included */
+	ret = shd_col_slice(file, &start, &end, slices, 4);
+	CU_ASSERT_EQUAL_FATAL(ret, 2);
+	CU_ASSERT_EQUAL(slices[0].nb_rows, NB_COL_CHUNK_ROWS - 5);
+	CU_ASSERT_EQUAL(slices[1].nb_rows, 12 - NB_COL_CHUNK_ROWS + 1);
+	check_slice(file, &slices[0], 5);
+	check_slice(file, &slices[1], NB_COL_CHUNK_ROWS);
+
+	/* Only the first slices are output */
+	ret = shd_col_slice(file, &start, &end, slices, 1);
+	CU_ASSERT_EQUAL(ret, 2);
+
+	/* Out of the recording */
+	start.tv_sec = 100;
+	ret = shd_col_slice(file, &start, NULL, slices, 4);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	CU_ASSERT_PTR_NULL(shd_col_get(file, &slices[0], 4, NULL));
+
+	ret = shd_col_close(file);
+	CU_ASSERT_EQUAL(ret, 0);
+	unlink(path);
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+static void test_col_invalid(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_col_writer *writer;
+	struct shd_col_file *file;
+	static const char garbage[64] = "not a recording";
+	char path[64];
+	FILE *f;
+	int ret;
+
+	get_col_path(path, sizeof(path));
+	ctx_prod = create_col_section(BLOB_NAME("col-invalid"));
+	ctx_cons = shd_open(BLOB_NAME("col-invalid"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	writer = shd_col_record_start(NULL, path, NB_COL_CHUNK_ROWS, rev);
+	CU_ASSERT_PTR_NULL(writer);
+	writer = shd_col_record_start(ctx_cons, NULL, NB_COL_CHUNK_ROWS, rev);
+	CU_ASSERT_PTR_NULL(writer);
+	writer = shd_col_record_start(ctx_cons, path, 0, rev);
+	CU_ASSERT_PTR_NULL(writer);
+	ret = shd_col_record(NULL, rev);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_col_record_stop(NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	/* Nothing was written yet */
+	writer = shd_col_record_start(ctx_cons, path, NB_COL_CHUNK_ROWS, rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(writer);
+	ret = shd_col_record(writer, rev);
+	CU_ASSERT_EQUAL(ret, -EAGAIN);
+	ret = shd_col_record_stop(writer);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* An empty recording is valid */
+	file = shd_col_open(path);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(file);
+	ret = shd_col_slice(file, NULL, NULL, NULL, 0);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_col_close(file);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	f = fopen(path, "w");
+	CU_ASSERT_PTR_NOT_NULL_FATAL(f);
+	fwrite(garbage, 1, sizeof(garbage), f);
+	fclose(f);
+	CU_ASSERT_PTR_NULL(shd_col_open(path));
+	CU_ASSERT_PTR_NULL(shd_col_open(NULL));
+	ret = shd_col_close(NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	unlink(path);
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+CU_TestInfo s_col_tests[] = {
+	{(char *)"record and read back", &test_col_record},
+	{(char *)"invalid arguments", &test_col_invalid},
+	CU_TEST_INFO_NULL,
+};
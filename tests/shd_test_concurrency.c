@@ -30,6 +30,7 @@
  */
 
 #define _GNU_SOURCE
+#define SHD_ADVANCED_READ_API
 #include <stddef.h>
 #include <pthread.h>
 #include "shd_test.h"
@@ -482,6 +483,8 @@ static void *overwrite_producer_thread(void *args)
 	struct shd_ctx *ctx;
 	int ret;
 	struct shd_sample_metadata sample_meta = METADATA_INIT;
+	struct shd_sample_metadata metas[2];
+	struct prod_blob blobs[2];
 	int index;
 
 	/* The producer starts by writing the whole section once */
@@ -512,13 +515,17 @@ static void *overwrite_producer_thread(void *args)
 	/* ... and let the consumer advance */
 	*(myArgs->prod_has_written_whole_section) = 1;
 
-	/* We make the final write while the consumer is stuck just after the
-	 * completion of its search : this overwrites the first produced
-	 * sample */
-	if (time_step(&sample_meta.ts) < 0)
-		CU_FAIL_FATAL("Could not get time");
+	/* We make the final writes while the consumer is stuck just after the
+	 * completion of its search : they overwrite the two first produced
+	 * samples, the second one being the oldest sample searches return */
+	for (index = 0; index < 2; index++) {
+		blobs[index] = s_blob;
+		metas[index] = index > 0 ? metas[index - 1] : sample_meta;
+		if (time_step(&metas[index].ts) < 0)
+			CU_FAIL_FATAL("Could not get time");
+	}
 
-	ret = shd_write_new_blob(ctx, &s_blob, sizeof(s_blob), &sample_meta);
+	ret = shd_write_new_blobs(ctx, blobs, sizeof(blobs[0]), metas, 2);
 
 	return (void*) ret;
 }
@@ -604,6 +611,128 @@ static void test_concurrency_overwrite_sample_just_after_search(void)
 	shd_concurrency_clean_hooks();
 }
 
+/*
+ * Test window reads during a burst of writes : the reading of a window which
+ * starts on one of the slots being overwritten should fail until the burst is
+ * committed
+ */
+
+#define BURST_NB_SAMPLES 10
+#define BURST_SIZE 5
+
+struct thread_burst_args {
+	struct shd_ctx *ctx;
+	/* metadata of the latest sample before the burst */
+	struct shd_sample_metadata meta;
+};
+
+static void *burst_producer_thread(void *args)
+{
+	struct thread_burst_args *myArgs = args;
+	struct shd_sample_metadata meta[BURST_SIZE];
+	struct prod_blob blobs[BURST_SIZE];
+	int i;
+
+	for (i = 0; i < BURST_SIZE; i++) {
+		blobs[i] = s_blob;
+		blobs[i].i1 = BURST_NB_SAMPLES + i;
+		meta[i] = i > 0 ? meta[i - 1] : myArgs->meta;
+		time_step(&meta[i].ts);
+	}
+
+	return (void *) shd_write_new_blobs(myArgs->ctx, blobs,
+					sizeof(blobs[0]), meta, BURST_SIZE);
+}
+
+static void test_concurrency_read_during_burst(void)
+{
+	struct shd_hdr_user_info hdr_info = s_hdr_info;
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_sample_metadata meta = METADATA_INIT;
+	struct shd_sample_metadata *metadata;
+	struct shd_search_result result;
+	struct shd_sample_search search = {
+		.method = SHD_LATEST,
+		.nb_values_before_date = BURST_NB_SAMPLES - 2,
+	};
+	struct prod_blob blob = s_blob;
+	struct thread_burst_args thread_args;
+	int i1[BURST_NB_SAMPLES - 1];
+	pthread_t prod_thread;
+	void *prod_ret;
+	int i;
+	int ret;
+
+	hdr_info.max_nb_samples = BURST_NB_SAMPLES;
+	ctx_prod = shd_create(BLOB_NAME("concurrency-read-during-burst"),
+				NULL, &hdr_info, &s_metadata_hdr);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+	ctx_cons = shd_open(BLOB_NAME("concurrency-read-during-burst"), NULL,
+				&rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	for (i = 0; i < BURST_NB_SAMPLES; i++) {
+		time_step(&meta.ts);
+		blob.i1 = i;
+		ret = shd_write_new_blob(ctx_prod, &blob, sizeof(blob), &meta);
+		CU_ASSERT_EQUAL_FATAL(ret, 0);
+	}
+
+	/* The consumer searches while the producer is about to commit its
+	 * burst, all of whose blobs have been copied */
+	shd_concurrency_clean_hooks();
+	shd_concurrency_set_hook_strategy(HOOK_SAMPLE_WRITE_BEFORE_COMMIT,
+			FIRST_THREAD_SIGNALS_FIRST_ACTION_WAITS_SECOND_ACTION);
+
+	thread_args.ctx = ctx_prod;
+	thread_args.meta = meta;
+	pthread_create(&prod_thread, NULL, &burst_producer_thread,
+			&thread_args);
+	while (!shd_concurrency_has_first_action_completed(0))
+		usleep(1000);
+
+	/* The window starts on a slot of the burst : its reading fails */
+	ret = shd_select_samples(ctx_cons, &search, &metadata, &result);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(result.nb_matches, BURST_NB_SAMPLES - 1);
+	ret = shd_read_quantity(ctx_cons, &q_s_blob_i1, i1, sizeof(i1));
+	CU_ASSERT_EQUAL(ret, BURST_NB_SAMPLES - 1);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, -EFAULT);
+
+	/* The samples which are not overwritten by the burst are still read */
+	search.nb_values_before_date = BURST_NB_SAMPLES - BURST_SIZE - 2;
+	ret = shd_select_samples(ctx_cons, &search, &metadata, &result);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(result.nb_matches, BURST_NB_SAMPLES - BURST_SIZE - 1);
+	ret = shd_read_quantity(ctx_cons, &q_s_blob_i1, i1, sizeof(i1));
+	CU_ASSERT_EQUAL(ret, BURST_NB_SAMPLES - BURST_SIZE - 1);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(i1[0], BURST_SIZE + 1);
+
+	shd_concurrency_emulate_thread_completion(1);
+	pthread_join(prod_thread, &prod_ret);
+	CU_ASSERT_EQUAL((intptr_t) prod_ret, 0);
+	shd_concurrency_clean_hooks();
+
+	/* Once committed, the whole burst is seen at once */
+	search.nb_values_before_date = BURST_NB_SAMPLES - 2;
+	ret = shd_select_samples(ctx_cons, &search, &metadata, &result);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(result.nb_matches, BURST_NB_SAMPLES - 1);
+	ret = shd_read_quantity(ctx_cons, &q_s_blob_i1, i1, sizeof(i1));
+	CU_ASSERT_EQUAL(ret, BURST_NB_SAMPLES - 1);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+	for (i = 0; i < BURST_NB_SAMPLES - 1; i++)
+		CU_ASSERT_EQUAL(i1[i], BURST_SIZE + 1 + i);
+
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
 CU_TestInfo s_concurrency_tests[] = {
 	{(char *)"create the same section simultaneously in 2 threads",
 			&test_concurrency_simultaneous_creation},
@@ -617,5 +746,7 @@ CU_TestInfo s_concurrency_tests[] = {
 			&test_concurrency_write_in_same_section},
 	{(char *)"overwrite a sample right after the consumer has finished its sample search",
 			&test_concurrency_overwrite_sample_just_after_search},
+	{(char *)"read a window during a burst of writes",
+			&test_concurrency_read_during_burst},
 	CU_TEST_INFO_NULL,
 };
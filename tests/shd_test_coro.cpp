@@ -0,0 +1,199 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_test_coro.cpp
+ *
+ * @brief Coroutine integration unit tests.
+ *
+ */
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <atomic>
+#include <optional>
+#include <thread>
+#include "libshdata-coro.hpp"
+#include <CUnit/CUnit.h>
+
+#define BLOB_NAME(a) "myBlob_coro_" a
+#define CORO_NB_SAMPLES 100
+#define CORO_NB_COROUTINES 1000
+#define CORO_NB_SECTION_SAMPLES 16
+/* Time given to the notifier to resume coroutines, in ms */
+#define CORO_TIMEOUT_MS 5000
+#define CORO_PENDING 1
+
+struct coro_blob {
+	int32_t id;
+};
+
+struct coro_metadata_hdr {
+	uint32_t version;
+};
+
+static const struct coro_metadata_hdr s_metadata_hdr = { 1 };
+
+/* Wait until value differs from pending, or give up after a while */
+static int wait_change(const std::atomic<int> &value, int pending)
+{
+	int i;
+
+	for (i = 0; i < CORO_TIMEOUT_MS && value.load() == pending; i++)
+		usleep(1000);
+
+	return value.load();
+}
+
+static shd::Task follow(shd::Notifier &notifier,
+			shd::Consumer<coro_blob> &cons,
+			std::atomic<int> &nb_done,
+			std::atomic<int> &nb_errors)
+{
+	const shd_sample_search latest = { {}, SHD_LATEST, 0, 0 };
+	shd::Subscription<coro_blob> sub(notifier, cons);
+	coro_blob blob = { -1 };
+	int last = -1;
+	int ret;
+
+	while (last != CORO_NB_SAMPLES - 1) {
+		ret = co_await sub.next_sample();
+		if (ret == 0)
+			ret = cons.read(latest, blob);
+		if (ret < 0 || blob.id < last) {
+			nb_errors++;
+			break;
+		}
+		last = blob.id;
+	}
+
+	nb_done++;
+}
+
+/* Await commits in a section, until one of them is not successful if
+ * until_error is set */
+static shd::Task await_commit(shd::Notifier &notifier, shd_ctx *ctx,
+			bool until_error, std::atomic<int> &result)
+{
+	uint32_t seq = 0;
+	int ret;
+
+	notifier.last_commit(ctx, seq);
+	do {
+		ret = co_await notifier.next_commit(ctx, seq);
+	} while (until_error && ret == 0);
+	result = ret;
+}
+
+static void test_coro_many_awaiting(void)
+{
+	shd::Producer<coro_blob> prod(BLOB_NAME("many"),
+			CORO_NB_SECTION_SAMPLES, 1000, s_metadata_hdr);
+	shd::Consumer<coro_blob> cons(BLOB_NAME("many"));
+	std::atomic<int> nb_done{0};
+	std::atomic<int> nb_errors{0};
+	int i;
+
+	prod.set_commit_notify(true);
+	{
+		shd::Notifier notifier;
+
+		for (i = 0; i < CORO_NB_COROUTINES; i++)
+			follow(notifier, cons, nb_done, nb_errors);
+		CU_ASSERT_EQUAL(nb_done.load(), 0);
+
+		std::thread producer([&prod] {
+			shd_sample_metadata metadata = {};
+
+			for (int j = 0; j < CORO_NB_SAMPLES; j++) {
+				usleep(500);
+				clock_gettime(CLOCK_MONOTONIC, &metadata.ts);
+				prod.write(coro_blob{ j }, metadata);
+			}
+		});
+		producer.join();
+
+		/* Every coroutine sees the last sample */
+		for (i = 0; i < CORO_TIMEOUT_MS
+				&& nb_done.load() < CORO_NB_COROUTINES; i++)
+			usleep(1000);
+		CU_ASSERT_EQUAL(nb_done.load(), CORO_NB_COROUTINES);
+		CU_ASSERT_EQUAL(nb_errors.load(), 0);
+	}
+}
+
+static void test_coro_section_error(void)
+{
+	std::optional<shd::Producer<coro_blob>> prod_failing;
+	shd::Producer<coro_blob> prod(BLOB_NAME("error-ok"),
+			CORO_NB_SECTION_SAMPLES, 1000, s_metadata_hdr);
+	shd_sample_metadata metadata = {};
+	std::atomic<int> result_failing{CORO_PENDING};
+	std::atomic<int> result{CORO_PENDING};
+	int ret;
+
+	prod_failing.emplace(BLOB_NAME("error-failing"),
+			CORO_NB_SECTION_SAMPLES, 1000, s_metadata_hdr);
+	shd::Consumer<coro_blob> cons_failing(BLOB_NAME("error-failing"));
+	shd::Consumer<coro_blob> cons(BLOB_NAME("error-ok"));
+	shd_set_auto_reconnect(cons_failing.get(), true);
+
+	shd::Notifier notifier;
+
+	await_commit(notifier, cons_failing.get(), true, result_failing);
+	await_commit(notifier, cons.get(), false, result);
+	CU_ASSERT_EQUAL(result_failing.load(), CORO_PENDING);
+	CU_ASSERT_EQUAL(result.load(), CORO_PENDING);
+
+	/* The failing section is re-created, then removed before its
+	 * consumer gets to reconnect : the re-creation itself may be seen as
+	 * a commit, the next wait fails */
+	prod_failing.reset();
+	prod_failing.emplace(BLOB_NAME("error-failing"),
+			CORO_NB_SECTION_SAMPLES, 1000, s_metadata_hdr);
+	shm_unlink("/shd_" BLOB_NAME("error-failing"));
+
+	/* Only the coroutine awaiting it gets the error */
+	ret = wait_change(result_failing, CORO_PENDING);
+	CU_ASSERT_EQUAL(ret, -EAGAIN);
+	usleep(50000);
+	CU_ASSERT_EQUAL(result.load(), CORO_PENDING);
+
+	/* The other section is still watched */
+	clock_gettime(CLOCK_MONOTONIC, &metadata.ts);
+	ret = prod.write(coro_blob{ 0 }, metadata);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = wait_change(result, CORO_PENDING);
+	CU_ASSERT_EQUAL(ret, 0);
+}
+
+CU_TestInfo s_coro_tests[] = {
+	{(char *)"many coroutines awaiting a section",
+			&test_coro_many_awaiting},
+	{(char *)"error of a watched section",
+			&test_coro_section_error},
+	CU_TEST_INFO_NULL,
+};
@@ -0,0 +1,214 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_test_cpp.cpp
+ *
+ * @brief C++ typed layer unit tests.
+ *
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <array>
+#include <system_error>
+#include "libshdata.hpp"
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <CUnit/Automated.h>
+
+#define BLOB_NAME(a) "myBlob_cpp_" a
+
+extern CU_TestInfo s_coro_tests[];
+#define CPP_NB_SAMPLES 10
+
+struct cpp_blob {
+	int32_t id;
+	float f;
+	double d;
+};
+
+struct cpp_metadata_hdr {
+	uint32_t version;
+};
+
+static const struct cpp_metadata_hdr s_metadata_hdr = { 1 };
+
+static shd_sample_metadata sample_metadata(int i)
+{
+	shd_sample_metadata metadata = {};
+
+	metadata.ts.tv_sec = 1;
+	metadata.ts.tv_nsec = i * 1000;
+	metadata.exp = metadata.ts;
+
+	return metadata;
+}
+
+static cpp_blob sample_blob(int i)
+{
+	return cpp_blob{ i, 0.5f * i, 0.25 * i };
+}
+
+static void test_cpp_quantity(void)
+{
+	shd_quantity q = shd::quantity<&cpp_blob::d>();
+
+	CU_ASSERT_EQUAL(q.quantity_offset, offsetof(cpp_blob, d));
+	CU_ASSERT_EQUAL(q.quantity_size, sizeof(double));
+
+	q = shd::quantity<&cpp_blob::f>();
+	CU_ASSERT_EQUAL(q.quantity_offset, offsetof(cpp_blob, f));
+	CU_ASSERT_EQUAL(q.quantity_size, sizeof(float));
+}
+
+static void test_cpp_read_write(void)
+{
+	shd::Producer<cpp_blob> prod(BLOB_NAME("read-write"),
+			CPP_NB_SAMPLES, 1000, s_metadata_hdr);
+	shd::Consumer<cpp_blob> cons(BLOB_NAME("read-write"));
+	const shd_sample_search latest = { {}, SHD_LATEST, 0, 0 };
+	const shd_sample_search window = { {}, SHD_LATEST, 3, 0 };
+	shd_sample_metadata metadata;
+	std::array<double, 4> d;
+	std::array<cpp_blob, 4> blobs;
+	cpp_blob blob;
+	float f;
+	int ret;
+	int i;
+
+	for (i = 0; i < 2 * CPP_NB_SAMPLES; i++) {
+		ret = prod.write(sample_blob(i), sample_metadata(i));
+		CU_ASSERT_EQUAL_FATAL(ret, 0);
+	}
+
+	/* Single sample reads */
+	ret = cons.read<&cpp_blob::f>(latest, f, &metadata);
+	CU_ASSERT_EQUAL(ret, 1);
+	CU_ASSERT_EQUAL(f, sample_blob(2 * CPP_NB_SAMPLES - 1).f);
+	CU_ASSERT_EQUAL(metadata.ts.tv_nsec,
+			sample_metadata(2 * CPP_NB_SAMPLES - 1).ts.tv_nsec);
+	ret = cons.read(latest, blob);
+	CU_ASSERT_EQUAL(ret, 1);
+	CU_ASSERT_EQUAL(blob.id, 2 * CPP_NB_SAMPLES - 1);
+
+	/* Window reads, ended explicitly or when the session goes out of
+	 * scope */
+	for (i = 0; i < 3; i++) {
+		auto session = cons.select(window);
+
+		CU_ASSERT_TRUE_FATAL(session);
+		CU_ASSERT_EQUAL(session.size(), 4);
+		CU_ASSERT_EQUAL(session.reference_index(), 3);
+		CU_ASSERT_EQUAL(session.metadata()[3].ts.tv_nsec,
+			sample_metadata(2 * CPP_NB_SAMPLES - 1).ts.tv_nsec);
+		ret = session.read<&cpp_blob::d>(d);
+		CU_ASSERT_EQUAL(ret, 4);
+		ret = session.read(blobs);
+		CU_ASSERT_EQUAL(ret, 4);
+		CU_ASSERT_EQUAL(d[0], sample_blob(2 * CPP_NB_SAMPLES - 4).d);
+		CU_ASSERT_EQUAL(blobs[3].id, 2 * CPP_NB_SAMPLES - 1);
+		if (i == 0)
+			CU_ASSERT_EQUAL(session.end(), 0);
+	}
+
+	/* Destination buffers too small for the window */
+	{
+		auto session = cons.select(window);
+		std::array<double, 2> small;
+
+		CU_ASSERT_TRUE(session.read<&cpp_blob::d>(small) < 0);
+	}
+}
+
+static void test_cpp_consumer_errors(void)
+{
+	struct other_blob {
+		int32_t id;
+	};
+	bool thrown = false;
+
+	try {
+		shd::Consumer<cpp_blob> cons(BLOB_NAME("missing"));
+	} catch (const std::system_error &e) {
+		thrown = true;
+		CU_ASSERT_EQUAL(e.code().value(), ENOENT);
+	}
+	CU_ASSERT_TRUE(thrown);
+
+	/* The blobs of the section are not of the size of the blob type */
+	shd::Producer<cpp_blob> prod(BLOB_NAME("blob-size"),
+			CPP_NB_SAMPLES, 1000, s_metadata_hdr);
+	thrown = false;
+	try {
+		shd::Consumer<other_blob> cons(BLOB_NAME("blob-size"));
+	} catch (const std::system_error &e) {
+		thrown = true;
+		CU_ASSERT_EQUAL(e.code().value(), EPROTO);
+	}
+	CU_ASSERT_TRUE(thrown);
+}
+
+static CU_TestInfo s_cpp_tests[] = {
+	{(char *)"quantities of blob members", &test_cpp_quantity},
+	{(char *)"write and read typed blobs", &test_cpp_read_write},
+	{(char *)"consumer errors", &test_cpp_consumer_errors},
+	CU_TEST_INFO_NULL,
+};
+
+static CU_SuiteInfo s_suites[] = {
+	{(char *)"C++ typed layer", NULL, NULL, s_cpp_tests},
+	{(char *)"C++ coroutines", NULL, NULL, s_coro_tests},
+	CU_SUITE_INFO_NULL,
+};
+
+int main(void)
+{
+	char registry[NAME_MAX];
+
+	/* Do not alter the section registry of the system */
+	snprintf(registry, sizeof(registry), "/shd-registry-test-%d",
+			getpid());
+	setenv("LIBSHDATA_CONFIG_INTERNAL_REGISTRY", registry, 1);
+
+	CU_initialize_registry();
+	CU_register_suites(s_suites);
+	if (getenv("CUNIT_OUT_NAME") != NULL)
+		CU_set_output_filename(getenv("CUNIT_OUT_NAME"));
+	if (getenv("CUNIT_AUTOMATED") != NULL) {
+		CU_automated_run_tests();
+		CU_list_tests_to_file();
+	} else {
+		CU_basic_set_mode(CU_BRM_VERBOSE);
+		CU_basic_run_tests();
+	}
+	CU_cleanup_registry();
+	shm_unlink(registry);
+	return 0;
+}
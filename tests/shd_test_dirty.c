@@ -0,0 +1,285 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_test_dirty.c
+ *
+ * @brief Tracked quantities unit tests.
+ *
+ */
+
+#define SHD_ADVANCED_READ_API
+#define SHD_ADVANCED_WRITE_API
+#include "shd_test.h"
+#include "shd_test_helper.h"
+
+#define DIRTY_I1	(UINT64_C(1) << 0)
+#define DIRTY_F1	(UINT64_C(1) << 1)
+#define DIRTY_ACC	(UINT64_C(1) << 2)
+#define DIRTY_ANGLES	(UINT64_C(1) << 3)
+#define DIRTY_ALL	(DIRTY_I1 | DIRTY_F1 | DIRTY_ACC | DIRTY_ANGLES)
+
+static const struct shd_quantity s_tracked[] = {
+	{ offsetof(struct prod_blob, i1), sizeof(s_blob.i1) },
+	{ offsetof(struct prod_blob, f1), sizeof(s_blob.f1) },
+	{ offsetof(struct prod_blob, acc), sizeof(s_blob.acc) },
+	{ offsetof(struct prod_blob, angles), sizeof(s_blob.angles) },
+};
+
+#define NB_TRACKED (sizeof(s_tracked) / sizeof(s_tracked[0]))
+
+static void write_partial_sample(struct shd_ctx *ctx,
+				struct shd_sample_metadata *meta,
+				const struct shd_quantity quantities[],
+				size_t nb)
+{
+	size_t i;
+	int ret;
+
+	time_step(&meta->ts);
+	ret = shd_new_sample(ctx, meta);
+	CU_ASSERT_EQUAL(ret, 0);
+	for (i = 0; i < nb; i++) {
+		ret = shd_write_quantity(ctx, &quantities[i],
+				(const char *)&s_blob
+					+ quantities[i].quantity_offset);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+	ret = shd_commit_sample(ctx);
+	CU_ASSERT_EQUAL(ret, 0);
+}
+
+static void test_dirty_partial_writes(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_sample_metadata meta = METADATA_INIT;
+	struct shd_sample_metadata *metadata;
+	struct shd_search_result result;
+	struct shd_sample_search search = {
+		.method = SHD_LATEST,
+		.nb_values_before_date = 3,
+	};
+	/* Only part of "angles" is written */
+	struct shd_quantity q_rho = {
+		offsetof(struct prod_blob, angles.rho),
+		sizeof(s_blob.angles.rho)
+	};
+	struct shd_quantity q_acc_rho[] = { q_s_blob_acc, q_rho };
+	struct shd_quantity tracked[SHD_DIRTY_MAX_QUANTITIES];
+	uint64_t dirty[4];
+	int i1;
+	struct shd_quantity_sample qty_sample = { .ptr = &i1,
+						.size = sizeof(i1) };
+	size_t i;
+	int ret;
+
+	ctx_prod = shd_create_tracked(BLOB_NAME("dirty-partial"), NULL,
+				&s_hdr_info, &s_metadata_hdr,
+				s_tracked, NB_TRACKED);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+	ctx_cons = shd_open(BLOB_NAME("dirty-partial"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	/* Consumers get the list of tracked quantities */
+	ret = shd_get_tracked_quantities(ctx_cons, tracked,
+			SHD_DIRTY_MAX_QUANTITIES, rev);
+	CU_ASSERT_EQUAL(ret, NB_TRACKED);
+	for (i = 0; i < NB_TRACKED; i++) {
+		CU_ASSERT_EQUAL(tracked[i].quantity_offset,
+				s_tracked[i].quantity_offset);
+		CU_ASSERT_EQUAL(tracked[i].quantity_size,
+				s_tracked[i].quantity_size);
+	}
+	ret = shd_get_tracked_quantities(ctx_cons, tracked, 1, rev);
+	CU_ASSERT_EQUAL(ret, NB_TRACKED);
+
+	/* Whole blob, then partial samples */
+	time_step(&meta.ts);
+	ret = shd_write_new_blob(ctx_prod, &s_blob, sizeof(s_blob), &meta);
+	CU_ASSERT_EQUAL(ret, 0);
+	write_partial_sample(ctx_prod, &meta, &q_s_blob_i1, 1);
+	write_partial_sample(ctx_prod, &meta, q_acc_rho, 2);
+	/* A quantity which is not tracked */
+	write_partial_sample(ctx_prod, &meta, &q_s_blob_c1, 1);
+
+	ret = shd_select_samples(ctx_cons, &search, &metadata, &result);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(result.nb_matches, 4);
+	ret = shd_read_dirty(ctx_cons, dirty, 4);
+	CU_ASSERT_EQUAL(ret, 4);
+	CU_ASSERT_EQUAL(dirty[0], DIRTY_ALL);
+	CU_ASSERT_EQUAL(dirty[1], DIRTY_I1);
+	CU_ASSERT_EQUAL(dirty[2], DIRTY_ACC | DIRTY_ANGLES);
+	CU_ASSERT_EQUAL(dirty[3], 0);
+	/* The destination array must hold all the selected samples */
+	ret = shd_read_dirty(ctx_cons, dirty, 3);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* Bitmaps also come along single sample reads */
+	write_partial_sample(ctx_prod, &meta, &q_s_blob_f1, 1);
+	search.nb_values_before_date = 0;
+	ret = shd_read_from_sample(ctx_cons, 1, &search, &q_s_blob_i1,
+			&qty_sample);
+	CU_ASSERT_EQUAL(ret, 1);
+	ret = shd_read_dirty(ctx_cons, dirty, 1);
+	CU_ASSERT_EQUAL(ret, 1);
+	CU_ASSERT_EQUAL(dirty[0], DIRTY_F1);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* Bitmaps are only read within a read sequence */
+	ret = shd_read_dirty(ctx_cons, dirty, 4);
+	CU_ASSERT_EQUAL(ret, -EPERM);
+
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+static void test_dirty_write_blobs(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_sample_metadata meta[3] = {
+		METADATA_INIT, METADATA_INIT, METADATA_INIT
+	};
+	struct shd_sample_metadata *metadata;
+	struct shd_search_result result;
+	struct shd_sample_search search = {
+		.method = SHD_LATEST,
+		.nb_values_before_date = 3,
+	};
+	struct prod_blob blobs[3] = { s_blob, s_blob, s_blob };
+	uint64_t dirty[4];
+	int i;
+	int ret;
+
+	ctx_prod = shd_create_tracked(BLOB_NAME("dirty-blobs"), NULL,
+				&s_hdr_info, &s_metadata_hdr,
+				s_tracked, NB_TRACKED);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+	ctx_cons = shd_open(BLOB_NAME("dirty-blobs"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	/* A partial sample, then a batch of blobs covering all quantities */
+	write_partial_sample(ctx_prod, &meta[0], &q_s_blob_i1, 1);
+	for (i = 0; i < 3; i++) {
+		meta[i] = meta[0];
+		time_step(&meta[i].ts);
+		meta[0] = meta[i];
+	}
+	ret = shd_write_new_blobs(ctx_prod, blobs, sizeof(blobs[0]), meta, 3);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	ret = shd_select_samples(ctx_cons, &search, &metadata, &result);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(result.nb_matches, 4);
+	ret = shd_read_dirty(ctx_cons, dirty, 4);
+	CU_ASSERT_EQUAL(ret, 4);
+	CU_ASSERT_EQUAL(dirty[0], DIRTY_I1);
+	CU_ASSERT_EQUAL(dirty[1], DIRTY_ALL);
+	CU_ASSERT_EQUAL(dirty[2], DIRTY_ALL);
+	CU_ASSERT_EQUAL(dirty[3], DIRTY_ALL);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+static void test_dirty_untracked(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_sample_metadata meta = METADATA_INIT;
+	struct shd_sample_metadata *metadata;
+	struct shd_search_result result;
+	struct shd_sample_search search = {
+		.method = SHD_LATEST,
+	};
+	struct shd_quantity tracked[SHD_DIRTY_MAX_QUANTITIES + 1];
+	struct shd_quantity out_of_blob = { sizeof(s_blob) - 1, 2 };
+	uint64_t dirty;
+	int i;
+	int ret;
+
+	/* Invalid lists of tracked quantities */
+	for (i = 0; i < SHD_DIRTY_MAX_QUANTITIES + 1; i++)
+		tracked[i] = q_s_blob_i1;
+	ctx_prod = shd_create_tracked(BLOB_NAME("dirty-untracked"), NULL,
+				&s_hdr_info, &s_metadata_hdr,
+				tracked, SHD_DIRTY_MAX_QUANTITIES + 1);
+	CU_ASSERT_PTR_NULL(ctx_prod);
+	ctx_prod = shd_create_tracked(BLOB_NAME("dirty-untracked"), NULL,
+				&s_hdr_info, &s_metadata_hdr,
+				&out_of_blob, 1);
+	CU_ASSERT_PTR_NULL(ctx_prod);
+	ctx_prod = shd_create_tracked(BLOB_NAME("dirty-untracked"), NULL,
+				&s_hdr_info, &s_metadata_hdr, NULL, 1);
+	CU_ASSERT_PTR_NULL(ctx_prod);
+
+	/* A tracked section re-created without tracking */
+	ctx_prod = shd_create_tracked(BLOB_NAME("dirty-untracked"), NULL,
+				&s_hdr_info, &s_metadata_hdr,
+				tracked, SHD_DIRTY_MAX_QUANTITIES);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+	shd_close(ctx_prod, NULL);
+	ctx_prod = shd_create(BLOB_NAME("dirty-untracked"), NULL,
+				&s_hdr_info, &s_metadata_hdr);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+	ctx_cons = shd_open(BLOB_NAME("dirty-untracked"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	ret = shd_get_tracked_quantities(ctx_cons, tracked, 1, rev);
+	CU_ASSERT_EQUAL(ret, -ENODATA);
+
+	time_step(&meta.ts);
+	ret = shd_write_new_blob(ctx_prod, &s_blob, sizeof(s_blob), &meta);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_select_samples(ctx_cons, &search, &metadata, &result);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_read_dirty(ctx_cons, &dirty, 1);
+	CU_ASSERT_EQUAL(ret, -ENODATA);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	ret = shd_read_dirty(NULL, &dirty, 1);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_get_tracked_quantities(ctx_cons, tracked, 1, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+CU_TestInfo s_dirty_tests[] = {
+	{(char *)"partial writes are tracked", &test_dirty_partial_writes},
+	{(char *)"blob writes mark all quantities", &test_dirty_write_blobs},
+	{(char *)"untracked sections and invalid lists",
+			&test_dirty_untracked},
+	CU_TEST_INFO_NULL,
+};
@@ -295,6 +295,106 @@ static void test_error_revision_nb(void)
 }
 
 
+static void test_error_revision_nb_auto_reconnect(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	int ret;
+	struct prod_blob read_blob;
+	struct shd_sample_metadata sample_meta = METADATA_INIT;
+	struct shd_sample_search search = {
+		.nb_values_after_date = 0,
+		.nb_values_before_date = 0,
+		.method = SHD_LATEST
+	};
+	struct shd_revision *rev;
+	struct shd_quantity_sample blob_samp[1] = {
+		{ .ptr = &read_blob, .size = sizeof(read_blob) }
+	};
+	struct shd_hdr_user_info hdr_info = s_hdr_info;
+	struct shd_hdr_user_info read_hdr_info;
+
+	ctx_prod = shd_create(BLOB_NAME("error-revision-nb-reconnect"), NULL,
+				&hdr_info,
+				&s_metadata_hdr);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+	ctx_cons = shd_open(BLOB_NAME("error-revision-nb-reconnect"), NULL,
+				&rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+	ret = shd_set_auto_reconnect(ctx_cons, true);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* The producer re-creates its section with a deeper history, between
+	 * two reads of the consumer */
+	ret = shd_close(ctx_prod, NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+	hdr_info.max_nb_samples *= 4;
+	ctx_prod = shd_create(BLOB_NAME("error-revision-nb-reconnect"), NULL,
+				&hdr_info,
+				&s_metadata_hdr);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+
+	if (time_step(&sample_meta.ts) < 0)
+		CU_FAIL_FATAL("Could not get time");
+	ret = shd_write_new_blob(ctx_prod,
+					&s_blob,
+					sizeof(s_blob),
+					&sample_meta);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+
+	/* The next read is done on the new section */
+	ret = shd_read_from_sample(ctx_cons, 0, &search, NULL,
+					blob_samp);
+	CU_ASSERT_TRUE(ret > 0);
+	CU_ASSERT_TRUE(time_is_equal(&blob_samp[0].meta.ts,
+					&sample_meta.ts));
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_read_section_hdr(ctx_cons, &read_hdr_info, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(read_hdr_info.max_nb_samples,
+			hdr_info.max_nb_samples);
+
+	/* The producer now re-creates its section during a read : the read
+	 * fails, but the next one is done on the new section */
+	ret = shd_read_from_sample(ctx_cons, 0, &search, NULL,
+					blob_samp);
+	CU_ASSERT_TRUE(ret > 0);
+	ret = shd_close(ctx_prod, NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+	ctx_prod = shd_create(BLOB_NAME("error-revision-nb-reconnect"), NULL,
+				&s_hdr_info,
+				&s_metadata_hdr);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, -EAGAIN);
+
+	if (time_step(&sample_meta.ts) < 0)
+		CU_FAIL_FATAL("Could not get time");
+	ret = shd_write_new_blob(ctx_prod,
+					&s_blob,
+					sizeof(s_blob),
+					&sample_meta);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+
+	ret = shd_read_from_sample(ctx_cons, 0, &search, NULL,
+					blob_samp);
+	CU_ASSERT_TRUE(ret > 0);
+	CU_ASSERT_TRUE(time_is_equal(&blob_samp[0].meta.ts,
+					&sample_meta.ts));
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_read_section_hdr(ctx_cons, &read_hdr_info, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(read_hdr_info.max_nb_samples,
+			s_hdr_info.max_nb_samples);
+
+	/* Close should unfold normally */
+	ret = shd_close(ctx_prod, NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_close(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+}
+
 CU_TestInfo s_error_tests[] = {
 	{(char *)"sample overwrite during read",
 			&test_error_overwrite_during_read},
@@ -304,5 +404,7 @@ CU_TestInfo s_error_tests[] = {
 			&test_error_read_data_undersized_buffer},
 	{(char *)"try to read without updating revision number",
 			&test_error_revision_nb},
+	{(char *)"read with automatic reconnection after revision change",
+			&test_error_revision_nb_auto_reconnect},
 	CU_TEST_INFO_NULL,
 };
@@ -0,0 +1,233 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_test_filter.c
+ *
+ * @brief Filtered read unit tests.
+ *
+ */
+
+#include "shd_test.h"
+#include "shd_test_helper.h"
+
+#define NB_FILTER_SLOTS 16
+#define NB_FILTER_SAMPLES 40
+#define FILTER_FLAG 0x8
+
+struct filter_blob {
+	uint16_t status;
+	int32_t level;
+	float temp;
+};
+
+static const struct shd_quantity_info s_filter_status = {
+	{ offsetof(struct filter_blob, status), sizeof(uint16_t) },
+	SHD_FIELD_UINT16, 1
+};
+static const struct shd_quantity_info s_filter_level = {
+	{ offsetof(struct filter_blob, level), sizeof(int32_t) },
+	SHD_FIELD_INT32, 1
+};
+static const struct shd_quantity_info s_filter_temp = {
+	{ offsetof(struct filter_blob, temp), sizeof(float) },
+	SHD_FIELD_FLOAT, 1
+};
+
+/* Flagged every 5 seconds */
+static void fill_filter_blob(void *p, int k)
+{
+	struct filter_blob *blob = p;
+
+	blob->status = k % 5 == 0 ? FILTER_FLAG | 0x1 : 0x1;
+	blob->level = 30 - k;
+	blob->temp = k * 0.5f;
+}
+
+static struct shd_ctx *create_filter_section(const char *blob_name)
+{
+	struct filter_blob blob;
+	struct shd_ctx *ctx;
+
+	ctx = create_test_section(blob_name, sizeof(blob), NB_FILTER_SLOTS,
+			NULL, 0, NULL, 0);
+	write_test_samples(ctx, &blob, sizeof(blob), fill_filter_blob, 0,
+			NB_FILTER_SAMPLES - 1);
+
+	return ctx;
+}
+
+static void test_filter_read(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_sample_search search = {
+		.method = SHD_LATEST,
+		.nb_values_before_date = NB_FILTER_SLOTS - 2,
+	};
+	struct shd_predicate pred = {
+		.quantity = s_filter_status,
+		.op = SHD_PRED_MASK,
+		.value = FILTER_FLAG,
+		.mask = FILTER_FLAG,
+	};
+	struct shd_quantity_sample samples[NB_FILTER_SLOTS];
+	float temp[NB_FILTER_SLOTS];
+	int i;
+	int ret;
+
+	ctx_prod = create_filter_section(BLOB_NAME("filter-read"));
+	ctx_cons = shd_open(BLOB_NAME("filter-read"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+	for (i = 0; i < NB_FILTER_SLOTS; i++) {
+		samples[i].ptr = &temp[i];
+		samples[i].size = sizeof(temp[i]);
+	}
+
+	/* The window wraps around the end of the section */
+	ret = shd_read_filtered(ctx_cons, &search, &pred,
+			&s_filter_temp.quantity, samples, NB_FILTER_SLOTS);
+	CU_ASSERT_EQUAL(ret, 3);
+	CU_ASSERT_EQUAL(samples[0].meta.ts.tv_sec, 25);
+	CU_ASSERT_EQUAL(samples[1].meta.ts.tv_sec, 30);
+	CU_ASSERT_EQUAL(samples[2].meta.ts.tv_sec, 35);
+	CU_ASSERT_DOUBLE_EQUAL(temp[0], 12.5, DOUBLE_PRECISION);
+	CU_ASSERT_DOUBLE_EQUAL(temp[2], 17.5, DOUBLE_PRECISION);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* Signed values are compared as two's complement */
+	pred.quantity = s_filter_level;
+	pred.op = SHD_PRED_EQUAL;
+	pred.value = (uint64_t)(int64_t)-3;
+	ret = shd_read_filtered(ctx_cons, &search, &pred,
+			&s_filter_temp.quantity, samples, NB_FILTER_SLOTS);
+	CU_ASSERT_EQUAL(ret, 1);
+	CU_ASSERT_EQUAL(samples[0].meta.ts.tv_sec, 33);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* Matching samples beyond max_samples are ignored */
+	pred.quantity = s_filter_temp;
+	pred.op = SHD_PRED_RANGE;
+	pred.min = 13;
+	pred.max = 14.5;
+	ret = shd_read_filtered(ctx_cons, &search, &pred,
+			&s_filter_temp.quantity, samples, NB_FILTER_SLOTS);
+	CU_ASSERT_EQUAL(ret, 4);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_read_filtered(ctx_cons, &search, &pred,
+			&s_filter_temp.quantity, samples, 2);
+	CU_ASSERT_EQUAL(ret, 2);
+	CU_ASSERT_EQUAL(samples[0].meta.ts.tv_sec, 26);
+	CU_ASSERT_EQUAL(samples[1].meta.ts.tv_sec, 27);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* No sample matches */
+	pred.min = 100;
+	pred.max = 200;
+	ret = shd_read_filtered(ctx_cons, &search, &pred,
+			&s_filter_temp.quantity, samples, NB_FILTER_SLOTS);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+static void test_filter_invalid(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_sample_search search = {
+		.method = SHD_LATEST,
+	};
+	struct shd_predicate pred = {
+		.quantity = s_filter_temp,
+		.op = SHD_PRED_MASK,
+		.mask = 1,
+	};
+	const struct shd_quantity *quantity = &s_filter_level.quantity;
+	struct shd_quantity_sample sample;
+	int32_t level;
+	int ret;
+
+	ctx_prod = create_filter_section(BLOB_NAME("filter-invalid"));
+	ctx_cons = shd_open(BLOB_NAME("filter-invalid"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+	sample.ptr = &level;
+	sample.size = sizeof(level);
+
+	/* Mask on a floating-point quantity */
+	ret = shd_read_filtered(ctx_cons, &search, &pred, quantity, &sample,
+			1);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	/* Unknown comparison */
+	pred.op = (enum shd_predicate_op)42;
+	ret = shd_read_filtered(ctx_cons, &search, &pred, quantity, &sample,
+			1);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	/* Size does not match the type */
+	pred.op = SHD_PRED_RANGE;
+	pred.quantity.type = SHD_FIELD_DOUBLE;
+	ret = shd_read_filtered(ctx_cons, &search, &pred, quantity, &sample,
+			1);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	/* Out of the blob */
+	pred.quantity = s_filter_temp;
+	pred.quantity.quantity.quantity_offset = sizeof(struct filter_blob);
+	ret = shd_read_filtered(ctx_cons, &search, &pred, quantity, &sample,
+			1);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	pred.quantity = s_filter_temp;
+	ret = shd_read_filtered(NULL, &search, &pred, quantity, &sample, 1);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_read_filtered(ctx_cons, NULL, &pred, quantity, &sample, 1);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_read_filtered(ctx_cons, &search, NULL, quantity, &sample, 1);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_read_filtered(ctx_cons, &search, &pred, NULL, &sample, 1);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_read_filtered(ctx_cons, &search, &pred, quantity, NULL, 1);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	/* Buffer too small for the quantity */
+	sample.size = sizeof(int16_t);
+	ret = shd_read_filtered(ctx_cons, &search, &pred, quantity, &sample,
+			1);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+CU_TestInfo s_filter_tests[] = {
+	{(char *)"read matching samples", &test_filter_read},
+	{(char *)"invalid arguments", &test_filter_invalid},
+	CU_TEST_INFO_NULL,
+};
@@ -886,6 +886,159 @@ static void test_func_adv_read_several_latest_by_quantity(void)
 	CU_ASSERT_EQUAL(ret, 0);
 }
 
+static void test_func_adv_read_power_of_two_section(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	int ret, index;
+	bool b_time;
+	struct shd_sample_metadata sample_meta = METADATA_INIT;
+	struct shd_hdr_user_info hdr_info = s_hdr_info;
+	struct shd_sample_search search = {
+		.nb_values_after_date = 2,
+		.nb_values_before_date = 3,
+		.method = SHD_FIRST_BEFORE
+	};
+	struct shd_sample_metadata *metadata = NULL;
+	struct shd_search_result result;
+	struct shd_revision *rev;
+	struct prod_blob blobs[6];
+
+	/* Sections whose number of samples is a power of two use a mask
+	 * instead of a modulo for ring index arithmetic : check that windows
+	 * wrapping around the end of the buffer are still correct */
+	hdr_info.max_nb_samples = 16;
+	ctx_prod = shd_create(BLOB_NAME("select-power-of-two"), NULL,
+				&hdr_info,
+				&s_metadata_hdr);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+	ctx_cons = shd_open(BLOB_NAME("select-power-of-two"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	/* Loop more than twice over the section, and stop right after the
+	 * end of the buffer */
+	ret = 0;
+	for (index = 0; index < 2 * 16 + 2; index++) {
+		if (time_step(&sample_meta.ts) < 0)
+			CU_FAIL_FATAL("Could not get time");
+		s_blob.i1 = index;
+		ret += shd_write_new_blob(ctx_prod,
+						&s_blob,
+						sizeof(s_blob),
+						&sample_meta);
+	}
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+
+	/* The reference sample is the 4th most recent one : the window spans
+	 * the slots 12 to 17 modulo 16 */
+	time_set(&search.date, time_in_past_after(sample_meta.ts, 3));
+	ret = shd_select_samples(ctx_cons, &search, &metadata, &result);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	CU_ASSERT_EQUAL(result.nb_matches, 6);
+	CU_ASSERT_EQUAL(result.r_sample_idx, 3);
+
+	b_time = true;
+	for (index = 0; index < result.nb_matches; index++) {
+		struct timespec expected = time_in_past(sample_meta.ts,
+						result.nb_matches - index);
+		b_time &= time_is_equal(&metadata[index].ts, &expected);
+	}
+	CU_ASSERT_TRUE(b_time);
+
+	ret = shd_read_quantity(ctx_cons, &q_s_blob_i1, blobs, sizeof(blobs));
+	CU_ASSERT_EQUAL(ret, 6);
+	for (index = 0; index < 6; index++)
+		CU_ASSERT_EQUAL(((int *)blobs)[index], 2 * 16 - 5 + index);
+
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* The oldest sample is the one right after the next slot to be
+	 * written */
+	search.method = SHD_OLDEST;
+	search.nb_values_before_date = 0;
+	search.nb_values_after_date = 0;
+	ret = shd_select_samples(ctx_cons, &search, &metadata, &result);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	CU_ASSERT_EQUAL(result.nb_matches, 1);
+	{
+		struct timespec expected = time_in_past(sample_meta.ts, 14);
+		CU_ASSERT_TRUE(time_is_equal(&metadata[0].ts, &expected));
+	}
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	s_blob.i1 = TEST_VAL_i1;
+
+	ret = shd_close(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_close(ctx_prod, NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+}
+
+static void test_func_adv_read_alternate_select_and_basic_read(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	int ret, index;
+	struct shd_sample_metadata sample_meta = METADATA_INIT;
+	struct shd_sample_search search = {
+		.nb_values_after_date = 0,
+		.nb_values_before_date = 2,
+		.method = SHD_LATEST
+	};
+	struct shd_sample_search search_one = {
+		.nb_values_after_date = 0,
+		.nb_values_before_date = 0,
+		.method = SHD_LATEST
+	};
+	struct shd_sample_metadata *metadata = NULL;
+	struct shd_search_result result;
+	struct shd_revision *rev;
+	struct prod_blob read_blob;
+	struct shd_quantity_sample blob_samp[1] = {
+		{ .ptr = &read_blob, .size = sizeof(read_blob) }
+	};
+
+	ctx_prod = shd_create(BLOB_NAME("select-alternate-basic-read"), NULL,
+				&s_hdr_info,
+				&s_metadata_hdr);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+	ctx_cons = shd_open(BLOB_NAME("select-alternate-basic-read"), NULL,
+				&rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	for (index = 0; index < 3; index++) {
+		if (time_step(&sample_meta.ts) < 0)
+			CU_FAIL_FATAL("Could not get time");
+		ret = shd_write_new_blob(ctx_prod, &s_blob, sizeof(s_blob),
+						&sample_meta);
+		CU_ASSERT_EQUAL_FATAL(ret, 0);
+	}
+
+	/* The metadata of a window is released by shd_end_read() : a read
+	 * that does not allocate any metadata must not release it again */
+	for (index = 0; index < 5; index++) {
+		ret = shd_select_samples(ctx_cons, &search, &metadata,
+						&result);
+		CU_ASSERT_EQUAL_FATAL(ret, 0);
+		CU_ASSERT_EQUAL(result.nb_matches, 3);
+		ret = shd_end_read(ctx_cons, rev);
+		CU_ASSERT_EQUAL(ret, 0);
+
+		ret = shd_read_from_sample(ctx_cons, 0, &search_one, NULL,
+						blob_samp);
+		CU_ASSERT_EQUAL(ret, 1);
+		CU_ASSERT_TRUE(time_is_equal(&blob_samp[0].meta.ts,
+						&sample_meta.ts));
+		ret = shd_end_read(ctx_cons, rev);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+
+	ret = shd_close(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_close(ctx_prod, NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+}
+
 
 CU_TestInfo s_func_adv_read_tests[] = {
 	{(char *)"select latest sample",
@@ -908,6 +1061,10 @@ CU_TestInfo s_func_adv_read_tests[] = {
 			&test_func_adv_read_latest_by_quantity},
 	{(char *)"read several latest by quantity",
 			&test_func_adv_read_several_latest_by_quantity},
+	{(char *)"select samples in a power-of-two sized section",
+			&test_func_adv_read_power_of_two_section},
+	{(char *)"alternate window and single sample reads",
+			&test_func_adv_read_alternate_select_and_basic_read},
 	CU_TEST_INFO_NULL,
 };
 
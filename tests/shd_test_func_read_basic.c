@@ -324,9 +324,10 @@ static void test_func_basic_read_from_sample_first_after(void)
 	CU_ASSERT_EQUAL(ret, 0);
 
 	/* Search for the first sample after TIME_INIT : we should find the
-	 * oldest sample */
+	 * second oldest sample, as SHD_OLDEST does, since the oldest one may be
+	 * being overwritten */
 	time_set(&search.date, TIME_INIT);
-	match_expected_ts = time_in_past(last_sample_ts, NUMBER_OF_SAMPLES - 1);
+	match_expected_ts = time_in_past(last_sample_ts, NUMBER_OF_SAMPLES - 2);
 
 	ret = shd_read_from_sample(ctx_cons, 0, &search, NULL,
 					blob_samp);
@@ -349,9 +350,9 @@ static void test_func_basic_read_from_sample_first_after(void)
 					sizeof(s_blob), &sample_meta), 0);
 	time_set(&last_sample_ts, sample_meta.ts);
 
-	/* We're still looking for the oldest sample in the section, which
-	 * is now 1 tick more recent than in the previous search */
-	match_expected_ts = time_in_past(last_sample_ts, NUMBER_OF_SAMPLES - 1);
+	/* We're still looking for the second oldest sample in the section,
+	 * which is now 1 tick more recent than in the previous search */
+	match_expected_ts = time_in_past(last_sample_ts, NUMBER_OF_SAMPLES - 2);
 
 	ret = shd_read_from_sample(ctx_cons, 0, &search, NULL, blob_samp);
 	CU_ASSERT_EQUAL_FATAL(ret, 1);
@@ -377,6 +378,63 @@ static void test_func_basic_read_from_sample_first_after(void)
 	CU_ASSERT_EQUAL(ret, 0);
 }
 
+static void test_func_basic_read_from_sample_first_after_partial(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	int ret, index;
+	struct shd_sample_metadata sample_meta = METADATA_INIT;
+	struct shd_sample_search search = {
+		.date = TIME_INIT,
+		.nb_values_after_date = 0,
+		.nb_values_before_date = 0,
+		.method = SHD_FIRST_AFTER
+	};
+	struct shd_revision *rev;
+	struct prod_blob read_blob;
+	struct shd_quantity_sample blob_samp[1] = {
+		{ .ptr = &read_blob, .size = sizeof(read_blob) }
+	};
+	struct timespec first_sample_ts;
+	char blob_name[NAME_MAX];
+
+	CU_ASSERT_TRUE_FATAL(
+		get_unique_blob_name(
+			BLOB_NAME("basic-select-sample-first-after-partial"),
+			blob_name) > 0);
+
+	ctx_prod = shd_create(blob_name, NULL, &s_hdr_info, &s_metadata_hdr);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+	ctx_cons = shd_open(blob_name, NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	/* While the section has not been written in full, searching for the
+	 * first sample after a date set before all the samples should return
+	 * the first sample ever produced, and not an unwritten one */
+	for (index = 0; index < NUMBER_OF_SAMPLES - 1; index++) {
+		if (time_step(&sample_meta.ts) < 0)
+			CU_FAIL_FATAL("Could not get time");
+		if (index == 0)
+			time_set(&first_sample_ts, sample_meta.ts);
+		ret = shd_write_new_blob(ctx_prod, &s_blob, sizeof(s_blob),
+						&sample_meta);
+		CU_ASSERT_EQUAL_FATAL(ret, 0);
+
+		ret = shd_read_from_sample(ctx_cons, 0, &search, NULL,
+						blob_samp);
+		CU_ASSERT_EQUAL(ret, 1);
+		CU_ASSERT_TRUE(time_is_equal(&blob_samp[0].meta.ts,
+						&first_sample_ts));
+		ret = shd_end_read(ctx_cons, rev);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+
+	/* Close should unfold normally */
+	ret = shd_close(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_close(ctx_prod, NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+}
+
 static void test_func_basic_read_from_sample_first_before(void)
 {
 	struct shd_ctx *ctx_prod, *ctx_cons;
@@ -655,8 +713,8 @@ static void test_func_basic_read_from_sample_closest(void)
 			time_in_past_before(last_sample_ts,
 						NUMBER_OF_SAMPLES - 1));
 	/* The returned sample timestamp should be equal to the date of the
-	 * oldest sample */
-	match_expected_ts = time_in_past(last_sample_ts, NUMBER_OF_SAMPLES - 1);
+	 * second oldest sample, as returned by SHD_OLDEST */
+	match_expected_ts = time_in_past(last_sample_ts, NUMBER_OF_SAMPLES - 2);
 
 	ret = shd_read_from_sample(ctx_cons, 0, &search, NULL, blob_samp);
 	CU_ASSERT_EQUAL_FATAL(ret, 1);
@@ -670,8 +728,8 @@ static void test_func_basic_read_from_sample_closest(void)
 	/* Set the search date to be the oldest possible */
 	time_set(&search.date, TIME_INIT);
 	/* The returned sample timestamp should be equal to the date of the
-	 * oldest sample */
-	match_expected_ts = time_in_past(last_sample_ts, NUMBER_OF_SAMPLES - 1);
+	 * second oldest sample, as returned by SHD_OLDEST */
+	match_expected_ts = time_in_past(last_sample_ts, NUMBER_OF_SAMPLES - 2);
 
 	ret = shd_read_from_sample(ctx_cons, 0, &search, NULL, blob_samp);
 	CU_ASSERT_EQUAL_FATAL(ret, 1);
@@ -692,9 +750,9 @@ static void test_func_basic_read_from_sample_closest(void)
 					sizeof(s_blob), &sample_meta), 0);
 	time_set(&last_sample_ts, sample_meta.ts);
 
-	/* We're still looking for the oldest sample in the section, which
-	 * is now 1 tick more recent than in the previous search */
-	match_expected_ts = time_in_past(last_sample_ts, NUMBER_OF_SAMPLES - 1);
+	/* We're still looking for the second oldest sample in the section,
+	 * which is now 1 tick more recent than in the previous search */
+	match_expected_ts = time_in_past(last_sample_ts, NUMBER_OF_SAMPLES - 2);
 
 	ret = shd_read_from_sample(ctx_cons, 0, &search, NULL, blob_samp);
 	CU_ASSERT_EQUAL_FATAL(ret, 1);
@@ -712,6 +770,63 @@ static void test_func_basic_read_from_sample_closest(void)
 	CU_ASSERT_EQUAL(ret, 0);
 }
 
+static void test_func_basic_read_from_sample_closest_partial(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	int ret, index;
+	struct shd_sample_metadata sample_meta = METADATA_INIT;
+	struct shd_sample_search search = {
+		.date = TIME_INIT,
+		.nb_values_after_date = 0,
+		.nb_values_before_date = 0,
+		.method = SHD_CLOSEST
+	};
+	struct shd_revision *rev;
+	struct prod_blob read_blob;
+	struct shd_quantity_sample blob_samp[1] = {
+		{ .ptr = &read_blob, .size = sizeof(read_blob) }
+	};
+	struct timespec first_sample_ts;
+	char blob_name[NAME_MAX];
+
+	CU_ASSERT_TRUE_FATAL(
+		get_unique_blob_name(
+			BLOB_NAME("basic-select-sample-closest-partial"),
+			blob_name) > 0);
+
+	ctx_prod = shd_create(blob_name, NULL, &s_hdr_info, &s_metadata_hdr);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+	ctx_cons = shd_open(blob_name, NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	/* While the section has not been written in full, searching for the
+	 * sample closest to a date set before all the samples should return
+	 * the first sample ever produced, and not an unwritten one */
+	for (index = 0; index < NUMBER_OF_SAMPLES - 1; index++) {
+		if (time_step(&sample_meta.ts) < 0)
+			CU_FAIL_FATAL("Could not get time");
+		if (index == 0)
+			time_set(&first_sample_ts, sample_meta.ts);
+		ret = shd_write_new_blob(ctx_prod, &s_blob, sizeof(s_blob),
+						&sample_meta);
+		CU_ASSERT_EQUAL_FATAL(ret, 0);
+
+		ret = shd_read_from_sample(ctx_cons, 0, &search, NULL,
+						blob_samp);
+		CU_ASSERT_EQUAL(ret, 1);
+		CU_ASSERT_TRUE(time_is_equal(&blob_samp[0].meta.ts,
+						&first_sample_ts));
+		ret = shd_end_read(ctx_cons, rev);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+
+	/* Close should unfold normally */
+	ret = shd_close(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_close(ctx_prod, NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+}
+
 static void test_func_basic_read_from_sample_blob_data(void)
 {
 	struct shd_ctx *ctx_prod, *ctx_cons;
@@ -1162,10 +1277,16 @@ CU_TestInfo s_func_basic_read_tests[] = {
 		&test_func_basic_read_from_sample_oldest},
 	{(char *)"read from sample by \"first after\" search",
 		&test_func_basic_read_from_sample_first_after},
+	{(char *)"read from sample by \"first after\" search in a partially "
+			"written section",
+		&test_func_basic_read_from_sample_first_after_partial},
 	{(char *)"read from sample by \"first before\" search",
 		&test_func_basic_read_from_sample_first_before},
 	{(char *)"read from sample by \"closest\" search",
 		&test_func_basic_read_from_sample_closest},
+	{(char *)"read from sample by \"closest\" search in a partially "
+			"written section",
+		&test_func_basic_read_from_sample_closest_partial},
 	{(char *)"read a blob using read from sample",
 		&test_func_basic_read_from_sample_blob_data},
 	{(char *)"read all quantities in order using read from sample",
@@ -118,7 +118,170 @@ static void test_func_adv_write_by_quantity(void)
 	CU_ASSERT_EQUAL(ret, 0);
 }
 
+#define STREAM_BLOB_SIZE 1000
+
+static void test_func_write_streaming(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_sample_metadata sample_meta = METADATA_INIT;
+	struct shd_hdr_user_info hdr_info = s_hdr_info;
+	struct shd_sample_search search = {
+		.method = SHD_LATEST,
+	};
+	/* Neither the size nor the offset are multiples of a cache line */
+	struct shd_quantity q_blob = { 0, STREAM_BLOB_SIZE };
+	struct shd_quantity q_part = { 3, 200 };
+	uint8_t src[STREAM_BLOB_SIZE];
+	uint8_t dst[STREAM_BLOB_SIZE];
+	struct shd_quantity_sample qty_sample = { .ptr = dst,
+						.size = sizeof(dst) };
+	int i;
+	int ret;
+
+	hdr_info.blob_size = STREAM_BLOB_SIZE;
+	ctx_prod = shd_create(BLOB_NAME("write-streaming"), NULL,
+				&hdr_info,
+				&s_metadata_hdr);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+	ctx_cons = shd_open(BLOB_NAME("write-streaming"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	ret = shd_set_write_mode(ctx_prod, SHD_WRITE_MODE_STREAMING);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* Whole blobs */
+	for (i = 0; i < STREAM_BLOB_SIZE; i++)
+		src[i] = (uint8_t)i;
+	time_step(&sample_meta.ts);
+	ret = shd_write_new_blob(ctx_prod, src, sizeof(src), &sample_meta);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_read_from_sample(ctx_cons, 1, &search, &q_blob,
+			&qty_sample);
+	CU_ASSERT_EQUAL(ret, 1);
+	CU_ASSERT_EQUAL(memcmp(dst, src, sizeof(src)), 0);
+	shd_end_read(ctx_cons, rev);
+
+	/* Quantities, over a sample that previously held another blob */
+	for (i = 0; i < STREAM_BLOB_SIZE; i++)
+		src[i] = (uint8_t)(255 - i);
+	time_step(&sample_meta.ts);
+	ret = shd_new_sample(ctx_prod, &sample_meta);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_write_quantity(ctx_prod, &q_blob, src);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_write_quantity(ctx_prod, &q_part, src);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_commit_sample(ctx_prod);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_read_from_sample(ctx_cons, 1, &search, &q_blob,
+			&qty_sample);
+	CU_ASSERT_EQUAL(ret, 1);
+	CU_ASSERT_EQUAL(memcmp(dst, src, 3), 0);
+	CU_ASSERT_EQUAL(memcmp(dst + 3, src, 200), 0);
+	CU_ASSERT_EQUAL(memcmp(dst + 203, src + 203,
+			STREAM_BLOB_SIZE - 203), 0);
+	shd_end_read(ctx_cons, rev);
+
+	/* Invalid modes */
+	ret = shd_set_write_mode(ctx_prod, (enum shd_write_mode)42);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_set_write_mode(NULL, SHD_WRITE_MODE_CACHED);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+static void test_func_write_from_previous(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_sample_metadata sample_meta = METADATA_INIT;
+	struct shd_sample_search search = {
+		.method = SHD_LATEST,
+	};
+	struct shd_quantity q_all = { 0, sizeof(struct prod_blob) };
+	struct shd_quantity q_out = { sizeof(struct prod_blob) - 1, 2 };
+	struct shd_quantity q_neg = { -1, 2 };
+	/* Given in reverse order on purpose */
+	struct shd_quantity written[] = { q_s_blob_angles, q_s_blob_i1 };
+	struct prod_blob read_blob, expected;
+	struct shd_quantity_sample qty_sample = {
+		.ptr = &read_blob,
+		.size = sizeof(read_blob)
+	};
+	struct angles new_angles = { 1.0, 2.0, 3.0 };
+	int new_i1 = 42;
+	int ret;
+
+	ctx_prod = shd_create(BLOB_NAME("write-from-previous"), NULL,
+				&s_hdr_info, &s_metadata_hdr);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+	ctx_cons = shd_open(BLOB_NAME("write-from-previous"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	/* Invalid arguments */
+	ret = shd_new_sample_from_previous(NULL, &sample_meta, written, 2);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_new_sample_from_previous(ctx_prod, NULL, written, 2);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_new_sample_from_previous(ctx_prod, &sample_meta, NULL, 2);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_new_sample_from_previous(ctx_prod, &sample_meta, &q_out, 1);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_new_sample_from_previous(ctx_prod, &sample_meta, &q_neg, 1);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	/* Nothing to copy from in the first sample */
+	time_step(&sample_meta.ts);
+	ret = shd_new_sample_from_previous(ctx_prod, &sample_meta, &q_all, 1);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_write_quantity(ctx_prod, &q_all, &s_blob);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_commit_sample(ctx_prod);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* Only update a few quantities, the others are carried over */
+	time_step(&sample_meta.ts);
+	ret = shd_new_sample_from_previous(ctx_prod, &sample_meta, written, 2);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_write_quantity(ctx_prod, &q_s_blob_i1, &new_i1);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_write_quantity(ctx_prod, &q_s_blob_angles, &new_angles);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_commit_sample(ctx_prod);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	memcpy(&expected, &s_blob, sizeof(expected));
+	expected.i1 = new_i1;
+	expected.angles = new_angles;
+	ret = shd_read_from_sample(ctx_cons, 1, &search, &q_all, &qty_sample);
+	CU_ASSERT_EQUAL(ret, 1);
+	CU_ASSERT_EQUAL(memcmp(&read_blob, &expected, sizeof(expected)), 0);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* Without any written quantity, the whole blob is carried over */
+	time_step(&sample_meta.ts);
+	ret = shd_new_sample_from_previous(ctx_prod, &sample_meta, NULL, 0);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_commit_sample(ctx_prod);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_read_from_sample(ctx_cons, 1, &search, &q_all, &qty_sample);
+	CU_ASSERT_EQUAL(ret, 1);
+	CU_ASSERT_EQUAL(memcmp(&read_blob, &expected, sizeof(expected)), 0);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
 CU_TestInfo s_func_adv_write_tests[] = {
 	{(char *)"write by quantity", &test_func_adv_write_by_quantity},
+	{(char *)"write with streaming stores", &test_func_write_streaming},
+	{(char *)"new sample from the previous one",
+			&test_func_write_from_previous},
 	CU_TEST_INFO_NULL,
 };
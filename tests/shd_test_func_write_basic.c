@@ -152,6 +152,115 @@ static void test_func_write_change_blob_structure(void)
 	CU_ASSERT_EQUAL(ret, 0);
 }
 
+#define BATCH_SIZE 8
+
+static void test_func_basic_write_blobs(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_sample_metadata sample_meta = METADATA_INIT;
+	struct shd_sample_metadata batch_meta[NUMBER_OF_SAMPLES];
+	struct prod_blob batch[NUMBER_OF_SAMPLES];
+	struct shd_sample_search search = {
+		.method = SHD_LATEST,
+	};
+	int i1 = 0;
+	struct shd_quantity_sample qty_sample = { .ptr = &i1,
+						.size = sizeof(i1) };
+	int index;
+	int ret;
+
+	ctx_prod = shd_create(BLOB_NAME("write-blobs"), NULL,
+				&s_hdr_info,
+				&s_metadata_hdr);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+	ctx_cons = shd_open(BLOB_NAME("write-blobs"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	/* A few single samples, then a batch which wraps around the end of
+	 * the section */
+	for (index = 0; index < NUMBER_OF_SAMPLES - BATCH_SIZE / 2; index++) {
+		time_step(&sample_meta.ts);
+		ret = shd_write_new_blob(ctx_prod, &s_blob, sizeof(s_blob),
+				&sample_meta);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+	for (index = 0; index < BATCH_SIZE; index++) {
+		time_step(&sample_meta.ts);
+		batch_meta[index] = sample_meta;
+		batch[index] = s_blob;
+		batch[index].i1 = index;
+	}
+	ret = shd_write_new_blobs(ctx_prod, batch, sizeof(batch[0]),
+			batch_meta, BATCH_SIZE);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* The last blob of the batch is the latest sample ... */
+	ret = shd_read_from_sample(ctx_cons, 1, &search, &q_s_blob_i1,
+			&qty_sample);
+	CU_ASSERT_EQUAL(ret, 1);
+	CU_ASSERT_EQUAL(i1, BATCH_SIZE - 1);
+	CU_ASSERT_EQUAL(qty_sample.meta.ts.tv_sec,
+			batch_meta[BATCH_SIZE - 1].ts.tv_sec);
+	CU_ASSERT_EQUAL(qty_sample.meta.ts.tv_nsec,
+			batch_meta[BATCH_SIZE - 1].ts.tv_nsec);
+	shd_end_read(ctx_cons, rev);
+
+	/* ... and each blob can be found by its date */
+	search.method = SHD_CLOSEST;
+	for (index = 0; index < BATCH_SIZE; index++) {
+		search.date = batch_meta[index].ts;
+		ret = shd_read_from_sample(ctx_cons, 1, &search, &q_s_blob_i1,
+				&qty_sample);
+		CU_ASSERT_EQUAL(ret, 1);
+		CU_ASSERT_EQUAL(i1, index);
+		shd_end_read(ctx_cons, rev);
+	}
+
+	/* Single writes go on after the batch */
+	time_step(&sample_meta.ts);
+	ret = shd_write_new_blob(ctx_prod, &s_blob, sizeof(s_blob),
+			&sample_meta);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* The whole readable history at once */
+	for (index = 0; index < NUMBER_OF_SAMPLES - 1; index++) {
+		time_step(&sample_meta.ts);
+		batch_meta[index] = sample_meta;
+		batch[index] = s_blob;
+		batch[index].i1 = index;
+	}
+	ret = shd_write_new_blobs(ctx_prod, batch, sizeof(batch[0]),
+			batch_meta, NUMBER_OF_SAMPLES - 1);
+	CU_ASSERT_EQUAL(ret, 0);
+	search.method = SHD_OLDEST;
+	ret = shd_read_from_sample(ctx_cons, 1, &search, &q_s_blob_i1,
+			&qty_sample);
+	CU_ASSERT_EQUAL(ret, 1);
+	CU_ASSERT_EQUAL(i1, 0);
+	shd_end_read(ctx_cons, rev);
+
+	/* Invalid batches */
+	ret = shd_write_new_blobs(ctx_prod, batch, sizeof(batch[0]),
+			batch_meta, 0);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_write_new_blobs(ctx_prod, batch, sizeof(batch[0]),
+			batch_meta, NUMBER_OF_SAMPLES);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_write_new_blobs(ctx_prod, batch, sizeof(batch[0]) + 1,
+			batch_meta, 1);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_write_new_blobs(ctx_prod, NULL, sizeof(batch[0]),
+			batch_meta, 1);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_write_new_blobs(ctx_prod, batch, sizeof(batch[0]),
+			NULL, 1);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
 CU_TestInfo s_func_basic_write_tests[] = {
 	{(char *)"write by blob whole section once",
 			&test_func_basic_write_by_blob_whole_once},
@@ -159,5 +268,7 @@ CU_TestInfo s_func_basic_write_tests[] = {
 			&test_func_basic_write_by_blob_whole_twice},
 	{(char *)"write by blob and then change blob structure",
 			&test_func_write_change_blob_structure},
+	{(char *)"write several blobs at once",
+			&test_func_basic_write_blobs},
 	CU_TEST_INFO_NULL,
 };
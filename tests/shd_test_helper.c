@@ -34,7 +34,9 @@
 #include <time.h>
 #include <stdbool.h>
 #include <limits.h>
+#include <stdlib.h>
 #include "libshdata.h"
+#include <CUnit/CUnit.h>
 #include "shd_test_helper.h"
 
 struct prod_blob s_blob = {
@@ -247,3 +249,62 @@ int get_unique_blob_name(const char *root, char *dest)
 			current_time.tv_sec,
 			current_time.tv_nsec);
 }
+
+struct shd_ctx *create_test_section(const char *blob_name, size_t blob_size,
+				uint32_t max_nb_samples,
+				const struct shd_field_desc fields[],
+				size_t nb_fields,
+				const struct shd_tier_info tiers[],
+				size_t nb_tiers)
+{
+	struct shd_hdr_user_info hdr_info = {
+		.blob_size = blob_size,
+		.max_nb_samples = max_nb_samples,
+		.rate = 1000,
+		.blob_metadata_hdr_size = sizeof(s_metadata_hdr),
+	};
+	struct shd_ctx *ctx;
+	void *mdata = &s_metadata_hdr;
+	int ret;
+
+	if (fields != NULL) {
+		hdr_info.blob_metadata_hdr_size = shd_blob_schema_get_size(0,
+				fields, nb_fields);
+		CU_ASSERT_NOT_EQUAL_FATAL(hdr_info.blob_metadata_hdr_size, 0);
+		mdata = malloc(hdr_info.blob_metadata_hdr_size);
+		CU_ASSERT_PTR_NOT_NULL_FATAL(mdata);
+		ret = shd_blob_schema_write(mdata,
+				hdr_info.blob_metadata_hdr_size, NULL, 0,
+				fields, nb_fields);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+
+	if (tiers != NULL)
+		ctx = shd_create_tiered(blob_name, NULL, &hdr_info, mdata,
+				tiers, nb_tiers);
+	else
+		ctx = shd_create(blob_name, NULL, &hdr_info, mdata);
+	if (fields != NULL)
+		free(mdata);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx);
+
+	return ctx;
+}
+
+void write_test_samples(struct shd_ctx *ctx, void *blob, size_t blob_size,
+				fill_test_blob_t fill, int first, int last)
+{
+	struct shd_sample_metadata metadata;
+	int k;
+	int ret;
+
+	for (k = first; k <= last; k++) {
+		metadata.ts.tv_sec = k;
+		metadata.ts.tv_nsec = 0;
+		metadata.exp = metadata.ts;
+		if (fill != NULL)
+			fill(blob, k);
+		ret = shd_write_new_blob(ctx, blob, blob_size, &metadata);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+}
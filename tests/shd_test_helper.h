@@ -161,4 +161,19 @@ bool compare_blobs(struct prod_blob b1, struct prod_blob b2);
 
 int get_unique_blob_name(const char *root, char *dest);
 
+/* Section fixtures shared by the read suites: blobs described by an optional
+ * schema (s_metadata_hdr otherwise), in optional tiers, written by
+ * write_test_samples() at one sample per second, the sample of date k being
+ * filled by fill(blob, k), if any */
+typedef void (*fill_test_blob_t)(void *blob, int k);
+
+struct shd_ctx *create_test_section(const char *blob_name, size_t blob_size,
+				uint32_t max_nb_samples,
+				const struct shd_field_desc fields[],
+				size_t nb_fields,
+				const struct shd_tier_info tiers[],
+				size_t nb_tiers);
+void write_test_samples(struct shd_ctx *ctx, void *blob, size_t blob_size,
+				fill_test_blob_t fill, int first, int last);
+
 #endif /* SHD_TEST_HELPER_H_ */
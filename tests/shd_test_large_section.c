@@ -0,0 +1,199 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_test_large_section.c
+ *
+ * @brief Large (> 4 GiB) section unit tests.
+ *
+ */
+
+#define SHD_ADVANCED_WRITE_API
+#define SHD_ADVANCED_READ_API
+#include <stdint.h>
+#include <sys/mman.h>
+#include "shd_test.h"
+#include "shd_test_helper.h"
+
+/* 72 frames of 64 MiB : the section is about 4.5 GiB large. Only a few bytes
+ * of each frame are written, so that the section remains sparse in tmpfs */
+#define LARGE_FRAME_SIZE	(64 * 1024 * 1024)
+#define LARGE_NB_SAMPLES	72
+#define LARGE_NB_WRITES		100
+#define LARGE_TAIL_OFFSET	(LARGE_FRAME_SIZE - sizeof(uint64_t))
+
+static struct shd_quantity q_frame_id = { 0, sizeof(int) };
+static struct shd_quantity q_frame_tail = {
+	LARGE_TAIL_OFFSET, sizeof(uint64_t)
+};
+
+static struct shd_hdr_user_info s_large_hdr_info = {
+	.blob_size = LARGE_FRAME_SIZE,
+	.max_nb_samples = LARGE_NB_SAMPLES,
+	.rate = 30000,
+	.blob_metadata_hdr_size = sizeof(s_metadata_hdr)
+};
+
+static uint64_t frame_tail(int frame_id)
+{
+	return 0xCAFE000000000000ULL | frame_id;
+}
+
+static void check_large_section_search(const char *blob_name,
+					struct timespec *date, int frame_id)
+{
+	struct shd_ctx *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_hdr_user_info hdr_info;
+	struct shd_sample_metadata *metadata;
+	struct shd_search_result result;
+	struct shd_sample_search search = {
+		.method = SHD_CLOSEST,
+		.nb_values_before_date = 3,
+		.nb_values_after_date = 2,
+	};
+	int ids[6];
+	uint64_t tails[6];
+	int ret;
+	int i;
+
+	ctx_cons = shd_open(blob_name, NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	ret = shd_read_section_hdr(ctx_cons, &hdr_info, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(hdr_info.blob_size, LARGE_FRAME_SIZE);
+	CU_ASSERT_EQUAL(hdr_info.max_nb_samples, LARGE_NB_SAMPLES);
+
+	/* The reference frame sits beyond the first 4 GiB of the section, and
+	 * the window wraps around the end of the buffer */
+	search.date = *date;
+	ret = shd_select_samples(ctx_cons, &search, &metadata, &result);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	CU_ASSERT_EQUAL(result.nb_matches, 6);
+	CU_ASSERT_EQUAL(result.r_sample_idx, 3);
+
+	ret = shd_read_quantity(ctx_cons, &q_frame_id, ids, sizeof(ids));
+	CU_ASSERT_EQUAL(ret, 6);
+	ret = shd_read_quantity(ctx_cons, &q_frame_tail, tails, sizeof(tails));
+	CU_ASSERT_EQUAL(ret, 6);
+	for (i = 0; i < 6; i++) {
+		CU_ASSERT_EQUAL(ids[i], frame_id - 3 + i);
+		CU_ASSERT_EQUAL(tails[i], frame_tail(frame_id - 3 + i));
+	}
+
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	ret = shd_close(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+}
+
+static void test_large_section_write_search(void)
+{
+	struct shd_ctx *ctx_prod;
+	struct shd_sample_metadata sample_meta = METADATA_INIT;
+	struct timespec ref_date = TIME_INIT;
+	/* Frame located in the last slots of the section */
+	int ref_id = LARGE_NB_SAMPLES - 2;
+	uint64_t tail;
+	int ret;
+	int i;
+
+	ctx_prod = shd_create(BLOB_NAME("large-section"), NULL,
+			&s_large_hdr_info, &s_metadata_hdr);
+
+	/* Such a section can not be addressed with a 32-bit size_t */
+	if (SIZE_MAX <= UINT32_MAX) {
+		CU_ASSERT_PTR_NULL(ctx_prod);
+		return;
+	}
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+
+	for (i = 0; i < LARGE_NB_WRITES; i++) {
+		if (time_step(&sample_meta.ts) < 0)
+			CU_FAIL_FATAL("Could not get time");
+		if (i == ref_id)
+			ref_date = sample_meta.ts;
+
+		ret = shd_new_sample(ctx_prod, &sample_meta);
+		CU_ASSERT_EQUAL_FATAL(ret, 0);
+		ret = shd_write_quantity(ctx_prod, &q_frame_id, &i);
+		CU_ASSERT_EQUAL(ret, 0);
+		tail = frame_tail(i);
+		ret = shd_write_quantity(ctx_prod, &q_frame_tail, &tail);
+		CU_ASSERT_EQUAL(ret, 0);
+		ret = shd_commit_sample(ctx_prod);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+
+	/* Search with both reference sample search methods */
+	check_large_section_search(BLOB_NAME("large-section"),
+				&ref_date, ref_id);
+	setenv("LIBSHDATA_CONFIG_INTERNAL_SEARCH_METHOD", "BINARY", 1);
+	check_large_section_search(BLOB_NAME("large-section"),
+				&ref_date, ref_id);
+	unsetenv("LIBSHDATA_CONFIG_INTERNAL_SEARCH_METHOD");
+
+	ret = shd_close(ctx_prod, NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+}
+
+static void test_large_section_too_large(void)
+{
+	struct shd_ctx *ctx;
+	struct shd_hdr_user_info hdr_info = s_large_hdr_info;
+
+	/* The size of such a section can not be represented by a size_t */
+	hdr_info.blob_size = SIZE_MAX / 4;
+	hdr_info.max_nb_samples = 8;
+	ctx = shd_create(BLOB_NAME("too-large-section"), NULL,
+			&hdr_info, &s_metadata_hdr);
+	CU_ASSERT_PTR_NULL(ctx);
+
+	/* Sample indexes are handled as int */
+	hdr_info.blob_size = 1;
+	hdr_info.max_nb_samples = (uint32_t) INT32_MAX + 1;
+	ctx = shd_create(BLOB_NAME("too-large-section"), NULL,
+			&hdr_info, &s_metadata_hdr);
+	CU_ASSERT_PTR_NULL(ctx);
+}
+
+/* The large section is sparse but still accounts for about 4.5 GiB of the
+ * tmpfs : do not leave it behind, even if a test failed */
+int large_section_cleanup(void)
+{
+	shm_unlink("/shd_" BLOB_NAME("large-section"));
+
+	return 0;
+}
+
+CU_TestInfo s_large_section_tests[] = {
+	{(char *)"write and search a section larger than 4 GiB",
+			&test_large_section_write_search},
+	{(char *)"refuse sections too large to be addressed",
+			&test_large_section_too_large},
+	CU_TEST_INFO_NULL,
+};
@@ -0,0 +1,397 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_test_notify.c
+ *
+ * @brief Commit notification unit tests.
+ *
+ */
+
+#include <pthread.h>
+#include "shd_test.h"
+#include "shd_test_helper.h"
+
+#define WAIT_NB_SECTIONS 3
+
+static void date_in_ms(struct timespec *date, long ms)
+{
+	clock_gettime(CLOCK_MONOTONIC, date);
+	date->tv_sec += ms / 1000;
+	date->tv_nsec += (ms % 1000) * 1000000;
+	if (date->tv_nsec >= 1000000000) {
+		date->tv_nsec -= 1000000000;
+		date->tv_sec++;
+	}
+}
+
+static void *delayed_write(void *arg)
+{
+	struct shd_ctx *ctx = arg;
+	struct shd_sample_metadata metadata = METADATA_INIT;
+	intptr_t ret;
+
+	usleep(20000);
+	ret = shd_write_new_blob(ctx, &s_blob, sizeof(s_blob), &metadata);
+
+	return (void *)ret;
+}
+
+static void test_wait_sample_timeout(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_sample_metadata metadata = METADATA_INIT;
+	struct timespec timeout = { 0, 0 };
+	uint32_t seq = 0;
+	int ret;
+
+	ctx_prod = shd_create(BLOB_NAME("wait-timeout"), NULL, &s_hdr_info,
+			&s_metadata_hdr);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+	ctx_cons = shd_open(BLOB_NAME("wait-timeout"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	/* A timeout in the past returns the current sequence number */
+	shd_wait_sample(ctx_cons, &seq, &timeout);
+	ret = shd_wait_sample(ctx_cons, &seq, &timeout);
+	CU_ASSERT_EQUAL(ret, -ETIMEDOUT);
+
+	/* No commit : the wait gives up */
+	date_in_ms(&timeout, 10);
+	ret = shd_wait_sample(ctx_cons, &seq, &timeout);
+	CU_ASSERT_EQUAL(ret, -ETIMEDOUT);
+
+	/* Commit before the wait : it returns at once */
+	ret = shd_write_new_blob(ctx_prod, &s_blob, sizeof(s_blob), &metadata);
+	CU_ASSERT_EQUAL(ret, 0);
+	date_in_ms(&timeout, 1000);
+	ret = shd_wait_sample(ctx_cons, &seq, &timeout);
+	CU_ASSERT_EQUAL(ret, 1);
+
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+static void test_wait_sample_wake(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct timespec timeout = { 0, 0 };
+	struct shd_sample_search search = {
+		.method = SHD_LATEST,
+	};
+	int i1 = 0;
+	struct shd_quantity_sample qty_sample = { .ptr = &i1,
+						.size = sizeof(i1) };
+	pthread_t prod_thread;
+	void *prod_ret;
+	uint32_t seq = 0;
+	int ret;
+
+	ctx_prod = shd_create(BLOB_NAME("wait-wake"), NULL, &s_hdr_info,
+			&s_metadata_hdr);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+	ctx_cons = shd_open(BLOB_NAME("wait-wake"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+	shd_wait_sample(ctx_cons, &seq, &timeout);
+
+	/* The consumer polls the section until the producer commits a
+	 * sample ... */
+	pthread_create(&prod_thread, NULL, &delayed_write, ctx_prod);
+	date_in_ms(&timeout, 5000);
+	ret = shd_wait_sample(ctx_cons, &seq, &timeout);
+	CU_ASSERT_EQUAL(ret, 1);
+	pthread_join(prod_thread, &prod_ret);
+	CU_ASSERT_EQUAL((intptr_t)prod_ret, 0);
+
+	/* ... or blocks until it is woken up by the commit */
+	ret = shd_set_commit_notify(ctx_prod, true);
+	CU_ASSERT_EQUAL(ret, 0);
+	pthread_create(&prod_thread, NULL, &delayed_write, ctx_prod);
+	date_in_ms(&timeout, 5000);
+	ret = shd_wait_sample(ctx_cons, &seq, &timeout);
+	CU_ASSERT_EQUAL(ret, 1);
+	pthread_join(prod_thread, &prod_ret);
+	CU_ASSERT_EQUAL((intptr_t)prod_ret, 0);
+
+	/* The committed sample can be read right away */
+	ret = shd_read_from_sample(ctx_cons, 1, &search, &q_s_blob_i1,
+			&qty_sample);
+	CU_ASSERT_EQUAL(ret, 1);
+	CU_ASSERT_EQUAL(i1, s_blob.i1);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+static void test_wait_any(void)
+{
+	static const char * const names[WAIT_NB_SECTIONS] = {
+		BLOB_NAME("wait-any-0"),
+		BLOB_NAME("wait-any-1"),
+		BLOB_NAME("wait-any-2"),
+	};
+	struct shd_ctx *ctx_prod[WAIT_NB_SECTIONS];
+	struct shd_ctx *ctx_cons[WAIT_NB_SECTIONS];
+	struct shd_revision *rev[WAIT_NB_SECTIONS];
+	struct timespec timeout = { 0, 0 };
+	uint32_t seq[WAIT_NB_SECTIONS] = { 0 };
+	uint32_t prev_seq[WAIT_NB_SECTIONS];
+	pthread_t prod_thread;
+	void *prod_ret;
+	int i;
+	int ret;
+
+	for (i = 0; i < WAIT_NB_SECTIONS; i++) {
+		ctx_prod[i] = shd_create(names[i], NULL, &s_hdr_info,
+				&s_metadata_hdr);
+		CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod[i]);
+		ctx_cons[i] = shd_open(names[i], NULL, &rev[i]);
+		CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons[i]);
+		shd_set_commit_notify(ctx_prod[i], true);
+	}
+	shd_wait_any(ctx_cons, seq, WAIT_NB_SECTIONS, &timeout);
+	memcpy(prev_seq, seq, sizeof(seq));
+
+	/* Only the section in which a sample is committed is reported */
+	pthread_create(&prod_thread, NULL, &delayed_write, ctx_prod[1]);
+	date_in_ms(&timeout, 5000);
+	ret = shd_wait_any(ctx_cons, seq, WAIT_NB_SECTIONS, &timeout);
+	CU_ASSERT_EQUAL(ret, 1);
+	pthread_join(prod_thread, &prod_ret);
+	CU_ASSERT_EQUAL(seq[0], prev_seq[0]);
+	CU_ASSERT_NOT_EQUAL(seq[1], prev_seq[1]);
+	CU_ASSERT_EQUAL(seq[2], prev_seq[2]);
+
+	/* Invalid arguments */
+	ret = shd_wait_any(ctx_cons, seq, 0, &timeout);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_wait_any(ctx_cons, seq, SHD_WAIT_MAX_SECTIONS + 1, &timeout);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_wait_sample(NULL, seq, &timeout);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_wait_sample(ctx_cons[0], NULL, &timeout);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_set_commit_notify(NULL, true);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	for (i = 0; i < WAIT_NB_SECTIONS; i++) {
+		shd_close(ctx_cons[i], rev[i]);
+		shd_close(ctx_prod[i], NULL);
+	}
+}
+
+static void test_wait_recreation(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct timespec timeout = { 0, 0 };
+	uint32_t seq = 0;
+	int ret;
+
+	ctx_prod = shd_create(BLOB_NAME("wait-recreate"), NULL, &s_hdr_info,
+			&s_metadata_hdr);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+	ctx_cons = shd_open(BLOB_NAME("wait-recreate"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+	shd_set_commit_notify(ctx_prod, true);
+	shd_wait_sample(ctx_cons, &seq, &timeout);
+
+	/* Re-creating the section wakes up its consumers */
+	shd_close(ctx_prod, NULL);
+	ctx_prod = shd_create(BLOB_NAME("wait-recreate"), NULL, &s_hdr_info,
+			&s_metadata_hdr);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+	date_in_ms(&timeout, 1000);
+	ret = shd_wait_sample(ctx_cons, &seq, &timeout);
+	CU_ASSERT_EQUAL(ret, 1);
+
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+static void test_read_latest_if_new(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_sample_metadata metadata = METADATA_INIT;
+	struct prod_blob blob = s_blob;
+	int i1 = 0;
+	struct shd_quantity_sample qty_sample = { .ptr = &i1,
+						.size = sizeof(i1) };
+	uint32_t last_seen = 0;
+	int ret;
+
+	ctx_prod = shd_create(BLOB_NAME("read-if-new"), NULL, &s_hdr_info,
+			&s_metadata_hdr);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+	ctx_cons = shd_open(BLOB_NAME("read-if-new"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	/* Nothing to read yet */
+	ret = shd_read_latest_if_new(ctx_cons, &last_seen, 1, &q_s_blob_i1,
+			&qty_sample);
+	CU_ASSERT_EQUAL(ret, -EAGAIN);
+
+	blob.i1 = 1;
+	ret = shd_write_new_blob(ctx_prod, &blob, sizeof(blob), &metadata);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_read_latest_if_new(ctx_cons, &last_seen, 1, &q_s_blob_i1,
+			&qty_sample);
+	CU_ASSERT_EQUAL(ret, 1);
+	CU_ASSERT_EQUAL(i1, 1);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* The same sample is not read twice */
+	i1 = 0;
+	ret = shd_read_latest_if_new(ctx_cons, &last_seen, 1, &q_s_blob_i1,
+			&qty_sample);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(i1, 0);
+
+	/* Only the latest of several new samples is read */
+	time_step(&metadata.ts);
+	blob.i1 = 2;
+	ret = shd_write_new_blob(ctx_prod, &blob, sizeof(blob), &metadata);
+	CU_ASSERT_EQUAL(ret, 0);
+	time_step(&metadata.ts);
+	blob.i1 = 3;
+	ret = shd_write_new_blob(ctx_prod, &blob, sizeof(blob), &metadata);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_read_latest_if_new(ctx_cons, &last_seen, 1, &q_s_blob_i1,
+			&qty_sample);
+	CU_ASSERT_EQUAL(ret, 1);
+	CU_ASSERT_EQUAL(i1, 3);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_read_latest_if_new(ctx_cons, &last_seen, 1, &q_s_blob_i1,
+			&qty_sample);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	ret = shd_read_latest_if_new(ctx_cons, NULL, 1, &q_s_blob_i1,
+			&qty_sample);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+#define PERIODIC_NB_SAMPLES 10
+#define PERIODIC_PERIOD_MS 5
+
+static void *periodic_write(void *arg)
+{
+	struct shd_ctx *ctx = arg;
+	struct shd_sample_metadata metadata;
+	intptr_t ret = 0;
+	int i;
+
+	for (i = 0; i < PERIODIC_NB_SAMPLES && ret == 0; i++) {
+		usleep(PERIODIC_PERIOD_MS * 1000);
+		clock_gettime(CLOCK_MONOTONIC, &metadata.ts);
+		metadata.exp = metadata.ts;
+		ret = shd_write_new_blob(ctx, &s_blob, sizeof(s_blob),
+				&metadata);
+	}
+
+	return (void *)ret;
+}
+
+static void test_wait_next_expected(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct timespec timeout = { 0, 0 };
+	pthread_t prod_thread;
+	void *prod_ret;
+	uint32_t seq = 0;
+	uint32_t first_seq;
+	uint32_t rate;
+	int ret;
+
+	ctx_prod = shd_create(BLOB_NAME("wait-expected"), NULL, &s_hdr_info,
+			&s_metadata_hdr);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+	ctx_cons = shd_open(BLOB_NAME("wait-expected"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+	shd_wait_next_expected(ctx_cons, &seq, &timeout);
+
+	ret = shd_get_measured_rate(ctx_cons, &rate);
+	CU_ASSERT_EQUAL(ret, -EAGAIN);
+
+	/* No commit : the wait gives up */
+	date_in_ms(&timeout, 10);
+	ret = shd_wait_next_expected(ctx_cons, &seq, &timeout);
+	CU_ASSERT_EQUAL(ret, -ETIMEDOUT);
+
+	/* The commits of a periodic producer are seen, whether they are
+	 * expected from the declared rate or from the measured one */
+	ret = pthread_create(&prod_thread, NULL, periodic_write, ctx_prod);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	date_in_ms(&timeout, 1000);
+	first_seq = seq;
+	while (seq - first_seq < PERIODIC_NB_SAMPLES) {
+		ret = shd_wait_next_expected(ctx_cons, &seq, &timeout);
+		CU_ASSERT_EQUAL(ret, 1);
+		if (ret < 0)
+			break;
+	}
+	pthread_join(prod_thread, &prod_ret);
+	CU_ASSERT_EQUAL((intptr_t)prod_ret, 0);
+
+	/* The period is measured from the sample timestamps : sleeps may only
+	 * make it longer */
+	ret = shd_get_measured_rate(ctx_cons, &rate);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_TRUE(rate >= PERIODIC_PERIOD_MS * 1000);
+
+	ret = shd_wait_next_expected(NULL, &seq, &timeout);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_get_measured_rate(ctx_cons, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+CU_TestInfo s_notify_tests[] = {
+	{(char *)"wait for a sample with timeout",
+			&test_wait_sample_timeout},
+	{(char *)"wake up on sample commit",
+			&test_wait_sample_wake},
+	{(char *)"wait for samples in several sections",
+			&test_wait_any},
+	{(char *)"wake up on section re-creation",
+			&test_wait_recreation},
+	{(char *)"read the latest sample only if new",
+			&test_read_latest_if_new},
+	{(char *)"wait for the next expected sample",
+			&test_wait_next_expected},
+	CU_TEST_INFO_NULL,
+};
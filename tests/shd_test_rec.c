@@ -0,0 +1,263 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_test_rec.c
+ *
+ * @brief Record sections unit tests.
+ *
+ */
+
+#define SHD_ADVANCED_READ_API
+#include "shd_test.h"
+#include "shd_test_helper.h"
+
+#define NB_RECORDS 16
+
+static void write_records(struct shd_ctx *ctx, int first, int nb,
+				struct timespec ts[])
+{
+	char msg[64];
+	int len;
+	int i;
+	int ret;
+
+	for (i = first; i < first + nb; i++) {
+		/* Records of increasing lengths */
+		len = snprintf(msg, sizeof(msg), "record %d %.*s", i, i % 20,
+				"....................");
+		if (i > 0)
+			ts[i] = ts[i - 1];
+		time_step(&ts[i]);
+		ret = shd_rec_write(ctx, &ts[i], msg, len);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+}
+
+static void check_record(const struct shd_rec_record *record, int i,
+				struct timespec ts[])
+{
+	struct timespec record_ts = record->ts;
+	char msg[64];
+	int len;
+
+	len = snprintf(msg, sizeof(msg), "record %d %.*s", i, i % 20,
+			"....................");
+	CU_ASSERT_EQUAL(record->seq, (uint64_t) i);
+	CU_ASSERT_TRUE(time_is_equal(&record_ts, &ts[i]));
+	CU_ASSERT_EQUAL(record->len, (size_t) len);
+	CU_ASSERT_EQUAL(memcmp(record->data, msg, len), 0);
+}
+
+static void test_rec_write_read(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_sample_metadata *metadata;
+	struct shd_search_result result;
+	struct shd_sample_search search = {
+		.method = SHD_LATEST,
+		.nb_values_before_date = 2,
+	};
+	struct shd_rec_record records[NB_RECORDS];
+	struct timespec ts[NB_RECORDS] = { { 0, 0 } };
+	char buf[1024];
+	int i;
+	int ret;
+
+	ctx_prod = shd_rec_create(BLOB_NAME("rec-write-read"), NULL, 1024,
+				NB_RECORDS);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+	ctx_cons = shd_open(BLOB_NAME("rec-write-read"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	write_records(ctx_prod, 0, 10, ts);
+
+	/* Latest records */
+	ret = shd_select_samples(ctx_cons, &search, &metadata, &result);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(result.nb_matches, 3);
+	ret = shd_rec_read(ctx_cons, records, NB_RECORDS, buf, sizeof(buf));
+	CU_ASSERT_EQUAL(ret, 3);
+	for (i = 0; i < 3; i++) {
+		check_record(&records[i], 7 + i, ts);
+		/* Record data is aligned */
+		CU_ASSERT_EQUAL(((uintptr_t) records[i].data) % 8,
+				((uintptr_t) buf) % 8);
+	}
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* Records following a date */
+	search.method = SHD_FIRST_AFTER;
+	search.date = ts[3];
+	search.nb_values_before_date = 0;
+	search.nb_values_after_date = 4;
+	ret = shd_select_samples(ctx_cons, &search, &metadata, &result);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(result.nb_matches, 5);
+	ret = shd_rec_read(ctx_cons, records, NB_RECORDS, buf, sizeof(buf));
+	CU_ASSERT_EQUAL(ret, 5);
+	for (i = 0; i < 5; i++)
+		check_record(&records[i], 3 + i, ts);
+	/* Copies stop when the destination is full */
+	ret = shd_rec_read(ctx_cons, records, 2, buf, sizeof(buf));
+	CU_ASSERT_EQUAL(ret, 2);
+	ret = shd_rec_read(ctx_cons, records, NB_RECORDS, buf, 20);
+	CU_ASSERT_EQUAL(ret, 1);
+	check_record(&records[0], 3, ts);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* Out-of-sequence call */
+	ret = shd_rec_read(ctx_cons, records, NB_RECORDS, buf, sizeof(buf));
+	CU_ASSERT_EQUAL(ret, -EPERM);
+
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+static void test_rec_overwrite(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_sample_metadata *metadata;
+	struct shd_search_result result;
+	struct shd_sample_search search = {
+		.method = SHD_LATEST,
+		.nb_values_before_date = NB_RECORDS - 2,
+	};
+	struct shd_rec_record records[NB_RECORDS];
+	struct timespec ts[3 * NB_RECORDS] = { { 0, 0 } };
+	char buf[1024];
+	int i;
+	int ret;
+
+	/* The byte ring only holds a few records, which wrap around its end */
+	ctx_prod = shd_rec_create(BLOB_NAME("rec-overwrite"), NULL, 300,
+				NB_RECORDS);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+	ctx_cons = shd_open(BLOB_NAME("rec-overwrite"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	write_records(ctx_prod, 0, 3 * NB_RECORDS, ts);
+
+	ret = shd_select_samples(ctx_cons, &search, &metadata, &result);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(result.nb_matches, NB_RECORDS - 1);
+	ret = shd_rec_read(ctx_cons, records, NB_RECORDS, buf, sizeof(buf));
+	CU_ASSERT_TRUE(ret > 0);
+	CU_ASSERT_TRUE(ret < NB_RECORDS - 1);
+	/* Only the latest records are still in the byte ring */
+	for (i = 0; i < ret; i++)
+		check_record(&records[i], 3 * NB_RECORDS - ret + i, ts);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+static void test_rec_invalid(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_rec, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_sample_metadata meta = METADATA_INIT;
+	struct shd_sample_metadata *metadata;
+	struct shd_search_result result;
+	struct shd_sample_search search = {
+		.method = SHD_LATEST,
+	};
+	struct shd_rec_record record;
+	struct shd_quantity_info info;
+	struct timespec ts = { 1, 0 };
+	char buf[128] = { 0 };
+	int ret;
+
+	/* Invalid creation arguments */
+	ctx_rec = shd_rec_create(NULL, NULL, 1024, NB_RECORDS);
+	CU_ASSERT_PTR_NULL(ctx_rec);
+	ctx_rec = shd_rec_create(BLOB_NAME("rec-invalid"), NULL, 1024, 0);
+	CU_ASSERT_PTR_NULL(ctx_rec);
+	ctx_rec = shd_rec_create(BLOB_NAME("rec-invalid"), NULL, 8,
+				NB_RECORDS);
+	CU_ASSERT_PTR_NULL(ctx_rec);
+
+	/* Records longer than the byte ring */
+	ctx_rec = shd_rec_create(BLOB_NAME("rec-invalid"), NULL, 100,
+				NB_RECORDS);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_rec);
+	ret = shd_rec_write(ctx_rec, &ts, buf, sizeof(buf));
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_rec_write(ctx_rec, NULL, buf, 1);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_rec_write(ctx_rec, &ts, NULL, 1);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	/* Empty records are valid */
+	ret = shd_rec_write(ctx_rec, &ts, NULL, 0);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* The records are not a blob metadata header, nor a blob schema */
+	ctx_cons = shd_open(BLOB_NAME("rec-invalid"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+	ret = shd_read_blob_metadata_hdr(ctx_cons, buf, sizeof(buf), rev);
+	CU_ASSERT_EQUAL(ret, -ENODATA);
+	ret = shd_quantity_resolve(ctx_cons, "i1", &info, rev);
+	CU_ASSERT_EQUAL(ret, -ENODATA);
+	CU_ASSERT_PTR_NULL(shd_col_record_start(ctx_cons,
+			"/tmp/shd_test_rec_invalid.col", 16, rev));
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_rec, NULL);
+
+	/* Regular sections do not hold records */
+	ctx_prod = shd_create(BLOB_NAME("rec-regular"), NULL, &s_hdr_info,
+				&s_metadata_hdr);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+	ctx_cons = shd_open(BLOB_NAME("rec-regular"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+	ret = shd_rec_write(ctx_prod, &ts, buf, 1);
+	CU_ASSERT_EQUAL(ret, -EOPNOTSUPP);
+	time_step(&meta.ts);
+	ret = shd_write_new_blob(ctx_prod, &s_blob, sizeof(s_blob), &meta);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_select_samples(ctx_cons, &search, &metadata, &result);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_rec_read(ctx_cons, &record, 1, buf, sizeof(buf));
+	CU_ASSERT_EQUAL(ret, -EOPNOTSUPP);
+	ret = shd_rec_read(ctx_cons, NULL, 1, buf, sizeof(buf));
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+CU_TestInfo s_rec_tests[] = {
+	{(char *)"write and read records", &test_rec_write_read},
+	{(char *)"overwritten records", &test_rec_overwrite},
+	{(char *)"invalid arguments", &test_rec_invalid},
+	CU_TEST_INFO_NULL,
+};
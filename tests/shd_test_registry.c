@@ -0,0 +1,319 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_test_registry.c
+ *
+ * @brief Section registry unit tests.
+ *
+ */
+
+#include <sys/wait.h>
+#include "shd_test.h"
+#include "shd_test_helper.h"
+#include "shd_registry.h"
+#include "shd_section.h"
+#include "concurrency/hooks_implem.h"
+
+#define REGISTRY_NB_SECTIONS	3
+/* Greater than the number of entries of the registry */
+#define REGISTRY_NB_NAMES	3000
+
+static const char * const s_registry_blobs[REGISTRY_NB_SECTIONS + 1] = {
+	BLOB_NAME("registry-0"),
+	BLOB_NAME("registry-1"),
+	BLOB_NAME("registry-2"),
+	BLOB_NAME("registry-missing"),
+};
+
+static struct shd_hdr_user_info registry_hdr_info(int i)
+{
+	struct shd_hdr_user_info hdr_info = s_hdr_info;
+
+	hdr_info.max_nb_samples = 10 + i;
+	return hdr_info;
+}
+
+static void create_registry_sections(struct shd_ctx *ctx_prod[])
+{
+	struct shd_sample_metadata metadata = METADATA_INIT;
+	struct shd_hdr_user_info hdr_info;
+	struct prod_blob blob = s_blob;
+	int ret;
+	int i;
+
+	for (i = 0; i < REGISTRY_NB_SECTIONS; i++) {
+		hdr_info = registry_hdr_info(i);
+		ctx_prod[i] = shd_create(s_registry_blobs[i], NULL,
+				&hdr_info, &s_metadata_hdr);
+		CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod[i]);
+
+		blob.i1 = i;
+		metadata.ts.tv_sec = i + 1;
+		ret = shd_write_new_blob(ctx_prod[i], &blob, sizeof(blob),
+				&metadata);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+}
+
+static void close_registry_sections(struct shd_ctx *ctx_prod[])
+{
+	int i;
+
+	for (i = 0; i < REGISTRY_NB_SECTIONS; i++)
+		shd_close(ctx_prod[i], NULL);
+}
+
+static void check_open_many(int nb_from_registry)
+{
+	struct shd_ctx *ctx[REGISTRY_NB_SECTIONS + 1];
+	struct shd_revision *rev[REGISTRY_NB_SECTIONS + 1];
+	struct shd_sample_search search = {
+		.method = SHD_LATEST,
+	};
+	struct shd_quantity_sample qty_sample;
+	int i1;
+	int ret;
+	int i;
+
+	shd_concurrency_clean_hooks();
+	shd_concurrency_set_hook_strategy(HOOK_SECTION_OPEN_FROM_REGISTRY,
+			COUNT_HITS);
+	ret = shd_open_many(s_registry_blobs, REGISTRY_NB_SECTIONS + 1, NULL,
+			ctx, rev);
+	CU_ASSERT_EQUAL(ret, REGISTRY_NB_SECTIONS);
+	CU_ASSERT_PTR_NULL(ctx[REGISTRY_NB_SECTIONS]);
+	CU_ASSERT_EQUAL(shd_concurrency_get_nb_hits(), nb_from_registry);
+	shd_concurrency_clean_hooks();
+
+	for (i = 0; i < REGISTRY_NB_SECTIONS; i++) {
+		CU_ASSERT_PTR_NOT_NULL_FATAL(ctx[i]);
+
+		qty_sample.ptr = &i1;
+		qty_sample.size = sizeof(i1);
+		ret = shd_read_from_sample(ctx[i], 1, &search, &q_s_blob_i1,
+				&qty_sample);
+		CU_ASSERT_EQUAL(ret, 1);
+		CU_ASSERT_EQUAL(i1, i);
+		CU_ASSERT_EQUAL(qty_sample.meta.ts.tv_sec, i + 1);
+		ret = shd_end_read(ctx[i], rev[i]);
+		CU_ASSERT_EQUAL(ret, 0);
+
+		shd_close(ctx[i], rev[i]);
+	}
+}
+
+static void test_registry_list(void)
+{
+	struct shd_ctx *ctx_prod[REGISTRY_NB_SECTIONS];
+	struct shd_section_info *infos;
+	struct shd_hdr_user_info hdr_info;
+	int nb_sections;
+	int nb_found = 0;
+	int ret;
+	int i, j;
+
+	create_registry_sections(ctx_prod);
+
+	nb_sections = shd_list_sections(NULL, 0);
+	CU_ASSERT_TRUE_FATAL(nb_sections >= REGISTRY_NB_SECTIONS);
+
+	infos = calloc(nb_sections, sizeof(*infos));
+	CU_ASSERT_PTR_NOT_NULL_FATAL(infos);
+	ret = shd_list_sections(infos, nb_sections);
+	CU_ASSERT_TRUE(ret >= nb_sections);
+
+	for (i = 0; i < nb_sections; i++) {
+		for (j = 0; j < REGISTRY_NB_SECTIONS; j++) {
+			if (strcmp(infos[i].name, s_registry_blobs[j]))
+				continue;
+			hdr_info = registry_hdr_info(j);
+			CU_ASSERT_EQUAL(infos[i].backend,
+					SHD_SECTION_BACKEND_SHM);
+			CU_ASSERT_EQUAL(infos[i].size,
+				shd_section_get_total_size(&hdr_info, false));
+			CU_ASSERT_EQUAL(infos[i].producer_pid, getpid());
+			CU_ASSERT_TRUE(infos[i].revision > 0);
+			CU_ASSERT_EQUAL(infos[i].revision % 2, 0);
+			CU_ASSERT_EQUAL(memcmp(&infos[i].hdr_info, &hdr_info,
+					sizeof(hdr_info)), 0);
+			nb_found++;
+		}
+	}
+	CU_ASSERT_EQUAL(nb_found, REGISTRY_NB_SECTIONS);
+
+	free(infos);
+	close_registry_sections(ctx_prod);
+
+	/* Closed sections are not listed anymore */
+	CU_ASSERT_EQUAL(shd_list_sections(NULL, 0), nb_sections
+			- REGISTRY_NB_SECTIONS);
+}
+
+static void test_registry_list_tracked(void)
+{
+	struct shd_ctx *ctx_prod;
+	struct shd_section_info info;
+	struct shd_registry *reg;
+	int ret;
+
+	ctx_prod = shd_create_tracked(BLOB_NAME("registry-tracked"), NULL,
+			&s_hdr_info, &s_metadata_hdr, &q_s_blob_i1, 1);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+
+	/* The recorded size accounts for the dirty map */
+	reg = shd_registry_open();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(reg);
+	ret = shd_registry_find(reg, BLOB_NAME("registry-tracked"), &info);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(info.size,
+			shd_section_get_total_size(&s_hdr_info, true));
+	shd_registry_close(reg);
+
+	shd_close(ctx_prod, NULL);
+}
+
+static void test_registry_list_dead_producer(void)
+{
+	struct shd_ctx *ctx_prod;
+	int nb_sections;
+	int status;
+	pid_t pid;
+
+	nb_sections = shd_list_sections(NULL, 0);
+
+	/* The producer is gone without closing its section */
+	pid = fork();
+	CU_ASSERT_TRUE_FATAL(pid >= 0);
+	if (pid == 0) {
+		ctx_prod = shd_create(BLOB_NAME("registry-dead"), NULL,
+				&s_hdr_info, &s_metadata_hdr);
+		_exit(ctx_prod != NULL ? 0 : 1);
+	}
+	CU_ASSERT_EQUAL(waitpid(pid, &status, 0), pid);
+	CU_ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+	CU_ASSERT_EQUAL(shd_list_sections(NULL, 0), nb_sections);
+
+	/* Its entry is taken over by the next producer */
+	ctx_prod = shd_create(BLOB_NAME("registry-dead"), NULL,
+			&s_hdr_info, &s_metadata_hdr);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+	CU_ASSERT_EQUAL(shd_list_sections(NULL, 0), nb_sections + 1);
+	shd_close(ctx_prod, NULL);
+	CU_ASSERT_EQUAL(shd_list_sections(NULL, 0), nb_sections);
+}
+
+static void test_registry_reclaim(void)
+{
+	struct shd_section_id id;
+	char blob_name[NAME_MAX];
+	int ret;
+	int i;
+
+	memset(&id, 0, sizeof(id));
+
+	/* Entries of removed sections are reused */
+	for (i = 0; i < REGISTRY_NB_NAMES; i++) {
+		snprintf(blob_name, sizeof(blob_name),
+				BLOB_NAME("registry-reclaim-%d"), i);
+		ret = shd_registry_add(blob_name, &id, &s_hdr_info,
+				shd_section_get_total_size(&s_hdr_info, false),
+				i * 2);
+		CU_ASSERT_EQUAL_FATAL(ret, 0);
+		ret = shd_registry_remove(blob_name, i * 2);
+		CU_ASSERT_EQUAL_FATAL(ret, 0);
+	}
+
+	/* Only the entry of the matching revision is removed */
+	ret = shd_registry_add(blob_name, &id, &s_hdr_info,
+			shd_section_get_total_size(&s_hdr_info, false), 4);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(shd_registry_remove(blob_name, 2), -ENOENT);
+	CU_ASSERT_EQUAL(shd_registry_remove(blob_name, 4), 0);
+	CU_ASSERT_EQUAL(shd_registry_remove(blob_name, 4), -ENOENT);
+}
+
+static void test_registry_open_many(void)
+{
+	struct shd_ctx *ctx_prod[REGISTRY_NB_SECTIONS];
+
+	create_registry_sections(ctx_prod);
+	check_open_many(REGISTRY_NB_SECTIONS);
+	close_registry_sections(ctx_prod);
+}
+
+static void test_registry_open_many_out_of_date(void)
+{
+	struct shd_ctx *ctx_prod[REGISTRY_NB_SECTIONS];
+	struct shd_section_id id;
+	struct shd_hdr_user_info hdr_info = registry_hdr_info(0);
+	int ret;
+
+	create_registry_sections(ctx_prod);
+
+	/* The registry entry of the first section does not match the section
+	 * anymore : it should be open the usual way */
+	memset(&id, 0, sizeof(id));
+	hdr_info.max_nb_samples = 100;
+	ret = shd_registry_add(s_registry_blobs[0], &id, &hdr_info,
+			shd_section_get_total_size(&hdr_info, false), 2);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	check_open_many(REGISTRY_NB_SECTIONS - 1);
+	close_registry_sections(ctx_prod);
+}
+
+static void test_registry_open_many_invalid(void)
+{
+	struct shd_ctx *ctx[1];
+	struct shd_revision *rev[1];
+
+	CU_ASSERT_EQUAL(shd_open_many(NULL, 1, NULL, ctx, rev), -EINVAL);
+	CU_ASSERT_EQUAL(shd_open_many(s_registry_blobs, 1, NULL, NULL, rev),
+			-EINVAL);
+	CU_ASSERT_EQUAL(shd_open_many(s_registry_blobs, 1, NULL, ctx, NULL),
+			-EINVAL);
+	CU_ASSERT_EQUAL(shd_open_many(s_registry_blobs, 0, NULL, ctx, rev),
+			0);
+}
+
+CU_TestInfo s_registry_tests[] = {
+	{(char *)"list registered sections",
+			&test_registry_list},
+	{(char *)"list registered sections holding a dirty map",
+			&test_registry_list_tracked},
+	{(char *)"do not list sections of a dead producer",
+			&test_registry_list_dead_producer},
+	{(char *)"reuse the entries of removed sections",
+			&test_registry_reclaim},
+	{(char *)"open many sections",
+			&test_registry_open_many},
+	{(char *)"open many sections with out of date registry",
+			&test_registry_open_many_out_of_date},
+	{(char *)"open many sections with invalid arguments",
+			&test_registry_open_many_invalid},
+	CU_TEST_INFO_NULL,
+};
@@ -0,0 +1,271 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_test_schema.c
+ *
+ * @brief Blob schema unit tests.
+ *
+ */
+
+#define SHD_ADVANCED_READ_API
+#include "shd_test.h"
+#include "shd_test_helper.h"
+
+static const struct shd_field_desc s_blob_fields[] = {
+	{ "i1", SHD_FIELD_INT32, offsetof(struct prod_blob, i1), 1 },
+	{ "f1", SHD_FIELD_FLOAT, offsetof(struct prod_blob, f1), 1 },
+	{ "imu.acc", SHD_FIELD_DOUBLE, offsetof(struct prod_blob, acc), 3 },
+	{ "imu.angles.rho", SHD_FIELD_DOUBLE,
+			offsetof(struct prod_blob, angles.rho), 1 },
+	{ "imu.angles.phi", SHD_FIELD_DOUBLE,
+			offsetof(struct prod_blob, angles.phi), 1 },
+	{ "imu.angles.theta", SHD_FIELD_DOUBLE,
+			offsetof(struct prod_blob, angles.theta), 1 },
+};
+
+#define NB_BLOB_FIELDS (sizeof(s_blob_fields) / sizeof(s_blob_fields[0]))
+
+static struct shd_ctx *create_schema_section(const char *blob_name,
+					const struct shd_field_desc fields[],
+					size_t nb_fields)
+{
+	struct shd_hdr_user_info hdr_info = s_hdr_info;
+	struct shd_sample_metadata metadata = METADATA_INIT;
+	struct shd_ctx *ctx;
+	void *mdata;
+	int ret;
+
+	hdr_info.blob_metadata_hdr_size = shd_blob_schema_get_size(
+			sizeof(s_metadata_hdr), fields, nb_fields);
+	CU_ASSERT_NOT_EQUAL_FATAL(hdr_info.blob_metadata_hdr_size, 0);
+
+	mdata = malloc(hdr_info.blob_metadata_hdr_size);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(mdata);
+	ret = shd_blob_schema_write(mdata, hdr_info.blob_metadata_hdr_size,
+			&s_metadata_hdr, sizeof(s_metadata_hdr),
+			fields, nb_fields);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	ctx = shd_create(blob_name, NULL, &hdr_info, mdata);
+	free(mdata);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx);
+
+	ret = shd_write_new_blob(ctx, &s_blob, sizeof(s_blob), &metadata);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	return ctx;
+}
+
+static void test_schema_resolve(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_quantity_info info;
+	struct shd_sample_search search = {
+		.method = SHD_LATEST,
+	};
+	struct shd_sample_metadata *metadata;
+	struct shd_search_result result;
+	struct acceleration acc;
+	int ret;
+
+	ctx_prod = create_schema_section(BLOB_NAME("schema-resolve"),
+			s_blob_fields, NB_BLOB_FIELDS);
+	ctx_cons = shd_open(BLOB_NAME("schema-resolve"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	ret = shd_quantity_resolve(ctx_cons, "i1", &info, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(info.quantity.quantity_offset,
+			q_s_blob_i1.quantity_offset);
+	CU_ASSERT_EQUAL(info.quantity.quantity_size,
+			q_s_blob_i1.quantity_size);
+	CU_ASSERT_EQUAL(info.type, SHD_FIELD_INT32);
+	CU_ASSERT_EQUAL(info.count, 1);
+
+	/* Array field */
+	ret = shd_quantity_resolve(ctx_cons, "imu.acc", &info, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(info.quantity.quantity_offset,
+			q_s_blob_acc.quantity_offset);
+	CU_ASSERT_EQUAL(info.quantity.quantity_size,
+			q_s_blob_acc.quantity_size);
+	CU_ASSERT_EQUAL(info.type, SHD_FIELD_DOUBLE);
+	CU_ASSERT_EQUAL(info.count, 3);
+
+	/* The resolved quantity is used as is by read functions */
+	ret = shd_select_samples(ctx_cons, &search, &metadata, &result);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_read_quantity(ctx_cons, &info.quantity, &acc, sizeof(acc));
+	CU_ASSERT_EQUAL(ret, 1);
+	CU_ASSERT_EQUAL(memcmp(&acc, &s_blob.acc, sizeof(acc)), 0);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* Group of nested fields */
+	ret = shd_quantity_resolve(ctx_cons, "imu.angles", &info, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(info.quantity.quantity_offset,
+			q_s_blob_angles.quantity_offset);
+	CU_ASSERT_EQUAL(info.quantity.quantity_size,
+			q_s_blob_angles.quantity_size);
+	CU_ASSERT_EQUAL(info.type, SHD_FIELD_GROUP);
+
+	ret = shd_quantity_resolve(ctx_cons, "imu", &info, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(info.quantity.quantity_offset,
+			q_s_blob_acc.quantity_offset);
+	CU_ASSERT_EQUAL(info.quantity.quantity_size,
+			offsetof(struct prod_blob, angles)
+			+ sizeof(struct angles)
+			- offsetof(struct prod_blob, acc));
+
+	/* Names are only matched as a whole, or up to a dot separator */
+	ret = shd_quantity_resolve(ctx_cons, "imu.ang", &info, rev);
+	CU_ASSERT_EQUAL(ret, -ENOENT);
+	ret = shd_quantity_resolve(ctx_cons, "li1", &info, rev);
+	CU_ASSERT_EQUAL(ret, -ENOENT);
+
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+static void test_schema_user_mdata(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_hdr_user_info hdr_info;
+	struct blob_metadata_hdr *mdata;
+	int ret;
+
+	ctx_prod = create_schema_section(BLOB_NAME("schema-user-mdata"),
+			s_blob_fields, NB_BLOB_FIELDS);
+	ctx_cons = shd_open(BLOB_NAME("schema-user-mdata"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	/* User metadata stays at the start of the blob metadata header */
+	ret = shd_read_section_hdr(ctx_cons, &hdr_info, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_TRUE(hdr_info.blob_metadata_hdr_size
+			> sizeof(s_metadata_hdr));
+	mdata = malloc(hdr_info.blob_metadata_hdr_size);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(mdata);
+	ret = shd_read_blob_metadata_hdr(ctx_cons, mdata,
+			hdr_info.blob_metadata_hdr_size, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(memcmp(mdata, &s_metadata_hdr,
+			sizeof(s_metadata_hdr)), 0);
+	free(mdata);
+
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+static void test_schema_missing(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_quantity_info info;
+	int ret;
+
+	ctx_prod = shd_create(BLOB_NAME("schema-missing"), NULL, &s_hdr_info,
+			&s_metadata_hdr);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_prod);
+	ctx_cons = shd_open(BLOB_NAME("schema-missing"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	ret = shd_quantity_resolve(ctx_cons, "i1", &info, rev);
+	CU_ASSERT_EQUAL(ret, -ENODATA);
+
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+static void test_schema_invalid(void)
+{
+	struct shd_field_desc fields[] = {
+		{ "i1", SHD_FIELD_INT32, offsetof(struct prod_blob, i1), 1 },
+	};
+	struct shd_field_desc past_end[] = {
+		{ "i1", SHD_FIELD_INT32, sizeof(struct prod_blob), 1 },
+	};
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_quantity_info info;
+	char mdata[256];
+	size_t size;
+	int ret;
+
+	/* Invalid field descriptions */
+	size = shd_blob_schema_get_size(0, fields, 1);
+	CU_ASSERT_NOT_EQUAL(size, 0);
+	CU_ASSERT_EQUAL(shd_blob_schema_get_size(0, fields, 0), 0);
+	CU_ASSERT_EQUAL(shd_blob_schema_get_size(0, NULL, 1), 0);
+	fields[0].count = 0;
+	CU_ASSERT_EQUAL(shd_blob_schema_get_size(0, fields, 1), 0);
+	fields[0].count = 1;
+	fields[0].type = SHD_FIELD_GROUP;
+	CU_ASSERT_EQUAL(shd_blob_schema_get_size(0, fields, 1), 0);
+	fields[0].type = SHD_FIELD_INT32;
+	fields[0].name = "";
+	CU_ASSERT_EQUAL(shd_blob_schema_get_size(0, fields, 1), 0);
+	fields[0].name = "i1";
+
+	ret = shd_blob_schema_write(mdata, size - 1, NULL, 0, fields, 1);
+	CU_ASSERT_EQUAL(ret, -ENOMEM);
+	ret = shd_blob_schema_write(NULL, size, NULL, 0, fields, 1);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_blob_schema_write(mdata, size, NULL, 4, fields, 1);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	/* Field which does not fit in the blob */
+	ctx_prod = create_schema_section(BLOB_NAME("schema-invalid"),
+			past_end, 1);
+	ctx_cons = shd_open(BLOB_NAME("schema-invalid"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	ret = shd_quantity_resolve(ctx_cons, "i1", &info, rev);
+	CU_ASSERT_EQUAL(ret, -EPROTO);
+	ret = shd_quantity_resolve(ctx_cons, NULL, &info, rev);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_quantity_resolve(ctx_cons, "i1", NULL, rev);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+CU_TestInfo s_schema_tests[] = {
+	{(char *)"resolve quantities by name",
+			&test_schema_resolve},
+	{(char *)"keep user metadata along with schema",
+			&test_schema_user_mdata},
+	{(char *)"resolve quantities without schema",
+			&test_schema_missing},
+	{(char *)"invalid schemas",
+			&test_schema_invalid},
+	CU_TEST_INFO_NULL,
+};
@@ -0,0 +1,336 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_test_sub.c
+ *
+ * @brief Subscription unit tests.
+ *
+ */
+
+#include "shd_test.h"
+#include "shd_test_helper.h"
+
+#define NB_SUB_SLOTS 16
+#define NB_SUB_MAX 32
+
+/* Date of the next sample written */
+static int s_sub_sec;
+
+struct sub_blob {
+	float f;
+	uint32_t flags;
+	uint8_t bytes[3];
+};
+
+static const struct shd_quantity_info s_sub_f = {
+	{ offsetof(struct sub_blob, f), sizeof(float) }, SHD_FIELD_FLOAT, 1
+};
+static const struct shd_quantity_info s_sub_flags = {
+	{ offsetof(struct sub_blob, flags), sizeof(uint32_t) },
+	SHD_FIELD_UINT32, 1
+};
+static const struct shd_quantity_info s_sub_bytes = {
+	{ offsetof(struct sub_blob, bytes), 3 }, SHD_FIELD_BYTES, 3
+};
+
+static struct shd_ctx *create_sub_section(const char *blob_name)
+{
+	s_sub_sec = 0;
+
+	return create_test_section(blob_name, sizeof(struct sub_blob),
+			NB_SUB_SLOTS, NULL, 0, NULL, 0);
+}
+
+static void write_sub_blob(struct shd_ctx *ctx, float f, uint32_t flags,
+				uint8_t byte)
+{
+	struct sub_blob blob = {
+		.f = f,
+		.flags = flags,
+		.bytes = { 0, byte, 0 },
+	};
+
+	write_test_samples(ctx, &blob, sizeof(blob), NULL, s_sub_sec,
+			s_sub_sec);
+	s_sub_sec++;
+}
+
+/* Point each sample to its element of values */
+static void init_samples(struct shd_quantity_sample samples[], void *values,
+				size_t size, size_t nb)
+{
+	size_t i;
+
+	for (i = 0; i < nb; i++) {
+		samples[i].ptr = (char *)values + i * size;
+		samples[i].size = size;
+	}
+}
+
+static void test_sub_changed(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_sub_info info = {
+		.quantity = s_sub_flags,
+		.mode = SHD_SUB_CHANGED,
+	};
+	struct shd_sub *sub, *sub_mask, *sub_bytes;
+	struct shd_quantity_sample samples[NB_SUB_MAX];
+	uint32_t flags[NB_SUB_MAX];
+	uint8_t bytes[NB_SUB_MAX][3];
+	int ret;
+
+	ctx_prod = create_sub_section(BLOB_NAME("sub-changed"));
+	ctx_cons = shd_open(BLOB_NAME("sub-changed"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+	init_samples(samples, flags, sizeof(flags[0]), NB_SUB_MAX);
+
+	sub = shd_subscribe(ctx_cons, &info);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(sub);
+	info.mask = 0x2;
+	sub_mask = shd_subscribe(ctx_cons, &info);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(sub_mask);
+	info.quantity = s_sub_bytes;
+	info.mask = 0;
+	sub_bytes = shd_subscribe(ctx_cons, &info);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(sub_bytes);
+
+	/* Nothing was written yet */
+	ret = shd_sub_read(sub, samples, NB_SUB_MAX);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* The first sample read is always reported */
+	write_sub_blob(ctx_prod, 0, 0, 0);
+	write_sub_blob(ctx_prod, 0, 0, 0);
+	ret = shd_sub_read(sub, samples, NB_SUB_MAX);
+	CU_ASSERT_EQUAL(ret, 1);
+	CU_ASSERT_EQUAL(flags[0], 0);
+	CU_ASSERT_EQUAL(samples[0].meta.ts.tv_sec, 1);
+	ret = shd_sub_read(sub_mask, samples, NB_SUB_MAX);
+	CU_ASSERT_EQUAL(ret, 1);
+	init_samples(samples, bytes, sizeof(bytes[0]), NB_SUB_MAX);
+	ret = shd_sub_read(sub_bytes, samples, NB_SUB_MAX);
+	CU_ASSERT_EQUAL(ret, 1);
+	init_samples(samples, flags, sizeof(flags[0]), NB_SUB_MAX);
+
+	/* Only changes are reported */
+	write_sub_blob(ctx_prod, 0, 0, 0);
+	write_sub_blob(ctx_prod, 0, 1, 0);
+	write_sub_blob(ctx_prod, 0, 1, 7);
+	write_sub_blob(ctx_prod, 0, 3, 7);
+	write_sub_blob(ctx_prod, 0, 3, 7);
+	write_sub_blob(ctx_prod, 0, 1, 0);
+	ret = shd_sub_read(sub, samples, NB_SUB_MAX);
+	CU_ASSERT_EQUAL(ret, 3);
+	CU_ASSERT_EQUAL(flags[0], 1);
+	CU_ASSERT_EQUAL(flags[1], 3);
+	CU_ASSERT_EQUAL(flags[2], 1);
+	CU_ASSERT_EQUAL(samples[0].meta.ts.tv_sec, 3);
+	ret = shd_sub_read(sub, samples, NB_SUB_MAX);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* Only changes of the masked bits are reported */
+	ret = shd_sub_read(sub_mask, samples, NB_SUB_MAX);
+	CU_ASSERT_EQUAL(ret, 2);
+	CU_ASSERT_EQUAL(flags[0], 3);
+	CU_ASSERT_EQUAL(flags[1], 1);
+
+	/* Quantities which are not integers are compared as a whole */
+	init_samples(samples, bytes, sizeof(bytes[0]), NB_SUB_MAX);
+	ret = shd_sub_read(sub_bytes, samples, NB_SUB_MAX);
+	CU_ASSERT_EQUAL(ret, 2);
+	CU_ASSERT_EQUAL(bytes[0][1], 7);
+	CU_ASSERT_EQUAL(bytes[1][1], 0);
+	init_samples(samples, flags, sizeof(flags[0]), NB_SUB_MAX);
+
+	/* Reads resume after the last reported sample */
+	write_sub_blob(ctx_prod, 0, 10, 0);
+	write_sub_blob(ctx_prod, 0, 11, 0);
+	write_sub_blob(ctx_prod, 0, 12, 0);
+	ret = shd_sub_read(sub, samples, 2);
+	CU_ASSERT_EQUAL(ret, 2);
+	CU_ASSERT_EQUAL(flags[0], 10);
+	CU_ASSERT_EQUAL(flags[1], 11);
+	ret = shd_sub_read(sub, samples, 2);
+	CU_ASSERT_EQUAL(ret, 1);
+	CU_ASSERT_EQUAL(flags[0], 12);
+
+	ret = shd_unsubscribe(sub);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_unsubscribe(sub_mask);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_unsubscribe(sub_bytes);
+	CU_ASSERT_EQUAL(ret, 0);
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+static void test_sub_deadband(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_sub_info info = {
+		.quantity = s_sub_f,
+		.mode = SHD_SUB_DEADBAND,
+		.deadband = 1.0,
+	};
+	struct shd_sub *sub;
+	struct shd_quantity_sample samples[NB_SUB_MAX];
+	float f[NB_SUB_MAX];
+	int k;
+	int ret;
+
+	ctx_prod = create_sub_section(BLOB_NAME("sub-deadband"));
+	ctx_cons = shd_open(BLOB_NAME("sub-deadband"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+	init_samples(samples, f, sizeof(f[0]), NB_SUB_MAX);
+
+	sub = shd_subscribe(ctx_cons, &info);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(sub);
+
+	write_sub_blob(ctx_prod, 0, 0, 0);
+	ret = shd_sub_read(sub, samples, NB_SUB_MAX);
+	CU_ASSERT_EQUAL(ret, 1);
+
+	/* Values are compared to the last reported one */
+	write_sub_blob(ctx_prod, 0.5, 0, 0);
+	write_sub_blob(ctx_prod, 1.25, 0, 0);
+	write_sub_blob(ctx_prod, 1.5, 0, 0);
+	write_sub_blob(ctx_prod, 2.5, 0, 0);
+	write_sub_blob(ctx_prod, 2, 0, 0);
+	write_sub_blob(ctx_prod, 1.25, 0, 0);
+	ret = shd_sub_read(sub, samples, NB_SUB_MAX);
+	CU_ASSERT_EQUAL(ret, 3);
+	CU_ASSERT_DOUBLE_EQUAL(f[0], 1.25, DOUBLE_PRECISION);
+	CU_ASSERT_DOUBLE_EQUAL(f[1], 2.5, DOUBLE_PRECISION);
+	CU_ASSERT_DOUBLE_EQUAL(f[2], 1.25, DOUBLE_PRECISION);
+
+	/* The scan wraps around the end of the section */
+	for (k = 0; k < NB_SUB_SLOTS - 4; k++)
+		write_sub_blob(ctx_prod, 10 + 2 * k, 0, 0);
+	ret = shd_sub_read(sub, samples, NB_SUB_MAX);
+	CU_ASSERT_EQUAL(ret, NB_SUB_SLOTS - 4);
+	CU_ASSERT_DOUBLE_EQUAL(f[NB_SUB_SLOTS - 5], 2 * NB_SUB_SLOTS,
+			DOUBLE_PRECISION);
+
+	/* The scan resumes from the oldest sample if the producer lapped the
+	 * subscription : the slot after the latest sample is skipped */
+	for (k = 0; k < 2 * NB_SUB_SLOTS; k++)
+		write_sub_blob(ctx_prod, 100 + 2 * k, 0, 0);
+	ret = shd_sub_read(sub, samples, NB_SUB_MAX);
+	CU_ASSERT_EQUAL(ret, NB_SUB_SLOTS - 1);
+	CU_ASSERT_DOUBLE_EQUAL(f[0], 100 + 2 * (NB_SUB_SLOTS + 1),
+			DOUBLE_PRECISION);
+	CU_ASSERT_DOUBLE_EQUAL(f[NB_SUB_SLOTS - 2],
+			100 + 2 * (2 * NB_SUB_SLOTS - 1), DOUBLE_PRECISION);
+
+	ret = shd_unsubscribe(sub);
+	CU_ASSERT_EQUAL(ret, 0);
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+static void test_sub_invalid(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_sub_info info = {
+		.quantity = s_sub_f,
+		.mode = SHD_SUB_DEADBAND,
+		.deadband = -1.0,
+	};
+	struct shd_sub *sub;
+	struct shd_quantity_sample samples[1];
+	uint16_t small;
+	float f;
+	int ret;
+
+	ctx_prod = create_sub_section(BLOB_NAME("sub-invalid"));
+	ctx_cons = shd_open(BLOB_NAME("sub-invalid"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	/* Negative deadband */
+	sub = shd_subscribe(ctx_cons, &info);
+	CU_ASSERT_PTR_NULL(sub);
+	/* Deadband on a non-numeric quantity */
+	info.deadband = 1.0;
+	info.quantity = s_sub_bytes;
+	sub = shd_subscribe(ctx_cons, &info);
+	CU_ASSERT_PTR_NULL(sub);
+	/* Mask on a non-integer quantity */
+	info.mode = SHD_SUB_CHANGED;
+	info.quantity = s_sub_f;
+	info.mask = 1;
+	sub = shd_subscribe(ctx_cons, &info);
+	CU_ASSERT_PTR_NULL(sub);
+	/* Out of the blob */
+	info.mask = 0;
+	info.quantity.quantity.quantity_offset = sizeof(struct sub_blob);
+	sub = shd_subscribe(ctx_cons, &info);
+	CU_ASSERT_PTR_NULL(sub);
+	/* Unknown mode */
+	info.quantity = s_sub_f;
+	info.mode = (enum shd_sub_mode)42;
+	sub = shd_subscribe(ctx_cons, &info);
+	CU_ASSERT_PTR_NULL(sub);
+	sub = shd_subscribe(NULL, &info);
+	CU_ASSERT_PTR_NULL(sub);
+	sub = shd_subscribe(ctx_cons, NULL);
+	CU_ASSERT_PTR_NULL(sub);
+
+	info.mode = SHD_SUB_CHANGED;
+	sub = shd_subscribe(ctx_cons, &info);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(sub);
+
+	samples[0].ptr = &f;
+	samples[0].size = sizeof(f);
+	ret = shd_sub_read(NULL, samples, 1);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_sub_read(sub, NULL, 1);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_sub_read(sub, samples, 0);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	/* Buffer too small for the quantity */
+	samples[0].ptr = &small;
+	samples[0].size = sizeof(small);
+	ret = shd_sub_read(sub, samples, 1);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	ret = shd_unsubscribe(sub);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_unsubscribe(NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+CU_TestInfo s_sub_tests[] = {
+	{(char *)"report changes", &test_sub_changed},
+	{(char *)"report moves beyond a deadband", &test_sub_deadband},
+	{(char *)"invalid arguments", &test_sub_invalid},
+	CU_TEST_INFO_NULL,
+};
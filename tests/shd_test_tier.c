@@ -0,0 +1,311 @@
+/**
+ * Copyright (c) 2015 Parrot S.A.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT COMPANY BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file shd_test_tier.c
+ *
+ * @brief Downsampled tiers unit tests.
+ *
+ */
+
+#define SHD_ADVANCED_READ_API
+#include "shd_test.h"
+#include "shd_test_helper.h"
+
+#define NB_TIER_SAMPLES 40
+
+struct tier_blob {
+	int32_t i;
+	float f;
+	/* not described in the schema */
+	uint8_t tag;
+};
+
+static const struct shd_field_desc s_tier_fields[] = {
+	{ "i", SHD_FIELD_INT32, offsetof(struct tier_blob, i), 1 },
+	{ "f", SHD_FIELD_FLOAT, offsetof(struct tier_blob, f), 1 },
+};
+
+#define NB_TIER_FIELDS (sizeof(s_tier_fields) / sizeof(s_tier_fields[0]))
+
+static const struct shd_tier_info s_tiers[] = {
+	{ .factor = 4, .max_nb_samples = 8 },
+	{ .factor = 16, .max_nb_samples = 4 },
+};
+
+static const struct shd_quantity q_i = {
+	offsetof(struct tier_blob, i), sizeof(int32_t)
+};
+static const struct shd_quantity q_f = {
+	offsetof(struct tier_blob, f), sizeof(float)
+};
+
+static void fill_tier_blob(void *p, int k)
+{
+	struct tier_blob *blob = p;
+
+	blob->i = k;
+	blob->f = k * 0.5f;
+	blob->tag = k;
+}
+
+static struct shd_ctx *create_tiered_section(const char *blob_name)
+{
+	return create_test_section(blob_name, sizeof(struct tier_blob), 8,
+			s_tier_fields, NB_TIER_FIELDS, s_tiers, 2);
+}
+
+/* One sample per second, ts[k] being the date of the k-th one */
+static void write_tier_samples(struct shd_ctx *ctx, struct timespec ts[])
+{
+	struct tier_blob blob;
+	int k;
+
+	write_test_samples(ctx, &blob, sizeof(blob), fill_tier_blob, 0,
+			NB_TIER_SAMPLES - 1);
+	for (k = 0; k < NB_TIER_SAMPLES; k++) {
+		ts[k].tv_sec = k;
+		ts[k].tv_nsec = 0;
+	}
+}
+
+static void test_tier_aggregate(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_sample_metadata *metadata;
+	struct shd_search_result result;
+	struct shd_sample_search search = {
+		.method = SHD_CLOSEST,
+	};
+	struct timespec ts[NB_TIER_SAMPLES];
+	struct timespec tier_ts;
+	struct shd_quantity_info info;
+	struct shd_aggregate agg;
+	struct shd_quantity q;
+	struct tier_blob blob;
+	int32_t i;
+	float f;
+	int ret;
+
+	ctx_prod = create_tiered_section(BLOB_NAME("tier-aggregate"));
+	ctx_cons = shd_open(BLOB_NAME("tier-aggregate"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	write_tier_samples(ctx_prod, ts);
+
+	/* Recent samples are read from the section itself */
+	search.date = ts[NB_TIER_SAMPLES - 2];
+	ret = shd_select_samples(ctx_cons, &search, &metadata, &result);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(shd_get_read_factor(ctx_cons), 1);
+	ret = shd_tier_quantity(ctx_cons, &q_i, SHD_TIER_MAX, &q);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(q.quantity_offset, q_i.quantity_offset);
+	ret = shd_read_quantity(ctx_cons, &q, &i, sizeof(i));
+	CU_ASSERT_EQUAL(ret, 1);
+	CU_ASSERT_EQUAL(i, NB_TIER_SAMPLES - 2);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* The first tier holds the 8 latest buckets of 4 samples */
+	search.date = ts[20];
+	ret = shd_select_samples(ctx_cons, &search, &metadata, &result);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(result.nb_matches, 1);
+	CU_ASSERT_EQUAL(shd_get_read_factor(ctx_cons), 4);
+	tier_ts = metadata->ts;
+	CU_ASSERT_TRUE(time_is_equal(&tier_ts, &ts[20]));
+	tier_ts = metadata->exp;
+	CU_ASSERT_TRUE(time_is_equal(&tier_ts, &ts[23]));
+
+	ret = shd_tier_quantity(ctx_cons, &q_i, SHD_TIER_MEAN, &q);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_read_quantity(ctx_cons, &q, &i, sizeof(i));
+	CU_ASSERT_EQUAL(ret, 1);
+	/* 21.5, rounded to nearest */
+	CU_ASSERT_EQUAL(i, 22);
+	ret = shd_tier_quantity(ctx_cons, &q_i, SHD_TIER_MIN, &q);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_read_quantity(ctx_cons, &q, &i, sizeof(i));
+	CU_ASSERT_EQUAL(ret, 1);
+	CU_ASSERT_EQUAL(i, 20);
+	ret = shd_tier_quantity(ctx_cons, &q_i, SHD_TIER_MAX, &q);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_read_quantity(ctx_cons, &q, &i, sizeof(i));
+	CU_ASSERT_EQUAL(ret, 1);
+	CU_ASSERT_EQUAL(i, 23);
+	ret = shd_tier_quantity(ctx_cons, &q_f, SHD_TIER_MEAN, &q);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_read_quantity(ctx_cons, &q, &f, sizeof(f));
+	CU_ASSERT_EQUAL(ret, 1);
+	CU_ASSERT_DOUBLE_EQUAL(f, 10.75, FLOAT_PRECISION);
+
+	/* The whole blob is the mean, other bytes being the latest ones */
+	ret = shd_read_quantity(ctx_cons, NULL, &blob, sizeof(blob));
+	CU_ASSERT_EQUAL(ret, 1);
+	CU_ASSERT_EQUAL(blob.i, 22);
+	CU_ASSERT_EQUAL(blob.tag, 23);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(shd_get_read_factor(ctx_cons), 1);
+
+	/* Older dates are only covered by the second tier */
+	search.date = ts[5];
+	ret = shd_select_samples(ctx_cons, &search, &metadata, &result);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(shd_get_read_factor(ctx_cons), 16);
+	tier_ts = metadata->ts;
+	CU_ASSERT_TRUE(time_is_equal(&tier_ts, &ts[0]));
+	ret = shd_tier_quantity(ctx_cons, &q_i, SHD_TIER_MAX, &q);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = shd_read_quantity(ctx_cons, &q, &i, sizeof(i));
+	CU_ASSERT_EQUAL(ret, 1);
+	CU_ASSERT_EQUAL(i, 15);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* Aggregates over tier samples keep the extrema of their buckets */
+	ret = shd_quantity_resolve(ctx_cons, "i", &info, rev);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	search.date = ts[20];
+	search.nb_values_before_date = 1;
+	ret = shd_aggregate(ctx_cons, &search, NULL, &info, &agg);
+	CU_ASSERT_EQUAL(ret, 2);
+	CU_ASSERT_EQUAL(shd_get_read_factor(ctx_cons), 4);
+	CU_ASSERT_DOUBLE_EQUAL(agg.min, 16, FLOAT_PRECISION);
+	CU_ASSERT_DOUBLE_EQUAL(agg.max, 23, FLOAT_PRECISION);
+	/* Means of 18 and 22, rounded to nearest */
+	CU_ASSERT_DOUBLE_EQUAL(agg.mean, 20, FLOAT_PRECISION);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* Windows which do not fit in any tier are searched in the section */
+	search.date = ts[5];
+	search.nb_values_before_date = 10;
+	ret = shd_select_samples(ctx_cons, &search, &metadata, &result);
+	CU_ASSERT_EQUAL(shd_get_read_factor(ctx_cons), 1);
+	ret = shd_end_read(ctx_cons, rev);
+
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+static void test_tier_decimate(void)
+{
+	struct shd_ctx *ctx_prod, *ctx_cons;
+	struct shd_revision *rev;
+	struct shd_sample_metadata *metadata;
+	struct shd_search_result result;
+	struct shd_sample_search search = {
+		.method = SHD_CLOSEST,
+	};
+	struct timespec ts[NB_TIER_SAMPLES];
+	struct tier_blob blob;
+	int ret;
+
+	/* Without blob schema, tier samples hold the last sample of their
+	 * bucket */
+	ctx_prod = create_test_section(BLOB_NAME("tier-decimate"),
+			sizeof(struct tier_blob), 8, NULL, 0, s_tiers, 1);
+	ctx_cons = shd_open(BLOB_NAME("tier-decimate"), NULL, &rev);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx_cons);
+
+	write_tier_samples(ctx_prod, ts);
+
+	search.date = ts[20];
+	ret = shd_select_samples(ctx_cons, &search, &metadata, &result);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(shd_get_read_factor(ctx_cons), 4);
+	ret = shd_read_quantity(ctx_cons, NULL, &blob, sizeof(blob));
+	CU_ASSERT_EQUAL(ret, 1);
+	CU_ASSERT_EQUAL(blob.i, 23);
+	CU_ASSERT_EQUAL(blob.tag, 23);
+	ret = shd_end_read(ctx_cons, rev);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	shd_close(ctx_cons, rev);
+	shd_close(ctx_prod, NULL);
+}
+
+static void test_tier_invalid(void)
+{
+	struct shd_ctx *ctx;
+	struct shd_quantity q;
+	struct shd_tier_info tiers[SHD_MAX_TIERS + 1] = {
+		{ .factor = 2, .max_nb_samples = 4 },
+		{ .factor = 4, .max_nb_samples = 4 },
+		{ .factor = 8, .max_nb_samples = 4 },
+		{ .factor = 16, .max_nb_samples = 4 },
+		{ .factor = 32, .max_nb_samples = 4 },
+	};
+	int ret;
+
+	ctx = shd_create_tiered(BLOB_NAME("tier-invalid"), NULL, &s_hdr_info,
+			&s_metadata_hdr, NULL, 1);
+	CU_ASSERT_PTR_NULL(ctx);
+	ctx = shd_create_tiered(BLOB_NAME("tier-invalid"), NULL, &s_hdr_info,
+			&s_metadata_hdr, tiers, 0);
+	CU_ASSERT_PTR_NULL(ctx);
+	ctx = shd_create_tiered(BLOB_NAME("tier-invalid"), NULL, &s_hdr_info,
+			&s_metadata_hdr, tiers, SHD_MAX_TIERS + 1);
+	CU_ASSERT_PTR_NULL(ctx);
+
+	/* Factors must increase */
+	tiers[1].factor = 2;
+	ctx = shd_create_tiered(BLOB_NAME("tier-invalid"), NULL, &s_hdr_info,
+			&s_metadata_hdr, tiers, 2);
+	CU_ASSERT_PTR_NULL(ctx);
+	tiers[0].factor = 1;
+	ctx = shd_create_tiered(BLOB_NAME("tier-invalid"), NULL, &s_hdr_info,
+			&s_metadata_hdr, tiers, 1);
+	CU_ASSERT_PTR_NULL(ctx);
+
+	tiers[0].factor = 2;
+	tiers[0].max_nb_samples = 0;
+	ctx = shd_create_tiered(BLOB_NAME("tier-invalid"), NULL, &s_hdr_info,
+			&s_metadata_hdr, tiers, 1);
+	CU_ASSERT_PTR_NULL(ctx);
+
+	ret = shd_get_read_factor(NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	tiers[0].max_nb_samples = 4;
+	ctx = shd_create_tiered(BLOB_NAME("tier-invalid"), NULL, &s_hdr_info,
+			&s_metadata_hdr, tiers, 1);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ctx);
+	ret = shd_tier_quantity(ctx, &q_s_blob_i1, SHD_TIER_MAX + 1, &q);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = shd_tier_quantity(ctx, NULL, SHD_TIER_MEAN, &q);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	shd_close(ctx, NULL);
+}
+
+CU_TestInfo s_tier_tests[] = {
+	{(char *)"aggregated tier samples", &test_tier_aggregate},
+	{(char *)"tiers without blob schema", &test_tier_decimate},
+	{(char *)"invalid arguments", &test_tier_invalid},
+	CU_TEST_INFO_NULL,
+};